@@ -0,0 +1,395 @@
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <detail/path_aggregation_ops.hpp>
+#include <detail/winner_takes_all_ops.hpp>
+
+#include "benchmark_util.hpp"
+
+namespace sgm_cpu {
+namespace bench {
+
+// Tune with another cost layout, see cost_layout.hpp
+template <class Base, class Layout>
+struct LayoutTune {
+  using simd = typename Base::simd;
+  using census = typename Base::census;
+
+  struct aggregation {
+    using cost_layout = Layout;
+  };
+};
+
+// Which step of the non-fused pipeline a cost_layout benchmark times
+enum class Step {
+  COST,
+  VERTICAL,
+  HORIZONTAL,
+};
+
+template <class Tune>
+struct RegisterAggregation {
+  using Ops = detail::PathAggregationOps<Tune>;
+
+  static constexpr int P = Ops::consts::patch_size;
+
+  void operator()(const std::string &tune_name) const {
+    const std::string patch =
+      std::to_string(P) + "x" + std::to_string(P);
+
+    for (const Resolution &res : resolutions) {
+      for (int D : disparity_sizes) {
+        const std::string suffix = "/" + tune_name + "/" + res.name + "/" +
+          std::to_string(D);
+
+        benchmark::RegisterBenchmark(
+            ("aggregate_patch_" + patch + suffix).c_str(),
+            aggregate_patch<false>, res.width, res.height, D)
+          ->Unit(benchmark::kMillisecond);
+
+        benchmark::RegisterBenchmark(
+            ("aggregate_edge_patch_" + patch + suffix).c_str(),
+            aggregate_patch<true>, res.width, res.height, D)
+          ->Unit(benchmark::kMillisecond);
+
+        benchmark::RegisterBenchmark(
+            ("execute_vertical_row" + suffix).c_str(),
+            execute_vertical_row, res.width, res.height, D)
+          ->Unit(benchmark::kMillisecond);
+
+        benchmark::RegisterBenchmark(
+            ("execute_horizontal_row" + suffix).c_str(),
+            execute_horizontal_row, res.width, res.height, D)
+          ->Unit(benchmark::kMillisecond);
+
+        benchmark::RegisterBenchmark(
+            ("winner_takes_all" + suffix).c_str(),
+            winner_takes_all, res.width, res.height, D, SubpixelFit::NONE,
+            false)
+          ->Unit(benchmark::kMillisecond);
+
+        benchmark::RegisterBenchmark(
+            ("winner_takes_all_lr_check" + suffix).c_str(),
+            winner_takes_all, res.width, res.height, D, SubpixelFit::NONE,
+            true)
+          ->Unit(benchmark::kMillisecond);
+
+        benchmark::RegisterBenchmark(
+            ("winner_takes_all_subpixel" + suffix).c_str(),
+            winner_takes_all, res.width, res.height, D,
+            SubpixelFit::EQUIANGULAR, false)
+          ->Unit(benchmark::kMillisecond);
+
+        const std::pair<const char *, CostPacking> packings[] = {
+          { "byte", CostPacking::BYTE },
+          { "six_bit", CostPacking::SIX_BIT },
+          { "four_bit", CostPacking::FOUR_BIT },
+        };
+
+        for (const auto &packing : packings) {
+          benchmark::RegisterBenchmark(
+              ("cost_volume_" + std::string(packing.first) + suffix).c_str(),
+              cost_volume, res.width, res.height, D, packing.second)
+            ->Unit(benchmark::kMillisecond);
+        }
+
+        register_layout<CostLayoutPlanes>("planes", suffix, res, D);
+        register_layout<CostLayoutTiled>("tiled", suffix, res, D);
+        register_layout<CostLayoutInterleaved>("interleaved", suffix, res, D);
+      }
+    }
+  }
+
+  template <class Layout>
+  static void register_layout(const std::string &name,
+      const std::string &suffix, const Resolution &res, int D) {
+
+    const std::pair<const char *, Step> steps[] = {
+      { "cost", Step::COST },
+      { "vertical", Step::VERTICAL },
+      { "horizontal", Step::HORIZONTAL },
+    };
+
+    for (const auto &step : steps) {
+      benchmark::RegisterBenchmark(
+          ("cost_layout_" + name + "_" + step.first + suffix).c_str(),
+          cost_layout<Layout>, res.width, res.height, D, step.second)
+        ->Unit(benchmark::kMillisecond);
+    }
+  }
+
+  static int padded(int width) {
+    return (width + P - 1) / P * P;
+  }
+
+  // The matching cost of a whole frame, a row at a time into one row buffer
+  // so that 4K at 256 disparities does not need 2GB.
+  template <bool is_edge_block>
+  static void aggregate_patch(benchmark::State &state, int width,
+      int height, int disparity_size) {
+
+    const int W = padded(width);
+    const int D = disparity_size;
+
+    const std::vector<uint32_t> &left = random_descriptors(W, height);
+    const std::vector<uint32_t> &right = random_descriptors(W + D, height);
+
+    std::vector<cost_type> dst(static_cast<size_t>(D) * W);
+
+    typename Ops::PatchLayout layout;
+
+    for (auto _ : state) {
+      for (int y = 0; y < height; y += 1) {
+        const feature_type *l = left.data() + y*W;
+        const feature_type *r = right.data() + y*(W + D) + D;
+
+        for (int x0 = 0; x0 < W; x0 += P) {
+          Ops::tune::simd::load_w4(layout.left, l + x0);
+
+          for (int d0 = 0; d0 < D; d0 += P) {
+            Ops::tune::simd::load_w4(layout.right[0], r + x0 - d0 - P);
+            Ops::tune::simd::load_w4(layout.right[1], r + x0 - d0);
+
+            if (is_edge_block) {
+              Ops::aggregate_edge_patch(&layout, dst.data() + d0*W + x0, W);
+            } else {
+              Ops::aggregate_patch(&layout, dst.data() + d0*W + x0, W);
+            }
+          }
+        }
+      }
+      benchmark::DoNotOptimize(dst.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, static_cast<double>(W) * height);
+  }
+
+  // The vertical and both diagonal paths from one row to the next, over the
+  // rows of a frame. The cost row is reused, which leaves it in cache.
+  static void execute_vertical_row(benchmark::State &state, int width,
+      int height, int disparity_size) {
+
+    const int W = padded(width);
+    const int D = disparity_size;
+
+    const std::vector<uint32_t> &left = random_descriptors(W, 1);
+    const std::vector<uint32_t> &right = random_descriptors(W, 2);
+
+    std::vector<cost_type> cost(static_cast<size_t>(D) * W);
+    std::vector<cost_sum_type> sum(static_cast<size_t>(D) * W, 0);
+    const detail::CostVolume volume(cost.data());
+    Ops::execute_cost_row(left.data(), right.data(), W, D, volume);
+
+    const detail::PathStateLayout layout(W, D);
+    std::vector<uint8_t> state_buffer(2 * 3 * layout.path_size());
+    uint8_t *prev = state_buffer.data();
+    uint8_t *cur = prev + 3*layout.path_size();
+    layout.reset(prev, 3);
+    layout.reset(cur, 3);
+
+    for (auto _ : state) {
+      for (int y = 0; y < height; y += 1) {
+        Ops::execute_vertical_row(volume, W, width, D, 10, 120, 3,
+            prev, cur, sum.data());
+        std::swap(prev, cur);
+      }
+      benchmark::DoNotOptimize(sum.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, static_cast<double>(W) * height);
+  }
+
+  static void execute_horizontal_row(benchmark::State &state, int width,
+      int height, int disparity_size) {
+
+    const int W = padded(width);
+    const int D = disparity_size;
+
+    const std::vector<uint32_t> &left = random_descriptors(W, 1);
+    const std::vector<uint32_t> &right = random_descriptors(W, 2);
+
+    std::vector<cost_type> cost(static_cast<size_t>(D) * W);
+    std::vector<cost_sum_type> sum(static_cast<size_t>(D) * W, 0);
+    const detail::CostVolume volume(cost.data());
+    Ops::execute_cost_row(left.data(), right.data(), W, D, volume);
+
+    for (auto _ : state) {
+      for (int y = 0; y < height; y += 1) {
+        Ops::execute_horizontal_row(volume, W, width, D, 10, 120,
+            (y % 2) != 0, sum.data());
+      }
+      benchmark::DoNotOptimize(sum.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, static_cast<double>(W) * height);
+  }
+
+  // The disparities of a frame from one row of sums, whole or with a
+  // fraction, and with or without the right view and the left-right check
+  static void winner_takes_all(benchmark::State &state, int width,
+      int height, int disparity_size, SubpixelFit fit, bool lr_check) {
+
+    using WtaOps = detail::WinnerTakesAllOps<Tune>;
+
+    const int W = padded(width);
+    const int D = disparity_size;
+
+    std::vector<cost_sum_type> sum(static_cast<size_t>(D) * W);
+    uint32_t seed = 1;
+    for (cost_sum_type &s : sum) {
+      seed = seed*1664525 + 1013904223;
+      s = static_cast<cost_sum_type>(seed >> 21);
+    }
+
+    std::vector<output_type> rows(2*W);
+
+    for (auto _ : state) {
+      for (int y = 0; y < height; y += 1) {
+        if (fit == SubpixelFit::NONE) {
+          WtaOps::execute_row(sum.data(), W, D, rows.data());
+        } else {
+          WtaOps::execute_subpixel_row(sum.data(), W, D, fit, 4, rows.data());
+        }
+
+        if (lr_check) {
+          WtaOps::execute_right_row(sum.data(), W, width, D, 0, 0xffff,
+              rows.data() + W);
+          WtaOps::execute_lr_check(rows.data(), rows.data() + W, width, 0, 1,
+              0xffff);
+        }
+      }
+      benchmark::DoNotOptimize(rows.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, static_cast<double>(W) * height);
+  }
+
+  // A whole frame's cost volume stored, then read back by the vertical
+  // paths, as StereoSGM does when not fused. Far too big for cache, so this
+  // is where packing pays.
+  static void cost_volume(benchmark::State &state, int width, int height,
+      int disparity_size, CostPacking packing) {
+
+    const int W = padded(width);
+    const int D = disparity_size;
+
+    const detail::CostVolumeLayout volume(W, D, packing);
+    const size_t volume_size = volume.row_size() * height;
+
+    if (volume_size > (size_t(1) << 30)) {
+      state.SkipWithError("cost volume over 1GB");
+      return;
+    }
+
+    const std::vector<uint32_t> &left = random_descriptors(W, height);
+    const std::vector<uint32_t> &right = random_descriptors(W, height);
+
+    std::vector<cost_type> cost(volume_size);
+    std::vector<cost_sum_type> sum(static_cast<size_t>(D) * W, 0);
+
+    const detail::PathStateLayout layout(W, D);
+    std::vector<uint8_t> state_buffer(2 * 3 * layout.path_size());
+    uint8_t *prev = state_buffer.data();
+    uint8_t *cur = prev + 3*layout.path_size();
+    layout.reset(prev, 3);
+    layout.reset(cur, 3);
+
+    for (auto _ : state) {
+      for (int y = 0; y < height; y += 1) {
+        Ops::execute_cost_row(left.data() + y*W, right.data() + y*W, W, D,
+            detail::CostVolume(cost.data() + y*volume.row_size(), W,
+              packing));
+      }
+      for (int y = 0; y < height; y += 1) {
+        Ops::execute_vertical_row(
+            detail::ConstCostVolume(cost.data() + y*volume.row_size(), W,
+              packing),
+            W, width, D, 10, 120, 3, prev, cur, sum.data());
+        std::swap(prev, cur);
+      }
+      benchmark::DoNotOptimize(sum.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, static_cast<double>(W) * height);
+  }
+
+  // One step over a whole frame's cost volume, stored in Layout. The volume
+  // is written once up front for the paths, which then read it all back.
+  template <class Layout>
+  static void cost_layout(benchmark::State &state, int width, int height,
+      int disparity_size, Step step) {
+
+    using LayoutOps = detail::PathAggregationOps<LayoutTune<Tune, Layout>>;
+
+    const int W = padded(width);
+    const int D = disparity_size;
+
+    const size_t row_size = static_cast<size_t>(D) * W;
+
+    if (row_size * height > (size_t(1) << 30)) {
+      state.SkipWithError("cost volume over 1GB");
+      return;
+    }
+
+    const std::vector<uint32_t> &left = random_descriptors(W, height);
+    const std::vector<uint32_t> &right = random_descriptors(W, height);
+
+    std::vector<cost_type> cost(row_size * height);
+    std::vector<cost_sum_type> sum(row_size, 0);
+
+    auto execute_cost = [&]() {
+      for (int y = 0; y < height; y += 1) {
+        LayoutOps::execute_cost_row(left.data() + y*W, right.data() + y*W,
+            W, D, detail::CostVolume(cost.data() + y*row_size));
+      }
+    };
+
+    const detail::PathStateLayout layout(W, D);
+    std::vector<uint8_t> state_buffer(2 * 3 * layout.path_size());
+    uint8_t *prev = state_buffer.data();
+    uint8_t *cur = prev + 3*layout.path_size();
+    layout.reset(prev, 3);
+    layout.reset(cur, 3);
+
+    if (step != Step::COST) {
+      execute_cost();
+    }
+
+    for (auto _ : state) {
+      for (int y = 0; (step != Step::COST) && (y < height); y += 1) {
+        const detail::ConstCostVolume c(cost.data() + y*row_size);
+
+        if (step == Step::VERTICAL) {
+          LayoutOps::execute_vertical_row(c, W, width, D, 10, 120, 3, prev,
+              cur, sum.data());
+          std::swap(prev, cur);
+        } else {
+          LayoutOps::execute_horizontal_row(c, W, width, D, 10, 120, false,
+              sum.data());
+          LayoutOps::execute_horizontal_row(c, W, width, D, 10, 120, true,
+              sum.data());
+        }
+      }
+
+      if (step == Step::COST) {
+        execute_cost();
+      }
+      benchmark::DoNotOptimize(cost.data());
+      benchmark::DoNotOptimize(sum.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, static_cast<double>(W) * height);
+  }
+};
+
+static const int registered = (for_each_tune<RegisterAggregation>(), 0);
+
+} // namespace bench
+} // namespace sgm_cpu
@@ -0,0 +1,54 @@
+#include <map>
+#include <utility>
+
+#include "benchmark_util.hpp"
+
+namespace sgm_cpu {
+namespace bench {
+
+const std::vector<uint8_t> &random_image(int width, int height) {
+  static std::map<std::pair<int, int>, std::vector<uint8_t>> images;
+
+  std::vector<uint8_t> &image = images[{ width, height }];
+  if (image.empty()) {
+    std::minstd_rand0 rng;
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    image.resize(static_cast<size_t>(width) * height);
+    for (uint8_t &p : image) {
+      p = dist(rng);
+    }
+  }
+  return image;
+}
+
+const std::vector<uint32_t> &random_descriptors(int width, int height) {
+  static std::map<std::pair<int, int>, std::vector<uint32_t>> descriptors;
+
+  std::vector<uint32_t> &desc = descriptors[{ width, height }];
+  if (desc.empty()) {
+    std::minstd_rand0 rng;
+
+    desc.resize(static_cast<size_t>(width) * height);
+    for (uint32_t &d : desc) {
+      d = rng();
+    }
+  }
+  return desc;
+}
+
+void set_pixel_counters(benchmark::State &state, double pixels) {
+  const double cycles_per_second = benchmark::CPUInfo::Get().cycles_per_second;
+
+  // printed as a rate, Mpix=.../s
+  state.counters["Mpix"] = benchmark::Counter(pixels * 1e-6,
+      benchmark::Counter::kIsIterationInvariantRate);
+
+  // the rate of pixels / cycles_per_second, inverted (printed in "s")
+  state.counters["cycles/pix"] = benchmark::Counter(pixels / cycles_per_second,
+      benchmark::Counter::kIsIterationInvariantRate |
+      benchmark::Counter::kInvert);
+}
+
+} // namespace bench
+} // namespace sgm_cpu
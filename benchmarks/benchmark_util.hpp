@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <tune/array128_tune.hpp>
+
+#if defined(__SSSE3__)
+#include <tune/sse128_tune.hpp>
+#endif
+
+#if defined(__AVX2__)
+#include <tune/avx2_tune.hpp>
+#endif
+
+#if defined(__AVX512BW__) && defined(__AVX512VPOPCNTDQ__)
+#include <tune/avx512_tune.hpp>
+#endif
+
+#if defined(__aarch64__)
+#include <tune/neon128_tune.hpp>
+#endif
+
+namespace sgm_cpu {
+namespace bench {
+
+// Every native tune the benchmark was compiled for. Unlike the tests, NEON
+// emulation is left out, its timings mean nothing.
+template <template <class> class F>
+void for_each_tune() {
+  F<tune::Array128>()("array128");
+#if defined(__SSSE3__)
+  F<tune::Sse128>()("sse128");
+#endif
+#if defined(__AVX2__)
+  F<tune::Avx2>()("avx2");
+#endif
+#if defined(__AVX512BW__) && defined(__AVX512VPOPCNTDQ__)
+  F<tune::Avx512>()("avx512");
+#endif
+#if defined(__aarch64__)
+  F<tune::Neon128>()("neon128");
+#endif
+}
+
+struct Resolution {
+  const char *name;
+  int width;
+  int height;
+};
+
+static constexpr Resolution resolutions[] = {
+  { "vga", 640, 480 },
+  { "720p", 1280, 720 },
+  { "1080p", 1920, 1080 },
+  { "4k", 3840, 2160 },
+};
+
+static constexpr int disparity_sizes[] = { 64, 128, 256 };
+
+// Inputs are generated once per size and kept for the whole run
+const std::vector<uint8_t> &random_image(int width, int height);
+const std::vector<uint32_t> &random_descriptors(int width, int height);
+
+// Mpix/s and cycles/pixel for pixels processed per iteration. Cycles are
+// derived from the measured time and the nominal clock that google-benchmark
+// reports, so they are only as good as that with frequency scaling.
+void set_pixel_counters(benchmark::State &state, double pixels);
+
+} // namespace bench
+} // namespace sgm_cpu
@@ -0,0 +1,263 @@
+#include <string>
+#include <vector>
+
+#include <census_stream.hpp>
+#include <detail/census_ops.hpp>
+
+#include "benchmark_util.hpp"
+
+namespace sgm_cpu {
+namespace bench {
+
+// Base with another census window, and input type
+template <class Base, class Window, class Input = char>
+struct WindowTune {
+  using simd = typename Base::simd;
+
+  struct census {
+    static constexpr int h_block = Base::census::h_block;
+    static constexpr int v_block = Base::census::v_block;
+
+    static constexpr int h_step = Base::census::h_step;
+    static constexpr int v_step = Base::census::v_step;
+
+    using window = Window;
+    using input_type = Input;
+  };
+};
+
+template <class Tune>
+struct RegisterCensus {
+  using Ops = detail::CensusOps<Tune>;
+  using feature_type = typename Ops::feature_type;
+
+  void operator()(const std::string &tune_name) const {
+    for (const Resolution &res : resolutions) {
+      benchmark::RegisterBenchmark(
+          ("execute_census/" + tune_name + "/" + res.name).c_str(),
+          execute_census, res.width, res.height)
+        ->Unit(benchmark::kMillisecond);
+    }
+
+    // the other windows at 1080p
+    benchmark::RegisterBenchmark(
+        ("execute_census_5x5/" + tune_name + "/1080p").c_str(),
+        RegisterCensus<WindowTune<Tune, CensusWindow5x5>>::execute_census,
+        1920, 1080)
+      ->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark(
+        ("execute_census_7x7/" + tune_name + "/1080p").c_str(),
+        RegisterCensus<WindowTune<Tune, CensusWindow7x7>>::execute_census,
+        1920, 1080)
+      ->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark(
+        ("execute_census_11x9/" + tune_name + "/1080p").c_str(),
+        RegisterCensus<WindowTune<Tune, CensusWindow11x9>>::execute_census,
+        1920, 1080)
+      ->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark(
+        ("execute_census_yuyv/" + tune_name + "/1080p").c_str(),
+        execute_census_yuyv, 1920, 1080)
+      ->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark(
+        ("execute_census_border/" + tune_name + "/1080p").c_str(),
+        execute_census_border, 1920, 1080)
+      ->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark(
+        ("execute_census_rois/" + tune_name + "/1080p").c_str(),
+        execute_census_rois, 1920, 1080)
+      ->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark(
+        ("census_stream/" + tune_name + "/1080p").c_str(),
+        census_stream, 1920, 1080)
+      ->Unit(benchmark::kMillisecond);
+
+    // 16-bit input
+    benchmark::RegisterBenchmark(
+        ("execute_census_16bit/" + tune_name + "/1080p").c_str(),
+        RegisterCensus<WindowTune<Tune, CensusWindow9x7, uint16_t>>::
+          execute_census, 1920, 1080)
+      ->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark(
+        ("execute_block_x2/" + tune_name).c_str(), execute_block_x2<false>);
+
+    benchmark::RegisterBenchmark(
+        ("execute_block_x2_sliding/" + tune_name).c_str(),
+        execute_block_x2<true>);
+
+    benchmark::RegisterBenchmark(
+        ("execute_patch_x2/" + tune_name).c_str(), execute_patch_x2);
+  }
+
+  static void execute_census(benchmark::State &state, int width, int height) {
+    using input_type = typename Ops::input_type;
+
+    // the same bytes, read two at a time for 16-bit input
+    const std::vector<uint8_t> &image =
+      random_image(width * sizeof(input_type), height);
+    const input_type *src = reinterpret_cast<const input_type *>(image.data());
+
+    const int dst_width = width - (Ops::consts::feature_width - 1);
+    const int dst_height = height - (Ops::consts::feature_height - 1);
+    std::vector<feature_type> dst(static_cast<size_t>(dst_width) * dst_height);
+
+    for (auto _ : state) {
+      Ops::execute_census(src, dst.data(), width, height, width, dst_width);
+      benchmark::DoNotOptimize(dst.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, static_cast<double>(dst_width) * dst_height);
+  }
+
+  // Luma read in place, against execute_census on a Y plane
+  static void execute_census_yuyv(benchmark::State &state, int width,
+      int height) {
+
+    const std::vector<uint8_t> &image = random_image(2*width, height);
+    const char *src = reinterpret_cast<const char *>(image.data());
+
+    const int dst_width = width - (Ops::consts::feature_width - 1);
+    const int dst_height = height - (Ops::consts::feature_height - 1);
+    std::vector<feature_type> dst(static_cast<size_t>(dst_width) * dst_height);
+
+    for (auto _ : state) {
+      Ops::execute_census(src, dst.data(), width, height, 2*width, dst_width,
+          PixelFormat::YUYV);
+      benchmark::DoNotOptimize(dst.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, static_cast<double>(dst_width) * dst_height);
+  }
+
+  // Full size output, the edges replicated
+  static void execute_census_border(benchmark::State &state, int width,
+      int height) {
+
+    const std::vector<uint8_t> &image = random_image(width, height);
+    const char *src = reinterpret_cast<const char *>(image.data());
+
+    std::vector<feature_type> dst(static_cast<size_t>(width) * height);
+
+    for (auto _ : state) {
+      Ops::execute_census(src, dst.data(), width, height, width, width,
+          PixelFormat::GRAY, CensusBorder::REPLICATE);
+      benchmark::DoNotOptimize(dst.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, static_cast<double>(width) * height);
+  }
+
+  // Four 160x120 tracking windows, two of them overlapping
+  static void execute_census_rois(benchmark::State &state, int width,
+      int height) {
+
+    const std::vector<uint8_t> &image = random_image(width, height);
+    const char *src = reinterpret_cast<const char *>(image.data());
+
+    const int dst_width = width - 8;
+    std::vector<feature_type> dst(static_cast<size_t>(dst_width) * (height - 6));
+
+    const std::vector<Rect> rois = { { 100, 100, 160, 120 },
+      { 200, 150, 160, 120 }, { 900, 500, 160, 120 },
+      { 1600, 800, 160, 120 } };
+
+    for (auto _ : state) {
+      Ops::execute_census_rois(src, dst.data(), width, height, width,
+          dst_width, rois);
+      benchmark::DoNotOptimize(dst.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, 4 * 160 * 120);
+  }
+
+  // A row at a time through the ring buffer, against execute_census on the
+  // whole frame
+  static void census_stream(benchmark::State &state, int width, int height) {
+    const std::vector<uint8_t> &image = random_image(width, height);
+    const char *src = reinterpret_cast<const char *>(image.data());
+
+    CensusStream<Tune> stream;
+
+    for (auto _ : state) {
+      stream.begin(width, height);
+      for (int y = 0; y < height; y += 1) {
+        stream.push_row(src + y*width);
+      }
+      benchmark::DoNotOptimize(stream.get_output());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state,
+        static_cast<double>(stream.get_width()) * stream.get_height());
+  }
+
+  // One block, small enough to stay in cache, so independent of resolution
+  template <bool sliding>
+  static void execute_block_x2(benchmark::State &state) {
+    constexpr int W = Tune::census::h_block;
+    constexpr int H = Tune::census::v_block;
+
+    const std::vector<uint8_t> &image = random_image(W + 8, H + 6);
+    const char *src = reinterpret_cast<const char *>(image.data());
+
+    std::vector<feature_type> dst(W * H);
+
+    for (auto _ : state) {
+      if (sliding) {
+        Ops::execute_block_x2_sliding(src, dst.data(), W, H, W + 8, W);
+      } else {
+        Ops::execute_block_x2(src, dst.data(), W, H, W + 8, W);
+      }
+      benchmark::DoNotOptimize(dst.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, W * H);
+  }
+
+  // Loading the rows of one patch and computing its h_step x v_step
+  // descriptors, as the inner loop of execute_block_x2 does
+  static void execute_patch_x2(benchmark::State &state) {
+    using simd = typename Tune::simd;
+
+    constexpr int W = Ops::consts::h_patch;
+    constexpr int H = Ops::consts::v_patch;
+    constexpr int dst_pitch = Tune::census::h_step;
+
+    const std::vector<uint8_t> &image = random_image(W, H + 1);
+
+    std::vector<feature_type> dst(dst_pitch * Ops::consts::v_rows);
+
+    typename Ops::PatchLayout r;
+
+    for (auto _ : state) {
+      const uint8_t *row0 = image.data();
+      for (size_t i = 0; i < r.row2.size(); i += 1) {
+        simd::load_row2(r.row2[i], row0, W);
+        row0 += 2*W;
+      }
+
+      Ops::execute_patch_x2(r, dst.data(), dst_pitch);
+      benchmark::DoNotOptimize(dst.data());
+      benchmark::ClobberMemory();
+    }
+
+    set_pixel_counters(state, Tune::census::h_step * Tune::census::v_step);
+  }
+};
+
+static const int registered = (for_each_tune<RegisterCensus>(), 0);
+
+} // namespace bench
+} // namespace sgm_cpu
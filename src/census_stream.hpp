@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <types.hpp>
+#include <census_transform.hpp>
+
+namespace sgm_cpu {
+
+// Census of a frame that arrives a row at a time, as from a line-buffered
+// sensor. Only the last v_band input rows (the window height plus v_step,
+// rounded up to the kernel's rows) are kept, in a ring the band kernel
+// reads through a table of row pointers, and each band of features is
+// computed as soon as its input rows are in, so the top of the frame is
+// ready long before the bottom is read out. tune::Dispatch streams through
+// the band kernel of the active backend.
+//
+// The output is the same as CensusTransform::execute on the whole frame,
+// with CensusBorder::CROP only. The other borders fill in the edge features
+// from strips down the full height of the frame, which a band at a time
+// does not have, so begin() rejects them.
+template <class Arch>
+class CensusStream {
+
+ public:
+  using input_type = typename CensusTransform<Arch>::input_type;
+  using feature_type = typename CensusTransform<Arch>::feature_type;
+
+ private:
+  std::unique_ptr<feature_type[]> m_feature_buffer;
+  std::unique_ptr<input_type[]> m_row_buffer;
+
+  // the input rows of the next band, in order, within m_row_buffer
+  std::vector<const input_type *> m_band;
+
+  // allocated sizes of the buffers, in features and pixels
+  size_t m_buffer_size;
+  size_t m_row_buffer_size;
+
+  int m_width;
+  int m_height;
+  int m_pitch;
+
+  int m_input_width;
+  int m_input_height;
+  PixelFormat m_format;
+
+  CensusBorder m_border;
+
+  // input rows pushed, and output rows final
+  int m_rows_in;
+  int m_rows_out;
+
+ public:
+  explicit CensusStream(CensusBorder border = CensusBorder::CROP);
+
+  // Starts a frame of width x height input pixels, dropping any frame in
+  // progress. Returns false if the frame is too small, the format does not
+  // suit the tune or the border is not CROP. Buffers are kept between frames
+  // as in CensusTransform.
+  bool begin(
+      int width,
+      int height,
+      int dst_pitch = -1,
+      PixelFormat format = PixelFormat::GRAY);
+
+  // Adds the next row of the frame, width pixels (2 * width bytes for
+  // YUYV). The row is copied, so it may be reused once this returns.
+  // Returns the number of output rows now final.
+  int push_row(const input_type *row);
+
+  // Output rows 0 to get_rows_ready() - 1 hold their final features. Rows
+  // become ready in bands of v_step (rounded up to the kernel's rows), and
+  // all of them once the last input row is pushed.
+  int get_rows_ready() const { return m_rows_out; }
+
+  bool is_complete() const {
+    return (m_height > 0) && (m_rows_out == m_height);
+  }
+
+  const feature_type *get_output() const {
+    return m_feature_buffer.get();
+  }
+
+  // As CensusTransform
+  int get_width() const { return m_width; }
+  int get_height() const { return m_height; }
+  int get_pitch() const { return m_pitch; }
+};
+
+}
+
+#include <detail/census_stream_impl.hpp>
@@ -1,37 +1,179 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 #include <types.hpp>
+#include <census_window.hpp>
+#include <thread_pool.hpp>
 
 namespace sgm_cpu {
 
+namespace detail {
+
+template <class Tune, class = void>
+struct census_input {
+  using type = char;
+};
+
+template <class Tune>
+struct census_input<Tune, std::void_t<typename Tune::census::input_type>> {
+  using type = typename Tune::census::input_type;
+};
+
+} // namespace detail
+
+// Layout of the input image. Census only reads luma, so a NV12 (or any
+// planar YUV) frame is passed as GRAY by its Y plane and pitch.
+enum class PixelFormat {
+  GRAY,
+  // 4:2:2 Y0 U Y1 V, 2 bytes per pixel. Luma is read in place, src_pitch
+  // is in bytes.
+  YUYV,
+};
+
+// Features of the pixels within window/2 of the image edge, where the
+// census window does not fit. CROP leaves them out, so the output is
+// window - 1 smaller than the input. The others give a full size output,
+// reading pixels beyond the edge as 0 (ZERO), as the nearest edge pixel
+// (REPLICATE), or mirrored about the edge pixel, so x = -1 reads x = 1
+// (REFLECT).
+enum class CensusBorder {
+  CROP,
+  ZERO,
+  REPLICATE,
+  REFLECT,
+};
+
 template <class Arch>
 class CensusTransform {
 
  public:
-  // other input widths will require a new set of SIMD implementations
-	using input_type = char;
+  // 8-bit pixels, or uint16_t when the tune sets
+  // `using input_type = uint16_t` in its census struct, for 10 to 16-bit
+  // cameras. Pitches are in pixels either way.
+  using input_type = typename detail::census_input<Arch>::type;
+
+  // feature_type, or the descriptor of the tune's census window (16 bits for
+  // CensusWindow5x5, 64 for CensusWindow11x9)
+  using feature_type = detail::census_feature_t<Arch>;
 
  private:
   std::unique_ptr<feature_type[]> m_feature_buffer;
 
+  // allocated size of m_feature_buffer, in features
+  size_t m_buffer_size;
+
+  int m_width;
+  int m_height;
+  int m_pitch;
+
+  CensusBorder m_border;
+
  public:
-	CensusTransform();
+	explicit CensusTransform(CensusBorder border = CensusBorder::CROP);
 
 	const feature_type *get_output() const {
 		return m_feature_buffer.get();
 	}
+
+  // Dimensions of the last output. The feature window does not fit over the
+  // image border, so with the default 9x7 window the output is 8 columns
+  // narrower and 6 rows shorter than the input, and starts at input pixel
+  // (4, 3). Other windows (Tune::census::window) see census_window.hpp.
+  // With any border but CROP the output is the size of the input. Columns
+  // from get_width() to get_pitch() are not written.
+  int get_width() const { return m_width; }
+  int get_height() const { return m_height; }
+  int get_pitch() const { return m_pitch; }
 	
+  // The feature buffer is kept between calls and only reallocated when it
+  // needs to grow, so repeated calls at one resolution do not allocate.
+  // dst_pitch = -1 packs the output rows (pitch = output width). An input
+  // smaller than CensusOps::min_width() x min_height() (a backend patch of
+  // features plus the window border) is rejected, keeping the last output.
 	void execute(
       const input_type *src,
       int width,
       int height,
       int src_pitch,
-      int dst_pitch = -1);
+      int dst_pitch = -1,
+      PixelFormat format = PixelFormat::GRAY);
+
+  // As above, with the blocks of the image shared out over pool. The output
+  // is the same whatever the number of threads.
+  void execute(
+      const input_type *src,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      ThreadPool &pool,
+      PixelFormat format = PixelFormat::GRAY);
+
+  // Only the features of the pixels in rois (in input pixels), by the
+  // blocks of CensusOps::roi_blocks. Blocks shared by overlapping rois are
+  // computed once. The rest of the output, including the border of a full
+  // size output, keeps whatever the buffer held.
+  void execute(
+      const input_type *src,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      const std::vector<Rect> &rois,
+      PixelFormat format = PixelFormat::GRAY);
+
+  void execute(
+      const input_type *src,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      const std::vector<Rect> &rois,
+      ThreadPool &pool,
+      PixelFormat format = PixelFormat::GRAY);
+
+  // Both images of a stereo pair in one parallel loop, so the threads stay
+  // busy across the pair rather than waiting at the end of each image.
+  static void execute_pair(
+      CensusTransform &left,
+      CensusTransform &right,
+      const input_type *left_src,
+      const input_type *right_src,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      ThreadPool &pool,
+      PixelFormat format = PixelFormat::GRAY);
 
  private:
+  // Checks the size and format and sets up the output for a frame, false
+  // on error
+  bool prepare(int width, int height, int dst_pitch, PixelFormat format);
+
+  // The census blocks, then the edges of a full size output
+  int n_edges(int n_blocks) const {
+    return ((n_blocks > 0) && (m_border != CensusBorder::CROP)) ? 4 : 0;
+  }
+
+  void execute_task(
+      const input_type *src,
+      int width,
+      int height,
+      int src_pitch,
+      PixelFormat format,
+      int task,
+      int n_blocks);
+
+  // where the blocks of CensusOps write, past the border of a full size
+  // output
+  feature_type *interior();
 };
 
 }
 
+#include <detail/census_transform_impl.hpp>
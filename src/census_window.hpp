@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace sgm_cpu {
+
+// One bit of a census descriptor: set when the pixel at (x0, y0) of the
+// window is less than the pixel at (x1, y1).
+struct CensusPair {
+  int x0, y0;
+  int x1, y1;
+};
+
+namespace detail {
+
+// Center-symmetric pairs of a width x height window, each pixel before the
+// center (in raster order) against its mirror image through the center.
+template <int width, int height>
+constexpr std::array<CensusPair, (width * height) / 2> symmetric_pairs() {
+  std::array<CensusPair, (width * height) / 2> pairs = {};
+
+  for (int i = 0; i < (width * height) / 2; i += 1) {
+    const int x = i % width;
+    const int y = i / width;
+    pairs[i] = { x, y, width - 1 - x, height - 1 - y };
+  }
+  return pairs;
+}
+
+// True if the pairs of Window are symmetric_pairs, in their order. The 8-bit
+// census computes those with a shuffle schedule, other tables pair by pair.
+template <class Window>
+constexpr bool is_symmetric_window() {
+  constexpr auto pairs = symmetric_pairs<Window::width, Window::height>();
+
+  if (Window::pairs.size() != pairs.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < pairs.size(); i += 1) {
+    const CensusPair &a = Window::pairs[i];
+    const CensusPair &b = pairs[i];
+    if ((a.x0 != b.x0) || (a.y0 != b.y0) || (a.x1 != b.x1) ||
+        (a.y1 != b.y1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace detail
+
+// Census windows a tune may select with `using window = ...` in its census
+// struct. The output of a width x height window is width - 1 columns
+// narrower and height - 1 rows shorter than the input, and starts at input
+// pixel (width/2, height/2). Bit i of a descriptor is pairs[i], and
+// feature_type is the smallest of 16, 32 or 64 bits that holds them all.
+
+// The default, 31 center-symmetric pairs. Its bit order is the one of the
+// hand-scheduled kernel in CensusOps::execute_patch_x2.
+struct CensusWindow9x7 {
+  static constexpr int width = 9;
+  static constexpr int height = 7;
+
+  using feature_type = uint32_t;
+
+  static constexpr std::array<CensusPair, 31> pairs = {{
+    {0, 0, 8, 6}, {0, 2, 8, 4}, {0, 4, 8, 2}, {0, 6, 8, 0},
+    {0, 1, 8, 5}, {0, 3, 8, 3}, {0, 5, 8, 1}, {4, 0, 4, 6},
+
+    {1, 0, 7, 6}, {1, 2, 7, 4}, {1, 4, 7, 2}, {1, 6, 7, 0},
+    {1, 1, 7, 5}, {1, 3, 7, 3}, {1, 5, 7, 1}, {4, 2, 4, 4},
+
+    {2, 0, 6, 6}, {2, 2, 6, 4}, {2, 4, 6, 2}, {2, 6, 6, 0},
+    {2, 1, 6, 5}, {2, 3, 6, 3}, {2, 5, 6, 1}, {4, 1, 4, 5},
+
+    {3, 0, 5, 6}, {3, 2, 5, 4}, {3, 4, 5, 2}, {3, 6, 5, 0},
+    {3, 1, 5, 5}, {3, 3, 5, 3}, {3, 5, 5, 1} }};
+};
+
+// 12 pairs, the cheapest to compute, match and store
+struct CensusWindow5x5 {
+  static constexpr int width = 5;
+  static constexpr int height = 5;
+
+  using feature_type = uint16_t;
+
+  static constexpr auto pairs = detail::symmetric_pairs<5, 5>();
+};
+
+// 24 pairs
+struct CensusWindow7x7 {
+  static constexpr int width = 7;
+  static constexpr int height = 7;
+
+  using feature_type = uint32_t;
+
+  static constexpr auto pairs = detail::symmetric_pairs<7, 7>();
+};
+
+// 49 pairs, the most robust to noise and the most expensive: the matching
+// cost takes two 32-bit halves of each descriptor
+struct CensusWindow11x9 {
+  static constexpr int width = 11;
+  static constexpr int height = 9;
+
+  using feature_type = uint64_t;
+
+  static constexpr auto pairs = detail::symmetric_pairs<11, 9>();
+};
+
+namespace detail {
+
+template <class Tune, class = void>
+struct census_window {
+  using type = CensusWindow9x7;
+};
+
+template <class Tune>
+struct census_window<Tune, std::void_t<typename Tune::census::window>> {
+  using type = typename Tune::census::window;
+};
+
+// Tune::census::window, CensusWindow9x7 if the tune does not name one (or
+// has no census struct, as tune::Dispatch whose backends are all 9x7)
+template <class Tune>
+using census_window_t = typename census_window<Tune>::type;
+
+// The census descriptor of Tune, feature_type unless its window is not 9x7
+template <class Tune>
+using census_feature_t = typename census_window_t<Tune>::feature_type;
+
+} // namespace detail
+
+} // namespace sgm_cpu
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace sgm_cpu {
+
+// Layouts of a stored cost volume a tune may select with `using
+// cost_layout = ...` in its aggregation struct. Each image row of the
+// volume is `rows` rows of costs (one per disparity, fewer when packed, see
+// CostVolumeLayout), and the kernels work on patches of patch_size pixels.
+// Row r of pixel x0 + i in the patch at x0 is at
+//
+//   patch(x0, rows, pitch) + r*row_pitch(rows, pitch, patch_size)
+//     + i*pixel_pitch(rows)
+//
+// where pitch is the pitch the kernels are given, width for StereoSGM.
+// The layout is fixed at compile time, so the kernels are built for it.
+
+// The default, disparity-major: a plane of width costs per disparity,
+// pitch apart. A disparity of a patch is one register load, as the
+// vertical paths take it.
+struct CostLayoutPlanes {
+  static constexpr size_t patch(int x0, int rows, int pitch) {
+    return x0;
+  }
+
+  static constexpr int row_pitch(int rows, int pitch, int patch_size) {
+    return pitch;
+  }
+
+  static constexpr int pixel_pitch(int rows) {
+    return 1;
+  }
+};
+
+// Planes cut into tiles of patch_size pixels by all disparities, each tile
+// contiguous. A patch reads one stream of memory rather than one per
+// disparity. pitch is not used.
+struct CostLayoutTiled {
+  static constexpr size_t patch(int x0, int rows, int pitch) {
+    return static_cast<size_t>(x0) * rows;
+  }
+
+  static constexpr int row_pitch(int rows, int pitch, int patch_size) {
+    return patch_size;
+  }
+
+  static constexpr int pixel_pitch(int rows) {
+    return 1;
+  }
+};
+
+// Pixel-major: the costs of a pixel contiguous, as the paths along the row
+// use them. Patches are transposed on load in blocks of patch_size, which
+// the horizontal paths save and the vertical paths pay. Byte costs only,
+// pitch is not used.
+struct CostLayoutInterleaved {
+  static constexpr size_t patch(int x0, int rows, int pitch) {
+    return static_cast<size_t>(x0) * rows;
+  }
+
+  static constexpr int row_pitch(int rows, int pitch, int patch_size) {
+    return 1;
+  }
+
+  static constexpr int pixel_pitch(int rows) {
+    return rows;
+  }
+};
+
+namespace detail {
+
+template <class Tune, class = void>
+struct cost_layout {
+  using type = CostLayoutPlanes;
+};
+
+template <class Tune>
+struct cost_layout<Tune,
+    std::void_t<typename Tune::aggregation::cost_layout>> {
+  using type = typename Tune::aggregation::cost_layout;
+};
+
+// Tune::aggregation::cost_layout, CostLayoutPlanes if the tune does not
+// name one (or has no aggregation struct, as tune::Dispatch)
+template <class Tune>
+using cost_layout_t = typename cost_layout<Tune>::type;
+
+// Pixel-major layouts, whose patches are transposed on load and store
+template <class Layout>
+constexpr bool is_pixel_major() {
+  return Layout::pixel_pitch(2) != 1;
+}
+
+} // namespace detail
+
+} // namespace sgm_cpu
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <types.hpp>
+
+namespace sgm_cpu {
+namespace detail {
+
+// Path costs execute_vertical_row keeps from one row to the next. For each
+// path there are disparity_size rows of width costs, a sentinel row above
+// and below (d = -1 and d = disparity_size, always 0xff), and a row with the
+// minimum over d at each x. Every row has pad zero bytes either side, so the
+// diagonal paths can read one pixel beyond the image as a path start.
+struct PathStateLayout {
+  static constexpr int pad = 64;
+
+  int pitch;
+  int disparity_size;
+
+  PathStateLayout(int width, int disparity_size) :
+    pitch(width + 2*pad),
+    disparity_size(disparity_size) {
+  }
+
+  size_t path_size() const {
+    return static_cast<size_t>(disparity_size + 3) * pitch;
+  }
+
+  uint8_t *cost_row(uint8_t *path, int d) const {
+    return path + (d + 1)*pitch + pad;
+  }
+
+  const uint8_t *cost_row(const uint8_t *path, int d) const {
+    return path + (d + 1)*pitch + pad;
+  }
+
+  uint8_t *min_row(uint8_t *path) const {
+    return path + (disparity_size + 2)*pitch + pad;
+  }
+
+  const uint8_t *min_row(const uint8_t *path) const {
+    return path + (disparity_size + 2)*pitch + pad;
+  }
+
+  // the state before the first row, every path starts here
+  void reset(uint8_t *state, int n_paths) const {
+    for (int k = 0; k < n_paths; k += 1) {
+      uint8_t *path = state + k*path_size();
+
+      std::fill(path, path + path_size(), 0);
+      std::fill(path, path + pitch, 0xff);
+      std::fill(path + (disparity_size + 1)*pitch,
+          path + (disparity_size + 2)*pitch, 0xff);
+    }
+  }
+};
+
+// Rows of a cost volume as execute_cost_row stores it, each of width bytes.
+// BYTE has one row per disparity. SIX_BIT keeps disparities 4g to 4g+2 in
+// the low six bits of rows 3g to 3g+2, and 4g+3 two bits at a time in the
+// top bits of the three. FOUR_BIT keeps 2g and 2g+1 in the low and high
+// nibble of row g.
+struct CostVolumeLayout {
+  int width;
+  int disparity_size;
+  CostPacking packing;
+
+  CostVolumeLayout(int width, int disparity_size, CostPacking packing) :
+    width(width),
+    disparity_size(disparity_size),
+    packing(packing) {
+  }
+
+  // rows holding disparities 0 to d - 1, d a multiple of 4
+  static constexpr int rows(int d, CostPacking packing) {
+    switch (packing) {
+      case CostPacking::SIX_BIT:
+        return d / 4 * 3;
+      case CostPacking::FOUR_BIT:
+        return d / 2;
+      default:
+        return d;
+    }
+  }
+
+  // bytes per image row
+  size_t row_size() const {
+    return static_cast<size_t>(rows(disparity_size, packing)) * width;
+  }
+};
+
+// A stored row of a cost volume, as execute_cost_row writes it and the
+// aggregation kernels read it: the rows of CostVolumeLayout at data, placed
+// by the tune's cost layout for rows of pitch costs (-1 for the width).
+// FOUR_BIT saturates each cost at clamp, 0 <= clamp <= 15; the other
+// packings store costs as they are. Cost is cost_type to write, const
+// cost_type to read.
+template <class Cost>
+struct BasicCostVolume {
+  Cost *data;
+  int pitch;
+  CostPacking packing;
+  int clamp;
+
+  explicit BasicCostVolume(
+      Cost *data,
+      int pitch = -1,
+      CostPacking packing = CostPacking::BYTE,
+      int clamp = 15) :
+    data(data),
+    pitch(pitch),
+    packing(packing),
+    clamp(clamp) {
+  }
+
+  // a volume written, to read
+  template <class Other, class = std::enable_if_t<
+    !std::is_const_v<Other> && std::is_same_v<const Other, Cost>>>
+  BasicCostVolume(const BasicCostVolume<Other> &volume) :
+    BasicCostVolume(volume.data, volume.pitch, volume.packing,
+        volume.clamp) {
+  }
+};
+
+using CostVolume = BasicCostVolume<cost_type>;
+using ConstCostVolume = BasicCostVolume<const cost_type>;
+
+} // detail
+} // sgm_cpu
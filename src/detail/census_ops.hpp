@@ -1,10 +1,25 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include <census_transform.hpp>
+#include <census_window.hpp>
 
 namespace sgm_cpu {
 namespace detail {
 
+// Tune::census::sliding, false if the tune does not set it
+template <class Tune, class = void>
+struct census_sliding : std::false_type {};
+
+template <class Tune>
+struct census_sliding<Tune, std::void_t<decltype(Tune::census::sliding)>> :
+  std::bool_constant<Tune::census::sliding> {};
+
 template <class Tune>
 class CensusOps {
 
@@ -12,16 +27,106 @@ class CensusOps {
   using tune = Tune;
   using input_type = typename CensusTransform<Tune>::input_type;
 
+  // the descriptor of the tune's census window, see census_window.hpp
+  using feature_type = census_feature_t<Tune>;
+
   struct PatchLayout;
 
+  // For YUYV, width is in pixels and src_pitch in bytes. With any border
+  // but CROP, dst is width x height features.
   static void execute_census(
       const input_type *src,
       feature_type *dst,
       int width,
       int height,
       int src_pitch,
-      int dst_pitch);
+      int dst_pitch,
+      PixelFormat format = PixelFormat::GRAY,
+      CensusBorder border = CensusBorder::CROP);
+
+  // Edge 0 <= edge < 4 (top, bottom, left, right) of a full size output:
+  // the features within window/2 of the image edge, whose windows reach
+  // beyond it. With the blocks of execute_census_block written at (window/2,
+  // window/2) of dst, the four make up the whole output. The kernels read
+  // the image in place: rows beyond it through a table of row pointers
+  // (border_index, or a row of zeros), columns beyond it through a permute
+  // of the loaded row, see execute_edge_x2.
+  static void execute_census_edge(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      CensusBorder border,
+      int edge,
+      PixelFormat format = PixelFormat::GRAY);
+
+  // Smallest input execute_census accepts: a patch of features plus the
+  // window border
+  static constexpr int min_width() {
+    return consts::h_patch + consts::feature_width - 1;
+  }
+
+  static constexpr int min_height() {
+    return consts::v_patch + consts::feature_height - 1;
+  }
+
+  // execute_band computes band_rows() rows of features from band_height()
+  // rows of input, at least min_band_width() features wide
+  static constexpr int band_rows() {
+    return consts::v_rows;
+  }
+
+  static constexpr int band_height() {
+    return consts::v_band;
+  }
+
+  static constexpr int min_band_width() {
+    return consts::h_patch;
+  }
+
+  // execute_census splits the output into disjoint blocks of about
+  // h_block x v_block features, which may be computed in any order or
+  // concurrently. Returns the number of blocks, 0 if the image is too small.
+  static int census_blocks(int width, int height);
+
+  // Block 0 <= block < census_blocks(width, height) of execute_census
+  static void execute_census_block(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      int block,
+      PixelFormat format = PixelFormat::GRAY);
+
+  // The blocks of execute_census that hold the features of any pixel in
+  // rois, each block once and in increasing order. Rois are in input pixels
+  // and are clipped to the pixels that have features, that is all but a
+  // window/2 border.
+  static std::vector<int> roi_blocks(
+      int width,
+      int height,
+      const std::vector<Rect> &rois);
+
+  // execute_census over roi_blocks only. Features outside those blocks keep
+  // whatever dst held.
+  static void execute_census_rois(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      const std::vector<Rect> &rois,
+      PixelFormat format = PixelFormat::GRAY);
 
+  // The block kernels take format as a parameter. For YUYV, src is the
+  // first byte of the block's first pixel and src_pitch is in bytes: the
+  // kernels load the luma in place, see load_row2.
+  template <PixelFormat format = PixelFormat::GRAY>
   static void execute_block(
       const input_type *src,
       feature_type *dst,
@@ -30,6 +135,7 @@ class CensusOps {
       int src_pitch,
       int dst_pitch);
 
+  template <PixelFormat format = PixelFormat::GRAY>
   static void execute_block_x2(
       const input_type *src,
       feature_type *dst,
@@ -38,25 +144,256 @@ class CensusOps {
       int src_pitch,
       int dst_pitch);
 
+  // One band of execute_block: v_rows rows of features, from the v_band rows
+  // of input rows[0:v_band], which need not be pitch apart (CensusStream
+  // keeps them in a ring). The band is width features wide, at least
+  // h_patch. GRAY only.
+  static void execute_band(
+      const input_type *const *rows,
+      feature_type *dst,
+      int width,
+      int dst_pitch);
+
+  template <PixelFormat format = PixelFormat::GRAY>
+  static inline void execute_band_x2(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int src_pitch,
+      int dst_pitch);
+
+  // As execute_block_x2, but down one column of patches at a time. The rows
+  // a patch shares with the one below stay in registers, so each step loads
+  // only its v_rows new rows instead of the whole patch. execute_block runs
+  // it for tunes that set `static constexpr bool sliding = true` in their
+  // census struct, for hosts where loads rather than shuffles are the limit.
+  template <PixelFormat format = PixelFormat::GRAY>
+  static void execute_block_x2_sliding(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch);
+
+  // The kernel of any window but 9x7, and of 16-bit input. It computes one
+  // register width of a row at a time, see execute_patch_pairs.
+  template <PixelFormat format = PixelFormat::GRAY>
+  static void execute_block_pairs(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch);
+
+  // One register width of features of execute_block_pairs to dst. rows(i)
+  // is the first pixel of row i of their windows. The bytes of the
+  // descriptors come from symmetric_bytes where the window allows
+  // (consts::shuffle_schedule), else from pair_byte.
+  template <PixelFormat format, class Rows>
+  static inline void execute_patch_pairs(
+      const Rows &rows,
+      feature_type *dst);
+
+  // The shuffle schedule of a window of symmetric_pairs, 8-bit pixels. Each
+  // row of the window is loaded once, as two registers, and walked across
+  // the window with align_x1. Row y is compared with row height - 1 - y
+  // (the center row with itself) as the columns go past, in the bit order
+  // of the pairs. b[k] gets byte k of the descriptors, one per lane.
+  template <PixelFormat format, class Rows>
+  static inline void symmetric_bytes(
+      const Rows &rows,
+      typename Tune::simd::reg::x1_t *b);
+
+  // Columns 0 <= k < window width of the window row at src: cols[k] holds
+  // the register width of pixels from k
+  template <PixelFormat format>
+  static inline void row_columns(
+      const uint8_t *src,
+      typename Tune::simd::reg::x1_t *cols);
+
+  // The register width of pixels from src, lo, and the one after it, hi, as
+  // far as the window reaches: pixel k is byte k of lo:hi for k < x1_width
+  // + window width - 1, so align_x1<k>(lo, hi) is the column k
+  template <PixelFormat format>
+  static inline void load_row_pair(
+      const uint8_t *src,
+      typename Tune::simd::reg::x1_t &lo,
+      typename Tune::simd::reg::x1_t &hi);
+
+  // Byte 0 <= byte < sizeof(feature_type) of the descriptors of
+  // execute_patch_pairs, one per lane, a pair of unaligned loads per bit.
+  // For any pair table and 16-bit pixels, the latter GRAY only.
+  template <PixelFormat format, class Rows>
+  static inline typename Tune::simd::reg::x1_t pair_byte(
+      const Rows &rows,
+      int byte);
+
+  // f(std::integral_constant<int, i>()) for 0 <= i < n, so the schedules
+  // can index registers and shuffles at compile time
+  template <int n, class F>
+  static inline void for_each_index(F &&f);
+
+  template <class F, int... i>
+  static inline void for_each_index(std::integer_sequence<int, i...>, F &f);
+
+  // The features [x0, x1) x [y0, y1) of execute_census_edge, through the
+  // kernel of the window
+  template <PixelFormat format>
+  static void execute_edge(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      CensusBorder border,
+      int x0,
+      int y0,
+      int x1,
+      int y1);
+
+  // execute_edge with execute_patch_x2. The loads of a patch start inside
+  // the image; where its columns reach beyond, permute_row2 moves the ones
+  // border reads into place.
+  template <PixelFormat format>
+  static void execute_edge_x2(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      CensusBorder border,
+      int x0,
+      int y0,
+      int x1,
+      int y1);
+
+  // execute_edge with execute_patch_pairs, which pads rows only. Features
+  // whose windows reach beyond the left or right edge take edge_feature.
+  template <PixelFormat format>
+  static void execute_edge_pairs(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      CensusBorder border,
+      int x0,
+      int y0,
+      int x1,
+      int y1);
+
+  // The feature at (x, y) of a full size output, one pair at a time
+  template <PixelFormat format, class Pixel>
+  static inline feature_type edge_feature(
+      const Pixel *src,
+      int width,
+      int height,
+      int src_pitch,
+      CensusBorder border,
+      int x,
+      int y);
+
+  // The row or column of the image that index i beyond it reads, -1 for
+  // zero
+  static inline int border_index(int i, int size, CensusBorder border);
+
+  // simd::load_row2 of format: for YUYV, load_row2_even takes every second
+  // byte, the luma
+  template <PixelFormat format>
+  static inline void load_row2(
+      typename Tune::simd::reg::x2_t &r,
+      const uint8_t *src,
+      int src_pitch);
+
+  // load_row2 of rows that need not be pitch apart
+  template <PixelFormat format>
+  static inline void load_row2(
+      typename Tune::simd::reg::x2_t &r,
+      const uint8_t *const *rows);
+
+  // The Y bytes of a row of width YUYV pixels
+  static inline void extract_luma(
+      const uint8_t *src,
+      uint8_t *dst,
+      int width);
+
   static inline void execute_patch_x2(
       PatchLayout &r,
       feature_type *dst,
       int dst_pitch);
 
+  // Extent of the blocks along one axis of the output. The last block takes
+  // any remainder too short to make a block of its own.
+  static inline void block_span(
+      int size,
+      int block_size,
+      int min_size,
+      int index,
+      int &start,
+      int &length);
+
+  static inline int block_count(int size, int block_size, int min_size);
+
   struct consts {
-    static constexpr int feature_width = 9;
-    static constexpr int feature_height = 7;
+    using window = census_window_t<Tune>;
+
+    static constexpr int feature_width = window::width;
+    static constexpr int feature_height = window::height;
+    static constexpr int n_pairs = static_cast<int>(window::pairs.size());
+
+    // 16-bit pixels, as uint16_t
+    static constexpr bool wide_input = (sizeof(input_type) == 2);
+
+    // execute_block_pairs rather than the 9x7 kernel, which shuffles bytes
+    static constexpr bool pair_schedule =
+      !std::is_same_v<window, CensusWindow9x7> || wide_input;
+
+    // symmetric_bytes rather than pair_byte in execute_patch_pairs
+    static constexpr bool shuffle_schedule = pair_schedule && !wide_input &&
+      is_symmetric_window<window>();
+
+    // execute_block_x2_sliding rather than execute_block_x2
+    static constexpr bool sliding =
+      census_sliding<Tune>::value && !pair_schedule;
+
+    // Each x2_t register holds pairs of rows. Wider backends stack further
+    // pairs (offset by two rows) in additional 128-bit lanes, so registers
+    // still start every second row but overlap their neighbours.
+    static constexpr int rows_per_x2 = Tune::simd::reg::census_rows_per_x2;
 
-    static constexpr int v_patch = Tune::census::v_step + 6;
-    static constexpr int h_patch = 16;
+    // Rows of features a patch computes, v_step rounded up to whole
+    // registers. Any v_step works: the patches step by v_rows, so only the
+    // last one of a block, moved up to end on its last row, recomputes any.
+    static constexpr int v_rows =
+      (Tune::census::v_step + rows_per_x2 - 1) / rows_per_x2 * rows_per_x2;
+
+    static constexpr int v_patch = v_rows + 6;
+
+    // rows of input to v_rows rows of features
+    static constexpr int v_band = v_rows + feature_height - 1;
+
+    // pixels in a register of bytes
+    static constexpr int x1_width = 4 * Tune::simd::reg::descriptors_per_w1;
+
+    static constexpr int h_patch = pair_schedule ? x1_width : 16;
+
+    static constexpr int n_row2 = (v_patch - rows_per_x2) / 2 + 1;
   };
 
   struct PatchLayout {
-    std::array<typename Tune::simd::reg::x2_t, consts::v_patch / 2> row2;
+    std::array<typename Tune::simd::reg::x2_t, consts::n_row2> row2;
   };
 
-  static_assert((Tune::census::v_step % 2) == 0,
-      "Tune::census::v_step must be even");
+  static_assert((sizeof(input_type) == 1) || (sizeof(input_type) == 2),
+      "Census input is 8 or 16-bit");
+
+  static_assert(Tune::census::v_step >= 1,
+      "Tune::census::v_step must be positive");
 
   static_assert(Tune::census::v_block >= consts::v_patch,
       "Tune::census::v_block must be greater than patch height (v_patch)");
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <utility>
+#include <vector>
 
 namespace sgm_cpu {
 namespace detail {
@@ -13,70 +16,522 @@ void CensusOps<Tune>::execute_census(
     int width,
     int height,
     int src_pitch,
-    int dst_pitch) {
+    int dst_pitch,
+    PixelFormat format,
+    CensusBorder border) {
 
-  // Input image must be at least patch size
-  if ((width < consts::h_patch) || (height < consts::v_patch)) {
-    std::cerr << "CensusOps::execute_block: minimium image size " <<
-      consts::h_patch << "x" << consts::v_patch <<
-      " (input image " << width << "x" << height << ")\n";
+  if (consts::wide_input && (format == PixelFormat::YUYV)) {
+    std::cerr << "CensusOps::execute_census: YUYV is 8-bit, the tune takes "
+      "16-bit input\n";
     return;
   }
 
-  // subtract border
-  height -= (consts::feature_height - 1);
-  width -= (consts::feature_width - 1);
+  const int n_blocks = census_blocks(width, height);
+
+  if (border == CensusBorder::CROP) {
+    for (int block = 0; block < n_blocks; block += 1) {
+      execute_census_block(src, dst, width, height, src_pitch, dst_pitch,
+          block, format);
+    }
+    return;
+  }
+
+  dst_pitch = (dst_pitch == -1) ? width : dst_pitch;
+
+  feature_type *interior = dst + (consts::feature_height / 2)*dst_pitch +
+    consts::feature_width / 2;
+
+  for (int block = 0; block < n_blocks; block += 1) {
+    execute_census_block(src, interior, width, height, src_pitch, dst_pitch,
+        block, format);
+  }
+
+  // too small, reported by census_blocks
+  if (n_blocks > 0) {
+    for (int edge = 0; edge < 4; edge += 1) {
+      execute_census_edge(src, dst, width, height, src_pitch, dst_pitch,
+          border, edge, format);
+    }
+  }
+}
+
+template <class Tune>
+void CensusOps<Tune>::execute_census_edge(
+    const input_type *src,
+    feature_type *dst,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    CensusBorder border,
+    int edge,
+    PixelFormat format) {
+
+  constexpr int cx = consts::feature_width / 2;
+  constexpr int cy = consts::feature_height / 2;
+
+  dst_pitch = (dst_pitch == -1) ? width : dst_pitch;
+
+  // Top and bottom take whole rows, left and right the rows between them
+  int x0 = 0;
+  int x1 = width;
+  int y0 = cy;
+  int y1 = height - cy;
+
+  switch (edge) {
+    case 0: y0 = 0; y1 = cy; break;
+    case 1: y0 = height - cy; y1 = height; break;
+    case 2: x1 = cx; break;
+    default: x0 = width - cx; break;
+  }
+
+  // rejected by execute_census
+  if constexpr (!consts::wide_input) {
+    if (format == PixelFormat::YUYV) {
+      execute_edge<PixelFormat::YUYV>(src, dst, width, height, src_pitch,
+          dst_pitch, border, x0, y0, x1, y1);
+      return;
+    }
+  }
+
+  execute_edge<PixelFormat::GRAY>(src, dst, width, height, src_pitch,
+      dst_pitch, border, x0, y0, x1, y1);
+}
+
+template <class Tune>
+template <PixelFormat format>
+void CensusOps<Tune>::execute_edge(
+    const input_type *src,
+    feature_type *dst,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    CensusBorder border,
+    int x0,
+    int y0,
+    int x1,
+    int y1) {
+
+  if constexpr (consts::pair_schedule) {
+    execute_edge_pairs<format>(src, dst, width, height, src_pitch,
+        dst_pitch, border, x0, y0, x1, y1);
+  } else {
+    execute_edge_x2<format>(src, dst, width, height, src_pitch, dst_pitch,
+        border, x0, y0, x1, y1);
+  }
+}
+
+template <class Tune>
+template <PixelFormat format>
+void CensusOps<Tune>::execute_edge_x2(
+    const input_type *src,
+    feature_type *dst,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    CensusBorder border,
+    int x0,
+    int y0,
+    int x1,
+    int y1) {
+
+  using simd = typename Tune::simd;
+
+  constexpr int stride = (format == PixelFormat::YUYV) ? 2 : 1;
+  constexpr int cx = consts::feature_width / 2;
+  constexpr int cy = consts::feature_height / 2;
+
+  // execute_patch_x2 computes 8 columns from 16 of input
+  constexpr int n_cols = 8;
+  constexpr int n_in = 16;
+
+  // a row beyond a ZERO border, as wide as a load of one
+  static const uint8_t zeros[stride*n_in] = {};
+
+  static_assert(sizeof(*src) == 1, "Only 8-bit input types supported");
+  const uint8_t *src_u8 = reinterpret_cast<const uint8_t *>(src);
+
+  PatchLayout r;
+  std::array<feature_type, consts::v_rows * n_cols> features;
+
+  std::array<const uint8_t *, consts::v_patch> rows;
+  std::array<const uint8_t *, consts::v_patch> loads;
+  std::array<uint8_t, n_in> index;
+
+  for (int by = y0; by < y1; by += consts::v_rows) {
+
+    // As execute_block_x2, the last band moves up to end on the last row,
+    // but not above the image
+    const int y = std::max(std::min(by, y1 - consts::v_rows), 0);
+
+    for (int i = 0; i < consts::v_patch; i += 1) {
+      const int sy = border_index(y - cy + i, height, border);
+      rows[i] = (sy < 0) ? nullptr : src_u8 + sy*src_pitch;
+    }
+
+    for (int bx = x0; bx < x1; bx += n_cols) {
+      const int x = std::max(std::min(bx, x1 - n_cols), 0);
+
+      // The loads stay within the image. Where the patch reaches beyond
+      // it, the permute moves the columns read into place.
+      const int lx = std::clamp(x - cx, 0, width - n_in);
+
+      for (int i = 0; i < consts::v_patch; i += 1) {
+        loads[i] = rows[i] ? rows[i] + stride*lx : zeros;
+      }
+
+      for (int i = 0; i < consts::n_row2; i += 1) {
+        load_row2<format>(r.row2[i], loads.data() + 2*i);
+      }
+
+      if (lx != x - cx) {
+        for (int i = 0; i < n_in; i += 1) {
+          const int sx = border_index(x - cx + i, width, border);
+          index[i] = (sx < 0) ? 0x80 : static_cast<uint8_t>(sx - lx);
+        }
+
+        for (int i = 0; i < consts::n_row2; i += 1) {
+          simd::permute_row2(r.row2[i], index.data());
+        }
+      }
+
+      execute_patch_x2(r, features.data(), n_cols);
+
+      // only the border, so the edges and blocks write disjoint features
+      const int j1 = std::min(y + consts::v_rows, y1);
+      const int i1 = std::min(x + n_cols, x1);
+
+      for (int j = std::max(y, y0); j < j1; j += 1) {
+        for (int i = std::max(x, x0); i < i1; i += 1) {
+          dst[j*dst_pitch + i] = features[(j - y)*n_cols + (i - x)];
+        }
+      }
+    }
+  }
+}
+
+template <class Tune>
+template <PixelFormat format>
+void CensusOps<Tune>::execute_edge_pairs(
+    const input_type *src,
+    feature_type *dst,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    CensusBorder border,
+    int x0,
+    int y0,
+    int x1,
+    int y1) {
+
+  constexpr int stride = (format == PixelFormat::YUYV) ? 2 : 1;
+  constexpr int cx = consts::feature_width / 2;
+  constexpr int cy = consts::feature_height / 2;
+  constexpr int lanes = consts::h_patch;
+
+  using pixel_type =
+    std::conditional_t<consts::wide_input, uint16_t, uint8_t>;
+  const pixel_type *src_px = reinterpret_cast<const pixel_type *>(src);
+
+  // a row beyond a ZERO border, as far as a patch reads into one
+  static const pixel_type zeros[stride*(lanes + consts::feature_width)] = {};
+
+  // The columns whose windows stay within the image rows take registers.
+  // A pair loads a whole register at its own offset, which no in-lane
+  // permute pads, so the window/2 columns at the left and right edges are
+  // computed a feature at a time.
+  const int xa = std::max(x0, cx);
+  const int xb = std::min(x1, width - cx);
+
+  std::array<const pixel_type *, consts::feature_height> rows;
+  std::array<const pixel_type *, consts::feature_height> loads;
+
+  for (int y = y0; y < y1; y += 1) {
+    for (int i = 0; i < consts::feature_height; i += 1) {
+      const int sy = border_index(y - cy + i, height, border);
+      rows[i] = (sy < 0) ? nullptr : src_px + sy*src_pitch;
+    }
+
+    // xb - xa is 0 or at least lanes, see min_width
+    for (int bx = xa; bx < xb; bx += lanes) {
+
+      // avoid overshoot
+      const int x = std::min(bx, xb - lanes);
+
+      for (int i = 0; i < consts::feature_height; i += 1) {
+        loads[i] = rows[i] ? rows[i] + stride*(x - cx) : zeros;
+      }
 
-  // It's tempting for people to change the feature size thinking they will
-  // get better descriptors. This would lead to memory errors,
-  // so put in an additional asserts
-  static_assert(consts::feature_width == 9, "Do not change the feature size!");
-  static_assert(consts::feature_height == 7, "Do not change the feature size!");
+      execute_patch_pairs<format>(
+          [&](int i) { return loads[i]; }, dst + y*dst_pitch + x);
+    }
+
+    for (int x = x0; x < std::min(xa, x1); x += 1) {
+      dst[y*dst_pitch + x] = edge_feature<format>(src_px, width, height,
+          src_pitch, border, x, y);
+    }
+
+    for (int x = std::max(xb, x0); x < x1; x += 1) {
+      dst[y*dst_pitch + x] = edge_feature<format>(src_px, width, height,
+          src_pitch, border, x, y);
+    }
+  }
+}
+
+template <class Tune>
+template <PixelFormat format, class Pixel>
+typename CensusOps<Tune>::feature_type CensusOps<Tune>::edge_feature(
+    const Pixel *src,
+    int width,
+    int height,
+    int src_pitch,
+    CensusBorder border,
+    int x,
+    int y) {
 
-  for (int y = 0; y < height; y += tune::census::v_block) {
+  constexpr int stride = (format == PixelFormat::YUYV) ? 2 : 1;
 
-    int block_height = std::min(tune::census::v_block, height - y);
+  x -= consts::feature_width / 2;
+  y -= consts::feature_height / 2;
 
-    // check if block is shorter than minimum patch height, adjust
-    if (block_height < consts::v_patch) {
-      int overlap = consts::v_patch - block_height;
+  auto pixel = [&](int px, int py) {
+    const int sx = border_index(px, width, border);
+    const int sy = border_index(py, height, border);
 
-      src -= src_pitch * overlap;
-      dst -= dst_pitch * overlap;
+    return ((sx < 0) || (sy < 0)) ? Pixel(0) : src[sy*src_pitch + stride*sx];
+  };
 
-      block_height = consts::v_patch;
+  feature_type feature = 0;
+
+  for (int i = 0; i < consts::n_pairs; i += 1) {
+    const CensusPair &c = consts::window::pairs[i];
+
+    if (pixel(x + c.x0, y + c.y0) < pixel(x + c.x1, y + c.y1)) {
+      feature |= feature_type(1) << i;
     }
+  }
+
+  return feature;
+}
+
+template <class Tune>
+int CensusOps<Tune>::border_index(int i, int size, CensusBorder border) {
+  if ((i >= 0) && (i < size)) {
+    return i;
+  }
+
+  switch (border) {
+    case CensusBorder::REPLICATE:
+      return std::clamp(i, 0, size - 1);
+    case CensusBorder::REFLECT:
+      // an image narrower than the window reflects only so far
+      return std::clamp((i < 0) ? -i : 2*(size - 1) - i, 0, size - 1);
+    default:
+      return -1;
+  }
+}
+
+template <class Tune>
+int CensusOps<Tune>::census_blocks(int width, int height) {
+
+  // Windows are chosen with Tune::census::window, see census_window.hpp
+  static_assert((consts::feature_width % 2 == 1) &&
+      (consts::feature_height % 2 == 1), "Census windows have a center pixel");
+  static_assert(consts::n_pairs <= 8 * static_cast<int>(sizeof(feature_type)),
+      "Census window has more pairs than feature_type has bits");
+
+  // Output must be at least patch size
+  if ((width < min_width()) || (height < min_height())) {
+    std::cerr << "CensusOps::execute_census: minimium image size " <<
+      min_width() << "x" << min_height() <<
+      " (input image " << width << "x" << height << ")\n";
+    return 0;
+  }
 
-    const input_type *src0 = src;
-    feature_type *dst0 = dst;
+  // subtract border
+  const int dst_width = width - (consts::feature_width - 1);
+  const int dst_height = height - (consts::feature_height - 1);
+
+  return block_count(dst_width, tune::census::h_block, consts::h_patch) *
+    block_count(dst_height, tune::census::v_block, consts::v_patch);
+}
 
-    for (int x = 0; x < width; x += tune::census::h_block) {
+template <class Tune>
+std::vector<int> CensusOps<Tune>::roi_blocks(
+    int width,
+    int height,
+    const std::vector<Rect> &rois) {
 
-      int block_width = std::min(tune::census::h_block, width - x);
+  const int n_blocks = census_blocks(width, height);
+  if (n_blocks == 0) {
+    return {};
+  }
 
-      // check if block is thinner than minimum patch width, adjust
-      if (block_width < consts::h_patch) {
-        int overlap = consts::h_patch - block_width;
+  // subtract border
+  const int dst_width = width - (consts::feature_width - 1);
+  const int dst_height = height - (consts::feature_height - 1);
+
+  const int n_x = block_count(dst_width, tune::census::h_block,
+      consts::h_patch);
+  const int n_y = n_blocks / n_x;
+
+  std::vector<bool> used(n_blocks);
+
+  for (const Rect &roi : rois) {
+    // features of the roi pixels, clipped to the output
+    const int x0 = std::max(roi.x - consts::feature_width/2, 0);
+    const int y0 = std::max(roi.y - consts::feature_height/2, 0);
+    const int x1 = std::min(roi.x + roi.width - consts::feature_width/2,
+        dst_width);
+    const int y1 = std::min(roi.y + roi.height - consts::feature_height/2,
+        dst_height);
+
+    if ((x0 >= x1) || (y0 >= y1)) {
+      continue;
+    }
 
-        src0 -= overlap;
-        dst0 -= overlap;
+    // the last block along an axis also takes the remainder
+    const int bx0 = std::min(x0 / tune::census::h_block, n_x - 1);
+    const int bx1 = std::min((x1 - 1) / tune::census::h_block, n_x - 1);
+    const int by0 = std::min(y0 / tune::census::v_block, n_y - 1);
+    const int by1 = std::min((y1 - 1) / tune::census::v_block, n_y - 1);
 
-        block_width = consts::h_patch;
+    for (int by = by0; by <= by1; by += 1) {
+      for (int bx = bx0; bx <= bx1; bx += 1) {
+        used[by*n_x + bx] = true;
       }
+    }
+  }
+
+  std::vector<int> blocks;
+  for (int block = 0; block < n_blocks; block += 1) {
+    if (used[block]) {
+      blocks.push_back(block);
+    }
+  }
 
-      execute_block_x2(src0, dst0, block_width, block_height,
-          src_pitch, dst_pitch);
+  return blocks;
+}
 
-      src0 += tune::census::h_block;
-      dst0 += tune::census::h_block;
+template <class Tune>
+void CensusOps<Tune>::execute_census_rois(
+    const input_type *src,
+    feature_type *dst,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    const std::vector<Rect> &rois,
+    PixelFormat format) {
+
+  if (consts::wide_input && (format == PixelFormat::YUYV)) {
+    std::cerr << "CensusOps::execute_census: YUYV is 8-bit, the tune takes "
+      "16-bit input\n";
+    return;
+  }
+
+  for (int block : roi_blocks(width, height, rois)) {
+    execute_census_block(src, dst, width, height, src_pitch, dst_pitch,
+        block, format);
+  }
+}
+
+template <class Tune>
+void CensusOps<Tune>::execute_census_block(
+    const input_type *src,
+    feature_type *dst,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    int block,
+    PixelFormat format) {
+
+  // subtract border
+  height -= (consts::feature_height - 1);
+  width -= (consts::feature_width - 1);
+
+  dst_pitch = (dst_pitch == -1) ? width : dst_pitch;
+
+  const int n_x = block_count(width, tune::census::h_block, consts::h_patch);
+
+  int x;
+  int y;
+  int block_width;
+  int block_height;
+  block_span(width, tune::census::h_block, consts::h_patch, block % n_x,
+      x, block_width);
+  block_span(height, tune::census::v_block, consts::v_patch, block / n_x,
+      y, block_height);
+
+  if (format == PixelFormat::GRAY) {
+    execute_block(src + y*src_pitch + x, dst + y*dst_pitch + x,
+        block_width, block_height, src_pitch, dst_pitch);
+    return;
+  }
+
+  // rejected by execute_census
+  if constexpr (!consts::wide_input) {
+    execute_block<PixelFormat::YUYV>(src + y*src_pitch + 2*x,
+        dst + y*dst_pitch + x, block_width, block_height, src_pitch,
+        dst_pitch);
+  }
+}
+
+template <class Tune>
+void CensusOps<Tune>::extract_luma(
+    const uint8_t *src,
+    uint8_t *dst,
+    int width) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int lanes = consts::x1_width;
+
+  if (width < lanes) {
+    for (int x = 0; x < width; x += 1) {
+      dst[x] = src[2*x];
     }
+    return;
+  }
 
-    src += src_pitch * tune::census::v_block;
-    dst += dst_pitch * tune::census::v_block;
+  for (int bx = 0; bx < width; bx += lanes) {
+    // avoid overshoot
+    const int x = std::min(bx, width - lanes);
+
+    x1_t r;
+    simd::load_x1_even(r, src + 2*x);
+    simd::store_x1(r, dst + x);
   }
 }
 
 template <class Tune>
+int CensusOps<Tune>::block_count(int size, int block_size, int min_size) {
+  const int n = size / block_size;
+  return std::max(1, ((size % block_size) >= min_size) ? n + 1 : n);
+}
+
+template <class Tune>
+void CensusOps<Tune>::block_span(
+    int size,
+    int block_size,
+    int min_size,
+    int index,
+    int &start,
+    int &length) {
+
+  const int n = block_count(size, block_size, min_size);
+
+  start = index * block_size;
+  length = (index == n - 1) ? (size - start) : block_size;
+}
+
+template <class Tune>
+template <PixelFormat format>
 void CensusOps<Tune>::execute_block(
     const input_type *src,
     feature_type *dst,
@@ -85,13 +540,50 @@ void CensusOps<Tune>::execute_block(
     int src_pitch,
     int dst_pitch) {
 
-  static_assert(Tune::census::v_step >= 2,
-      "Tune::census::v_step == 1 not supported (yet!)");
+  if constexpr (consts::pair_schedule) {
+    execute_block_pairs<format>(src, dst, width, height, src_pitch,
+        dst_pitch);
+  } else if constexpr (consts::sliding) {
+    execute_block_x2_sliding<format>(src, dst, width, height, src_pitch,
+        dst_pitch);
+  } else {
+    execute_block_x2<format>(src, dst, width, height, src_pitch, dst_pitch);
+  }
+}
+
+template <class Tune>
+template <PixelFormat format>
+void CensusOps<Tune>::load_row2(
+    typename Tune::simd::reg::x2_t &r,
+    const uint8_t *src,
+    int src_pitch) {
 
-  execute_block_x2(src, dst, width, height, src_pitch, dst_pitch);
+  using simd = typename Tune::simd;
+
+  if constexpr (format == PixelFormat::YUYV) {
+    simd::load_row2_even(r, src, src_pitch);
+  } else {
+    simd::load_row2(r, src, src_pitch);
+  }
+}
+
+template <class Tune>
+template <PixelFormat format>
+void CensusOps<Tune>::load_row2(
+    typename Tune::simd::reg::x2_t &r,
+    const uint8_t *const *rows) {
+
+  using simd = typename Tune::simd;
+
+  if constexpr (format == PixelFormat::YUYV) {
+    simd::load_row2_even(r, rows);
+  } else {
+    simd::load_row2(r, rows);
+  }
 }
 
 template <class Tune>
+template <PixelFormat format>
 void CensusOps<Tune>::execute_block_x2(
     const input_type *src,
     feature_type *dst,
@@ -100,7 +592,8 @@ void CensusOps<Tune>::execute_block_x2(
     int src_pitch,
     int dst_pitch) {
 
-  using simd = typename Tune::simd;
+  static_assert(!consts::pair_schedule,
+      "execute_block_x2 computes the 9x7 window only");
 
   // Input block must be at least patch size
   if ((width < consts::h_patch) || (height < consts::v_patch)) {
@@ -112,56 +605,458 @@ void CensusOps<Tune>::execute_block_x2(
 
   dst_pitch = (dst_pitch == -1) ? width : dst_pitch;
 
-  PatchLayout r;
-
   // Improve cache performance across rows (especially on architectures with
   // limited simd registers) by processing the image in blocks.
-  for (int by = 0; by < height; by += Tune::census::v_step) {
+  for (int by = 0; by < height; by += consts::v_rows) {
+
+    // A patch computes v_rows >= v_step rows, all of which are kept. Where
+    // that would overshoot, the patch moves up to end on the last row,
+    // recomputing a few rows there only.
+    const int y = std::min(by, height - consts::v_rows);
+
+    execute_band_x2<format>(src + y*src_pitch, dst + y*dst_pitch, width,
+        src_pitch, dst_pitch);
+
+    if (y + consts::v_rows >= height) {
+      break;
+    }
+  }
+}
+
+// As execute_block_pairs and execute_band_x2, the rows through a table
+template <class Tune>
+void CensusOps<Tune>::execute_band(
+    const input_type *const *rows,
+    feature_type *dst,
+    int width,
+    int dst_pitch) {
+
+  using pixel_type =
+    std::conditional_t<consts::wide_input, uint16_t, uint8_t>;
+
+  std::array<const pixel_type *, consts::v_band> band;
+  for (int i = 0; i < consts::v_band; i += 1) {
+    band[i] = reinterpret_cast<const pixel_type *>(rows[i]);
+  }
+
+  if constexpr (consts::pair_schedule) {
+    constexpr int lanes = consts::h_patch;
+
+    for (int y = 0; y < consts::v_rows; y += 1) {
+      for (int bx = 0; bx < width; bx += lanes) {
+
+        // avoid overshoot
+        const int x = std::min(bx, width - lanes);
+
+        execute_patch_pairs<PixelFormat::GRAY>(
+            [&](int i) { return band[y + i] + x; }, dst + y*dst_pitch + x);
+      }
+    }
+  } else {
+    static_assert(consts::v_patch == consts::v_band,
+        "the 9x7 patch is one band");
+
+    constexpr int h_step = Tune::census::h_step;
+
+    PatchLayout r;
+    std::array<const uint8_t *, consts::v_band> loads;
+
+    for (int bx = 0; bx < width; bx += h_step) {
 
-    if ((by + Tune::census::v_step) > height) {
       // avoid overshoot
-      int overshoot = (by + Tune::census::v_step) - height;
-      src -= overshoot * src_pitch;
-      dst -= overshoot * dst_pitch;
+      const int x = std::min(bx, width - h_step);
+
+      for (int i = 0; i < consts::v_band; i += 1) {
+        loads[i] = band[i] + x;
+      }
+
+      for (int i = 0; i < consts::n_row2; i += 1) {
+        load_row2<PixelFormat::GRAY>(r.row2[i], loads.data() + 2*i);
+      }
+
+      execute_patch_x2(r, dst + x, dst_pitch);
+    }
+  }
+}
 
-      // no need to confuse the compiler by updating "by",
+template <class Tune>
+template <PixelFormat format>
+void CensusOps<Tune>::execute_band_x2(
+    const input_type *src,
+    feature_type *dst,
+    int width,
+    int src_pitch,
+    int dst_pitch) {
+
+  constexpr int stride = (format == PixelFormat::YUYV) ? 2 : 1;
+
+  PatchLayout r;
+
+  // This assumption is explained in header. Only 8-bit inputs supported.
+  static_assert(sizeof(*src) == 1, "Only 8-bit input types supported");
+  const uint8_t *src0 = reinterpret_cast<const uint8_t *>(src);
+  feature_type *dst0 = dst;
+
+  for (int bx = 0; bx < width; bx += Tune::census::h_step) {
+
+    if ((bx + Tune::census::h_step) > width) {
+      // avoid overshoot
+      int overshoot = (bx + Tune::census::h_step) - width;
+      src0 -= stride*overshoot;
+      dst0 -= overshoot;
+
+      // no need to confuse the compiler by updating "bx",
       // loop will terminate regardless.
     }
 
-    // This assumption is explained in header. Only 8-bit inputs supported.
-    static_assert(sizeof(*src) == 1, "Only 8-bit input types supported");
-    const uint8_t *src0 = reinterpret_cast<const uint8_t *>(src);
-    feature_type *dst0 = dst;
+    // load pixel patch
+    const uint8_t *row0 = reinterpret_cast<const uint8_t *>(src0);
+    for (size_t i = 0; i < r.row2.size(); i += 1) {
+      load_row2<format>(r.row2[i], row0, src_pitch);
+      row0 += 2*src_pitch;
+    }
+
+    execute_patch_x2(r, dst0, dst_pitch);
+    src0 += stride*Tune::census::h_step;
+    dst0 += Tune::census::h_step;
+  }
+}
 
-    for (int bx = 0; bx < width; bx += Tune::census::h_step) {
+template <class Tune>
+template <PixelFormat format>
+void CensusOps<Tune>::execute_block_x2_sliding(
+    const input_type *src,
+    feature_type *dst,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch) {
 
-      if ((bx + Tune::census::h_step) > width) {
-        // avoid overshoot
-        int overshoot = (bx + Tune::census::h_step) - width;
-        src0 -= overshoot;
-        dst0 -= overshoot;
+  static_assert(!consts::pair_schedule,
+      "execute_block_x2 computes the 9x7 window only");
 
-        // no need to confuse the compiler by updating "bx",
-        // loop will terminate regardless.
+  constexpr int stride = (format == PixelFormat::YUYV) ? 2 : 1;
+
+  // Input block must be at least patch size
+  if ((width < consts::h_patch) || (height < consts::v_patch)) {
+    std::cerr << "CensusOps::execute_block: minimium block size " <<
+      consts::h_patch << "x" << consts::v_patch <<
+      " (input image " << width << "x" << height << ")\n";
+    return;
+  }
+
+  dst_pitch = (dst_pitch == -1) ? width : dst_pitch;
+
+  // Registers start every second row, so moving down v_rows rows moves the
+  // window by v_rows/2 registers. With AVX-512 that is all of them.
+  constexpr int shift = consts::v_rows / 2;
+  constexpr int n_keep = std::max(0, consts::n_row2 - shift);
+
+  static_assert(sizeof(*src) == 1, "Only 8-bit input types supported");
+  const uint8_t *src_u8 = reinterpret_cast<const uint8_t *>(src);
+
+  // execute_patch_x2 rolls its registers, so it works on a copy
+  PatchLayout window;
+  PatchLayout r;
+
+  for (int bx = 0; bx < width; bx += Tune::census::h_step) {
+
+    // avoid overshoot
+    const int x = std::min(bx, width - Tune::census::h_step);
+    const uint8_t *src0 = src_u8 + stride*x;
+    feature_type *dst0 = dst + x;
+
+    int y = 0;
+    for (int i = 0; i < consts::n_row2; i += 1) {
+      load_row2<format>(window.row2[i], src0 + 2*i*src_pitch, src_pitch);
+    }
+
+    while (true) {
+      r = window;
+      execute_patch_x2(r, dst0 + y*dst_pitch, dst_pitch);
+
+      if (y + consts::v_rows >= height) {
+        break;
       }
 
-      // load pixel patch
-      const uint8_t *row0 = reinterpret_cast<const uint8_t *>(src0);
-      for (size_t i = 0; i < r.row2.size(); i += 1) {
-        simd::load_row2(r.row2[i], row0, src_pitch);
-        row0 += 2*src_pitch;
+      if (y + 2*consts::v_rows <= height) {
+        y += consts::v_rows;
+
+        for (int i = 0; i < n_keep; i += 1) {
+          window.row2[i] = window.row2[i + shift];
+        }
+        for (int i = n_keep; i < consts::n_row2; i += 1) {
+          load_row2<format>(window.row2[i], src0 + (y + 2*i)*src_pitch,
+              src_pitch);
+        }
+      } else {
+        // the last patch ends on the last row, recomputing a few rows
+        y = height - consts::v_rows;
+
+        for (int i = 0; i < consts::n_row2; i += 1) {
+          load_row2<format>(window.row2[i], src0 + (y + 2*i)*src_pitch,
+              src_pitch);
+        }
       }
+    }
+  }
+}
 
-      execute_patch_x2(r, dst0, dst_pitch);
-      src0 += Tune::census::h_step;
-      dst0 += Tune::census::h_step;
+template <class Tune>
+template <PixelFormat format>
+void CensusOps<Tune>::execute_block_pairs(
+    const input_type *src,
+    feature_type *dst,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch) {
+
+  // A row at a time, so any height will do (execute_band takes v_rows)
+  if (width < consts::h_patch) {
+    std::cerr << "CensusOps::execute_block: minimium block width " <<
+      consts::h_patch << " (input image " << width << "x" << height << ")\n";
+    return;
+  }
+
+  dst_pitch = (dst_pitch == -1) ? width : dst_pitch;
 
+  using pixel_type =
+    std::conditional_t<consts::wide_input, uint16_t, uint8_t>;
+  const pixel_type *src_u8 = reinterpret_cast<const pixel_type *>(src);
+
+  constexpr int stride = (format == PixelFormat::YUYV) ? 2 : 1;
+
+  constexpr int lanes = consts::h_patch;
+
+  for (int y = 0; y < height; y += 1) {
+    for (int bx = 0; bx < width; bx += lanes) {
+
+      // avoid overshoot
+      const int x = std::min(bx, width - lanes);
+      const pixel_type *src0 = src_u8 + y*src_pitch + stride*x;
+
+      execute_patch_pairs<format>(
+          [&](int i) { return src0 + i*src_pitch; }, dst + y*dst_pitch + x);
     }
-    src += Tune::census::v_step * src_pitch;
-    dst += Tune::census::v_step * dst_pitch;
   }
 }
 
+template <class Tune>
+template <PixelFormat format, class Rows>
+void CensusOps<Tune>::execute_patch_pairs(
+    const Rows &rows,
+    feature_type *dst) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int n_bytes = sizeof(feature_type);
+  constexpr int lanes = consts::h_patch;
+
+  std::array<x1_t, n_bytes> b;
+
+  if constexpr (consts::shuffle_schedule) {
+    symmetric_bytes<format>(rows, b.data());
+  } else {
+    for (int i = 0; i < n_bytes; i += 1) {
+      b[i] = pair_byte<format>(rows, i);
+    }
+  }
+
+  // Interleave the first half of the registers with the second, log2 of
+  // n_bytes times: each group of n_bytes bytes is then one little-endian
+  // descriptor.
+  for (int n = 1; n < n_bytes; n *= 2) {
+    std::array<x1_t, n_bytes> zipped;
+    for (int i = 0; i < n_bytes / 2; i += 1) {
+      zipped[2*i] = simd::zip_lo_x1(b[i], b[i + n_bytes/2]);
+      zipped[2*i + 1] = simd::zip_hi_x1(b[i], b[i + n_bytes/2]);
+    }
+    b = zipped;
+  }
+
+  uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+  for (int i = 0; i < n_bytes; i += 1) {
+    simd::store_x1(b[i], out + i*lanes);
+  }
+}
+
+template <class Tune>
+template <PixelFormat format, class Rows>
+void CensusOps<Tune>::symmetric_bytes(
+    const Rows &rows,
+    typename Tune::simd::reg::x1_t *b) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int W = consts::feature_width;
+  constexpr int H = consts::feature_height;
+
+  static_assert(consts::n_pairs == (W * H) / 2,
+      "symmetric_bytes computes the windows of symmetric_pairs");
+
+  const x1_t one = simd::fill_x1(1);
+
+  for (int i = 0; i < static_cast<int>(sizeof(feature_type)); i += 1) {
+    simd::clear(b[i]);
+  }
+
+  // Bit i of the descriptors, a < b. Bits go in from the most significant,
+  // each doubling what came before. Saturating subtraction leaves b - a > 0
+  // exactly where a < b.
+  auto put = [&](auto i, const x1_t &pa, const x1_t &pb) {
+    x1_t &acc = b[decltype(i)::value / 8];
+    acc = simd::adds_x1(acc, acc);
+    acc = simd::adds_x1(acc, simd::min_x1(simd::subs_x1(pb, pa), one));
+  };
+
+  std::array<x1_t, W> cols;
+
+  // The highest bits, the center row: pixel x against pixel W - 1 - x
+  row_columns<format>(rows(H/2), cols.data());
+
+  for_each_index<W/2>([&](auto n) {
+    constexpr int x = W/2 - 1 - decltype(n)::value;
+    put(std::integral_constant<int, (H/2)*W + x>(), cols[x], cols[W - 1 - x]);
+  });
+
+  // Then each row above the center, last first, against its mirror below.
+  // Pixel x of row y pairs with pixel W - 1 - x of row H - 1 - y, so as
+  // the columns of the lower row go past in increasing order the bits come
+  // in decreasing order.
+  for_each_index<H/2>([&](auto n) {
+    constexpr int y = H/2 - 1 - decltype(n)::value;
+
+    row_columns<format>(rows(y), cols.data());
+
+    x1_t lo;
+    x1_t hi;
+    load_row_pair<format>(rows(H - 1 - y), lo, hi);
+
+    for_each_index<W>([&](auto k) {
+      constexpr int x = W - 1 - decltype(k)::value;
+      put(std::integral_constant<int, y*W + x>(), cols[x],
+          simd::template align_x1<decltype(k)::value>(lo, hi));
+    });
+  });
+}
+
+template <class Tune>
+template <PixelFormat format>
+void CensusOps<Tune>::row_columns(
+    const uint8_t *src,
+    typename Tune::simd::reg::x1_t *cols) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  x1_t lo;
+  x1_t hi;
+  load_row_pair<format>(src, lo, hi);
+
+  for_each_index<consts::feature_width>([&](auto k) {
+    cols[k] = simd::template align_x1<decltype(k)::value>(lo, hi);
+  });
+}
+
+// Loading hi after lo would read past the last pixel of the window, so it
+// is taken from the load at window width - 1, whose last bytes are the
+// first of hi
+template <class Tune>
+template <PixelFormat format>
+void CensusOps<Tune>::load_row_pair(
+    const uint8_t *src,
+    typename Tune::simd::reg::x1_t &lo,
+    typename Tune::simd::reg::x1_t &hi) {
+
+  using simd = typename Tune::simd;
+
+  constexpr int W = consts::feature_width;
+
+  if constexpr (format == PixelFormat::YUYV) {
+    simd::load_x1_even(lo, src);
+    simd::load_x1_even(hi, src + 2*(W - 1));
+  } else {
+    simd::load_x1(lo, src);
+    simd::load_x1(hi, src + (W - 1));
+  }
+  hi = simd::template align_x1<consts::x1_width - (W - 1)>(hi, hi);
+}
+
+template <class Tune>
+template <int n, class F>
+void CensusOps<Tune>::for_each_index(F &&f) {
+  for_each_index(std::make_integer_sequence<int, n>(), f);
+}
+
+template <class Tune>
+template <class F, int... i>
+void CensusOps<Tune>::for_each_index(std::integer_sequence<int, i...>, F &f) {
+  (f(std::integral_constant<int, i>()), ...);
+}
+
+template <class Tune>
+template <PixelFormat format, class Rows>
+typename Tune::simd::reg::x1_t CensusOps<Tune>::pair_byte(
+    const Rows &rows,
+    int byte) {
+
+  using simd = typename Tune::simd;
+  using Pixel = std::remove_cv_t<std::remove_pointer_t<decltype(rows(0))>>;
+  using x1_t = typename simd::reg::x1_t;
+  using s1_t = typename simd::reg::s1_t;
+
+  constexpr int stride = (format == PixelFormat::YUYV) ? 2 : 1;
+
+  const x1_t one = simd::fill_x1(1);
+
+  x1_t acc;
+  simd::clear(acc);
+
+  // Most significant bit first, doubling what came before. Saturating
+  // subtraction leaves b - a > 0 exactly where a < b.
+  for (int bit = 7; bit >= 0; bit -= 1) {
+    const int i = 8*byte + bit;
+
+    acc = simd::adds_x1(acc, acc);
+
+    if (i < consts::n_pairs) {
+      const CensusPair &c = consts::window::pairs[i];
+
+      const Pixel *pa = rows(c.y0) + stride*c.x0;
+      const Pixel *pb = rows(c.y1) + stride*c.x1;
+
+      if constexpr (sizeof(Pixel) == 2) {
+        // a register of bytes takes two of 16-bit pixels per side
+        constexpr int half = consts::h_patch / 2;
+
+        s1_t a0, a1, b0, b1;
+        simd::load_s1(a0, pa);
+        simd::load_s1(a1, pa + half);
+        simd::load_s1(b0, pb);
+        simd::load_s1(b1, pb + half);
+
+        acc = simd::adds_x1(acc, simd::lt_s1x2(a0, a1, b0, b1));
+      } else {
+        x1_t a;
+        x1_t b;
+        if constexpr (format == PixelFormat::YUYV) {
+          simd::load_x1_even(a, pa);
+          simd::load_x1_even(b, pb);
+        } else {
+          simd::load_x1(a, pa);
+          simd::load_x1(b, pb);
+        }
+
+        acc = simd::adds_x1(acc, simd::min_x1(simd::subs_x1(b, a), one));
+      }
+    }
+  }
+
+  return acc;
+}
 
 // Implementation for 128-bit registers where two rows
 // (128-bits each) are processed simutaneously.
@@ -177,7 +1072,7 @@ void CensusOps<Tune>::execute_patch_x2(
   using x2_t = typename simd::reg::x2_t;
 
   constexpr int feature_half_width = consts::feature_width / 2;
-  constexpr int n_iterations = Tune::census::v_step / 2;
+  constexpr int n_iterations = consts::v_rows / consts::rows_per_x2;
 
   std::array<std::array<x1_t, 4>, n_iterations> out2;
 
@@ -205,6 +1100,9 @@ void CensusOps<Tune>::execute_patch_x2(
 
 
     for (int y = 0; y < n_iterations; y += 1) {
+      // first register of this iteration's patch
+      const int y0 = y * consts::rows_per_x2 / 2;
+
       x1_t out;
       p1_t p;
 
@@ -214,7 +1112,7 @@ void CensusOps<Tune>::execute_patch_x2(
       //
       //   p.left  = row[0].left < row[6].right
       //   p.right = row[1].left < row[7].right
-      p = simd::cmp_row2(r.row2[y+0], r.row2[y+3]);
+      p = simd::cmp_row2(r.row2[y0+0], r.row2[y0+3]);
       out = simd::template bsel2<0>(out, p);
 
       /*
@@ -230,7 +1128,7 @@ void CensusOps<Tune>::execute_patch_x2(
       //
       //   p[0] = row[2].left < row[4].right
       //   p[1] = row[3].left < row[5].right
-      p = simd::cmp_row2(r.row2[y+1], r.row2[y+2]);
+      p = simd::cmp_row2(r.row2[y0+1], r.row2[y0+2]);
       out = simd::template bsel2<1>(out, p);
 
       /*
@@ -244,7 +1142,7 @@ void CensusOps<Tune>::execute_patch_x2(
 
       //   p[0] = row[4].left < row[2].right
       //   p[1] = row[5].left < row[3].right
-      p = simd::cmp_row2(r.row2[y+2], r.row2[y+1]);
+      p = simd::cmp_row2(r.row2[y0+2], r.row2[y0+1]);
       out = simd::template bsel2<2>(out, p);
 
       /*
@@ -258,7 +1156,7 @@ void CensusOps<Tune>::execute_patch_x2(
 
       //   p[0] = row[6].left < row[0].right
       //   p[1] = row[7].left < row[1].right
-      p = simd::cmp_row2(r.row2[y+3], r.row2[y+0]);
+      p = simd::cmp_row2(r.row2[y0+3], r.row2[y0+0]);
       out = simd::template bsel2<3>(out, p);
 
       /*
@@ -283,10 +1181,10 @@ void CensusOps<Tune>::execute_patch_x2(
       //
       // Note these are references, not copies. Copies would add an entire
       // patch-worth of register pressure. Instead, we transpose, then undo.
-      x2_t &odd_x = r.row2[y];
-      x2_t &odd_2 = r.row2[y+1];
-      x2_t &odd_0 = r.row2[y+2];
-      x2_t &odd_1 = r.row2[y+3];
+      x2_t &odd_x = r.row2[y0];
+      x2_t &odd_2 = r.row2[y0+1];
+      x2_t &odd_0 = r.row2[y0+2];
+      x2_t &odd_1 = r.row2[y0+3];
 
       simd::transpose_row2(odd_1, odd_0);
       simd::transpose_row2(odd_x, odd_0);
@@ -406,22 +1304,24 @@ void CensusOps<Tune>::execute_patch_x2(
 
   // Finish with comparisons above and below center pixel.
   for (int y = 0; y < n_iterations; y += 1) {
+    const int y0 = y * consts::rows_per_x2 / 2;
+
     // Three comparisons remain (not seven, since the center column
     // is vertically mirrored, and no self comparison). Compute the
     // last comparisons and store results in last bit (7) unused by
     // previous loop.
     p1_t p;
 
-    p = simd::cmp_row2(r.row2[y+0], r.row2[y+3]);
+    p = simd::cmp_row2(r.row2[y0+0], r.row2[y0+3]);
     out2[y][0] = simd::template bsel2<7>(out2[y][0], p);
 
-    p = simd::cmp_row2(r.row2[y+1], r.row2[y+2]);
+    p = simd::cmp_row2(r.row2[y0+1], r.row2[y0+2]);
     out2[y][1] = simd::template bsel2<7>(out2[y][1], p);
 
-    x2_t &odd_x = r.row2[y];
-    x2_t &odd_2 = r.row2[y+1];
-    x2_t &odd_0 = r.row2[y+2];
-    x2_t &odd_y = r.row2[y+3];
+    x2_t &odd_x = r.row2[y0];
+    x2_t &odd_2 = r.row2[y0+1];
+    x2_t &odd_0 = r.row2[y0+2];
+    x2_t &odd_y = r.row2[y0+3];
 
     // first transpose unessesary because odd_y unused in comparisons
     // simd::transpose_row2(odd_y, odd_0);
@@ -432,6 +1332,14 @@ void CensusOps<Tune>::execute_patch_x2(
     p = simd::cmp_row2(odd_0, odd_2);
     out2[y][2] = simd::template bsel2<7>(out2[y][2], p);
 
+    // Unless rows_per_x2 is 8, the next iteration starts on registers of
+    // this one, which must hold their rows again.
+    if ((y + 1 < n_iterations) && (consts::rows_per_x2 < 8)) {
+      simd::transpose_row2(odd_0, odd_2);
+      simd::transpose_row2(odd_2, odd_y);
+      simd::transpose_row2(odd_x, odd_0);
+    }
+
     /*
     std::cout << "prezip\n";
 
@@ -465,7 +1373,8 @@ void CensusOps<Tune>::execute_patch_x2(
     std::cout << "\n";
     */
 
-    // store descriptors for rows(2)*h_step(8) = (16) pixels
+    // store descriptors for rows(rows_per_x2)*h_step(8) pixels. Each store
+    // writes one row per lane, store_feature places the lanes two rows apart.
     uint32_t *dst0 = dst;
     uint32_t *dst1 = dst + dst_pitch;
     simd::store_feature(out2[y][0], dst0 + 0, dst_pitch);
@@ -473,7 +1382,7 @@ void CensusOps<Tune>::execute_patch_x2(
     simd::store_feature(out2[y][2], dst1 + 0, dst_pitch);
     simd::store_feature(out2[y][3], dst1 + 4, dst_pitch);
 
-    dst += 2*dst_pitch;
+    dst += consts::rows_per_x2*dst_pitch;
   }
 }
 
@@ -1,11 +1,13 @@
+#include <algorithm>
 #include <random>
 #include <iostream>
 
-#include <tune/array128_tune.hpp>
 #include <detail/census_ops.hpp>
 
 #include <gtest/gtest.h>
 
+#include "test_tunes.hpp"
+
 namespace sgm_cpu {
 namespace test {
 
@@ -22,10 +24,45 @@ std::vector<uint32_t> apply_census(const uint8_t *src,
 [[maybe_unused]] static
 std::ostream &print_descriptor(std::ostream &os, uint32_t desc);
 
-TEST(CensusOpsTest, ExecuteCensus) {
+template <class Tune>
+class CensusOpsTest : public ::testing::Test {};
+
+// A tune with another v_step, rounded up to whole registers by CensusOps
+template <class Base, int v_step_>
+struct VStepTune {
+  using simd = typename Base::simd;
+
+  struct census {
+    static constexpr int h_block = Base::census::h_block;
+    static constexpr int v_block = Base::census::v_block;
+
+    static constexpr int h_step = Base::census::h_step;
+    static constexpr int v_step = v_step_;
+  };
+};
+
+// A tune that runs execute_block_x2_sliding in execute_census
+template <class Base>
+struct SlidingTune {
+  using simd = typename Base::simd;
+
+  struct census {
+    static constexpr int h_block = Base::census::h_block;
+    static constexpr int v_block = Base::census::v_block;
+
+    static constexpr int h_step = Base::census::h_step;
+    static constexpr int v_step = Base::census::v_step;
+
+    static constexpr bool sliding = true;
+  };
+};
+
+TYPED_TEST_SUITE(CensusOpsTest, TestTunes);
+
+TYPED_TEST(CensusOpsTest, ExecuteCensus) {
   std::minstd_rand0 rng;
 
-  using Ops = detail::CensusOps<tune::Array128>;
+  using Ops = detail::CensusOps<TypeParam>;
 
   constexpr uint32_t sentinel = 0xffffffff;
 
@@ -48,10 +85,44 @@ TEST(CensusOpsTest, ExecuteCensus) {
   ASSERT_EQ(output.back(), sentinel);
 }
 
-TEST(CensusOpsTest, ExecuteBlockX2) {
+// Blocks are disjoint, so any order gives the same output
+TYPED_TEST(CensusOpsTest, ExecuteCensusBlocksReversed) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::CensusOps<TypeParam>;
+
+  constexpr uint32_t sentinel = 0xffffffff;
+
+  int W = 2 * Ops::tune::census::h_block + 8 + 20;
+  int H = 2 * Ops::tune::census::v_block + 6 + 3;
+
+  std::vector<uint8_t> patch = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(patch.data(), W, H, W);
+
+  std::vector<uint32_t> output(reference.size() + 1);
+  output.back() = sentinel;
+
+  char *src = reinterpret_cast<char *>(patch.data());
+
+  // a 20 wide remainder is a block of its own, 3 rows are merged
+  int n_blocks = Ops::census_blocks(W, H);
+  ASSERT_EQ(n_blocks, 3*2);
+
+  for (int block = n_blocks - 1; block >= 0; block -= 1) {
+    Ops::execute_census_block(src, output.data(), W, H, W, W-8, block);
+  }
+
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(output[i], reference[i]) << "i = " << i << "\n";
+  }
+
+  ASSERT_EQ(output.back(), sentinel);
+}
+
+TYPED_TEST(CensusOpsTest, ExecuteBlockX2) {
   std::minstd_rand0 rng;
 
-  using Ops = detail::CensusOps<tune::Array128>;
+  using Ops = detail::CensusOps<TypeParam>;
 
   constexpr uint32_t sentinel = 0xffffffff;
 
@@ -74,10 +145,10 @@ TEST(CensusOpsTest, ExecuteBlockX2) {
   ASSERT_EQ(output.back(), sentinel);
 }
 
-TEST(CensusOpsTest, ExecuteBlockX2_Undersize) {
+TYPED_TEST(CensusOpsTest, ExecuteBlockX2_Undersize) {
   std::minstd_rand0 rng;
 
-  using Ops = detail::CensusOps<tune::Array128>;
+  using Ops = detail::CensusOps<TypeParam>;
 
   constexpr uint32_t sentinel = 0xffffffff;
 
@@ -100,10 +171,10 @@ TEST(CensusOpsTest, ExecuteBlockX2_Undersize) {
   ASSERT_EQ(output.back(), sentinel);
 }
 
-TEST(CensusOpsTest, ExecuteBlockX2_Oversize) {
+TYPED_TEST(CensusOpsTest, ExecuteBlockX2_Oversize) {
   std::minstd_rand0 rng;
 
-  using Ops = detail::CensusOps<tune::Array128>;
+  using Ops = detail::CensusOps<TypeParam>;
 
   constexpr uint32_t sentinel = 0xffffffff;
 
@@ -129,20 +200,537 @@ TEST(CensusOpsTest, ExecuteBlockX2_Oversize) {
   ASSERT_EQ(output.back(), sentinel);
 }
 
-TEST(CensusOpsTest, ExecutePatchX2) {
+template <class Tune>
+static void check_execute_census(int W, int H, std::minstd_rand0 &rng) {
+  using Ops = detail::CensusOps<Tune>;
+
+  constexpr uint32_t sentinel = 0xffffffff;
+
+  std::vector<uint8_t> patch = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(patch.data(), W, H, W);
+
+  std::vector<uint32_t> output(reference.size() + 1);
+  output.back() = sentinel;
+
+  char *src = reinterpret_cast<char *>(patch.data());
+  Ops::execute_census(src, output.data(), W, H, W, W-8);
+
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(output[i], reference[i]) << "v_step = " <<
+      Tune::census::v_step << ", i = " << i << "\n";
+  }
+
+  ASSERT_EQ(output.back(), sentinel);
+}
+
+// Steps of several registers per patch, and steps that are not a multiple
+// of census_rows_per_x2 at all
+TYPED_TEST(CensusOpsTest, ExecuteCensusVStep) {
+  std::minstd_rand0 rng;
+
+  int W = 2 * TypeParam::census::h_block + 8 + 20;
+  int H = 2 * TypeParam::census::v_block + 6 + 13;
+
+  check_execute_census<VStepTune<TypeParam, 1>>(W, H, rng);
+  check_execute_census<VStepTune<TypeParam, 3>>(W, H, rng);
+  check_execute_census<VStepTune<TypeParam, 4>>(W, H, rng);
+  check_execute_census<VStepTune<TypeParam, 5>>(W, H, rng);
+  check_execute_census<VStepTune<TypeParam, 6>>(W, H, rng);
+  check_execute_census<VStepTune<TypeParam, 8>>(W, H, rng);
+  check_execute_census<VStepTune<TypeParam, 16>>(W, H, rng);
+}
+
+template <class Tune>
+static void check_block_x2_sliding(int W, int H, std::minstd_rand0 &rng) {
+  using Ops = detail::CensusOps<Tune>;
+
+  constexpr uint32_t sentinel = 0xffffffff;
+
+  std::vector<uint8_t> patch = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(patch.data(), W, H, W);
+
+  std::vector<uint32_t> output(reference.size() + 1);
+  output.back() = sentinel;
+
+  char *src = reinterpret_cast<char *>(patch.data());
+  Ops::execute_block_x2_sliding(src, output.data(), W-8, H-6, W, W-8);
+
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(output[i], reference[i]) << "v_step = " <<
+      Tune::census::v_step << ", i = " << i << "\n";
+  }
+
+  ASSERT_EQ(output.back(), sentinel);
+}
+
+// Heights that end on a whole step and ones that need the last patch moved
+TYPED_TEST(CensusOpsTest, ExecuteBlockX2Sliding) {
   std::minstd_rand0 rng;
 
+  int W = TypeParam::census::h_block + 8 + 3;
+
+  for (int H : { TypeParam::census::v_block + 6,
+      TypeParam::census::v_block + 6 + 5 }) {
+    check_block_x2_sliding<TypeParam>(W, H, rng);
+    check_block_x2_sliding<VStepTune<TypeParam, 3>>(W, H, rng);
+    check_block_x2_sliding<VStepTune<TypeParam, 4>>(W, H, rng);
+    check_block_x2_sliding<VStepTune<TypeParam, 8>>(W, H, rng);
+  }
+}
+
+// execute_census with the sliding kernel selected, as the autotuner may
+TYPED_TEST(CensusOpsTest, ExecuteCensusSliding) {
+  std::minstd_rand0 rng;
+
+  static_assert(detail::CensusOps<SlidingTune<TypeParam>>::consts::sliding,
+      "SlidingTune selects the sliding kernel");
+
+  int W = 2 * TypeParam::census::h_block + 8 + 20;
+  int H = 2 * TypeParam::census::v_block + 6 + 13;
+
+  check_execute_census<SlidingTune<TypeParam>>(W, H, rng);
+}
+
+// The census of a window from its pairs, one pixel at a time
+template <class Window, class Pixel>
+static std::vector<typename Window::feature_type> apply_window(
+    const Pixel *src, int width, int height, int src_pitch) {
+
+  using feature_type = typename Window::feature_type;
+
+  const int dst_width = width - (Window::width - 1);
+  const int dst_height = height - (Window::height - 1);
+
+  std::vector<feature_type> dst(dst_width * dst_height);
+
+  for (int y = 0; y < dst_height; y += 1) {
+    for (int x = 0; x < dst_width; x += 1) {
+      const Pixel *p = src + y*src_pitch + x;
+
+      feature_type desc = 0;
+      for (size_t i = 0; i < Window::pairs.size(); i += 1) {
+        const CensusPair &c = Window::pairs[i];
+        bool b = p[c.y0*src_pitch + c.x0] < p[c.y1*src_pitch + c.x1];
+        desc |= static_cast<feature_type>(b ? 1 : 0) << i;
+      }
+      dst[y*dst_width + x] = desc;
+    }
+  }
+
+  return dst;
+}
+
+template <class Tune>
+static void check_window(int W, int H, std::minstd_rand0 &rng) {
+  using Ops = detail::CensusOps<Tune>;
+  using Window = typename Tune::census::window;
+
+  using feature_type = typename Ops::feature_type;
+
+  constexpr feature_type sentinel = ~feature_type(0);
+
+  const int dst_width = W - (Window::width - 1);
+
+  std::vector<uint8_t> patch = random_patch(W, H, rng);
+  std::vector<feature_type> reference = apply_window<Window>(patch.data(), W, H,
+      W);
+
+  std::vector<feature_type> output(reference.size() + 1);
+  output.back() = sentinel;
+
+  char *src = reinterpret_cast<char *>(patch.data());
+  Ops::execute_census(src, output.data(), W, H, W, dst_width);
+
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(output[i], reference[i]) << Window::width << "x" <<
+      Window::height << ", i = " << i << "\n";
+  }
+
+  ASSERT_EQ(output.back(), sentinel);
+}
+
+// 12-bit pixels, as from a camera, with many neighbours a few codes apart:
+// lost to a shift down to 8 bits, but not to the 16-bit census.
+template <class Tune>
+static void check_wide_input(int W, int H, std::minstd_rand0 &rng) {
+  using Ops = detail::CensusOps<Tune>;
+  using Window = typename Tune::census::window;
+
+  using feature_type = typename Ops::feature_type;
+
+  constexpr feature_type sentinel = ~feature_type(0);
+
+  const int dst_width = W - (Window::width - 1);
+  const int src_pitch = W + 3;
+
+  std::vector<uint16_t> image(src_pitch * H);
+  for (uint16_t &p : image) {
+    p = 2048 + rng() % 8;
+  }
+  // and the extremes of the range
+  image[0] = 0;
+  image[1] = 0xffff;
+
+  std::vector<feature_type> reference = apply_window<Window>(image.data(), W, H,
+      src_pitch);
+
+  std::vector<feature_type> output(reference.size() + 1);
+  output.back() = sentinel;
+
+  Ops::execute_census(image.data(), output.data(), W, H, src_pitch,
+      dst_width);
+
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(output[i], reference[i]) << Window::width << "x" <<
+      Window::height << ", i = " << i << "\n";
+  }
+
+  ASSERT_EQ(output.back(), sentinel);
+}
+
+TYPED_TEST(CensusOpsTest, ExecuteCensusWideInput) {
+  std::minstd_rand0 rng;
+
+  int W = 2 * TypeParam::census::h_block + 20 + 3;
+  int H = 2 * TypeParam::census::v_block + 13;
+
+  check_wide_input<WideInputTune<TypeParam>>(W, H, rng);
+  check_wide_input<WideInputTune<TypeParam, CensusWindow5x5>>(W, H, rng);
+  check_wide_input<WideInputTune<TypeParam, CensusWindow7x7>>(W, H, rng);
+  check_wide_input<WideInputTune<TypeParam, CensusWindow11x9>>(W, H, rng);
+}
+
+// Luma read in place from YUYV matches the census of the Y plane. The
+// chroma bytes are random, so any that leaked in would show.
+template <class Tune>
+static void check_yuyv(int W, int H, std::minstd_rand0 &rng) {
+  using Ops = detail::CensusOps<Tune>;
+  using Window = detail::census_window_t<Tune>;
+
+  using feature_type = typename Ops::feature_type;
+
+  constexpr feature_type sentinel = ~feature_type(0);
+
+  const int dst_width = W - (Window::width - 1);
+  const int src_pitch = 2*W + 6;
+
+  std::vector<uint8_t> yuyv = random_patch(src_pitch, H, rng);
+  std::vector<uint8_t> luma(W*H);
+  for (int y = 0; y < H; y += 1) {
+    for (int x = 0; x < W; x += 1) {
+      luma[y*W + x] = yuyv[y*src_pitch + 2*x];
+    }
+  }
+
+  std::vector<feature_type> reference = apply_window<Window>(luma.data(), W, H,
+      W);
+
+  std::vector<feature_type> output(reference.size() + 1);
+  output.back() = sentinel;
+
+  char *src = reinterpret_cast<char *>(yuyv.data());
+  Ops::execute_census(src, output.data(), W, H, src_pitch, dst_width,
+      PixelFormat::YUYV);
+
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(output[i], reference[i]) << Window::width << "x" <<
+      Window::height << ", i = " << i << "\n";
+  }
+
+  ASSERT_EQ(output.back(), sentinel);
+}
+
+// with a 20 column block, narrower than a register on AVX2 and AVX-512
+TYPED_TEST(CensusOpsTest, ExecuteCensusYuyv) {
+  std::minstd_rand0 rng;
+
+  int W = 2 * TypeParam::census::h_block + 8 + 20;
+  int H = 2 * TypeParam::census::v_block + 13;
+
+  check_yuyv<WindowTune<TypeParam, CensusWindow9x7>>(W, H, rng);
+  check_yuyv<WindowTune<TypeParam, CensusWindow5x5>>(W, H, rng);
+  check_yuyv<WindowTune<TypeParam, CensusWindow11x9>>(W, H, rng);
+  check_yuyv<SlidingTune<TypeParam>>(W, H, rng);
+}
+
+TYPED_TEST(CensusOpsTest, ExecuteCensusRois) {
+  using Ops = detail::CensusOps<TypeParam>;
+
+  std::minstd_rand0 rng;
+
+  constexpr uint32_t sentinel = 0xffffffff;
+
+  int W = 3 * TypeParam::census::h_block + 8 + 20;
+  int H = 3 * TypeParam::census::v_block + 6 + 13;
+  int dst_width = W - 8;
+  int dst_height = H - 6;
+
+  std::vector<uint8_t> patch = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(patch.data(), W, H, W);
+
+  // overlapping, partly off the image, in the border only, empty
+  std::vector<Rect> rois = {
+    { 10, 5, 30, 20 }, { 25, 15, 40, 10 }, { W - 5, H - 3, 20, 20 },
+    { -10, H/2, 15, 1 }, { 0, 0, 3, 2 }, { 50, 50, 0, 10 } };
+
+  std::vector<int> blocks = Ops::roi_blocks(W, H, rois);
+  ASSERT_FALSE(blocks.empty());
+  ASSERT_TRUE(std::is_sorted(blocks.begin(), blocks.end()));
+  ASSERT_EQ(std::adjacent_find(blocks.begin(), blocks.end()), blocks.end());
+  ASSERT_LT(static_cast<int>(blocks.size()), Ops::census_blocks(W, H));
+
+  std::vector<uint32_t> output(reference.size(), sentinel);
+  char *src = reinterpret_cast<char *>(patch.data());
+  Ops::execute_census_rois(src, output.data(), W, H, W, dst_width, rois);
+
+  // every feature of a roi pixel
+  for (const Rect &roi : rois) {
+    for (int y = std::max(roi.y, 3); y < std::min(roi.y + roi.height, H - 3);
+        y += 1) {
+      for (int x = std::max(roi.x, 4); x < std::min(roi.x + roi.width, W - 4);
+          x += 1) {
+        const int i = (y - 3)*dst_width + (x - 4);
+        ASSERT_EQ(output[i], reference[i]) << "x = " << x << ", y = " << y <<
+          "\n";
+      }
+    }
+  }
+
+  // and nothing outside the blocks
+  const int n_x = Ops::block_count(dst_width, TypeParam::census::h_block,
+      Ops::consts::h_patch);
+
+  std::vector<bool> inside(reference.size());
+  for (int block : blocks) {
+    int x0, y0, bw, bh;
+    Ops::block_span(dst_width, TypeParam::census::h_block,
+        Ops::consts::h_patch, block % n_x, x0, bw);
+    Ops::block_span(dst_height, TypeParam::census::v_block,
+        Ops::consts::v_patch, block / n_x, y0, bh);
+
+    for (int y = y0; y < y0 + bh; y += 1) {
+      for (int x = x0; x < x0 + bw; x += 1) {
+        inside[y*dst_width + x] = true;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(output[i], inside[i] ? reference[i] : sentinel) <<
+      "i = " << i << "\n";
+  }
+
+  // the whole image is every block
+  ASSERT_EQ(static_cast<int>(Ops::roi_blocks(W, H, { { 0, 0, W, H } }).size()),
+      Ops::census_blocks(W, H));
+  ASSERT_TRUE(Ops::roi_blocks(W, H, {}).empty());
+}
+
+// The pixel of a size pixel axis that i reads, -1 for zero
+static int padded_index(int i, int size, CensusBorder border) {
+  if (border == CensusBorder::ZERO) {
+    return ((i < 0) || (i >= size)) ? -1 : i;
+  }
+  while ((i < 0) || (i >= size)) {
+    if (border == CensusBorder::REPLICATE) {
+      i = std::max(0, std::min(i, size - 1));
+    } else {
+      i = (i < 0) ? -i : 2*(size - 1) - i;
+    }
+  }
+  return i;
+}
+
+// A full size output against the census of the image padded by border.
+// stride 2 reads the luma of YUYV.
+template <class Tune, class Pixel>
+static void check_border(const std::vector<Pixel> &image, int W, int H,
+    int src_pitch, PixelFormat format, CensusBorder border) {
+
+  using Ops = detail::CensusOps<Tune>;
+  using Window = typename Tune::census::window;
+
+  using feature_type = typename Ops::feature_type;
+
+  constexpr feature_type sentinel = ~feature_type(0);
+
+  const int stride = (format == PixelFormat::YUYV) ? 2 : 1;
+  const int cx = Window::width / 2;
+  const int cy = Window::height / 2;
+  const int pad_width = W + 2*cx;
+  const int pad_height = H + 2*cy;
+
+  std::vector<Pixel> padded(pad_width * pad_height);
+  for (int y = 0; y < pad_height; y += 1) {
+    for (int x = 0; x < pad_width; x += 1) {
+      const int sx = padded_index(x - cx, W, border);
+      const int sy = padded_index(y - cy, H, border);
+      padded[y*pad_width + x] = ((sx < 0) || (sy < 0)) ? 0 :
+        image[sy*src_pitch + stride*sx];
+    }
+  }
+
+  std::vector<feature_type> reference = apply_window<Window>(padded.data(),
+      pad_width, pad_height, pad_width);
+  ASSERT_EQ(static_cast<int>(reference.size()), W*H);
+
+  // with a pitch wider than the output
+  const int dst_pitch = W + 5;
+  std::vector<feature_type> output(dst_pitch*H, sentinel);
+
+  using input_type = typename Ops::input_type;
+  Ops::execute_census(reinterpret_cast<const input_type *>(image.data()),
+      output.data(), W, H, src_pitch, dst_pitch, format, border);
+
+  for (int y = 0; y < H; y += 1) {
+    for (int x = 0; x < W; x += 1) {
+      ASSERT_EQ(output[y*dst_pitch + x], reference[y*W + x]) <<
+        Window::width << "x" << Window::height << " border " <<
+        static_cast<int>(border) << ", x = " << x << ", y = " << y << "\n";
+    }
+    for (int x = W; x < dst_pitch; x += 1) {
+      ASSERT_EQ(output[y*dst_pitch + x], sentinel);
+    }
+  }
+}
+
+TYPED_TEST(CensusOpsTest, ExecuteCensusBorder) {
+  std::minstd_rand0 rng;
+
+  int W = 2 * TypeParam::census::h_block + 8 + 20;
+  int H = 2 * TypeParam::census::v_block + 13;
+
+  std::vector<uint8_t> image = random_patch(W, H, rng);
+
+  for (CensusBorder border : { CensusBorder::ZERO, CensusBorder::REPLICATE,
+      CensusBorder::REFLECT }) {
+    check_border<WindowTune<TypeParam, CensusWindow9x7>>(image, W, H, W,
+        PixelFormat::GRAY, border);
+    check_border<WindowTune<TypeParam, CensusWindow5x5>>(image, W, H, W,
+        PixelFormat::GRAY, border);
+    check_border<WindowTune<TypeParam, CensusWindow7x7>>(image, W, H, W,
+        PixelFormat::GRAY, border);
+    check_border<WindowTune<TypeParam, CensusWindow11x9>>(image, W, H, W,
+        PixelFormat::GRAY, border);
+  }
+
+  std::vector<uint8_t> yuyv = random_patch(2*W + 6, H, rng);
+  check_border<WindowTune<TypeParam, CensusWindow9x7>>(yuyv, W, H, 2*W + 6,
+      PixelFormat::YUYV, CensusBorder::REFLECT);
+  check_border<WindowTune<TypeParam, CensusWindow5x5>>(yuyv, W, H, 2*W + 6,
+      PixelFormat::YUYV, CensusBorder::ZERO);
+  check_border<WindowTune<TypeParam, CensusWindow11x9>>(yuyv, W, H, 2*W + 6,
+      PixelFormat::YUYV, CensusBorder::REPLICATE);
+
+  std::vector<uint16_t> wide(W*H);
+  for (uint16_t &p : wide) {
+    p = rng() % 4096;
+  }
+  check_border<WideInputTune<TypeParam>>(wide, W, H, W, PixelFormat::GRAY,
+      CensusBorder::REPLICATE);
+}
+
+// The smallest images, where the patches of opposite edges overlap
+TYPED_TEST(CensusOpsTest, ExecuteCensusBorderMinimumSize) {
+  using Tune9x7 = WindowTune<TypeParam, CensusWindow9x7>;
+  using Tune5x5 = WindowTune<TypeParam, CensusWindow5x5>;
+
+  std::minstd_rand0 rng;
+
+  const int W = detail::CensusOps<Tune9x7>::min_width();
+  const int H = detail::CensusOps<Tune9x7>::min_height();
+  const int W5 = detail::CensusOps<Tune5x5>::min_width();
+  const int H5 = detail::CensusOps<Tune5x5>::min_height();
+
+  std::vector<uint8_t> image = random_patch(W, H, rng);
+  std::vector<uint8_t> image5 = random_patch(W5, H5, rng);
+
+  for (CensusBorder border : { CensusBorder::ZERO, CensusBorder::REPLICATE,
+      CensusBorder::REFLECT }) {
+    check_border<Tune9x7>(image, W, H, W, PixelFormat::GRAY, border);
+    check_border<Tune5x5>(image5, W5, H5, W5, PixelFormat::GRAY, border);
+  }
+}
+
+// CROP, the default, is the cropped output
+TYPED_TEST(CensusOpsTest, ExecuteCensusCrop) {
+  using Ops = detail::CensusOps<TypeParam>;
+
+  std::minstd_rand0 rng;
+
+  int W = TypeParam::census::h_block + 30;
+  int H = TypeParam::census::v_block + 20;
+
+  std::vector<uint8_t> patch = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(patch.data(), W, H, W);
+
+  std::vector<uint32_t> output(reference.size());
+  Ops::execute_census(reinterpret_cast<char *>(patch.data()), output.data(),
+      W, H, W, -1, PixelFormat::GRAY, CensusBorder::CROP);
+
+  ASSERT_EQ(output, reference);
+}
+
+// The pair table of the default window is the bit order of the 9x7 kernel
+TEST(CensusWindowTest, Window9x7MatchesKernel) {
+  std::minstd_rand0 rng;
+
+  int W = 40;
+  int H = 20;
+
+  std::vector<uint8_t> patch = random_patch(W, H, rng);
+
+  ASSERT_EQ(apply_window<CensusWindow9x7>(patch.data(), W, H, W),
+      apply_census(patch.data(), W, H, W));
+}
+
+TEST(CensusWindowTest, Pairs) {
+  ASSERT_EQ(CensusWindow5x5::pairs.size(), 12u);
+  ASSERT_EQ(CensusWindow7x7::pairs.size(), 24u);
+  ASSERT_EQ(CensusWindow11x9::pairs.size(), 49u);
+
+  // every pair is mirrored through the center
+  for (const CensusPair &c : CensusWindow7x7::pairs) {
+    ASSERT_EQ(c.x0 + c.x1, 6);
+    ASSERT_EQ(c.y0 + c.y1, 6);
+  }
+  for (const CensusPair &c : CensusWindow11x9::pairs) {
+    ASSERT_EQ(c.x0 + c.x1, 10);
+    ASSERT_EQ(c.y0 + c.y1, 8);
+  }
+
+  // and the descriptors are as narrow as the pairs allow
+  static_assert(sizeof(CensusWindow5x5::feature_type) == 2, "");
+  static_assert(sizeof(CensusWindow9x7::feature_type) == 4, "");
+  static_assert(sizeof(CensusWindow11x9::feature_type) == 8, "");
+}
+
+TYPED_TEST(CensusOpsTest, ExecuteCensusWindows) {
+  std::minstd_rand0 rng;
+
+  int W = 2 * TypeParam::census::h_block + 20 + 3;
+  int H = 2 * TypeParam::census::v_block + 13;
+
+  check_window<WindowTune<TypeParam, CensusWindow5x5>>(W, H, rng);
+  check_window<WindowTune<TypeParam, CensusWindow7x7>>(W, H, rng);
+  check_window<WindowTune<TypeParam, CensusWindow11x9>>(W, H, rng);
+}
+
+TYPED_TEST(CensusOpsTest, ExecutePatchX2) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::CensusOps<TypeParam>;
+
   constexpr int src_pitch = 16;
   constexpr int dst_pitch = 8;
+  constexpr int v_step = Ops::consts::v_rows;
 
-  std::vector<uint8_t> patch = random_patch(16, 8, rng);
+  std::vector<uint8_t> patch = random_patch(16, Ops::consts::v_patch, rng);
 
-  std::array<uint32_t, dst_pitch*2> output;
+  std::array<uint32_t, dst_pitch*v_step> output;
   std::fill(output.begin(), output.end(), 0);
 
-  using Ops = detail::CensusOps<tune::Array128>;
-
-  Ops::PatchLayout r;
+  typename Ops::PatchLayout r;
 
   for (size_t i = 0; i < r.row2.size(); i += 1) {
     const uint8_t *src = patch.data()+2*src_pitch*i;
@@ -151,12 +739,12 @@ TEST(CensusOpsTest, ExecutePatchX2) {
 
   Ops::execute_patch_x2(r, output.data(), 8);
 
-  for (int y = 0; y < 2; y += 1) {
+  for (int y = 0; y < v_step; y += 1) {
     for (int x = 0; x < 8; x += 1) {
       uint32_t ref = compute_census(patch.data() + y*src_pitch + x, src_pitch);
       uint32_t desc = output[y*dst_pitch+x];
 
-      ASSERT_EQ(ref, desc);
+      ASSERT_EQ(ref, desc) << "x, y = " << x << ", " << y << "\n";
     }
   }
 }
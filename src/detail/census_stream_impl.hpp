@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <detail/census_ops.hpp>
+
+namespace sgm_cpu {
+
+template <class Arch>
+CensusStream<Arch>::CensusStream(CensusBorder border) :
+  m_buffer_size(0),
+  m_row_buffer_size(0),
+  m_width(0),
+  m_height(0),
+  m_pitch(0),
+  m_input_width(0),
+  m_input_height(0),
+  m_format(PixelFormat::GRAY),
+  m_border(border),
+  m_rows_in(0),
+  m_rows_out(0) {
+}
+
+template <class Arch>
+bool CensusStream<Arch>::begin(int width, int height, int dst_pitch,
+    PixelFormat format) {
+
+  using CensusOps = detail::CensusOps<Arch>;
+  using window = detail::census_window_t<Arch>;
+
+  // nothing to push to until a frame starts successfully
+  m_height = 0;
+  m_rows_in = 0;
+  m_rows_out = 0;
+
+  if (m_border != CensusBorder::CROP) {
+    std::cerr << "CensusStream::begin: only CensusBorder::CROP is supported\n";
+    return false;
+  }
+
+  if ((sizeof(input_type) != 1) && (format == PixelFormat::YUYV)) {
+    std::cerr << "CensusStream::begin: YUYV is 8-bit, the tune takes 16-bit "
+      "input\n";
+    return false;
+  }
+
+  const int dst_width = width - (window::width - 1);
+  const int dst_height = height - (window::height - 1);
+
+  // at least one band of one patch across
+  if ((dst_width < CensusOps::min_band_width()) ||
+      (dst_height < CensusOps::band_rows())) {
+    std::cerr << "CensusStream::begin: minimum image size " <<
+      (CensusOps::min_band_width() + window::width - 1) << "x" <<
+      CensusOps::band_height() << " (input image " << width << "x" <<
+      height << ")\n";
+    return false;
+  }
+
+  dst_pitch = (dst_pitch == -1) ? dst_width : dst_pitch;
+
+  if (dst_pitch < dst_width) {
+    std::cerr << "CensusStream::begin: dst_pitch " << dst_pitch <<
+      " is less than the output width " << dst_width << "\n";
+    return false;
+  }
+
+  size_t required = static_cast<size_t>(dst_pitch) * dst_height;
+
+  // Kept across frames, and only the output width of each row is written:
+  // the padding up to the pitch holds whatever an earlier frame left there
+  if (required > m_buffer_size) {
+    m_feature_buffer.reset(new feature_type[required]());
+    m_buffer_size = required;
+  }
+
+  // A ring of the last band_height() rows, which execute_band reads
+  // through m_band in the order of the frame whatever the wrap point
+  size_t row_required =
+    static_cast<size_t>(CensusOps::band_height()) * width;
+
+  if (row_required > m_row_buffer_size) {
+    m_row_buffer.reset(new input_type[row_required]);
+    m_row_buffer_size = row_required;
+  }
+
+  m_band.resize(CensusOps::band_height());
+
+  m_width = dst_width;
+  m_height = dst_height;
+  m_pitch = dst_pitch;
+
+  m_input_width = width;
+  m_input_height = height;
+  m_format = format;
+
+  return true;
+}
+
+template <class Arch>
+int CensusStream<Arch>::push_row(const input_type *row) {
+
+  using CensusOps = detail::CensusOps<Arch>;
+
+  const int band_rows = CensusOps::band_rows();
+  const int band_height = CensusOps::band_height();
+
+  if ((m_height == 0) || (m_rows_in == m_input_height)) {
+    std::cerr << "CensusStream::push_row: no frame in progress, call begin "
+      "first\n";
+    return m_rows_out;
+  }
+
+  input_type *dst =
+    m_row_buffer.get() + (m_rows_in % band_height)*m_input_width;
+
+  if (m_format == PixelFormat::YUYV) {
+    // rejected by begin
+    if constexpr (sizeof(input_type) == 1) {
+      CensusOps::extract_luma(reinterpret_cast<const uint8_t *>(row),
+          reinterpret_cast<uint8_t *>(dst), m_input_width);
+    }
+  } else {
+    std::memcpy(dst, row, m_input_width * sizeof(input_type));
+  }
+
+  m_rows_in += 1;
+
+  while (m_rows_out < m_height) {
+    // As execute_block_x2, the last band moves up to end on the last row
+    const int y = std::min(m_rows_out, m_height - band_rows);
+
+    if (y + band_height > m_rows_in) {
+      break;
+    }
+
+    for (int i = 0; i < band_height; i += 1) {
+      m_band[i] =
+        m_row_buffer.get() + ((y + i) % band_height)*m_input_width;
+    }
+
+    CensusOps::execute_band(m_band.data(), m_feature_buffer.get() + y*m_pitch,
+        m_width, m_pitch);
+
+    m_rows_out = y + band_rows;
+  }
+
+  return m_rows_out;
+}
+
+} // sgm_cpu
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <iostream>
+
+#include <detail/census_ops.hpp>
+
+namespace sgm_cpu {
+namespace detail {
+
+// census_ops.hpp includes this file through census_transform.hpp before
+// CensusOps itself is declared
+template <class Tune>
+class CensusOps;
+
+} // detail
+
+template <class Arch>
+CensusTransform<Arch>::CensusTransform(CensusBorder border) :
+  m_buffer_size(0),
+  m_width(0),
+  m_height(0),
+  m_pitch(0),
+  m_border(border) {
+}
+
+template <class Arch>
+void CensusTransform<Arch>::execute(
+    const input_type *src,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    PixelFormat format) {
+
+  if (!prepare(width, height, dst_pitch, format)) {
+    return;
+  }
+
+  detail::CensusOps<Arch>::execute_census(
+      src, m_feature_buffer.get(), width, height, src_pitch, m_pitch, format,
+      m_border);
+}
+
+template <class Arch>
+void CensusTransform<Arch>::execute(
+    const input_type *src,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    ThreadPool &pool,
+    PixelFormat format) {
+
+  using CensusOps = detail::CensusOps<Arch>;
+
+  if (!prepare(width, height, dst_pitch, format)) {
+    return;
+  }
+
+  const int n_blocks = CensusOps::census_blocks(width, height);
+
+  pool.parallel_for(n_blocks + n_edges(n_blocks),
+      [&](int i) {
+        execute_task(src, width, height, src_pitch, format, i, n_blocks);
+      });
+}
+
+template <class Arch>
+void CensusTransform<Arch>::execute(
+    const input_type *src,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    const std::vector<Rect> &rois,
+    PixelFormat format) {
+
+  if (!prepare(width, height, dst_pitch, format)) {
+    return;
+  }
+
+  detail::CensusOps<Arch>::execute_census_rois(src, interior(), width,
+      height, src_pitch, m_pitch, rois, format);
+}
+
+template <class Arch>
+void CensusTransform<Arch>::execute(
+    const input_type *src,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    const std::vector<Rect> &rois,
+    ThreadPool &pool,
+    PixelFormat format) {
+
+  using CensusOps = detail::CensusOps<Arch>;
+
+  if (!prepare(width, height, dst_pitch, format)) {
+    return;
+  }
+
+  feature_type *dst = interior();
+  const std::vector<int> blocks = CensusOps::roi_blocks(width, height, rois);
+
+  pool.parallel_for(static_cast<int>(blocks.size()),
+      [&](int i) {
+        CensusOps::execute_census_block(src, dst, width, height, src_pitch,
+            m_pitch, blocks[i], format);
+      });
+}
+
+template <class Arch>
+void CensusTransform<Arch>::execute_pair(
+    CensusTransform &left,
+    CensusTransform &right,
+    const input_type *left_src,
+    const input_type *right_src,
+    int width,
+    int height,
+    int src_pitch,
+    int dst_pitch,
+    ThreadPool &pool,
+    PixelFormat format) {
+
+  using CensusOps = detail::CensusOps<Arch>;
+
+  if (!left.prepare(width, height, dst_pitch, format) ||
+      !right.prepare(width, height, dst_pitch, format)) {
+    return;
+  }
+
+  const int n_blocks = CensusOps::census_blocks(width, height);
+  const int n_left = n_blocks + left.n_edges(n_blocks);
+  const int n_right = n_blocks + right.n_edges(n_blocks);
+
+  pool.parallel_for(n_left + n_right, [&](int i) {
+    if (i < n_left) {
+      left.execute_task(left_src, width, height, src_pitch, format, i,
+          n_blocks);
+    } else {
+      right.execute_task(right_src, width, height, src_pitch, format,
+          i - n_left, n_blocks);
+    }
+  });
+}
+
+template <class Arch>
+void CensusTransform<Arch>::execute_task(
+    const input_type *src,
+    int width,
+    int height,
+    int src_pitch,
+    PixelFormat format,
+    int task,
+    int n_blocks) {
+
+  using CensusOps = detail::CensusOps<Arch>;
+
+  if (task < n_blocks) {
+    CensusOps::execute_census_block(src, interior(), width, height,
+        src_pitch, m_pitch, task, format);
+  } else {
+    CensusOps::execute_census_edge(src, m_feature_buffer.get(), width,
+        height, src_pitch, m_pitch, m_border, task - n_blocks, format);
+  }
+}
+
+template <class Arch>
+typename CensusTransform<Arch>::feature_type *
+CensusTransform<Arch>::interior() {
+  using window = detail::census_window_t<Arch>;
+
+  if (m_border == CensusBorder::CROP) {
+    return m_feature_buffer.get();
+  }
+
+  return m_feature_buffer.get() + (window::height / 2)*m_pitch +
+    window::width / 2;
+}
+
+template <class Arch>
+bool CensusTransform<Arch>::prepare(int width, int height, int dst_pitch,
+    PixelFormat format) {
+
+  using window = detail::census_window_t<Arch>;
+
+  if ((format == PixelFormat::YUYV) && (sizeof(input_type) != 1)) {
+    std::cerr << "CensusTransform::execute: YUYV is 8-bit, the tune takes "
+      "16-bit input\n";
+    return false;
+  }
+
+  // checked before any state changes, so a rejected image keeps the last
+  // output intact
+  using CensusOps = detail::CensusOps<Arch>;
+
+  if ((width < CensusOps::min_width()) || (height < CensusOps::min_height())) {
+    std::cerr << "CensusTransform::execute: input image " <<
+      width << "x" << height << " is smaller than the minimum " <<
+      CensusOps::min_width() << "x" << CensusOps::min_height() << "\n";
+    return false;
+  }
+
+  const bool crop = (m_border == CensusBorder::CROP);
+  int dst_width = crop ? width - (window::width - 1) : width;
+  int dst_height = crop ? height - (window::height - 1) : height;
+
+  dst_pitch = (dst_pitch == -1) ? dst_width : dst_pitch;
+
+  if (dst_pitch < dst_width) {
+    std::cerr << "CensusTransform::execute: dst_pitch " << dst_pitch <<
+      " is less than the output width " << dst_width << "\n";
+    return false;
+  }
+
+  size_t required = static_cast<size_t>(dst_pitch) * dst_height;
+
+  // Kept across frames, and only the output width of each row is written:
+  // the padding up to the pitch holds whatever an earlier frame left there
+  if (required > m_buffer_size) {
+    m_feature_buffer.reset(new feature_type[required]());
+    m_buffer_size = required;
+  }
+
+  m_width = dst_width;
+  m_height = dst_height;
+  m_pitch = dst_pitch;
+
+  return true;
+}
+
+} // sgm_cpu
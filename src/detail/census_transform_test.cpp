@@ -0,0 +1,416 @@
+#include <random>
+#include <iostream>
+
+#include <census_stream.hpp>
+#include <census_transform.hpp>
+
+#include <gtest/gtest.h>
+
+#include "test_tunes.hpp"
+#include "test_util.hpp"
+
+namespace sgm_cpu {
+namespace test {
+
+template <class Tune>
+class CensusTransformTest : public ::testing::Test {};
+
+TYPED_TEST_SUITE(CensusTransformTest, TestTunes);
+
+TYPED_TEST(CensusTransformTest, Execute) {
+  std::minstd_rand0 rng;
+
+  int W = 200;
+  int H = 150;
+
+  std::vector<uint8_t> image = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(image.data(), W, H, W);
+
+  CensusTransform<TypeParam> census;
+  census.execute(reinterpret_cast<char *>(image.data()), W, H, W);
+
+  ASSERT_EQ(census.get_width(), W-8);
+  ASSERT_EQ(census.get_height(), H-6);
+  ASSERT_EQ(census.get_pitch(), W-8);
+
+  const feature_type *output = census.get_output();
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(output[i], reference[i]) << "i = " << i << "\n";
+  }
+}
+
+TYPED_TEST(CensusTransformTest, ExecutePitch) {
+  std::minstd_rand0 rng;
+
+  int W = 120;
+  int H = 80;
+  int src_pitch = W + 24;
+  int dst_pitch = W + 16;
+
+  std::vector<uint8_t> image = random_patch(src_pitch, H, rng);
+  std::vector<uint32_t> reference =
+    apply_census(image.data(), W, H, src_pitch);
+
+  CensusTransform<TypeParam> census;
+  census.execute(reinterpret_cast<char *>(image.data()),
+      W, H, src_pitch, dst_pitch);
+
+  ASSERT_EQ(census.get_pitch(), dst_pitch);
+
+  const feature_type *output = census.get_output();
+  for (int y = 0; y < H-6; y += 1) {
+    for (int x = 0; x < W-8; x += 1) {
+      ASSERT_EQ(output[y*dst_pitch + x], reference[y*(W-8) + x])
+        << "x = " << x << ", y = " << y << "\n";
+    }
+  }
+}
+
+TYPED_TEST(CensusTransformTest, ReusesBuffer) {
+  std::minstd_rand0 rng;
+
+  std::vector<uint8_t> large = random_patch(160, 120, rng);
+  std::vector<uint8_t> small = random_patch(100, 60, rng);
+
+  CensusTransform<TypeParam> census;
+
+  census.execute(reinterpret_cast<char *>(large.data()), 160, 120, 160);
+  const feature_type *buffer = census.get_output();
+
+  census.execute(reinterpret_cast<char *>(large.data()), 160, 120, 160);
+  ASSERT_EQ(census.get_output(), buffer);
+
+  // a smaller frame fits in the existing buffer
+  census.execute(reinterpret_cast<char *>(small.data()), 100, 60, 100);
+  ASSERT_EQ(census.get_output(), buffer);
+
+  std::vector<uint32_t> reference = apply_census(small.data(), 100, 60, 100);
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(census.get_output()[i], reference[i]) << "i = " << i << "\n";
+  }
+}
+
+TYPED_TEST(CensusTransformTest, RejectsSmallImage) {
+  std::minstd_rand0 rng;
+
+  using CensusOps = detail::CensusOps<TypeParam>;
+
+  // larger than the feature window, smaller than a patch of features
+  const int W = CensusOps::min_width() - 1;
+  const int H = CensusOps::min_height();
+
+  std::vector<uint8_t> image = random_patch(100, 60, rng);
+  std::vector<uint8_t> small = random_patch(W, H, rng);
+
+  CensusTransform<TypeParam> census;
+  census.execute(reinterpret_cast<char *>(image.data()), 100, 60, 100);
+
+  // the output of the last frame is kept
+  census.execute(reinterpret_cast<char *>(small.data()), W, H, W);
+
+  ASSERT_EQ(census.get_width(), 100-8);
+  ASSERT_EQ(census.get_height(), 60-6);
+  ASSERT_EQ(census.get_pitch(), 100-8);
+
+  std::vector<uint32_t> reference = apply_census(image.data(), 100, 60, 100);
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(census.get_output()[i], reference[i]) << "i = " << i << "\n";
+  }
+}
+
+TYPED_TEST(CensusTransformTest, ExecuteThreaded) {
+  std::minstd_rand0 rng;
+
+  int W = 300;
+  int H = 200;
+
+  std::vector<uint8_t> image = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(image.data(), W, H, W);
+
+  for (int n_threads : { 1, 2, 5 }) {
+    ThreadPool pool(n_threads);
+
+    CensusTransform<TypeParam> census;
+    census.execute(reinterpret_cast<char *>(image.data()), W, H, W, -1, pool);
+
+    const feature_type *output = census.get_output();
+    for (size_t i = 0; i < reference.size(); i += 1) {
+      ASSERT_EQ(output[i], reference[i]) << "i = " << i << ", n_threads = " <<
+        n_threads << "\n";
+    }
+  }
+}
+
+TYPED_TEST(CensusTransformTest, ExecutePair) {
+  std::minstd_rand0 rng;
+
+  int W = 300;
+  int H = 200;
+  int dst_pitch = W;
+
+  std::vector<uint8_t> left = random_patch(W, H, rng);
+  std::vector<uint8_t> right = random_patch(W, H, rng);
+
+  ThreadPool pool(4);
+
+  CensusTransform<TypeParam> census_left;
+  CensusTransform<TypeParam> census_right;
+  CensusTransform<TypeParam>::execute_pair(census_left, census_right,
+      reinterpret_cast<char *>(left.data()),
+      reinterpret_cast<char *>(right.data()), W, H, W, dst_pitch, pool);
+
+  for (auto [census, image] : { std::make_pair(&census_left, &left),
+      std::make_pair(&census_right, &right) }) {
+
+    std::vector<uint32_t> reference = apply_census(image->data(), W, H, W);
+
+    ASSERT_EQ(census->get_pitch(), dst_pitch);
+
+    for (int y = 0; y < H-6; y += 1) {
+      for (int x = 0; x < W-8; x += 1) {
+        ASSERT_EQ(census->get_output()[y*dst_pitch + x],
+            reference[y*(W-8) + x]) << "x = " << x << ", y = " << y << "\n";
+      }
+    }
+  }
+}
+
+TYPED_TEST(CensusTransformTest, ExecuteRois) {
+  std::minstd_rand0 rng;
+
+  int W = 300;
+  int H = 200;
+
+  std::vector<uint8_t> image = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(image.data(), W, H, W);
+
+  std::vector<Rect> rois = { { 20, 30, 40, 25 }, { 45, 40, 100, 8 },
+    { 250, 150, 50, 50 } };
+
+  ThreadPool pool(3);
+
+  CensusTransform<TypeParam> census;
+  CensusTransform<TypeParam> census_threaded;
+  census.execute(reinterpret_cast<char *>(image.data()), W, H, W, -1, rois);
+  census_threaded.execute(reinterpret_cast<char *>(image.data()), W, H, W, -1,
+      rois, pool);
+
+  ASSERT_EQ(census.get_width(), W-8);
+  ASSERT_EQ(census.get_height(), H-6);
+
+  for (const CensusTransform<TypeParam> *c : { &census, &census_threaded }) {
+    for (const Rect &roi : rois) {
+      for (int y = roi.y; y < std::min(roi.y + roi.height, H - 3); y += 1) {
+        for (int x = roi.x; x < std::min(roi.x + roi.width, W - 4); x += 1) {
+          const int i = (y - 3)*(W - 8) + (x - 4);
+          ASSERT_EQ(c->get_output()[i], reference[i]) << "x = " << x <<
+            ", y = " << y << "\n";
+        }
+      }
+    }
+  }
+}
+
+// A full size output is the same over a pool, and within the border
+// matches the cropped output
+TYPED_TEST(CensusTransformTest, ExecuteBorder) {
+  std::minstd_rand0 rng;
+
+  int W = 300;
+  int H = 200;
+
+  std::vector<uint8_t> left = random_patch(W, H, rng);
+  std::vector<uint8_t> right = random_patch(W, H, rng);
+  const char *left_src = reinterpret_cast<const char *>(left.data());
+  const char *right_src = reinterpret_cast<const char *>(right.data());
+
+  ThreadPool pool(3);
+
+  CensusTransform<TypeParam> cropped;
+  cropped.execute(left_src, W, H, W);
+
+  CensusTransform<TypeParam> single(CensusBorder::REFLECT);
+  single.execute(left_src, W, H, W);
+
+  ASSERT_EQ(single.get_width(), W);
+  ASSERT_EQ(single.get_height(), H);
+  ASSERT_EQ(single.get_pitch(), W);
+
+  CensusTransform<TypeParam> threaded(CensusBorder::REFLECT);
+  threaded.execute(left_src, W, H, W, -1, pool);
+
+  CensusTransform<TypeParam> pair_left(CensusBorder::REFLECT);
+  CensusTransform<TypeParam> pair_right(CensusBorder::REFLECT);
+  CensusTransform<TypeParam>::execute_pair(pair_left, pair_right, left_src,
+      right_src, W, H, W, -1, pool);
+
+  for (int i = 0; i < W*H; i += 1) {
+    ASSERT_EQ(threaded.get_output()[i], single.get_output()[i]) <<
+      "i = " << i << "\n";
+    ASSERT_EQ(pair_left.get_output()[i], single.get_output()[i]) <<
+      "i = " << i << "\n";
+  }
+
+  for (int y = 0; y < H-6; y += 1) {
+    for (int x = 0; x < W-8; x += 1) {
+      ASSERT_EQ(single.get_output()[(y + 3)*W + x + 4],
+          cropped.get_output()[y*(W-8) + x]) << "x = " << x << ", y = " <<
+        y << "\n";
+    }
+  }
+}
+
+// Pushes image a row at a time and compares with CensusTransform::execute
+// on the whole frame. Rows must only become ready once their input is in.
+template <class Tune, class Pixel>
+static void check_stream(const std::vector<Pixel> &image, int W, int H,
+    int src_pitch, int dst_pitch, PixelFormat format) {
+
+  using input_type = typename CensusStream<Tune>::input_type;
+  using consts = typename detail::CensusOps<Tune>::consts;
+
+  const input_type *src = reinterpret_cast<const input_type *>(image.data());
+
+  CensusTransform<Tune> census;
+  census.execute(src, W, H, src_pitch, dst_pitch, format);
+
+  CensusStream<Tune> stream;
+  ASSERT_TRUE(stream.begin(W, H, dst_pitch, format));
+
+  ASSERT_EQ(stream.get_width(), census.get_width());
+  ASSERT_EQ(stream.get_height(), census.get_height());
+  ASSERT_EQ(stream.get_pitch(), census.get_pitch());
+
+  int ready = 0;
+  for (int i = 0; i < H; i += 1) {
+    const int n = stream.push_row(src + i*src_pitch);
+
+    ASSERT_EQ(n, stream.get_rows_ready());
+    ASSERT_GE(n, ready);
+    if (n > 0) {
+      ASSERT_LE(n + consts::feature_height - 1, i + 1) << "i = " << i << "\n";
+    }
+
+    // no more than a band behind the input
+    if (i + 1 < H) {
+      ASSERT_GT(n + consts::v_band, i + 1) << "i = " << i << "\n";
+    }
+
+    ready = n;
+  }
+
+  ASSERT_TRUE(stream.is_complete());
+  ASSERT_EQ(ready, census.get_height());
+
+  const int pitch = census.get_pitch();
+  for (int y = 0; y < census.get_height(); y += 1) {
+    for (int x = 0; x < census.get_width(); x += 1) {
+      ASSERT_EQ(stream.get_output()[y*pitch + x],
+          census.get_output()[y*pitch + x])
+        << "x = " << x << ", y = " << y << "\n";
+    }
+  }
+}
+
+template <class Tune>
+class CensusStreamTest : public ::testing::Test {};
+
+TYPED_TEST_SUITE(CensusStreamTest, TestTunes);
+
+TYPED_TEST(CensusStreamTest, Execute) {
+  std::minstd_rand0 rng;
+
+  for (auto [W, H] : { std::make_pair(200, 150), std::make_pair(24, 20),
+      std::make_pair(97, 61) }) {
+    std::vector<uint8_t> image = random_patch(W + 5, H, rng);
+
+    check_stream<TypeParam>(image, W, H, W + 5, -1, PixelFormat::GRAY);
+    check_stream<TypeParam>(image, W, H, W + 5, W + 3, PixelFormat::GRAY);
+  }
+}
+
+TYPED_TEST(CensusStreamTest, Windows) {
+  std::minstd_rand0 rng;
+
+  int W = 150;
+  int H = 101;
+
+  std::vector<uint8_t> image = random_patch(W, H, rng);
+
+  check_stream<WindowTune<TypeParam, CensusWindow5x5>>(image, W, H, W, -1,
+      PixelFormat::GRAY);
+  check_stream<WindowTune<TypeParam, CensusWindow7x7>>(image, W, H, W, -1,
+      PixelFormat::GRAY);
+  check_stream<WindowTune<TypeParam, CensusWindow11x9>>(image, W, H, W, -1,
+      PixelFormat::GRAY);
+
+  std::vector<uint16_t> wide(W * H);
+  for (uint16_t &p : wide) {
+    p = rng() % 4096;
+  }
+
+  check_stream<WideInputTune<TypeParam>>(wide, W, H, W, -1,
+      PixelFormat::GRAY);
+}
+
+TYPED_TEST(CensusStreamTest, Yuyv) {
+  std::minstd_rand0 rng;
+
+  int W = 130;
+  int H = 77;
+
+  std::vector<uint8_t> image = random_patch(2*W + 6, H, rng);
+
+  check_stream<TypeParam>(image, W, H, 2*W + 6, -1, PixelFormat::YUYV);
+}
+
+TYPED_TEST(CensusStreamTest, Restart) {
+  std::minstd_rand0 rng;
+
+  int W = 120;
+  int H = 80;
+
+  std::vector<uint8_t> image = random_patch(W, H, rng);
+  const char *src = reinterpret_cast<const char *>(image.data());
+
+  CensusStream<TypeParam> stream;
+
+  // no frame yet
+  ASSERT_EQ(stream.push_row(src), 0);
+
+  // too small
+  ASSERT_FALSE(stream.begin(W, 6));
+
+  // the edge features of a full size output need the whole frame
+  for (CensusBorder border : { CensusBorder::ZERO, CensusBorder::REPLICATE,
+      CensusBorder::REFLECT }) {
+    CensusStream<TypeParam> full(border);
+    ASSERT_FALSE(full.begin(W, H));
+    ASSERT_EQ(full.push_row(src), 0);
+  }
+
+  // abandon a frame half way
+  ASSERT_TRUE(stream.begin(W, H));
+  for (int i = 0; i < H/2; i += 1) {
+    stream.push_row(src + (H - 1 - i)*W);
+  }
+  ASSERT_FALSE(stream.is_complete());
+
+  ASSERT_TRUE(stream.begin(W, H));
+  ASSERT_EQ(stream.get_rows_ready(), 0);
+  for (int i = 0; i < H; i += 1) {
+    stream.push_row(src + i*W);
+  }
+  ASSERT_TRUE(stream.is_complete());
+
+  // a complete frame takes no more rows
+  ASSERT_EQ(stream.push_row(src), H - 6);
+
+  std::vector<uint32_t> reference = apply_census(image.data(), W, H, W);
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(stream.get_output()[i], reference[i]) << "i = " << i << "\n";
+  }
+}
+
+} // namespace test
+} // namespace sgm_cpu
@@ -0,0 +1,235 @@
+#include <random>
+#include <iostream>
+
+#include <census_stream.hpp>
+#include <dispatch.hpp>
+
+#include <gtest/gtest.h>
+
+#include "test_util.hpp"
+
+namespace sgm_cpu {
+namespace test {
+
+// Runs against whatever the library was built with, on whatever CPU runs
+// the test, so backends the host lacks are skipped rather than failed.
+class Dispatch : public ::testing::TestWithParam<Backend> {
+
+ protected:
+  const detail::KernelTable *kernels() {
+    const detail::KernelTable *table = detail::kernel_table(GetParam());
+    if (table) {
+      EXPECT_EQ(table->backend, GetParam());
+    }
+    return backend_available(GetParam()) ? table : nullptr;
+  }
+};
+
+TEST_P(Dispatch, ExecuteCensus) {
+  const detail::KernelTable *kernels = this->kernels();
+  if (!kernels) {
+    GTEST_SKIP() << backend_name(GetParam()) << " is not available";
+  }
+
+  std::minstd_rand0 rng;
+
+  constexpr uint32_t sentinel = 0xffffffff;
+
+  int W = 3*64 + 16;
+  int H = 3*64 + 7;
+
+  std::vector<uint8_t> patch = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(patch.data(), W, H, W);
+
+  std::vector<uint32_t> output(reference.size() + 1);
+  output.back() = sentinel;
+
+  char *src = reinterpret_cast<char *>(patch.data());
+  kernels->execute_census(src, output.data(), W, H, W, W-8,
+      PixelFormat::GRAY, CensusBorder::CROP);
+
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(output[i], reference[i]) << "i = " << i << "\n";
+  }
+
+  ASSERT_EQ(output.back(), sentinel);
+}
+
+TEST_P(Dispatch, RoiBlocks) {
+  const detail::KernelTable *kernels = this->kernels();
+  if (!kernels) {
+    GTEST_SKIP() << backend_name(GetParam()) << " is not available";
+  }
+
+  int W = 3*64 + 16;
+  int H = 3*64 + 7;
+
+  std::vector<int> blocks = kernels->roi_blocks(W, H, { { 0, 0, W, H } });
+  ASSERT_EQ(static_cast<int>(blocks.size()), kernels->census_blocks(W, H));
+
+  // a pixel away from any block edge
+  ASSERT_EQ(kernels->roi_blocks(W, H, { { 40, 40, 1, 1 } }),
+      std::vector<int>{ 0 });
+}
+
+TEST_P(Dispatch, ExecuteCostRow) {
+  const detail::KernelTable *kernels = this->kernels();
+  if (!kernels) {
+    GTEST_SKIP() << backend_name(GetParam()) << " is not available";
+  }
+
+  std::minstd_rand0 rng;
+
+  int P = kernels->cost_patch_size;
+  int W = 3*P;
+  int D = 2*P;
+
+  std::vector<uint32_t> left = random_descriptors(W, 1, 0, rng);
+  std::vector<uint32_t> right = random_descriptors(W, 1, 0, rng);
+
+  std::vector<uint8_t> output(D*W, 0xff);
+
+  kernels->execute_cost_row(left.data(), right.data(), W, D,
+      detail::CostVolume(output.data()), 0);
+
+  for (int d = 0; d < D; d += 1) {
+    for (int x = 0; x < W; x += 1) {
+      uint32_t r = x >= d ? right[x-d] : 0;
+      int expected = __builtin_popcount(left[x] ^ r);
+      ASSERT_EQ(output[W*d + x], expected) << "d = " << d << ", x = " << x;
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, Dispatch,
+    ::testing::Values(
+      Backend::Array128,
+      Backend::Neon128,
+      Backend::Sse128,
+      Backend::Avx2,
+      Backend::Avx512),
+    [](const ::testing::TestParamInfo<Backend> &info) {
+      return std::string(backend_name(info.param));
+    });
+
+TEST(SelectBackend, Automatic) {
+  Backend backend = detail::select_backend(nullptr);
+  ASSERT_TRUE(backend_available(backend));
+
+  // nothing available may be preferred over the automatic choice
+  for (Backend other : {Backend::Avx512, Backend::Avx2, Backend::Sse128}) {
+    if (backend_available(other)) {
+      ASSERT_EQ(backend, other);
+      break;
+    }
+  }
+
+  ASSERT_EQ(detail::select_backend(""), backend);
+}
+
+TEST(SelectBackend, Override) {
+  ASSERT_EQ(detail::select_backend("array128"), Backend::Array128);
+
+  Backend automatic = detail::select_backend(nullptr);
+  ASSERT_EQ(detail::select_backend(backend_name(automatic)), automatic);
+}
+
+TEST(SelectBackend, UnknownOverride) {
+  ASSERT_EQ(detail::select_backend("no-such-backend"),
+      detail::select_backend(nullptr));
+}
+
+TEST(SelectBackend, Active) {
+  ASSERT_TRUE(backend_available(active_backend()));
+  ASSERT_EQ(detail::active_kernels().backend, active_backend());
+
+  using PathOps = detail::PathAggregationOps<tune::Dispatch>;
+  ASSERT_EQ(PathOps::patch_size(), detail::active_kernels().cost_patch_size);
+}
+
+TEST(SelectBackend, CensusTransform) {
+  std::minstd_rand0 rng;
+
+  int W = 100;
+  int H = 50;
+
+  std::vector<uint8_t> image = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(image.data(), W, H, W);
+
+  CensusTransform<tune::Dispatch> census;
+  census.execute(reinterpret_cast<char *>(image.data()), W, H, W);
+
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(census.get_output()[i], reference[i]) << "i = " << i << "\n";
+  }
+}
+
+// Rows pushed one at a time through the band kernel of the active backend
+TEST(SelectBackend, CensusStream) {
+  std::minstd_rand0 rng;
+
+  int W = 100;
+  int H = 50;
+
+  std::vector<uint8_t> image = random_patch(W, H, rng);
+  std::vector<uint32_t> reference = apply_census(image.data(), W, H, W);
+
+  CensusStream<tune::Dispatch> stream;
+  ASSERT_TRUE(stream.begin(W, H));
+
+  for (int y = 0; y < H; y += 1) {
+    stream.push_row(reinterpret_cast<char *>(image.data()) + y*W);
+  }
+  ASSERT_TRUE(stream.is_complete());
+
+  for (size_t i = 0; i < reference.size(); i += 1) {
+    ASSERT_EQ(stream.get_output()[i], reference[i]) << "i = " << i << "\n";
+  }
+}
+
+TEST(SelectBackend, StereoSGM) {
+  std::minstd_rand0 rng;
+
+  int W = 100;
+  int H = 30;
+  int D = 64;
+
+  std::vector<uint8_t> left = random_patch(W, H, rng);
+  std::vector<uint8_t> right = random_patch(W, H, rng);
+
+  std::vector<uint16_t> reference =
+    reference_sgm(left.data(), right.data(), W, H, D, 10, 120,
+        PathType::SCAN_8PATH);
+
+  std::vector<uint16_t> output(W*H);
+
+  StereoSGM<tune::Dispatch> sgm(W, H, D);
+  sgm.execute(reinterpret_cast<char *>(left.data()),
+      reinterpret_cast<char *>(right.data()), output.data());
+
+  ASSERT_EQ(output, reference);
+}
+
+TEST(SelectBackend, StereoSGMDisparityMultiple) {
+  std::minstd_rand0 rng;
+
+  int W = 100;
+  int H = 30;
+
+  std::vector<uint8_t> left = random_patch(W, H, rng);
+  std::vector<uint8_t> right = random_patch(W, H, rng);
+
+  // valid with the 16 and 32 wide backends, not with avx512
+  for (int D : {16, 32, 48, 96}) {
+    std::vector<uint16_t> output(W*H, 0x1234);
+
+    StereoSGM<tune::Dispatch> sgm(W, H, D);
+    sgm.execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), output.data());
+
+    ASSERT_EQ(output, std::vector<uint16_t>(W*H, 0x1234)) << "D = " << D;
+  }
+}
+
+} // namespace test
+} // namespace sgm_cpu
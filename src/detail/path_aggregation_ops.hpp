@@ -1,6 +1,13 @@
 #pragma once
 
+#include <array>
+#include <algorithm>
+#include <cstddef>
+
 #include <types.hpp>
+#include <census_window.hpp>
+#include <cost_layout.hpp>
+#include <detail/aggregation_layout.hpp>
 
 namespace sgm_cpu {
 namespace detail {
@@ -11,40 +18,448 @@ class PathAggregationOps {
  public:
   using tune = Tune;
 
+  // the descriptors of the tune's census window, see census_window.hpp
+  using feature_type = census_feature_t<Tune>;
+
   struct PatchLayout;
+  struct HorizontalState;
+
+  // runtime equivalent of consts::patch_size
+  static int patch_size() {
+    return consts::patch_size;
+  }
+
+  // what StereoSGM requires disparity_size to be a multiple of
+  static int disparity_multiple() {
+    return consts::patch_size;
+  }
+
+  // Matching cost of one row of descriptors:
+  //
+  //   dst.data[d*dst.pitch + x] =
+  //     popcount(left[x] ^ right[x - min_disparity - d])
+  //
+  // for 0 <= x < width and 0 <= d < disparity_size, so row d is disparity
+  // min_disparity + d. Where there is no right pixel, as in libSGM it is
+  // taken to be a zero descriptor. Both width and disparity_size must be
+  // multiples of consts::patch_size, min_disparity may be any value >= 0.
+  // The left patch stays in registers across the disparity tiles.
+  // Descriptors wider than 32 bits are matched as 32-bit planes, see
+  // load_features, and their costs go up to consts::max_cost.
+  //
+  // That is with the default CostLayoutPlanes and BYTE packing, otherwise
+  // the costs are placed as cost_layout.hpp and BasicCostVolume describe.
+  // Pixel-major layouts take BYTE only.
+  static void execute_cost_row(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int disparity_size,
+      const CostVolume &dst,
+      int min_disparity = 0);
+
+  // Semi-global matching paths that arrive from the neighbouring row, which
+  // is the previous row in whichever order the caller walks the image.
+  // n_paths = 1 is the straight path, n_paths = 3 adds both diagonals.
+  //
+  // cost holds disparity_size rows of width costs, as execute_cost_row
+  // stored them, and each path's cost is added to sum in the same layout.
+  // prev is the state after the neighbouring row and cur receives this
+  // row's, both laid out by PathStateLayout (reset for the first row).
+  // Columns from valid_width onwards are outside the image. width must be a
+  // multiple of consts::patch_size, 0 <= p1 <= p2 <= 255 - max_cost (223
+  // for 32-bit descriptors).
+  static void execute_vertical_row(
+      const ConstCostVolume &cost,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      cost_sum_type *sum);
+
+  // execute_vertical_row for columns x_begin <= x < x_end only, which must
+  // be multiples of consts::patch_size. The diagonal paths read one column
+  // either side of the stripe from prev, so neighbouring stripes of a row may
+  // run concurrently, but all of the previous row must be complete.
+  static void execute_vertical_stripe(
+      const ConstCostVolume &cost,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      int x_begin,
+      int x_end,
+      cost_sum_type *sum);
+
+  // The path along the row, left to right or right to left when reverse is
+  // set. Arguments as for execute_vertical_row.
+  static void execute_horizontal_row(
+      const ConstCostVolume &cost,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      bool reverse,
+      cost_sum_type *sum);
+
+  // execute_cost_row, execute_vertical_row and execute_horizontal_row in
+  // one (min_disparity as for execute_cost_row), without storing the cost.
+  // Each patch of cost is computed into registers and goes straight into
+  // the path recurrences. The paths along the row are enabled by from_left
+  // and from_right, with both the cost is computed twice.
+  static void execute_fused_row(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      bool from_left,
+      bool from_right,
+      cost_sum_type *sum,
+      int min_disparity = 0);
+
+  // The parts of execute_fused_row on their own: the vertical paths over a
+  // stripe as for execute_vertical_stripe, and one path along the row. They
+  // compute the costs stored would hold, saturated as it holds them, so
+  // they mix with the kernels that read it. stored.data is not read.
+  static void execute_fused_vertical_stripe(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      int x_begin,
+      int x_end,
+      cost_sum_type *sum,
+      int min_disparity = 0,
+      const ConstCostVolume &stored = ConstCostVolume(nullptr));
+
+  static void execute_fused_horizontal_row(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      bool reverse,
+      cost_sum_type *sum,
+      int min_disparity = 0,
+      const ConstCostVolume &stored = ConstCostVolume(nullptr));
+
+  // dst[0:size] += src[0:size], size a multiple of consts::patch_size / 2.
+  // Adds up sums accumulated separately.
+  static void execute_sum_row(
+      const cost_sum_type *src,
+      int size,
+      cost_sum_type *dst);
+
+  template <int n_paths>
+  static void execute_vertical_stripe_(
+      const ConstCostVolume &cost,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      const uint8_t *prev,
+      uint8_t *cur,
+      int x_begin,
+      int x_end,
+      cost_sum_type *sum);
+
+  template <int n_paths>
+  static void execute_fused_vertical_stripe_(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      const uint8_t *prev,
+      uint8_t *cur,
+      int x_begin,
+      int x_end,
+      cost_sum_type *sum,
+      int min_disparity,
+      int clamp);
+
+  template <int n_paths>
+  static void execute_fused_row_(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      const uint8_t *prev,
+      uint8_t *cur,
+      bool from_left,
+      bool from_right,
+      cost_sum_type *sum,
+      int min_disparity);
+
+  // Calls f(std::integral_constant<CostPacking, packing>()), so kernels can
+  // be specialised on a packing chosen at run time
+  template <class F>
+  static inline void with_packing(CostPacking packing, F &&f);
 
-  static inline void aggregate_patch_16x16_(
-      PatchLayout &input,
+  // Row d of the costs stored packed from cost, rows pitch bytes apart
+  template <CostPacking packing>
+  static inline typename Tune::simd::reg::x1_t load_cost(
+      const cost_type *cost,
+      int pitch,
+      int d);
+
+  // Stores tile[0:patch_size], disparities d0.. for d0 a multiple of the
+  // patch size, to the packed rows from dst
+  template <CostPacking packing>
+  static inline void store_cost_tile(
+      const typename Tune::simd::reg::x1_t *tile,
+      cost_type *dst,
+      int pitch,
+      const typename Tune::simd::reg::x1_t &clamp);
+
+  // Pixel-major layouts hold bytes only, and 6 bits do not hold the cost
+  // of 64-bit descriptors
+  static inline bool check_packing(CostPacking packing) {
+    return (!consts::pixel_major || (packing == CostPacking::BYTE)) &&
+      ((consts::max_cost < 64) || (packing != CostPacking::SIX_BIT));
+  }
+
+  static inline bool check_stripe(
+      int width,
+      int disparity_size,
+      int x_begin,
+      int x_end);
+
+  // Point layout[plane].right at the right pixels of the patch at (x0,
+  // d0), offset by min_disparity, for each of the consts::n_planes planes
+  static inline void load_right_patch(
+      PatchLayout *layout,
+      const feature_type *right,
+      int x0,
+      int d0,
+      int min_disparity);
+
+  // src[0:patch_size] to reg(plane) for each plane, bits 32*plane.. of the
+  // descriptors. 32-bit descriptors load as they are, others are split
+  // (or widened) through a copy on the stack.
+  template <class Reg>
+  static inline void load_features(const feature_type *src, Reg &&reg);
+
+  template <class Reg>
+  static inline void clear_features(Reg &&reg);
+
+  // Cost of pixels x0.. against all disparities, tile[d], saturated at
+  // clamp below consts::max_cost
+  static inline void cost_tile(
+      const feature_type *left,
+      const feature_type *right,
+      int x0,
+      int disparity_size,
+      typename Tune::simd::reg::x1_t *tile,
+      int min_disparity,
+      int clamp = consts::max_cost);
+
+  // execute_vertical_row for pixels x0.., cost_at(d) gives their cost
+  template <int n_paths, class CostAt>
+  static inline void vertical_patch_(
+      const CostAt &cost_at,
+      int x0,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      const uint8_t *prev,
+      uint8_t *cur,
+      cost_sum_type *sum);
+
+  static inline void reset_horizontal(
+      HorizontalState &state,
+      int disparity_size,
+      int p2);
+
+  // execute_horizontal_row for pixels x0.. with tile[d] their cost, or
+  // with pixel_major tile[b*patch_size + i] disparities b*patch_size.. of
+  // pixel x0 + i. The tile is overwritten.
+  template <bool pixel_major = false>
+  static inline void horizontal_patch(
+      typename Tune::simd::reg::x1_t *tile,
+      int x0,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      bool reverse,
+      HorizontalState &state,
+      cost_sum_type *sum);
+
+  // One step of the path recurrence, for each byte:
+  //
+  //   cost + min(prev, prev_lower + p1, prev_upper + p1, min_prev + p2)
+  //        - min_prev
+  //
+  // where prev_lower and prev_upper are the previous path costs at d-1 and
+  // d+1, and min_prev_p2 = min_prev + p2.
+  static inline typename Tune::simd::reg::x1_t aggregate_min_cost(
+      const typename Tune::simd::reg::x1_t &cost,
+      const typename Tune::simd::reg::x1_t &prev,
+      const typename Tune::simd::reg::x1_t &prev_lower,
+      const typename Tune::simd::reg::x1_t &prev_upper,
+      const typename Tune::simd::reg::x1_t &min_prev,
+      const typename Tune::simd::reg::x1_t &min_prev_p2,
+      const typename Tune::simd::reg::x1_t &penalty_1);
+
+  // Transpose patch_size registers of patch_size bytes in place
+  static inline void transpose_patch(typename Tune::simd::reg::x1_t *r);
+
+  // sum[0:patch_size] += r
+  static inline void accumulate_x1(
+      const typename Tune::simd::reg::x1_t &r,
+      cost_sum_type *sum);
+
+  // Hands each of the patch_size rows of cost to sink(d, cost)
+  // input[0:consts::n_planes], the cost of a descriptor being the sum of
+  // those of its planes
+  template <bool is_edge_block, class Sink>
+  static inline void aggregate_patch_(
+      PatchLayout *input,
+      Sink &&sink);
+
+  // popcnt_xor_w4<offset> summed over the planes of input
+  template <int offset>
+  static inline typename Tune::simd::reg::x1_t popcnt_xor_planes(
+      const PatchLayout *input);
+
+  // Cost of consts::patch_size left pixels against as many disparities,
+  // whatever the register width of the backend.
+  static inline void aggregate_patch(
+      PatchLayout *input,
       uint8_t *dst,
-      int dst_pitch);
+      int dst_pitch) {
 
-  template <bool is_edge_block>
-  static inline void aggregate_patch_16x16_(
-      PatchLayout &input,
+    aggregate_patch_<false>(input, RowStore{dst, dst_pitch});
+  }
+
+  static inline void aggregate_edge_patch(
+      PatchLayout *input,
       uint8_t *dst,
-      int dst_pitch);
+      int dst_pitch) {
+
+    aggregate_patch_<true>(input, RowStore{dst, dst_pitch});
+  }
 
   static inline void aggregate_patch_16x16(
-      PatchLayout &input,
+      PatchLayout *input,
       uint8_t *dst,
       int dst_pitch) {
 
-    aggregate_patch_16x16_<false>(input, dst, dst_pitch);
+    static_assert(consts::patch_size == 16, "Tune has a different patch size");
+    aggregate_patch_<false>(input, RowStore{dst, dst_pitch});
   }
 
   static inline void aggregate_edge_patch_16x16(
-      PatchLayout &input,
+      PatchLayout *input,
+      uint8_t *dst,
+      int dst_pitch) {
+
+    static_assert(consts::patch_size == 16, "Tune has a different patch size");
+    aggregate_patch_<true>(input, RowStore{dst, dst_pitch});
+  }
+
+  static inline void aggregate_patch_32x32(
+      PatchLayout *input,
+      uint8_t *dst,
+      int dst_pitch) {
+
+    static_assert(consts::patch_size == 32, "Tune has a different patch size");
+    aggregate_patch_<false>(input, RowStore{dst, dst_pitch});
+  }
+
+  static inline void aggregate_edge_patch_32x32(
+      PatchLayout *input,
+      uint8_t *dst,
+      int dst_pitch) {
+
+    static_assert(consts::patch_size == 32, "Tune has a different patch size");
+    aggregate_patch_<true>(input, RowStore{dst, dst_pitch});
+  }
+
+  static inline void aggregate_patch_64x64(
+      PatchLayout *input,
       uint8_t *dst,
       int dst_pitch) {
 
-    aggregate_patch_16x16_<true>(input, dst, dst_pitch);
+    static_assert(consts::patch_size == 64, "Tune has a different patch size");
+    aggregate_patch_<false>(input, RowStore{dst, dst_pitch});
+  }
+
+  static inline void aggregate_edge_patch_64x64(
+      PatchLayout *input,
+      uint8_t *dst,
+      int dst_pitch) {
+
+    static_assert(consts::patch_size == 64, "Tune has a different patch size");
+    aggregate_patch_<true>(input, RowStore{dst, dst_pitch});
   }
 
   static inline void aggregate_patch_16x1(
     const typename Tune::simd::reg::x1_t &cost,
     uint8_t *dst);
 
+  // aggregate_patch_ sink that stores rows dst_pitch apart
+  struct RowStore {
+    uint8_t *dst;
+    int dst_pitch;
+
+    void operator()(int d, const typename Tune::simd::reg::x1_t &cost) const {
+      aggregate_patch_16x1(cost, dst + d*dst_pitch);
+    }
+  };
+
   struct consts {
+    using cost_layout = cost_layout_t<Tune>;
+
+    static constexpr bool pixel_major = is_pixel_major<cost_layout>();
+
+    // descriptors per register, four registers per w4_t
+    static constexpr int descriptors_per_w1 =
+      Tune::simd::reg::descriptors_per_w1;
+
+    static constexpr int patch_size = 4 * descriptors_per_w1;
+
+    // bounds the scratch registers of execute_horizontal_row
+    static constexpr int max_disparity_size = 256;
+
+    // 32-bit planes of a descriptor, each a PatchLayout
+    static constexpr int n_planes =
+      static_cast<int>((sizeof(feature_type) + 3) / 4);
+
+    // Hamming distance of two descriptors at most, no clamp at all
+    static constexpr int max_cost = 8 * static_cast<int>(sizeof(feature_type));
   };
 
   struct PatchLayout {
@@ -52,6 +467,15 @@ class PathAggregationOps {
     std::array<typename Tune::simd::reg::w4_t, 2> right;
   };
 
+  // Path along the row, carried from one patch to the next
+  struct HorizontalState {
+    typename Tune::simd::reg::x1_t path[
+      consts::max_disparity_size / consts::patch_size];
+    typename Tune::simd::reg::x1_t min_prev;
+    typename Tune::simd::reg::x1_t min_prev_p2;
+    typename Tune::simd::reg::x1_t penalty_2;
+  };
+
 };
 
 } // detail
@@ -1,158 +1,1167 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <type_traits>
+
 namespace sgm_cpu {
 namespace detail {
 
+template <class Tune>
+void PathAggregationOps<Tune>::execute_cost_row(
+    const feature_type *left,
+    const feature_type *right,
+    int width,
+    int disparity_size,
+    const CostVolume &dst,
+    int min_disparity) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int P = consts::patch_size;
+
+  if (((width % P) != 0) || ((disparity_size % P) != 0) ||
+      (min_disparity < 0)) {
+    std::cerr << "PathAggregationOps::execute_cost_row: width and "
+      "disparity size must be multiples of " << P << ", min disparity "
+      "non-negative (" << width << ", " << disparity_size << ", " <<
+      min_disparity << ")\n";
+    return;
+  }
+
+  if ((dst.packing == CostPacking::FOUR_BIT) &&
+      ((dst.clamp < 0) || (dst.clamp > 15))) {
+    std::cerr << "PathAggregationOps::execute_cost_row: 4-bit costs must be "
+      "clamped to 0..15 (" << dst.clamp << ")\n";
+    return;
+  }
+
+  if (!check_packing(dst.packing)) {
+    std::cerr << "PathAggregationOps::execute_cost_row: the tune's cost "
+      "layout or descriptors do not fit the packing\n";
+    return;
+  }
+
+  using cost_layout = typename consts::cost_layout;
+
+  const int dst_pitch = (dst.pitch == -1) ? width : dst.pitch;
+
+  const x1_t clamp_x1 = simd::fill_x1(static_cast<uint8_t>(dst.clamp));
+
+  with_packing(dst.packing, [&](auto packed) {
+    constexpr CostPacking packing_ = decltype(packed)::value;
+
+    const int rows = CostVolumeLayout::rows(disparity_size, packing_);
+    const int row_pitch = cost_layout::row_pitch(rows, dst_pitch, P);
+    const int pixel_pitch = cost_layout::pixel_pitch(rows);
+
+    std::array<PatchLayout, consts::n_planes> layout;
+
+    for (int x0 = 0; x0 < width; x0 += P) {
+      cost_type *patch = dst.data +
+        cost_layout::patch(x0, rows, dst_pitch);
+
+      load_features(left + x0, [&layout](int p) -> auto & {
+        return layout[p].left;
+      });
+
+      for (int d0 = 0; d0 < disparity_size; d0 += P) {
+        cost_type *tile_dst = patch +
+          CostVolumeLayout::rows(d0, packing_)*row_pitch;
 
-/*
-void do_it() {
-  for (int by = 0; by < height; by += 1) {
-    for (int bx = 0; bx < width; bx += Tune::aggregation::block_x) {
-      aggregate_block();
+        load_right_patch(layout.data(), right, x0, d0, min_disparity);
+
+        if constexpr (consts::pixel_major) {
+          x1_t tile[P];
+          aggregate_patch_<false>(layout.data(),
+              [&tile](int d, const x1_t &cost) {
+            tile[d] = cost;
+          });
+          transpose_patch(tile);
+
+          for (int i = 0; i < P; i += 1) {
+            simd::store_x1(tile[i], tile_dst + i*pixel_pitch);
+          }
+        } else if constexpr (packing_ == CostPacking::BYTE) {
+          aggregate_patch(layout.data(), tile_dst, row_pitch);
+        } else {
+          // packing combines rows, so the whole tile is needed first
+          x1_t tile[P];
+          aggregate_patch_<false>(layout.data(),
+              [&tile](int d, const x1_t &cost) {
+            tile[d] = cost;
+          });
+          store_cost_tile<packing_>(tile, tile_dst, row_pitch, clamp_x1);
+        }
+      }
     }
+  });
+}
+
+
+template <class Tune>
+void PathAggregationOps<Tune>::execute_vertical_row(
+    const ConstCostVolume &cost,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    int p2,
+    int n_paths,
+    const uint8_t *prev,
+    uint8_t *cur,
+    cost_sum_type *sum) {
+
+  execute_vertical_stripe(cost, width, valid_width, disparity_size, p1, p2,
+      n_paths, prev, cur, 0, width, sum);
+}
+
+template <class Tune>
+void PathAggregationOps<Tune>::execute_vertical_stripe(
+    const ConstCostVolume &cost,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    int p2,
+    int n_paths,
+    const uint8_t *prev,
+    uint8_t *cur,
+    int x_begin,
+    int x_end,
+    cost_sum_type *sum) {
+
+  constexpr int P = consts::patch_size;
+
+  if (!check_stripe(width, disparity_size, x_begin, x_end)) {
+    std::cerr << "PathAggregationOps::execute_vertical_stripe: width, "
+      "disparity size and stripe must be multiples of " << P <<
+      " (" << width << ", " << disparity_size << ", " << x_begin << ".." <<
+      x_end << ")\n";
+    return;
+  }
+
+  if (!check_packing(cost.packing)) {
+    std::cerr << "PathAggregationOps::execute_vertical_stripe: the tune's "
+      "cost layout or descriptors do not fit the packing\n";
+    return;
+  }
+
+  switch (n_paths) {
+    case 1:
+      execute_vertical_stripe_<1>(cost, width, valid_width, disparity_size,
+          p1, p2, prev, cur, x_begin, x_end, sum);
+      break;
+
+    case 3:
+      execute_vertical_stripe_<3>(cost, width, valid_width, disparity_size,
+          p1, p2, prev, cur, x_begin, x_end, sum);
+      break;
+
+    default:
+      std::cerr << "PathAggregationOps::execute_vertical_stripe: n_paths "
+        "must be 1 or 3 (" << n_paths << ")\n";
   }
 }
 
-void aggregate_block() {
+template <class Tune>
+template <int n_paths>
+void PathAggregationOps<Tune>::execute_vertical_stripe_(
+    const ConstCostVolume &cost,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    int p2,
+    const uint8_t *prev,
+    uint8_t *cur,
+    int x_begin,
+    int x_end,
+    cost_sum_type *sum) {
 
   using simd = typename Tune::simd;
-  using w1_t = typename simd::reg::w1_t;
+  using x1_t = typename simd::reg::x1_t;
+  using cost_layout = typename consts::cost_layout;
 
-  using aggr = typename Tune::aggregate;
+  constexpr int P = consts::patch_size;
 
-  // TODO[carl]: Abstract pixels_per_reg concept into tune
-  constexpr int n_pixels_per_w1 = 4;
-  static_assert((aggr::block_x % n_pixels_per_w1) != 0,
-        "aggregation::block_x must be divisible by 4");
+  const int pitch = (cost.pitch == -1) ? width : cost.pitch;
 
-  static_assert((aggr::block_d % n_pixels_per_w1) != 0,
-        "aggregation::block_d must be divisible by 4");
+  with_packing(cost.packing, [&](auto packed) {
+    constexpr CostPacking packing_ = decltype(packed)::value;
 
-  constexpr int n_left = aggr::block_x / n_pixels_per_w1;
-  constexpr int n_right = (aggr::block_x + aggr::block_d) / n_pixels_per_w1;
+    const int rows = CostVolumeLayout::rows(disparity_size, packing_);
+    const int row_pitch = cost_layout::row_pitch(rows, pitch, P);
+    const int pixel_pitch = cost_layout::pixel_pitch(rows);
 
-  std::array<w1_t, n_left> left;
-  std::array<w1_t, n_right> right;
+    for (int x0 = x_begin; x0 < x_end; x0 += P) {
+      const cost_type *patch = cost.data +
+        cost_layout::patch(x0, rows, pitch);
 
-  for (size_t i = right.size() - 1; i >= 1; i -= 1) {
-    simd::shift_right(right[i], right[i-1]);
+      if constexpr (consts::pixel_major) {
+        // vertical_patch_ asks for d in order, so each block of patch_size
+        // disparities is transposed once on its first
+        x1_t block[P];
+
+        auto cost_at = [&block, patch, pixel_pitch](int d) {
+          constexpr int n = consts::patch_size;
+
+          if ((d % n) == 0) {
+            for (int i = 0; i < n; i += 1) {
+              simd::load_x1(block[i], patch + i*pixel_pitch + d);
+            }
+            transpose_patch(block);
+          }
+          return block[d % n];
+        };
+
+        vertical_patch_<n_paths>(cost_at, x0, width, valid_width,
+            disparity_size, p1, p2, prev, cur, sum);
+      } else {
+        auto cost_at = [patch, row_pitch](int d) {
+          return load_cost<packing_>(patch, row_pitch, d);
+        };
+
+        vertical_patch_<n_paths>(cost_at, x0, width, valid_width,
+            disparity_size, p1, p2, prev, cur, sum);
+      }
+    }
+  });
+}
+
+template <class Tune>
+template <class F>
+void PathAggregationOps<Tune>::with_packing(CostPacking packing, F &&f) {
+  switch (packing) {
+    case CostPacking::BYTE:
+      f(std::integral_constant<CostPacking, CostPacking::BYTE>());
+      break;
+
+    case CostPacking::SIX_BIT:
+      f(std::integral_constant<CostPacking, CostPacking::SIX_BIT>());
+      break;
+
+    case CostPacking::FOUR_BIT:
+      f(std::integral_constant<CostPacking, CostPacking::FOUR_BIT>());
+      break;
   }
-  simd::shift_right_zero(right[0]);
+}
+
+// The fourth cost of a SIX_BIT group is the only one to take more than a
+// load and a mask, three loads and the two bits at the top of each.
+template <class Tune>
+template <CostPacking packing>
+typename Tune::simd::reg::x1_t PathAggregationOps<Tune>::load_cost(
+    const cost_type *cost,
+    int pitch,
+    int d) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  x1_t r;
+
+  if constexpr (packing == CostPacking::SIX_BIT) {
+    const cost_type *group = cost + (d / 4 * 3)*pitch;
+    const int k = d % 4;
+
+    if (k < 3) {
+      simd::load_x1(r, group + k*pitch);
+      return simd::and_x1(r, simd::fill_x1(0x3f));
+    }
+
+    const x1_t top = simd::fill_x1(0xc0);
+
+    x1_t r1;
+    x1_t r2;
+    simd::load_x1(r, group);
+    simd::load_x1(r1, group + pitch);
+    simd::load_x1(r2, group + 2*pitch);
 
+    r = simd::template shr_bits_x1<6>(r);
+    r = simd::or_x1(r, simd::template shr_bits_x1<4>(simd::and_x1(r1, top)));
+    r = simd::or_x1(r, simd::template shr_bits_x1<2>(simd::and_x1(r2, top)));
+    return r;
+
+  } else if constexpr (packing == CostPacking::FOUR_BIT) {
+    simd::load_x1(r, cost + (d / 2)*pitch);
+
+    if ((d % 2) == 0) {
+      return simd::and_x1(r, simd::fill_x1(0x0f));
+    }
+    return simd::template shr_bits_x1<4>(r);
+
+  } else {
+    simd::load_x1(r, cost + d*pitch);
+    return r;
+  }
 }
-*/
 
-// TODO[carl]: Abstract the patch size once the
-// hard coded implementation is figured out.
 template <class Tune>
-template <bool is_edge_block>
-void PathAggregationOps<Tune>::aggregate_patch_16x16_(
-    PathAggregationOps<Tune>::PatchLayout &input,
-    uint8_t *dst,
-    int dst_pitch) {
+template <CostPacking packing>
+void PathAggregationOps<Tune>::store_cost_tile(
+    const typename Tune::simd::reg::x1_t *tile,
+    cost_type *dst,
+    int pitch,
+    const typename Tune::simd::reg::x1_t &clamp) {
 
   using simd = typename Tune::simd;
   using x1_t = typename simd::reg::x1_t;
-  using w4_t = typename simd::reg::w4_t;
 
-  w4_t &left = input.left;
-  std::array<w4_t, 2> &right = input.right;
+  constexpr int P = consts::patch_size;
 
-  for (int shift = 0; shift < 4; shift += 1) {
-    x1_t cost0 = simd::template popcnt_xor_w4<0>(left, right[0], right[1]);
-    x1_t cost1 = simd::template popcnt_xor_w4<1>(left, right[0], right[1]);
-    x1_t cost2 = simd::template popcnt_xor_w4<2>(left, right[0], right[1]);
-    x1_t cost3 = simd::template popcnt_xor_w4<3>(left, right[0], right[1]);
+  if constexpr (packing == CostPacking::SIX_BIT) {
+    // costs are at most 32, so the low six bits are free of the fourth's
+    const x1_t top = simd::fill_x1(0xc0);
 
-    if (is_edge_block) {
-      x1_t mask = simd::fill_x1(0xff);
-      mask = simd::shiftr_x1(mask, shift);
-      cost0 = simd::and_x1(cost0, mask);
+    for (int g = 0; g < P/4; g += 1) {
+      const x1_t *c = tile + 4*g;
+      cost_type *rows = dst + 3*g*pitch;
 
-      mask = simd::shiftr_x1(mask, 4);
-      cost1 = simd::and_x1(cost1, mask);
+      simd::store_x1(simd::or_x1(c[0], simd::template shl_bits_x1<6>(c[3])),
+          rows);
+      simd::store_x1(simd::or_x1(c[1],
+            simd::and_x1(simd::template shl_bits_x1<4>(c[3]), top)),
+          rows + pitch);
+      simd::store_x1(simd::or_x1(c[2],
+            simd::and_x1(simd::template shl_bits_x1<2>(c[3]), top)),
+          rows + 2*pitch);
+    }
 
-      mask = simd::shiftr_x1(mask, 4);
-      cost2 = simd::and_x1(cost2, mask);
+  } else if constexpr (packing == CostPacking::FOUR_BIT) {
+    for (int g = 0; g < P/2; g += 1) {
+      const x1_t lo = simd::min_x1(tile[2*g], clamp);
+      const x1_t hi = simd::min_x1(tile[2*g + 1], clamp);
 
-      mask = simd::shiftr_x1(mask, 4);
-      cost3 = simd::and_x1(cost3, mask);
+      simd::store_x1(simd::or_x1(lo, simd::template shl_bits_x1<4>(hi)),
+          dst + g*pitch);
     }
 
-    aggregate_patch_16x1(cost0, dst + 0*4*dst_pitch);
-    aggregate_patch_16x1(cost1, dst + 1*4*dst_pitch);
-    aggregate_patch_16x1(cost2, dst + 2*4*dst_pitch);
-    aggregate_patch_16x1(cost3, dst + 3*4*dst_pitch);
+  } else {
+    for (int d = 0; d < P; d += 1) {
+      simd::store_x1(tile[d], dst + d*pitch);
+    }
+  }
+}
+
+template <class Tune>
+bool PathAggregationOps<Tune>::check_stripe(
+    int width,
+    int disparity_size,
+    int x_begin,
+    int x_end) {
 
-    dst += dst_pitch;
+  constexpr int P = consts::patch_size;
 
-    simd::shift_up_w4(right[0], right[1]);
+  return ((width % P) == 0) && ((disparity_size % P) == 0) &&
+    ((x_begin % P) == 0) && ((x_end % P) == 0) &&
+    (0 <= x_begin) && (x_begin <= x_end) && (x_end <= width);
+}
+
+// Vectorised over x: each register holds one disparity of patch_size
+// neighbouring pixels, and a path reads the previous row at x + dx. The
+// previous costs at d-1, d and d+1 roll through registers as d increases.
+template <class Tune>
+template <int n_paths, class CostAt>
+void PathAggregationOps<Tune>::vertical_patch_(
+    const CostAt &cost_at,
+    int x0,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    int p2,
+    const uint8_t *prev,
+    uint8_t *cur,
+    cost_sum_type *sum) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+  using s1_t = typename simd::reg::s1_t;
+
+  constexpr int P = consts::patch_size;
+
+  static_assert(n_paths == 1 || n_paths == 3, "n_paths must be 1 or 3");
+
+  // straight path first, so n_paths = 1 takes only that
+  constexpr int dx[3] = { 0, -1, 1 };
+
+  const PathStateLayout layout(width, disparity_size);
+
+  const x1_t penalty_1 = simd::fill_x1(p1);
+  const x1_t penalty_2 = simd::fill_x1(p2);
+
+  // Path costs outside the image must be zero for the next row's
+  // diagonals to start there.
+  const bool is_tail = (x0 + P) > valid_width;
+
+  x1_t tail_mask = simd::fill_x1(0xff);
+  if (is_tail) {
+    // source[P - n : 2P - n] has n leading 0xff bytes
+    std::array<uint8_t, 2*P> source;
+    std::fill(source.begin(), source.begin() + P, 0xff);
+    std::fill(source.begin() + P, source.end(), 0);
+
+    int n_valid = std::max(0, std::min(P, valid_width - x0));
+    simd::load_x1(tail_mask, source.data() + P - n_valid);
   }
 
-  /*
-  s1_t best = penalty_2;
+  x1_t min_prev[n_paths];
+  x1_t min_prev_p2[n_paths];
+  x1_t prev_lower[n_paths];
+  x1_t prev_equal[n_paths];
+  x1_t min_cur[n_paths];
 
-  for (int block = 0; block < depth; block += 8) {
-    // there are 4 descriptors per register, which must be down shifted
-    for (int shift = 0; shift < 4; shift += 1) {
-      // in an 8x8 block, each group of 4 descriptors gets compared twice
-      for (int sub_block = 0; sub_block < 8; block += 4) {
+  for (int k = 0; k < n_paths; k += 1) {
+    const uint8_t *path = prev + k*layout.path_size();
+    const int xk = x0 + dx[k];
 
-        const int storage = block | (sub_block / 4) | (shift * 4);
-        const int r = sub_block / 4;
+    simd::load_x1(min_prev[k], layout.min_row(path) + xk);
+    min_prev_p2[k] = simd::adds_x1(min_prev[k], penalty_2);
 
-        s1_t cost = simd::xor_w2(left[0], left[1], right[r], right[r+1];
+    simd::load_x1(prev_lower[k], layout.cost_row(path, -1) + xk);
+    simd::load_x1(prev_equal[k], layout.cost_row(path, 0) + xk);
 
-        // Vertical
-        {
-          const uint16_t *dp_base = v_prev.dp + depth * depth_pitch;
-          const uint16_t *min_base = v_prev.min;
+    min_cur[k] = simd::fill_x1(0xff);
+  }
+
+  for (int d = 0; d < disparity_size; d += 1) {
+    const x1_t cost_d = cost_at(d);
+
+    s1_t sum_lo;
+    s1_t sum_hi;
+    simd::load_s1(sum_lo, sum + d*width + x0);
+    simd::load_s1(sum_hi, sum + d*width + x0 + P/2);
 
-          s1_t min_prev = simd::load_s(min_base);
+    for (int k = 0; k < n_paths; k += 1) {
+      const uint8_t *path = prev + k*layout.path_size();
 
-          s1_t prev_best = v_best.prev[x];
+      x1_t prev_upper;
+      simd::load_x1(prev_upper, layout.cost_row(path, d + 1) + x0 + dx[k]);
 
-          s1_t cost_closer = v_cost.prev[x-1][d];
-          s1_t cost_equal = v_cost.prev[x][d];
-          s1_t cost_farther = v_cost.prev[x][d];
+      x1_t path_cost = aggregate_min_cost(cost_d, prev_equal[k],
+          prev_lower[k], prev_upper, min_prev[k], min_prev_p2[k], penalty_1);
 
-          s1_t cost = aggregate_min_cost(cost_closer, cost_equal, cost_farther,
-              prev_best, penalty_1, penalty_2);
+      if (is_tail) {
+        path_cost = simd::and_x1(path_cost, tail_mask);
+      }
 
-          best = simd::min_s(best, cost);
+      simd::store_x1(path_cost,
+          layout.cost_row(cur + k*layout.path_size(), d) + x0);
+      min_cur[k] = simd::min_x1(min_cur[k], path_cost);
+
+      s1_t lo;
+      s1_t hi;
+      simd::widen_x1(path_cost, lo, hi);
+      sum_lo = simd::add_s1(sum_lo, lo);
+      sum_hi = simd::add_s1(sum_hi, hi);
+
+      prev_lower[k] = prev_equal[k];
+      prev_equal[k] = prev_upper;
+    }
+
+    simd::store_s1(sum_lo, sum + d*width + x0);
+    simd::store_s1(sum_hi, sum + d*width + x0 + P/2);
+  }
+
+  for (int k = 0; k < n_paths; k += 1) {
+    simd::store_x1(min_cur[k],
+        layout.min_row(cur + k*layout.path_size()) + x0);
+  }
+}
+
+template <class Tune>
+void PathAggregationOps<Tune>::execute_horizontal_row(
+    const ConstCostVolume &cost,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    int p2,
+    bool reverse,
+    cost_sum_type *sum) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int P = consts::patch_size;
+
+  if (((width % P) != 0) || ((disparity_size % P) != 0) ||
+      (disparity_size > consts::max_disparity_size)) {
+    std::cerr << "PathAggregationOps::execute_horizontal_row: width and "
+      "disparity size must be multiples of " << P << ", disparity size at "
+      "most " << consts::max_disparity_size <<
+      " (" << width << ", " << disparity_size << ")\n";
+    return;
+  }
+
+  if (!check_packing(cost.packing)) {
+    std::cerr << "PathAggregationOps::execute_horizontal_row: the tune's "
+      "cost layout or descriptors do not fit the packing\n";
+    return;
+  }
+
+  using cost_layout = typename consts::cost_layout;
+
+  x1_t tile[consts::max_disparity_size];
+
+  HorizontalState state;
+  reset_horizontal(state, disparity_size, p2);
+
+  const int pitch = (cost.pitch == -1) ? width : cost.pitch;
+
+  with_packing(cost.packing, [&](auto packed) {
+    constexpr CostPacking packing_ = decltype(packed)::value;
+
+    const int rows = CostVolumeLayout::rows(disparity_size, packing_);
+    const int row_pitch = cost_layout::row_pitch(rows, pitch, P);
+    const int pixel_pitch = cost_layout::pixel_pitch(rows);
+
+    for (int n = 0; n < width; n += P) {
+      const int x0 = reverse ? (width - P - n) : n;
+      const cost_type *patch = cost.data +
+        cost_layout::patch(x0, rows, pitch);
+
+      if constexpr (consts::pixel_major) {
+        // already the disparities of each pixel, as the recurrence wants
+        for (int b = 0; b < disparity_size; b += P) {
+          for (int i = 0; i < P; i += 1) {
+            simd::load_x1(tile[b + i], patch + i*pixel_pitch + b);
+          }
+        }
+      } else {
+        for (int d = 0; d < disparity_size; d += 1) {
+          tile[d] = load_cost<packing_>(patch, row_pitch, d);
         }
+      }
+
+      horizontal_patch<consts::pixel_major>(tile, x0, width, valid_width,
+          disparity_size, p1, reverse, state, sum);
     }
-    */
+  });
+}
 
+template <class Tune>
+void PathAggregationOps<Tune>::reset_horizontal(
+    HorizontalState &state,
+    int disparity_size,
+    int p2) {
 
-  /*
-  s_square_t cost_patch = simd::outer_product(w_left, w_right);
+  using simd = typename Tune::simd;
 
+  for (int b = 0; b < disparity_size / consts::patch_size; b += 1) {
+    simd::clear(state.path[b]);
   }
-  */
+
+  simd::clear(state.min_prev);
+  state.penalty_2 = simd::fill_x1(p2);
+  state.min_prev_p2 = state.penalty_2;
 }
 
-/*
-template <class Arch>
-typename Arch::simd::reg::s1_t AggregateOps<Arch>::aggregate_min_cost(
-    const typename simd::reg::s1_t &cost_closer,
-    const typename simd::reg::s1_t &cost_equal,
-    const typename simd::reg::s1_t &cost_farther,
-    const typename simd::reg::s1_t &cost_prev_best,
-    const typename simd::reg::s1_t &penalty_1,
-    const typename simd::reg::s1_t &penalty_1) {
+// The recurrence runs along x, so the patches of cost are transposed to
+// hold all disparities of a pixel in disparity_size / patch_size registers
+// (unless pixel_major, when they already do), and back again to accumulate.
+template <class Tune>
+template <bool pixel_major>
+void PathAggregationOps<Tune>::horizontal_patch(
+    typename Tune::simd::reg::x1_t *tile,
+    int x0,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    bool reverse,
+    HorizontalState &state,
+    cost_sum_type *sum) {
 
-  // cost = min(equal, closer + p1, farther + p1, prev_best + p2) - prev_best
-  typename simd::reg::s1_t cost;
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
 
-  cost = simd::min_s(cost_closer, cost_farther);
-  cost = simd::add_s(cost, penalty_1);
-  cost = simd::min_s(cost, cost_p0);
-  cost = simd::sub_s(cost, prev_best);
-  cost = simd::min_s(cost, penalty_2);
+  constexpr int P = consts::patch_size;
 
-  return cost;
+  const int n_blocks = disparity_size / P;
+
+  const x1_t penalty_1 = simd::fill_x1(p1);
+  const x1_t infinity = simd::fill_x1(0xff);
+
+  const x1_t &penalty_2 = state.penalty_2;
+
+  x1_t *path = state.path;
+
+  // tile[b*P + i] then holds disparities b*P.. of pixel x0 + i
+  if (!pixel_major) {
+    for (int b = 0; b < n_blocks; b += 1) {
+      transpose_patch(tile + b*P);
+    }
+  }
+
+  for (int j = 0; j < P; j += 1) {
+    const int i = reverse ? (P - 1 - j) : j;
+
+    if ((x0 + i) >= valid_width) {
+      // outside the image, the path starts afresh at the border
+      for (int b = 0; b < n_blocks; b += 1) {
+        simd::clear(path[b]);
+      }
+      simd::clear(state.min_prev);
+      state.min_prev_p2 = penalty_2;
+      continue;
+    }
+
+    x1_t min_cur = infinity;
+    x1_t below = infinity;
+
+    for (int b = 0; b < n_blocks; b += 1) {
+      const x1_t &above = (b + 1 < n_blocks) ? path[b+1] : infinity;
+
+      x1_t prev_lower = simd::shift_up_x1(path[b], below);
+      x1_t prev_upper = simd::shift_down_x1(path[b], above);
+
+      x1_t path_cost = aggregate_min_cost(tile[b*P + i], path[b],
+          prev_lower, prev_upper, state.min_prev, state.min_prev_p2,
+          penalty_1);
+
+      below = path[b];
+      path[b] = path_cost;
+      tile[b*P + i] = path_cost;
+
+      min_cur = simd::min_x1(min_cur, path_cost);
+    }
+
+    state.min_prev = simd::hmin_x1(min_cur);
+    state.min_prev_p2 = simd::adds_x1(state.min_prev, penalty_2);
+  }
+
+  for (int b = 0; b < n_blocks; b += 1) {
+    transpose_patch(tile + b*P);
+  }
+  for (int d = 0; d < disparity_size; d += 1) {
+    accumulate_x1(tile[d], sum + d*width + x0);
+  }
+}
+
+template <class Tune>
+void PathAggregationOps<Tune>::execute_fused_row(
+    const feature_type *left,
+    const feature_type *right,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    int p2,
+    int n_paths,
+    const uint8_t *prev,
+    uint8_t *cur,
+    bool from_left,
+    bool from_right,
+    cost_sum_type *sum,
+    int min_disparity) {
+
+  constexpr int P = consts::patch_size;
+
+  if (((width % P) != 0) || ((disparity_size % P) != 0) ||
+      (disparity_size > consts::max_disparity_size) || (min_disparity < 0)) {
+    std::cerr << "PathAggregationOps::execute_fused_row: width and "
+      "disparity size must be multiples of " << P << ", disparity size at "
+      "most " << consts::max_disparity_size <<
+      " (" << width << ", " << disparity_size << ")\n";
+    return;
+  }
+
+  switch (n_paths) {
+    case 1:
+      execute_fused_row_<1>(left, right, width, valid_width, disparity_size,
+          p1, p2, prev, cur, from_left, from_right, sum, min_disparity);
+      break;
+
+    case 3:
+      execute_fused_row_<3>(left, right, width, valid_width, disparity_size,
+          p1, p2, prev, cur, from_left, from_right, sum, min_disparity);
+      break;
+
+    default:
+      std::cerr << "PathAggregationOps::execute_fused_row: n_paths must "
+        "be 1 or 3 (" << n_paths << ")\n";
+  }
+}
+
+// One pass over the patches takes the paths from the neighbouring row and
+// the path along the row in the same direction. The path in the other
+// direction needs a second pass, which recomputes the cost.
+template <class Tune>
+template <int n_paths>
+void PathAggregationOps<Tune>::execute_fused_row_(
+    const feature_type *left,
+    const feature_type *right,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    int p2,
+    const uint8_t *prev,
+    uint8_t *cur,
+    bool from_left,
+    bool from_right,
+    cost_sum_type *sum,
+    int min_disparity) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int P = consts::patch_size;
+
+  x1_t tile[consts::max_disparity_size];
+
+  auto cost_at = [&tile](int d) {
+    return tile[d];
+  };
+
+  HorizontalState state;
+  reset_horizontal(state, disparity_size, p2);
+
+  const bool reverse = !from_left;
+
+  for (int n = 0; n < width; n += P) {
+    const int x0 = reverse ? (width - P - n) : n;
+
+    cost_tile(left, right, x0, disparity_size, tile, min_disparity);
+
+    vertical_patch_<n_paths>(cost_at, x0, width, valid_width,
+        disparity_size, p1, p2, prev, cur, sum);
+
+    if (from_left || from_right) {
+      horizontal_patch(tile, x0, width, valid_width, disparity_size, p1,
+          reverse, state, sum);
+    }
+  }
+
+  if (from_left && from_right) {
+    reset_horizontal(state, disparity_size, p2);
+
+    for (int x0 = width - P; x0 >= 0; x0 -= P) {
+      cost_tile(left, right, x0, disparity_size, tile, min_disparity);
+
+      horizontal_patch(tile, x0, width, valid_width, disparity_size, p1,
+          true, state, sum);
+    }
+  }
+}
+
+template <class Tune>
+void PathAggregationOps<Tune>::execute_fused_vertical_stripe(
+    const feature_type *left,
+    const feature_type *right,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    int p2,
+    int n_paths,
+    const uint8_t *prev,
+    uint8_t *cur,
+    int x_begin,
+    int x_end,
+    cost_sum_type *sum,
+    int min_disparity,
+    const ConstCostVolume &stored) {
+
+  constexpr int P = consts::patch_size;
+
+  if (!check_stripe(width, disparity_size, x_begin, x_end) ||
+      (disparity_size > consts::max_disparity_size) || (min_disparity < 0)) {
+    std::cerr << "PathAggregationOps::execute_fused_vertical_stripe: width, "
+      "disparity size and stripe must be multiples of " << P << ", "
+      "disparity size at most " << consts::max_disparity_size <<
+      " (" << width << ", " << disparity_size << ", " << x_begin << ".." <<
+      x_end << ")\n";
+    return;
+  }
+
+  const int clamp = (stored.packing == CostPacking::FOUR_BIT) ?
+    stored.clamp : consts::max_cost;
+
+  switch (n_paths) {
+    case 1:
+      execute_fused_vertical_stripe_<1>(left, right, width, valid_width,
+          disparity_size, p1, p2, prev, cur, x_begin, x_end, sum,
+          min_disparity, clamp);
+      break;
+
+    case 3:
+      execute_fused_vertical_stripe_<3>(left, right, width, valid_width,
+          disparity_size, p1, p2, prev, cur, x_begin, x_end, sum,
+          min_disparity, clamp);
+      break;
+
+    default:
+      std::cerr << "PathAggregationOps::execute_fused_vertical_stripe: "
+        "n_paths must be 1 or 3 (" << n_paths << ")\n";
+  }
+}
+
+template <class Tune>
+template <int n_paths>
+void PathAggregationOps<Tune>::execute_fused_vertical_stripe_(
+    const feature_type *left,
+    const feature_type *right,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    int p2,
+    const uint8_t *prev,
+    uint8_t *cur,
+    int x_begin,
+    int x_end,
+    cost_sum_type *sum,
+    int min_disparity,
+    int clamp) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int P = consts::patch_size;
+
+  x1_t tile[consts::max_disparity_size];
+
+  auto cost_at = [&tile](int d) {
+    return tile[d];
+  };
+
+  for (int x0 = x_begin; x0 < x_end; x0 += P) {
+    cost_tile(left, right, x0, disparity_size, tile, min_disparity, clamp);
+
+    vertical_patch_<n_paths>(cost_at, x0, width, valid_width,
+        disparity_size, p1, p2, prev, cur, sum);
+  }
+}
+
+template <class Tune>
+void PathAggregationOps<Tune>::execute_fused_horizontal_row(
+    const feature_type *left,
+    const feature_type *right,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int p1,
+    int p2,
+    bool reverse,
+    cost_sum_type *sum,
+    int min_disparity,
+    const ConstCostVolume &stored) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int P = consts::patch_size;
+
+  if (((width % P) != 0) || ((disparity_size % P) != 0) ||
+      (disparity_size > consts::max_disparity_size) || (min_disparity < 0)) {
+    std::cerr << "PathAggregationOps::execute_fused_horizontal_row: width "
+      "and disparity size must be multiples of " << P << ", disparity size "
+      "at most " << consts::max_disparity_size <<
+      " (" << width << ", " << disparity_size << ")\n";
+    return;
+  }
+
+  const int clamp = (stored.packing == CostPacking::FOUR_BIT) ?
+    stored.clamp : consts::max_cost;
+
+  x1_t tile[consts::max_disparity_size];
+
+  HorizontalState state;
+  reset_horizontal(state, disparity_size, p2);
+
+  for (int n = 0; n < width; n += P) {
+    const int x0 = reverse ? (width - P - n) : n;
+
+    cost_tile(left, right, x0, disparity_size, tile, min_disparity, clamp);
+
+    horizontal_patch(tile, x0, width, valid_width, disparity_size, p1,
+        reverse, state, sum);
+  }
+}
+
+template <class Tune>
+void PathAggregationOps<Tune>::execute_sum_row(
+    const cost_sum_type *src,
+    int size,
+    cost_sum_type *dst) {
+
+  using simd = typename Tune::simd;
+  using s1_t = typename simd::reg::s1_t;
+
+  constexpr int n = consts::patch_size / 2;
+
+  if ((size % n) != 0) {
+    std::cerr << "PathAggregationOps::execute_sum_row: size must be a "
+      "multiple of " << n << " (" << size << ")\n";
+    return;
+  }
+
+  for (int i = 0; i < size; i += n) {
+    s1_t a;
+    s1_t b;
+    simd::load_s1(a, src + i);
+    simd::load_s1(b, dst + i);
+    simd::store_s1(simd::add_s1(a, b), dst + i);
+  }
+}
+
+// Patches are aligned, so without a disparity offset each is either
+// entirely right of the diagonal x == d, straddles it exactly, or has no
+// right pixels. An offset that is not a multiple of the patch size leaves
+// patches that start part way before the first right pixel. The missing
+// right pixels are zero descriptors.
+template <class Tune>
+void PathAggregationOps<Tune>::load_right_patch(
+    PatchLayout *layout,
+    const feature_type *right,
+    int x0,
+    int d0,
+    int min_disparity) {
+
+  constexpr int P = consts::patch_size;
+
+  auto right_0 = [layout](int p) -> auto & { return layout[p].right[0]; };
+  auto right_1 = [layout](int p) -> auto & { return layout[p].right[1]; };
+
+  // right pixel of register 0, lane 0
+  const int r0 = x0 - d0 - min_disparity - P;
+
+  if (r0 >= 0) {
+    load_features(right + r0, right_0);
+    load_features(right + r0 + P, right_1);
+  } else if (r0 == -P) {
+    clear_features(right_0);
+    load_features(right, right_1);
+  } else if (r0 <= -2*P) {
+    clear_features(right_0);
+    clear_features(right_1);
+  } else {
+    std::array<feature_type, 2*P> padded = {};
+    std::copy(right, right + r0 + 2*P, padded.begin() - r0);
+    load_features(padded.data(), right_0);
+    load_features(padded.data() + P, right_1);
+  }
+}
+
+// The planes of a 32-bit descriptor are the descriptor itself. Narrower
+// descriptors widen to one plane, wider ones split into low bits first.
+template <class Tune>
+template <class Reg>
+void PathAggregationOps<Tune>::load_features(
+    const feature_type *src,
+    Reg &&reg) {
+
+  using simd = typename Tune::simd;
+
+  constexpr int P = consts::patch_size;
+
+  if constexpr (std::is_same<feature_type, uint32_t>::value) {
+    simd::load_w4(reg(0), src);
+  } else {
+    std::array<std::array<uint32_t, P>, consts::n_planes> planes;
+
+    for (int p = 0; p < consts::n_planes; p += 1) {
+      for (int i = 0; i < P; i += 1) {
+        planes[p][i] = static_cast<uint32_t>(
+            static_cast<uint64_t>(src[i]) >> (32*p));
+      }
+
+      simd::load_w4(reg(p), planes[p].data());
+    }
+  }
 }
 
-*/
+template <class Tune>
+template <class Reg>
+void PathAggregationOps<Tune>::clear_features(Reg &&reg) {
+  using simd = typename Tune::simd;
+
+  for (int p = 0; p < consts::n_planes; p += 1) {
+    simd::clear(reg(p));
+  }
+}
+
+template <class Tune>
+void PathAggregationOps<Tune>::cost_tile(
+    const feature_type *left,
+    const feature_type *right,
+    int x0,
+    int disparity_size,
+    typename Tune::simd::reg::x1_t *tile,
+    int min_disparity,
+    int clamp) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int P = consts::patch_size;
+
+  std::array<PatchLayout, consts::n_planes> layout;
+  load_features(left + x0, [&layout](int p) -> auto & {
+    return layout[p].left;
+  });
+
+  for (int d0 = 0; d0 < disparity_size; d0 += P) {
+    load_right_patch(layout.data(), right, x0, d0, min_disparity);
+
+    x1_t *dst = tile + d0;
+    aggregate_patch_<false>(layout.data(), [dst](int d, const x1_t &cost) {
+      dst[d] = cost;
+    });
+  }
+
+  if (clamp < consts::max_cost) {
+    const x1_t clamp_x1 = simd::fill_x1(static_cast<uint8_t>(clamp));
+
+    for (int d = 0; d < disparity_size; d += 1) {
+      tile[d] = simd::min_x1(tile[d], clamp_x1);
+    }
+  }
+}
+
+template <class Tune>
+typename Tune::simd::reg::x1_t PathAggregationOps<Tune>::aggregate_min_cost(
+    const typename Tune::simd::reg::x1_t &cost,
+    const typename Tune::simd::reg::x1_t &prev,
+    const typename Tune::simd::reg::x1_t &prev_lower,
+    const typename Tune::simd::reg::x1_t &prev_upper,
+    const typename Tune::simd::reg::x1_t &min_prev,
+    const typename Tune::simd::reg::x1_t &min_prev_p2,
+    const typename Tune::simd::reg::x1_t &penalty_1) {
+
+  using simd = typename Tune::simd;
+
+  // Every term is at least min_prev, so the subtraction never clamps. With
+  // p2 <= 255 - consts::max_cost the result stays below 256.
+  typename simd::reg::x1_t t;
+
+  t = simd::min_x1(prev_lower, prev_upper);
+  t = simd::adds_x1(t, penalty_1);
+  t = simd::min_x1(t, prev);
+  t = simd::min_x1(t, min_prev_p2);
+  t = simd::subs_x1(t, min_prev);
+
+  return simd::adds_x1(cost, t);
+}
+
+// log2(patch_size) rounds of interleaving the first half of the registers
+// with the second. Each round rotates the bits of (row, column) by one, so
+// after log2(patch_size) rounds they are swapped.
+template <class Tune>
+void PathAggregationOps<Tune>::transpose_patch(
+    typename Tune::simd::reg::x1_t *r) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int P = consts::patch_size;
+
+  for (int round = 1; round < P; round *= 2) {
+    x1_t t[P];
+
+    for (int i = 0; i < P/2; i += 1) {
+      t[2*i + 0] = simd::zip_lo_x1(r[i], r[i + P/2]);
+      t[2*i + 1] = simd::zip_hi_x1(r[i], r[i + P/2]);
+    }
+
+    std::copy(t, t + P, r);
+  }
+}
+
+template <class Tune>
+void PathAggregationOps<Tune>::accumulate_x1(
+    const typename Tune::simd::reg::x1_t &r,
+    cost_sum_type *sum) {
+
+  using simd = typename Tune::simd;
+  using s1_t = typename simd::reg::s1_t;
+
+  constexpr int P = consts::patch_size;
+
+  s1_t lo;
+  s1_t hi;
+  simd::widen_x1(r, lo, hi);
+
+  s1_t sum_lo;
+  s1_t sum_hi;
+  simd::load_s1(sum_lo, sum);
+  simd::load_s1(sum_hi, sum + P/2);
+
+  simd::store_s1(simd::add_s1(sum_lo, lo), sum);
+  simd::store_s1(simd::add_s1(sum_hi, hi), sum + P/2);
+}
+
+// A patch is four w4_t registers wide in both directions, i.e. 16x16 for
+// 128-bit backends, 32x32 for 256-bit and 64x64 for 512-bit ones.
+// Disparity d = n*k + shift comes from popcnt_xor_w4<k> after shift calls
+// to shift_up_w4, where n is the number of descriptors per register.
+template <class Tune>
+template <bool is_edge_block, class Sink>
+void PathAggregationOps<Tune>::aggregate_patch_(
+    PathAggregationOps<Tune>::PatchLayout *input,
+    Sink &&sink) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  constexpr int n = consts::descriptors_per_w1;
+
+  for (int shift = 0; shift < n; shift += 1) {
+    x1_t cost0 = popcnt_xor_planes<0>(input);
+    x1_t cost1 = popcnt_xor_planes<1>(input);
+    x1_t cost2 = popcnt_xor_planes<2>(input);
+    x1_t cost3 = popcnt_xor_planes<3>(input);
+
+    if (is_edge_block) {
+      x1_t mask = simd::fill_x1(0xff);
+      mask = simd::shiftr_x1(mask, shift);
+      cost0 = simd::and_x1(cost0, mask);
+
+      mask = simd::shiftr_x1(mask, n);
+      cost1 = simd::and_x1(cost1, mask);
+
+      mask = simd::shiftr_x1(mask, n);
+      cost2 = simd::and_x1(cost2, mask);
+
+      mask = simd::shiftr_x1(mask, n);
+      cost3 = simd::and_x1(cost3, mask);
+    }
+
+    sink(0*n + shift, cost0);
+    sink(1*n + shift, cost1);
+    sink(2*n + shift, cost2);
+    sink(3*n + shift, cost3);
+
+    for (int p = 0; p < consts::n_planes; p += 1) {
+      simd::shift_up_w4(input[p].right[0], input[p].right[1]);
+    }
+  }
+}
+
+// Each plane's count is at most 32, so the byte sums never saturate
+template <class Tune>
+template <int offset>
+typename Tune::simd::reg::x1_t PathAggregationOps<Tune>::popcnt_xor_planes(
+    const PatchLayout *input) {
+
+  using simd = typename Tune::simd;
+  using x1_t = typename simd::reg::x1_t;
+
+  x1_t cost = simd::template popcnt_xor_w4<offset>(input[0].left,
+      input[0].right[0], input[0].right[1]);
+
+  for (int p = 1; p < consts::n_planes; p += 1) {
+    cost = simd::adds_x1(cost, simd::template popcnt_xor_w4<offset>(
+        input[p].left, input[p].right[0], input[p].right[1]));
+  }
+
+  return cost;
+}
 
 template <class Tune>
 void PathAggregationOps<Tune>::aggregate_patch_16x1(
@@ -1,41 +1,49 @@
+#include <algorithm>
 #include <random>
 #include <iostream>
 
-#include <tune/array128_tune.hpp>
 #include <detail/path_aggregation_ops.hpp>
 
 #include <gtest/gtest.h>
 
+#include "test_tunes.hpp"
 #include "test_util.hpp"
 
 namespace sgm_cpu {
 namespace test {
 
-TEST(PathAggregationOps, AggregatePatch16x16) {
+template <class Tune>
+class PathAggregationOps : public ::testing::Test {};
+
+TYPED_TEST_SUITE(PathAggregationOps, TestTunes);
+
+TYPED_TEST(PathAggregationOps, AggregatePatch) {
   std::minstd_rand0 rng;
 
-  using Ops = detail::PathAggregationOps<tune::Array128>;
+  using Ops = detail::PathAggregationOps<TypeParam>;
 
-  int W = 32;
+  constexpr int P = Ops::consts::patch_size;
+
+  int W = 2*P;
   int H = 1;
   int B = 0;
-  int D = 16;
+  int D = P;
 
   std::vector<uint32_t> left = random_descriptors(W, H, B, rng);
   std::vector<uint32_t> right = random_descriptors(W, H, B, rng);
 
-  std::vector<uint8_t> output(16*16);
+  std::vector<uint8_t> output(P*P);
 
-  Ops::PatchLayout layout;
+  typename Ops::PatchLayout layout;
 
   Ops::tune::simd::load_w4(layout.left, left.data());
   Ops::tune::simd::load_w4(layout.right[0], right.data());
-  Ops::tune::simd::load_w4(layout.right[1], right.data() + 16);
+  Ops::tune::simd::load_w4(layout.right[1], right.data() + P);
 
-  Ops::aggregate_patch_16x16(layout, output.data(), D);
+  Ops::aggregate_patch(&layout, output.data(), D);
 
-  for (int d = 0; d < 16; d += 1) {
-    for (int l = 0; l < 16; l += 1) {
+  for (int d = 0; d < P; d += 1) {
+    for (int l = 0; l < P; l += 1) {
       int i = D*d + l;
       ASSERT_EQ(output[i], __builtin_popcount(left[l] ^ right[l+D-d])) << "i = " << i << "\n";
     }
@@ -43,31 +51,33 @@ TEST(PathAggregationOps, AggregatePatch16x16) {
 }
 
 
-TEST(PathAggregationOps, AggregateEdgePatch16x16) {
+TYPED_TEST(PathAggregationOps, AggregateEdgePatch) {
   std::minstd_rand0 rng;
 
-  using Ops = detail::PathAggregationOps<tune::Array128>;
+  using Ops = detail::PathAggregationOps<TypeParam>;
+
+  constexpr int P = Ops::consts::patch_size;
 
-  int W = 16;
+  int W = P;
   int H = 1;
   int B = 0;
-  int D = 16;
+  int D = P;
 
   std::vector<uint32_t> left = random_descriptors(W, H, B, rng);
   std::vector<uint32_t> right = random_descriptors(W, H, B, rng);
 
-  std::vector<uint8_t> output(16*16);
+  std::vector<uint8_t> output(P*P);
 
-  Ops::PatchLayout layout;
+  typename Ops::PatchLayout layout;
 
   Ops::tune::simd::load_w4(layout.left, left.data());
   Ops::tune::simd::clear(layout.right[0]);
   Ops::tune::simd::load_w4(layout.right[1], right.data());
 
-  Ops::aggregate_edge_patch_16x16(layout, output.data(), D);
+  Ops::aggregate_edge_patch(&layout, output.data(), D);
 
-  for (int d = 0; d < 16; d += 1) {
-    for (int l = 0; l < 16; l += 1) {
+  for (int d = 0; d < P; d += 1) {
+    for (int l = 0; l < P; l += 1) {
       int i = D*d + l;
       int r = l-d;
       if (r >= 0) {
@@ -79,6 +89,624 @@ TEST(PathAggregationOps, AggregateEdgePatch16x16) {
   }
 }
 
+TYPED_TEST(PathAggregationOps, ExecuteCostRow) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::PathAggregationOps<TypeParam>;
+
+  constexpr int P = Ops::consts::patch_size;
+
+  int W = 3*P;
+  int H = 1;
+  int B = 0;
+  int D = 2*P;
+  int pitch = W + 8;
+
+  std::vector<uint32_t> left = random_descriptors(W, H, B, rng);
+  std::vector<uint32_t> right = random_descriptors(W, H, B, rng);
+
+  std::vector<uint8_t> output(D*pitch, 0xff);
+
+  Ops::execute_cost_row(left.data(), right.data(), W, D,
+      detail::CostVolume(output.data(), pitch));
+
+  for (int d = 0; d < D; d += 1) {
+    for (int x = 0; x < pitch; x += 1) {
+      int i = pitch*d + x;
+      if (x >= W) {
+        ASSERT_EQ(output[i], 0xff) << "i = " << i << "\n";
+      } else if (x >= d) {
+        ASSERT_EQ(output[i], __builtin_popcount(left[x] ^ right[x-d])) << "i = " << i << "\n";
+      } else {
+        ASSERT_EQ(output[i], __builtin_popcount(left[x])) << "i = " << i << "\n";
+      }
+    }
+  }
+}
+
+TYPED_TEST(PathAggregationOps, ExecuteCostRowMinDisparity) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::PathAggregationOps<TypeParam>;
+
+  constexpr int P = Ops::consts::patch_size;
+
+  int W = 3*P;
+  int H = 1;
+  int B = 0;
+  int D = 2*P;
+
+  std::vector<uint32_t> left = random_descriptors(W, H, B, rng);
+  std::vector<uint32_t> right = random_descriptors(W, H, B, rng);
+
+  // within a patch, a whole patch, across patches and beyond the row
+  for (int m : { 1, 5, P, P + 3, 2*P + 7, 4*P }) {
+    std::vector<uint8_t> output(D*W, 0xff);
+
+    Ops::execute_cost_row(left.data(), right.data(), W, D,
+        detail::CostVolume(output.data()), m);
+
+    for (int d = 0; d < D; d += 1) {
+      for (int x = 0; x < W; x += 1) {
+        int i = W*d + x;
+        int r = x - m - d;
+        if (r >= 0) {
+          ASSERT_EQ(output[i], __builtin_popcount(left[x] ^ right[r])) <<
+            "i = " << i << ", m = " << m << "\n";
+        } else {
+          ASSERT_EQ(output[i], __builtin_popcount(left[x])) << "i = " << i <<
+            ", m = " << m << "\n";
+        }
+      }
+    }
+  }
+}
+
+// Descriptors of 16 and 64 bits, the latter matched as two 32-bit planes
+template <class Tune>
+static void check_cost_row_window(std::minstd_rand0 &rng) {
+  using Ops = detail::PathAggregationOps<Tune>;
+  using feature_type = typename Ops::feature_type;
+
+  constexpr int P = Ops::consts::patch_size;
+
+  int W = 3*P;
+  int D = 2*P;
+
+  auto random_row = [&rng, W]() {
+    std::vector<feature_type> row(W);
+    for (feature_type &f : row) {
+      f = static_cast<feature_type>(
+          (static_cast<uint64_t>(rng()) << 32) ^ (rng() << 1) ^ rng());
+    }
+    return row;
+  };
+
+  std::vector<feature_type> left = random_row();
+  std::vector<feature_type> right = random_row();
+
+  // all ones against zero at d = 1, the largest cost
+  left[1] = 0;
+  right[0] = ~feature_type(0);
+
+  for (int m : { 0, 3 }) {
+    std::vector<uint8_t> output(D*W, 0xff);
+
+    Ops::execute_cost_row(left.data(), right.data(), W, D,
+        detail::CostVolume(output.data()), m);
+
+    for (int d = 0; d < D; d += 1) {
+      for (int x = 0; x < W; x += 1) {
+        int i = W*d + x;
+        int r = x - m - d;
+        uint64_t diff = (r >= 0) ? left[x] ^ right[r] : left[x];
+        ASSERT_EQ(output[i], __builtin_popcountll(diff)) <<
+          8*sizeof(feature_type) << " bits, i = " << i << ", m = " << m <<
+          "\n";
+      }
+    }
+  }
+}
+
+TYPED_TEST(PathAggregationOps, ExecuteCostRowWindows) {
+  std::minstd_rand0 rng;
+
+  check_cost_row_window<WindowTune<TypeParam, CensusWindow5x5>>(rng);
+  check_cost_row_window<WindowTune<TypeParam, CensusWindow11x9>>(rng);
+
+  // 6 bits do not hold the 0..64 cost of 64-bit descriptors
+  using Ops = detail::PathAggregationOps<
+    WindowTune<TypeParam, CensusWindow11x9>>;
+  ASSERT_TRUE(Ops::check_packing(CostPacking::BYTE));
+  ASSERT_FALSE(Ops::check_packing(CostPacking::SIX_BIT));
+}
+
+// A minimum disparity m is the same as a right image moved m pixels right,
+// zero descriptors coming in from the left edge
+TYPED_TEST(PathAggregationOps, ExecuteFusedMinDisparity) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::PathAggregationOps<TypeParam>;
+
+  constexpr int P = Ops::consts::patch_size;
+
+  int W = 4*P;
+  int H = 3;
+  int B = 0;
+  int D = 2*P;
+  int valid_width = W - 7;
+
+  std::vector<uint32_t> left = random_descriptors(W, H, B, rng);
+  std::vector<uint32_t> right = random_descriptors(W, H, B, rng);
+
+  const detail::PathStateLayout layout(W, D);
+
+  for (int m : { 3, P + 5 }) {
+    std::vector<uint32_t> shifted(W*H, 0);
+    for (int y = 0; y < H; y += 1) {
+      std::copy(right.begin() + y*W, right.begin() + y*W + W - m,
+          shifted.begin() + y*W + m);
+    }
+
+    std::vector<uint8_t> state(4*3*layout.path_size());
+    uint8_t *prev[2];
+    uint8_t *cur[2];
+    for (int k = 0; k < 2; k += 1) {
+      prev[k] = state.data() + 2*k*3*layout.path_size();
+      cur[k] = prev[k] + 3*layout.path_size();
+      layout.reset(prev[k], 3);
+      layout.reset(cur[k], 3);
+    }
+
+    std::vector<uint8_t> cost(D*W);
+    std::vector<uint8_t> expected_cost(D*W);
+
+    for (int y = 0; y < H; y += 1) {
+      std::vector<uint16_t> expected(D*W, 0);
+      std::vector<uint16_t> fused(D*W, 0);
+
+      const uint32_t *l = left.data() + y*W;
+
+      Ops::execute_cost_row(l, shifted.data() + y*W, W, D,
+          detail::CostVolume(expected_cost.data()));
+      Ops::execute_cost_row(l, right.data() + y*W, W, D,
+          detail::CostVolume(cost.data()), m);
+      ASSERT_EQ(cost, expected_cost) << "y = " << y << ", m = " << m << "\n";
+
+      Ops::execute_fused_row(l, shifted.data() + y*W, W, valid_width, D, 10,
+          120, 3, prev[0], cur[0], true, true, expected.data());
+      Ops::execute_fused_row(l, right.data() + y*W, W, valid_width, D, 10,
+          120, 3, prev[1], cur[1], true, true, fused.data(), m);
+
+      for (int k = 0; k < 2; k += 1) {
+        std::swap(prev[k], cur[k]);
+      }
+
+      for (int i = 0; i < D*W; i += 1) {
+        ASSERT_EQ(fused[i], expected[i]) << "i = " << i << ", y = " << y <<
+          ", m = " << m << "\n";
+      }
+    }
+  }
+}
+
+// Packed costs read back as stored, FOUR_BIT saturated at the clamp
+TYPED_TEST(PathAggregationOps, ExecuteCostRowPacked) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::PathAggregationOps<TypeParam>;
+  using x1_t = typename Ops::tune::simd::reg::x1_t;
+
+  constexpr int P = Ops::consts::patch_size;
+
+  int W = 3*P;
+  int H = 1;
+  int B = 0;
+  int D = 2*P;
+  int m = 5;
+  int clamp = 9;
+
+  std::vector<uint32_t> left = random_descriptors(W, H, B, rng);
+  std::vector<uint32_t> right = random_descriptors(W, H, B, rng);
+
+  // one in four pairs equal, for costs of 0
+  for (int x = 0; x < W; x += 4) {
+    right[x] = left[(x + 7) % W];
+  }
+
+  std::vector<uint8_t> expected(D*W);
+  Ops::execute_cost_row(left.data(), right.data(), W, D,
+      detail::CostVolume(expected.data()), m);
+
+  for (CostPacking packing : { CostPacking::SIX_BIT, CostPacking::FOUR_BIT }) {
+    const detail::CostVolumeLayout layout(W, D, packing);
+
+    std::vector<uint8_t> packed(layout.row_size(), 0xff);
+    Ops::execute_cost_row(left.data(), right.data(), W, D,
+        detail::CostVolume(packed.data(), W, packing, clamp), m);
+
+    for (int d = 0; d < D; d += 1) {
+      for (int x0 = 0; x0 < W; x0 += P) {
+        x1_t cost = (packing == CostPacking::SIX_BIT) ?
+          Ops::template load_cost<CostPacking::SIX_BIT>(packed.data() + x0,
+              W, d) :
+          Ops::template load_cost<CostPacking::FOUR_BIT>(packed.data() + x0,
+              W, d);
+
+        uint8_t row[P];
+        Ops::tune::simd::store_x1(cost, row);
+
+        for (int i = 0; i < P; i += 1) {
+          int c = expected[d*W + x0 + i];
+          if (packing == CostPacking::FOUR_BIT) {
+            c = std::min(c, clamp);
+          }
+          ASSERT_EQ(row[i], c) << "d = " << d << ", x = " << (x0 + i) <<
+            ", packing = " << static_cast<int>(packing) << "\n";
+        }
+      }
+    }
+  }
+}
+
+// The path kernels give the same sums from a packed volume as from bytes
+// holding the same costs
+TYPED_TEST(PathAggregationOps, ExecutePacked) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::PathAggregationOps<TypeParam>;
+
+  constexpr int P = Ops::consts::patch_size;
+
+  int W = 4*P;
+  int H = 3;
+  int B = 0;
+  int D = 2*P;
+  int valid_width = W - 7;
+  int clamp = 6;
+
+  std::vector<uint32_t> left = random_descriptors(W, H, B, rng);
+  std::vector<uint32_t> right = random_descriptors(W, H, B, rng);
+
+  const detail::PathStateLayout layout(W, D);
+
+  for (CostPacking packing : { CostPacking::SIX_BIT, CostPacking::FOUR_BIT }) {
+    std::vector<uint8_t> state(4*3*layout.path_size());
+    uint8_t *prev[2];
+    uint8_t *cur[2];
+    for (int k = 0; k < 2; k += 1) {
+      prev[k] = state.data() + 2*k*3*layout.path_size();
+      cur[k] = prev[k] + 3*layout.path_size();
+      layout.reset(prev[k], 3);
+      layout.reset(cur[k], 3);
+    }
+
+    std::vector<uint8_t> cost(D*W);
+    std::vector<uint8_t> packed(
+        detail::CostVolumeLayout(W, D, packing).row_size());
+
+    for (int y = 0; y < H; y += 1) {
+      const uint32_t *l = left.data() + y*W;
+      const uint32_t *r = right.data() + y*W;
+
+      const detail::CostVolume bytes(cost.data());
+      const detail::CostVolume volume(packed.data(), W, packing, clamp);
+
+      Ops::execute_cost_row(l, r, W, D, bytes);
+      if (packing == CostPacking::FOUR_BIT) {
+        for (uint8_t &c : cost) {
+          c = std::min<uint8_t>(c, clamp);
+        }
+      }
+      Ops::execute_cost_row(l, r, W, D, volume);
+
+      std::vector<uint16_t> expected(D*W, 0);
+      std::vector<uint16_t> sum(D*W, 0);
+
+      Ops::execute_vertical_row(bytes, W, valid_width, D, 10, 120, 3,
+          prev[0], cur[0], expected.data());
+      Ops::execute_horizontal_row(bytes, W, valid_width, D, 10, 120,
+          false, expected.data());
+      Ops::execute_horizontal_row(bytes, W, valid_width, D, 10, 120,
+          true, expected.data());
+
+      Ops::execute_vertical_row(volume, W, valid_width, D, 10, 120, 3,
+          prev[1], cur[1], sum.data());
+      Ops::execute_horizontal_row(volume, W, valid_width, D, 10, 120,
+          false, sum.data());
+      Ops::execute_horizontal_row(volume, W, valid_width, D, 10, 120,
+          true, sum.data());
+
+      for (int k = 0; k < 2; k += 1) {
+        std::swap(prev[k], cur[k]);
+      }
+
+      for (int i = 0; i < D*W; i += 1) {
+        ASSERT_EQ(sum[i], expected[i]) << "i = " << i << ", y = " << y <<
+          ", packing = " << static_cast<int>(packing) << "\n";
+      }
+    }
+  }
+}
+
+// Costs land where the layout says, and the path kernels read them back to
+// the same sums as with planes
+template <class Base, class Layout>
+static void check_cost_layout(CostPacking packing, std::minstd_rand0 &rng) {
+  using Planes = detail::PathAggregationOps<Base>;
+  using Ops = detail::PathAggregationOps<LayoutTune<Base, Layout>>;
+
+  constexpr int P = Ops::consts::patch_size;
+
+  int W = 4*P;
+  int H = 3;
+  int B = 0;
+  int D = 2*P;
+  int valid_width = W - 7;
+
+  std::vector<uint32_t> left = random_descriptors(W, H, B, rng);
+  std::vector<uint32_t> right = random_descriptors(W, H, B, rng);
+
+  const detail::PathStateLayout layout(W, D);
+
+  std::vector<uint8_t> state(4*3*layout.path_size());
+  uint8_t *prev[2];
+  uint8_t *cur[2];
+  for (int k = 0; k < 2; k += 1) {
+    prev[k] = state.data() + 2*k*3*layout.path_size();
+    cur[k] = prev[k] + 3*layout.path_size();
+    layout.reset(prev[k], 3);
+    layout.reset(cur[k], 3);
+  }
+
+  const size_t row_size = detail::CostVolumeLayout(W, D, packing).row_size();
+  const int rows = detail::CostVolumeLayout::rows(D, packing);
+
+  std::vector<uint8_t> expected_cost(row_size);
+  std::vector<uint8_t> cost(row_size);
+
+  for (int y = 0; y < H; y += 1) {
+    const uint32_t *l = left.data() + y*W;
+    const uint32_t *r = right.data() + y*W;
+
+    const detail::CostVolume expected_volume(expected_cost.data(), W,
+        packing);
+    const detail::CostVolume volume(cost.data(), W, packing);
+
+    Planes::execute_cost_row(l, r, W, D, expected_volume);
+    Ops::execute_cost_row(l, r, W, D, volume);
+
+    for (int x = 0; x < W; x += 1) {
+      const int x0 = x / P * P;
+      for (int k = 0; k < rows; k += 1) {
+        size_t i = Layout::patch(x0, rows, W) +
+          k*Layout::row_pitch(rows, W, P) + (x - x0)*Layout::pixel_pitch(rows);
+        ASSERT_EQ(cost[i], expected_cost[k*W + x]) << "x = " << x <<
+          ", row = " << k << ", y = " << y << "\n";
+      }
+    }
+
+    std::vector<uint16_t> expected(D*W, 0);
+    std::vector<uint16_t> sum(D*W, 0);
+
+    Planes::execute_vertical_row(expected_volume, W, valid_width, D, 10,
+        120, 3, prev[0], cur[0], expected.data());
+    Planes::execute_horizontal_row(expected_volume, W, valid_width, D,
+        10, 120, false, expected.data());
+    Planes::execute_horizontal_row(expected_volume, W, valid_width, D,
+        10, 120, true, expected.data());
+
+    Ops::execute_vertical_row(volume, W, valid_width, D, 10, 120, 3,
+        prev[1], cur[1], sum.data());
+    Ops::execute_horizontal_row(volume, W, valid_width, D, 10, 120,
+        false, sum.data());
+    Ops::execute_horizontal_row(volume, W, valid_width, D, 10, 120,
+        true, sum.data());
+
+    for (int k = 0; k < 2; k += 1) {
+      std::swap(prev[k], cur[k]);
+    }
+
+    for (int i = 0; i < D*W; i += 1) {
+      ASSERT_EQ(sum[i], expected[i]) << "i = " << i << ", y = " << y << "\n";
+    }
+  }
+}
+
+TYPED_TEST(PathAggregationOps, CostLayouts) {
+  std::minstd_rand0 rng;
+
+  check_cost_layout<TypeParam, CostLayoutTiled>(CostPacking::BYTE, rng);
+  check_cost_layout<TypeParam, CostLayoutTiled>(CostPacking::SIX_BIT, rng);
+  check_cost_layout<TypeParam, CostLayoutInterleaved>(CostPacking::BYTE,
+      rng);
+}
+
+TYPED_TEST(PathAggregationOps, TransposePatch) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::PathAggregationOps<TypeParam>;
+  using simd = typename Ops::tune::simd;
+
+  constexpr int P = Ops::consts::patch_size;
+
+  std::vector<uint8_t> input = random_patch(P, P, rng);
+  std::vector<uint8_t> output(P*P);
+
+  typename simd::reg::x1_t r[P];
+  for (int i = 0; i < P; i += 1) {
+    simd::load_x1(r[i], input.data() + i*P);
+  }
+
+  Ops::transpose_patch(r);
+
+  for (int i = 0; i < P; i += 1) {
+    simd::store_x1(r[i], output.data() + i*P);
+  }
+
+  for (int y = 0; y < P; y += 1) {
+    for (int x = 0; x < P; x += 1) {
+      ASSERT_EQ(output[y*P + x], input[x*P + y]) << "x = " << x << ", y = " << y;
+    }
+  }
+}
+
+// The fused kernel against the cost, vertical and horizontal row kernels,
+// over a few rows so that the path state is carried along.
+TYPED_TEST(PathAggregationOps, ExecuteFusedRow) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::PathAggregationOps<TypeParam>;
+
+  constexpr int P = Ops::consts::patch_size;
+
+  int W = 3*P;
+  int H = 4;
+  int B = 0;
+  int D = 2*P;
+  int valid_width = W - 5;
+
+  std::vector<uint32_t> left = random_descriptors(W, H, B, rng);
+  std::vector<uint32_t> right = random_descriptors(W, H, B, rng);
+
+  const detail::PathStateLayout layout(W, D);
+
+  for (int n_paths : { 1, 3 }) {
+    for (int sides : { 0, 1, 2, 3 }) {
+      const bool from_left = (sides & 1) != 0;
+      const bool from_right = (sides & 2) != 0;
+
+      std::vector<uint8_t> state(4*3*layout.path_size());
+      uint8_t *prev = state.data();
+      uint8_t *cur = prev + 3*layout.path_size();
+      uint8_t *fused_prev = cur + 3*layout.path_size();
+      uint8_t *fused_cur = fused_prev + 3*layout.path_size();
+
+      for (uint8_t *s : { prev, cur, fused_prev, fused_cur }) {
+        layout.reset(s, n_paths);
+      }
+
+      std::vector<uint8_t> cost(D*W);
+
+      for (int y = 0; y < H; y += 1) {
+        std::vector<uint16_t> expected(D*W, 0);
+        std::vector<uint16_t> output(D*W, 0);
+
+        const detail::CostVolume volume(cost.data());
+
+        Ops::execute_cost_row(left.data() + y*W, right.data() + y*W, W, D,
+            volume);
+        Ops::execute_vertical_row(volume, W, valid_width, D, 10, 120,
+            n_paths, prev, cur, expected.data());
+        if (from_left) {
+          Ops::execute_horizontal_row(volume, W, valid_width, D, 10, 120,
+              false, expected.data());
+        }
+        if (from_right) {
+          Ops::execute_horizontal_row(volume, W, valid_width, D, 10, 120,
+              true, expected.data());
+        }
+
+        Ops::execute_fused_row(left.data() + y*W, right.data() + y*W, W,
+            valid_width, D, 10, 120, n_paths, fused_prev, fused_cur,
+            from_left, from_right, output.data());
+
+        std::swap(prev, cur);
+        std::swap(fused_prev, fused_cur);
+
+        for (int i = 0; i < D*W; i += 1) {
+          ASSERT_EQ(output[i], expected[i]) << "i = " << i << ", y = " << y <<
+            ", n_paths = " << n_paths << ", sides = " << sides << "\n";
+        }
+      }
+    }
+  }
+}
+
+// Stripes in any order, and the two halves of the fused kernel, against the
+// whole-row kernels
+TYPED_TEST(PathAggregationOps, ExecuteStripes) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::PathAggregationOps<TypeParam>;
+
+  constexpr int P = Ops::consts::patch_size;
+
+  int W = 4*P;
+  int H = 3;
+  int B = 0;
+  int D = 2*P;
+  int valid_width = W - 7;
+
+  // patches [0, 1), [1, 3) and [3, 4), last first
+  const int x_begin[] = { 3*P, P, 0 };
+  const int x_end[] = { 4*P, 3*P, P };
+
+  std::vector<uint32_t> left = random_descriptors(W, H, B, rng);
+  std::vector<uint32_t> right = random_descriptors(W, H, B, rng);
+
+  const detail::PathStateLayout layout(W, D);
+
+  for (int n_paths : { 1, 3 }) {
+    std::vector<uint8_t> state(6*3*layout.path_size());
+    uint8_t *prev[3];
+    uint8_t *cur[3];
+    for (int k = 0; k < 3; k += 1) {
+      prev[k] = state.data() + 2*k*3*layout.path_size();
+      cur[k] = prev[k] + 3*layout.path_size();
+      layout.reset(prev[k], n_paths);
+      layout.reset(cur[k], n_paths);
+    }
+
+    std::vector<uint8_t> cost(D*W);
+
+    for (int y = 0; y < H; y += 1) {
+      std::vector<uint16_t> expected(D*W, 0);
+      std::vector<uint16_t> stripes(D*W, 0);
+      std::vector<uint16_t> fused(D*W, 0);
+
+      const uint32_t *l = left.data() + y*W;
+      const uint32_t *r = right.data() + y*W;
+
+      const detail::CostVolume volume(cost.data());
+
+      Ops::execute_cost_row(l, r, W, D, volume);
+      Ops::execute_fused_row(l, r, W, valid_width, D, 10, 120, n_paths,
+          prev[0], cur[0], true, true, expected.data());
+
+      for (int i = 0; i < 3; i += 1) {
+        Ops::execute_vertical_stripe(volume, W, valid_width, D, 10, 120,
+            n_paths, prev[1], cur[1], x_begin[i], x_end[i], stripes.data());
+        Ops::execute_fused_vertical_stripe(l, r, W, valid_width, D, 10, 120,
+            n_paths, prev[2], cur[2], x_begin[i], x_end[i], fused.data());
+      }
+      Ops::execute_horizontal_row(volume, W, valid_width, D, 10, 120,
+          false, stripes.data());
+      Ops::execute_horizontal_row(volume, W, valid_width, D, 10, 120,
+          true, stripes.data());
+
+      // the paths along the row in a sum of their own
+      std::vector<uint16_t> horizontal(D*W, 0);
+      Ops::execute_fused_horizontal_row(l, r, W, valid_width, D, 10, 120,
+          false, horizontal.data());
+      Ops::execute_fused_horizontal_row(l, r, W, valid_width, D, 10, 120,
+          true, horizontal.data());
+      Ops::execute_sum_row(horizontal.data(), D*W, fused.data());
+
+      for (int k = 0; k < 3; k += 1) {
+        std::swap(prev[k], cur[k]);
+      }
+
+      for (int i = 0; i < D*W; i += 1) {
+        ASSERT_EQ(stripes[i], expected[i]) << "i = " << i << ", y = " << y <<
+          ", n_paths = " << n_paths << "\n";
+        ASSERT_EQ(fused[i], expected[i]) << "i = " << i << ", y = " << y <<
+          ", n_paths = " << n_paths << "\n";
+      }
+    }
+  }
+}
+
 } // namespace test
 } // namespace sgm_cpu
 
@@ -35,6 +35,7 @@ struct array128_impl {
     };
 
     static constexpr int census_rows_per_x2 = 2;
+    static constexpr int descriptors_per_w1 = 4;
   };
 
   inline static
@@ -66,6 +67,76 @@ struct array128_impl {
     std::copy(src1 + 8, src1 + 16, r.reg1.begin() + 8);
   }
 
+  // load_row2 of the luma of YUYV rows, see load_x1_even
+  inline static
+  void load_row2_even(reg::x2_t &r, const uint8_t *src, ptrdiff_t pitch) {
+    const uint8_t *src0 = src + 0*pitch;
+    const uint8_t *src1 = src + 1*pitch;
+
+    for (size_t i = 0; i < 8; i += 1) {
+      r.reg0[i] = src0[2*i];
+      r.reg0[8 + i] = src1[2*i];
+
+      r.reg1[i] = src0[2*(8 + i)];
+      r.reg1[8 + i] = src1[2*(8 + i)];
+    }
+  }
+
+  // load_row2 of the census_rows_per_x2 rows at rows[k], which need not be
+  // pitch apart: the edges of the census read rows beyond the image as
+  // other rows of it
+  inline static
+  void load_row2(reg::x2_t &r, const uint8_t *const *rows) {
+    const uint8_t *src0 = rows[0];
+    const uint8_t *src1 = rows[1];
+
+    std::copy(src0, src0 + 8, r.reg0.begin());
+    std::copy(src1, src1 + 8, r.reg0.begin() + 8);
+
+    std::copy(src0 + 8, src0 + 16, r.reg1.begin());
+    std::copy(src1 + 8, src1 + 16, r.reg1.begin() + 8);
+  }
+
+  inline static
+  void load_row2_even(reg::x2_t &r, const uint8_t *const *rows) {
+    const uint8_t *src0 = rows[0];
+    const uint8_t *src1 = rows[1];
+
+    for (size_t i = 0; i < 8; i += 1) {
+      r.reg0[i] = src0[2*i];
+      r.reg0[8 + i] = src1[2*i];
+
+      r.reg1[i] = src0[2*(8 + i)];
+      r.reg1[8 + i] = src1[2*(8 + i)];
+    }
+  }
+
+  // Byte i of each row of r becomes its byte index[i], or 0 where index[i]
+  // has the high bit set, as pshufb. The census edges pad columns beyond
+  // the image with it.
+  inline static
+  void permute_row2(reg::x2_t &r, const uint8_t *index) {
+    std::array<std::array<uint8_t, 16>, 2> rows;
+
+    for (int i = 0; i < 8; i += 1) {
+      rows[0][i] = r.reg0[i];
+      rows[0][8 + i] = r.reg1[i];
+      rows[1][i] = r.reg0[8 + i];
+      rows[1][8 + i] = r.reg1[8 + i];
+    }
+
+    auto at = [&](int row, int i) -> uint8_t {
+      return (index[i] & 0x80) ? 0 : rows[row][index[i] & 0x0f];
+    };
+
+    for (int i = 0; i < 8; i += 1) {
+      r.reg0[i] = at(0, i);
+      r.reg1[i] = at(0, 8 + i);
+      r.reg0[8 + i] = at(1, i);
+      r.reg1[8 + i] = at(1, 8 + i);
+    }
+  }
+
   inline static
   void store_feature(reg::x1_t r, uint32_t *dst, ptrdiff_t pitch) {
     uint8_t *dst0 = reinterpret_cast<uint8_t *>(dst);
@@ -184,6 +255,35 @@ struct array128_impl {
     return result;
   }
 
+  inline static
+  reg::x1_t or_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result = a;
+    for (size_t i = 0; i < a.reg0.size(); i += 1) {
+      result.reg0[i] = a.reg0[i] | b.reg0[i];
+    }
+    return result;
+  }
+
+  // Each byte shifted by n bits, zeros shifted in. Used to pack costs into
+  // fewer than 8 bits.
+  template <int n> static
+  reg::x1_t shl_bits_x1(const reg::x1_t &r) {
+    reg::x1_t result;
+    for (size_t i = 0; i < r.reg0.size(); i += 1) {
+      result.reg0[i] = static_cast<uint8_t>(r.reg0[i] << n);
+    }
+    return result;
+  }
+
+  template <int n> static
+  reg::x1_t shr_bits_x1(const reg::x1_t &r) {
+    reg::x1_t result;
+    for (size_t i = 0; i < r.reg0.size(); i += 1) {
+      result.reg0[i] = static_cast<uint8_t>(r.reg0[i] >> n);
+    }
+    return result;
+  }
+
   inline static
   reg::x1_t shiftr_x1(const reg::x1_t &r, int n) {
     reg::x1_t result;
@@ -233,6 +333,171 @@ struct array128_impl {
     std::for_each(right1.reg.begin(), right1.reg.end(), shift_up);
   }
 
+  inline static
+  void load_x1(reg::x1_t &r, const uint8_t *src) {
+    std::copy(src, src + r.reg0.size(), r.reg0.begin());
+  }
+
+  // Every second byte of twice a register's width at src, the luma of YUYV
+  inline static
+  void load_x1_even(reg::x1_t &r, const uint8_t *src) {
+    for (size_t i = 0; i < r.reg0.size(); i += 1) {
+      r.reg0[i] = src[2*i];
+    }
+  }
+
+  inline static
+  void store_s1(const reg::s1_t &r, uint16_t *dst) {
+    std::copy(r.reg0.begin(), r.reg0.end(), dst);
+  }
+
+  inline static
+  reg::s1_t fill_s1(uint16_t x) {
+    reg::s1_t result;
+    std::fill(result.reg0.begin(), result.reg0.end(), x);
+    return result;
+  }
+
+  inline static
+  reg::x1_t min_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    for (size_t i = 0; i < a.reg0.size(); i += 1) {
+      result.reg0[i] = std::min(a.reg0[i], b.reg0[i]);
+    }
+    return result;
+  }
+
+  // saturating
+  inline static
+  reg::x1_t adds_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    for (size_t i = 0; i < a.reg0.size(); i += 1) {
+      result.reg0[i] = std::min(a.reg0[i] + b.reg0[i], 0xff);
+    }
+    return result;
+  }
+
+  // saturating
+  inline static
+  reg::x1_t subs_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    for (size_t i = 0; i < a.reg0.size(); i += 1) {
+      result.reg0[i] = std::max(a.reg0[i] - b.reg0[i], 0);
+    }
+    return result;
+  }
+
+  // Byte interleave of the low (high) halves of a and b across the whole
+  // register: <a0, b0, a1, b1, ...>
+  inline static
+  reg::x1_t zip_lo_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    for (size_t i = 0; i < a.reg0.size() / 2; i += 1) {
+      result.reg0[2*i + 0] = a.reg0[i];
+      result.reg0[2*i + 1] = b.reg0[i];
+    }
+    return result;
+  }
+
+  inline static
+  reg::x1_t zip_hi_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    const size_t half = a.reg0.size() / 2;
+
+    reg::x1_t result;
+    for (size_t i = 0; i < half; i += 1) {
+      result.reg0[2*i + 0] = a.reg0[half + i];
+      result.reg0[2*i + 1] = b.reg0[half + i];
+    }
+    return result;
+  }
+
+  // Shift by one byte towards the end of the register, the first byte comes
+  // from the end of prev.
+  inline static
+  reg::x1_t shift_up_x1(const reg::x1_t &r, const reg::x1_t &prev) {
+    reg::x1_t result;
+    result.reg0.front() = prev.reg0.back();
+    std::copy(r.reg0.begin(), r.reg0.end() - 1, result.reg0.begin() + 1);
+    return result;
+  }
+
+  // Shift by one byte towards the start of the register, the last byte comes
+  // from the start of next.
+  inline static
+  reg::x1_t shift_down_x1(const reg::x1_t &r, const reg::x1_t &next) {
+    reg::x1_t result;
+    std::copy(r.reg0.begin() + 1, r.reg0.end(), result.reg0.begin());
+    result.reg0.back() = next.reg0.front();
+    return result;
+  }
+
+  // Bytes n to n + register width of the concatenation lo:hi, for 0 <= n <
+  // register width: palignr across the whole register. The census walks
+  // the columns of a window with it.
+  template <int n> static
+  reg::x1_t align_x1(const reg::x1_t &lo, const reg::x1_t &hi) {
+    reg::x1_t result;
+    std::copy(lo.reg0.begin() + n, lo.reg0.end(), result.reg0.begin());
+    std::copy(hi.reg0.begin(), hi.reg0.begin() + n, result.reg0.end() - n);
+    return result;
+  }
+
+  // minimum of all bytes, in every byte
+  inline static
+  reg::x1_t hmin_x1(const reg::x1_t &r) {
+    return fill_x1(*std::min_element(r.reg0.begin(), r.reg0.end()));
+  }
+
+  // Zero extend, lo gets the first half of the bytes
+  inline static
+  void widen_x1(const reg::x1_t &r, reg::s1_t &lo, reg::s1_t &hi) {
+    std::copy(r.reg0.begin(), r.reg0.begin() + 8, lo.reg0.begin());
+    std::copy(r.reg0.begin() + 8, r.reg0.end(), hi.reg0.begin());
+  }
+
+  // One byte per pixel of a (a0, then a1): 1 where it is less than the
+  // pixel of b, else 0. The 16-bit census compares with this.
+  inline static
+  reg::x1_t lt_s1x2(
+      const reg::s1_t &a0,
+      const reg::s1_t &a1,
+      const reg::s1_t &b0,
+      const reg::s1_t &b1) {
+
+    reg::x1_t result;
+    for (size_t i = 0; i < a0.reg0.size(); i += 1) {
+      result.reg0[i] = (a0.reg0[i] < b0.reg0[i]) ? 1 : 0;
+      result.reg0[a0.reg0.size() + i] = (a1.reg0[i] < b1.reg0[i]) ? 1 : 0;
+    }
+    return result;
+  }
+
+  inline static
+  reg::s1_t add_s1(const reg::s1_t &a, const reg::s1_t &b) {
+    reg::s1_t result;
+    for (size_t i = 0; i < a.reg0.size(); i += 1) {
+      result.reg0[i] = a.reg0[i] + b.reg0[i];
+    }
+    return result;
+  }
+
+  // Where value < best, replace best with value and best_index with index.
+  // Ties keep the earlier index.
+  inline static
+  void select_min_s1(
+      reg::s1_t &best,
+      reg::s1_t &best_index,
+      const reg::s1_t &value,
+      const reg::s1_t &index) {
+
+    for (size_t i = 0; i < best.reg0.size(); i += 1) {
+      if (value.reg0[i] < best.reg0[i]) {
+        best.reg0[i] = value.reg0[i];
+        best_index.reg0[i] = index.reg0[i];
+      }
+    }
+  }
+
 };
 
 } // namespace simd
@@ -0,0 +1,554 @@
+#pragma once
+
+#if !defined(__AVX2__) && !defined(SGM_CPU_TARGET_PRAGMA)
+#error "avx2_impl.hpp requires AVX2 (compile with -mavx2 or better)"
+#endif
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+#include <detail/simd/x86_intrinsics.hpp>
+
+namespace sgm_cpu {
+namespace detail {
+namespace simd {
+
+// AVX2 implementation. Each 128-bit lane uses the sse_impl layout, so the
+// in-lane shuffles and unpacks of AVX2 do the same work as their SSE
+// counterparts on twice the data:
+//
+//  - census registers hold four rows, lane 0 = <row0 | row1> and
+//    lane 1 = <row2 | row3>. Registers still start every second row, so
+//    neighbouring registers overlap and one execute_patch_x2 iteration
+//    produces four output rows.
+//  - aggregation registers hold 8 descriptors, so a patch covers 32 left
+//    pixels and 32 disparities.
+struct avx2_impl {
+  struct reg {
+    struct x1_t {
+      __m256i reg0;
+    };
+
+    struct s1_t {
+      __m256i reg0;
+    };
+
+    struct w4_t {
+      __m256i reg[4];
+    };
+
+    struct p1_t {
+      // 0xff where the comparison is false, i.e. (a >= b)
+      __m256i reg0;
+    };
+
+    struct x2_t {
+      // reg0 = <row0.left, row1.left | row2.left, row3.left>
+      // reg1 = <row0.right, row1.right | row2.right, row3.right>
+      __m256i reg0;
+      __m256i reg1;
+    };
+
+    static constexpr int census_rows_per_x2 = 4;
+    static constexpr int descriptors_per_w1 = 8;
+  };
+
+  inline static
+  void clear(reg::x1_t &r) {
+    r.reg0 = _mm256_setzero_si256();
+  }
+
+  inline static
+  void clear(reg::s1_t &r) {
+    r.reg0 = _mm256_setzero_si256();
+  }
+
+  inline static
+  void clear(reg::w4_t &r) {
+    for (int i = 0; i < 4; i += 1) {
+      r.reg[i] = _mm256_setzero_si256();
+    }
+  }
+
+  inline static
+  void load_row2(reg::x2_t &r, const uint8_t *src, ptrdiff_t pitch) {
+    __m256i row02 = load_lanes(src + 0*pitch, src + 2*pitch);
+    __m256i row13 = load_lanes(src + 1*pitch, src + 3*pitch);
+
+    r.reg0 = _mm256_unpacklo_epi64(row02, row13);
+    r.reg1 = _mm256_unpackhi_epi64(row02, row13);
+  }
+
+  // see array128_impl::load_row2_even
+  inline static
+  void load_row2_even(reg::x2_t &r, const uint8_t *src, ptrdiff_t pitch) {
+    __m256i row02 = load_even(src + 0*pitch, src + 2*pitch);
+    __m256i row13 = load_even(src + 1*pitch, src + 3*pitch);
+
+    r.reg0 = _mm256_unpacklo_epi64(row02, row13);
+    r.reg1 = _mm256_unpackhi_epi64(row02, row13);
+  }
+
+  // see array128_impl::load_row2
+  inline static
+  void load_row2(reg::x2_t &r, const uint8_t *const *rows) {
+    __m256i row02 = load_lanes(rows[0], rows[2]);
+    __m256i row13 = load_lanes(rows[1], rows[3]);
+
+    r.reg0 = _mm256_unpacklo_epi64(row02, row13);
+    r.reg1 = _mm256_unpackhi_epi64(row02, row13);
+  }
+
+  inline static
+  void load_row2_even(reg::x2_t &r, const uint8_t *const *rows) {
+    __m256i row02 = load_even(rows[0], rows[2]);
+    __m256i row13 = load_even(rows[1], rows[3]);
+
+    r.reg0 = _mm256_unpacklo_epi64(row02, row13);
+    r.reg1 = _mm256_unpackhi_epi64(row02, row13);
+  }
+
+  // see array128_impl::permute_row2. A row is a 128-bit lane of the
+  // unpacked registers, which the in-lane shuffle suits.
+  inline static
+  void permute_row2(reg::x2_t &r, const uint8_t *index) {
+    const __m256i idx = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(index)));
+
+    __m256i row02 = _mm256_shuffle_epi8(
+        _mm256_unpacklo_epi64(r.reg0, r.reg1), idx);
+    __m256i row13 = _mm256_shuffle_epi8(
+        _mm256_unpackhi_epi64(r.reg0, r.reg1), idx);
+
+    r.reg0 = _mm256_unpacklo_epi64(row02, row13);
+    r.reg1 = _mm256_unpackhi_epi64(row02, row13);
+  }
+
+  inline static
+  void store_feature(reg::x1_t r, uint32_t *dst, ptrdiff_t pitch) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst),
+        _mm256_castsi256_si128(r.reg0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2*pitch),
+        _mm256_extracti128_si256(r.reg0, 1));
+  }
+
+  inline static
+  void store_x1(const reg::x1_t &r, uint8_t *dst) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), r.reg0);
+  }
+
+  inline static
+  void store_w4(const reg::w4_t &r, uint32_t *dst) {
+    for (int i = 0; i < 4; i += 1) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 8*i), r.reg[i]);
+    }
+  }
+
+  inline static
+  void load_s1(reg::s1_t &r, const uint16_t *src) {
+    r.reg0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+  }
+
+  inline static
+  void load_w4(reg::w4_t &r, const uint32_t *src) {
+    for (int i = 0; i < 4; i += 1) {
+      r.reg[i] = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(src + 8*i));
+    }
+  }
+
+  // see sse_impl::cmp_row2
+  inline static
+  reg::p1_t cmp_row2(reg::x2_t a, reg::x2_t b) {
+    reg::p1_t result;
+    result.reg0 = _mm256_cmpeq_epi8(_mm256_min_epu8(a.reg0, b.reg1), b.reg1);
+    return result;
+  }
+
+  template <int b> static
+  reg::x1_t bsel2(reg::x1_t acc, reg::p1_t pred) {
+    const __m256i bit = _mm256_set1_epi8(static_cast<char>(1 << b));
+
+    reg::x1_t result;
+    result.reg0 = _mm256_or_si256(
+        _mm256_andnot_si256(bit, acc.reg0),
+        _mm256_andnot_si256(pred.reg0, bit));
+
+    return result;
+  }
+
+  inline static
+  void transpose_row2(reg::x2_t &r0, reg::x2_t &r1) {
+    __m256i t0 = _mm256_unpacklo_epi64(r0.reg0, r1.reg0);
+    __m256i t1 = _mm256_unpacklo_epi64(r0.reg1, r1.reg1);
+
+    r1.reg0 = _mm256_unpackhi_epi64(r0.reg0, r1.reg0);
+    r1.reg1 = _mm256_unpackhi_epi64(r0.reg1, r1.reg1);
+
+    r0.reg0 = t0;
+    r0.reg1 = t1;
+  }
+
+  inline static
+  void zip4b2(reg::x1_t &r0, reg::x1_t &r1, reg::x1_t &r2, reg::x1_t &r3) {
+    __m256i lo01 = _mm256_unpacklo_epi8(r0.reg0, r1.reg0);
+    __m256i lo23 = _mm256_unpacklo_epi8(r2.reg0, r3.reg0);
+    __m256i hi01 = _mm256_unpackhi_epi8(r0.reg0, r1.reg0);
+    __m256i hi23 = _mm256_unpackhi_epi8(r2.reg0, r3.reg0);
+
+    r0.reg0 = _mm256_unpacklo_epi16(lo01, lo23);
+    r1.reg0 = _mm256_unpackhi_epi16(lo01, lo23);
+    r2.reg0 = _mm256_unpacklo_epi16(hi01, hi23);
+    r3.reg0 = _mm256_unpackhi_epi16(hi01, hi23);
+  }
+
+  // see sse_impl::roll_outward2, shuffle masks repeat in both lanes
+  inline static
+  reg::x2_t roll_outward2(reg::x2_t r, int x) {
+    const __m256i offset = _mm256_set1_epi8(static_cast<char>(2*x));
+
+    const __m256i down0 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        1, 2, 3, 4, 5, 6, 7, -128, 9, 10, 11, 12, 13, 14, 15, -128));
+    const __m256i down1 = _mm256_add_epi8(offset,
+        _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        -128, -128, -128, -128, -128, -128, -128, 0,
+        -128, -128, -128, -128, -128, -128, -128, 8)));
+
+    const __m256i up0 = _mm256_sub_epi8(
+        _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        7, -113, -113, -113, -113, -113, -113, -113,
+        15, -113, -113, -113, -113, -113, -113, -113)), offset);
+    const __m256i up1 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        -128, 0, 1, 2, 3, 4, 5, 6, -128, 8, 9, 10, 11, 12, 13, 14));
+
+    reg::x2_t result;
+    result.reg0 = _mm256_or_si256(
+        _mm256_shuffle_epi8(r.reg0, down0),
+        _mm256_shuffle_epi8(r.reg1, down1));
+    result.reg1 = _mm256_or_si256(
+        _mm256_shuffle_epi8(r.reg0, up0),
+        _mm256_shuffle_epi8(r.reg1, up1));
+
+    return result;
+  }
+
+  inline static
+  reg::x1_t fill_x1(uint8_t x) {
+    reg::x1_t result;
+    result.reg0 = _mm256_set1_epi8(static_cast<char>(x));
+    return result;
+  }
+
+  inline static
+  reg::x1_t and_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm256_and_si256(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t or_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm256_or_si256(a.reg0, b.reg0);
+    return result;
+  }
+
+  // see array128_impl::shl_bits_x1. There are no byte shifts, so shift
+  // words and mask off the bits that crossed between bytes.
+  template <int n> static
+  reg::x1_t shl_bits_x1(const reg::x1_t &r) {
+    reg::x1_t result;
+    result.reg0 = _mm256_and_si256(_mm256_slli_epi16(r.reg0, n),
+        _mm256_set1_epi8(static_cast<char>((0xff << n) & 0xff)));
+    return result;
+  }
+
+  template <int n> static
+  reg::x1_t shr_bits_x1(const reg::x1_t &r) {
+    reg::x1_t result;
+    result.reg0 = _mm256_and_si256(_mm256_srli_epi16(r.reg0, n),
+        _mm256_set1_epi8(static_cast<char>(0xff >> n)));
+    return result;
+  }
+
+  // Byte shifts don't cross lanes on AVX2. This is only used to build edge
+  // masks, so go through memory instead.
+  inline static
+  reg::x1_t shiftr_x1(const reg::x1_t &r, int n) {
+    alignas(32) uint8_t buffer[64] = {};
+    _mm256_store_si256(reinterpret_cast<__m256i *>(buffer + 32), r.reg0);
+
+    reg::x1_t result;
+    result.reg0 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(buffer + 32 - n));
+    return result;
+  }
+
+  template<int offset> static
+  reg::x1_t popcnt_xor_w4(
+      const reg::w4_t &left,
+      const reg::w4_t &right0,
+      const reg::w4_t &right1) {
+
+    static_assert(0 <= offset && offset < 4,
+        "popcnt_xor_w2 offset must be one of 0,1,2,3");
+
+    const __m256i ones = _mm256_set1_epi8(1);
+
+    __m256i sum[4];
+    for (int l = 0; l < 4; l += 1) {
+      const __m256i &right = l >= offset ?
+        right1.reg[l-offset] : right0.reg[l+4-offset];
+
+      __m256i count = popcnt_epi8(_mm256_xor_si256(left.reg[l], right));
+      sum[l] = _mm256_maddubs_epi16(count, ones);
+    }
+
+    // In-lane packing leaves each register's descriptors split across the
+    // lanes, dword i holds descriptors 4*(i/4)..+3 of register i%4.
+    __m256i packed = _mm256_packus_epi16(
+        _mm256_hadd_epi16(sum[0], sum[1]),
+        _mm256_hadd_epi16(sum[2], sum[3]));
+
+    reg::x1_t result;
+    result.reg0 = _mm256_permutevar8x32_epi32(packed,
+        _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+
+    return result;
+  }
+
+  inline static
+  void shift_up_w4(
+      reg::w4_t &right0,
+      reg::w4_t &right1) {
+
+    for (int i = 3; i >= 1; i -= 1) {
+      right1.reg[i] = shift_up_carry(right1.reg[i], right1.reg[i-1]);
+    }
+    right1.reg[0] = shift_up_carry(right1.reg[0], right0.reg[3]);
+
+    for (int i = 3; i >= 1; i -= 1) {
+      right0.reg[i] = shift_up_carry(right0.reg[i], right0.reg[i-1]);
+    }
+    right0.reg[0] = shift_up_carry(right0.reg[0], _mm256_setzero_si256());
+  }
+
+  inline static
+  void load_x1(reg::x1_t &r, const uint8_t *src) {
+    r.reg0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+  }
+
+  // see array128_impl::load_x1_even. The pack works within 128-bit lanes,
+  // so the quarters are put back in order after.
+  inline static
+  void load_x1_even(reg::x1_t &r, const uint8_t *src) {
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+    __m256i hi = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + 32));
+
+    r.reg0 = _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_and_si256(lo, mask),
+          _mm256_and_si256(hi, mask)), 0xd8);
+  }
+
+  inline static
+  void store_s1(const reg::s1_t &r, uint16_t *dst) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), r.reg0);
+  }
+
+  inline static
+  reg::s1_t fill_s1(uint16_t x) {
+    reg::s1_t result;
+    result.reg0 = _mm256_set1_epi16(static_cast<short>(x));
+    return result;
+  }
+
+  inline static
+  reg::x1_t min_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm256_min_epu8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t adds_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm256_adds_epu8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t subs_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm256_subs_epu8(a.reg0, b.reg0);
+    return result;
+  }
+
+  // The unpacks work within lanes, so first gather the low (high) halves of
+  // both lanes into the low (high) 8 bytes of each lane.
+  inline static
+  reg::x1_t zip_lo_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm256_unpacklo_epi8(
+        _mm256_permute4x64_epi64(a.reg0, 0xd8),
+        _mm256_permute4x64_epi64(b.reg0, 0xd8));
+    return result;
+  }
+
+  inline static
+  reg::x1_t zip_hi_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm256_unpackhi_epi8(
+        _mm256_permute4x64_epi64(a.reg0, 0xd8),
+        _mm256_permute4x64_epi64(b.reg0, 0xd8));
+    return result;
+  }
+
+  // see shift_up_carry
+  inline static
+  reg::x1_t shift_up_x1(const reg::x1_t &r, const reg::x1_t &prev) {
+    __m256i lower = _mm256_permute2x128_si256(r.reg0, prev.reg0, 0x03);
+
+    reg::x1_t result;
+    result.reg0 = _mm256_alignr_epi8(r.reg0, lower, 15);
+    return result;
+  }
+
+  inline static
+  reg::x1_t shift_down_x1(const reg::x1_t &r, const reg::x1_t &next) {
+    __m256i upper = _mm256_permute2x128_si256(r.reg0, next.reg0, 0x21);
+
+    reg::x1_t result;
+    result.reg0 = _mm256_alignr_epi8(upper, r.reg0, 1);
+    return result;
+  }
+
+  // see array128_impl::align_x1. vpalignr shifts within 128-bit lanes, so
+  // it takes the lane pair that starts at byte n rounded down to 16.
+  template <int n> static
+  reg::x1_t align_x1(const reg::x1_t &lo, const reg::x1_t &hi) {
+    const __m256i middle = _mm256_permute2x128_si256(lo.reg0, hi.reg0, 0x21);
+
+    reg::x1_t result;
+    if constexpr (n < 16) {
+      result.reg0 = _mm256_alignr_epi8(middle, lo.reg0, n);
+    } else {
+      result.reg0 = _mm256_alignr_epi8(hi.reg0, middle, n - 16);
+    }
+    return result;
+  }
+
+  // see sse_impl::hmin_x1, after folding the lanes together
+  inline static
+  reg::x1_t hmin_x1(const reg::x1_t &r) {
+    __m256i m = _mm256_min_epu8(r.reg0,
+        _mm256_permute2x128_si256(r.reg0, r.reg0, 0x01));
+    m = _mm256_min_epu8(m, _mm256_shuffle_epi32(m, 0x4e));
+    m = _mm256_min_epu8(m, _mm256_shuffle_epi32(m, 0xb1));
+    m = _mm256_min_epu8(m, _mm256_srli_epi32(m, 16));
+    m = _mm256_min_epu8(m, _mm256_srli_epi16(m, 8));
+
+    reg::x1_t result;
+    result.reg0 = _mm256_shuffle_epi8(m, _mm256_setzero_si256());
+    return result;
+  }
+
+  inline static
+  void widen_x1(const reg::x1_t &r, reg::s1_t &lo, reg::s1_t &hi) {
+    lo.reg0 = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(r.reg0));
+    hi.reg0 = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(r.reg0, 1));
+  }
+
+  // see sse_impl::lt_s1x2. The pack works within 128-bit lanes, so the
+  // quarters are put back in pixel order after.
+  inline static
+  reg::x1_t lt_s1x2(
+      const reg::s1_t &a0,
+      const reg::s1_t &a1,
+      const reg::s1_t &b0,
+      const reg::s1_t &b1) {
+
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i ge0 = _mm256_cmpeq_epi16(_mm256_subs_epu16(b0.reg0, a0.reg0),
+        zero);
+    __m256i ge1 = _mm256_cmpeq_epi16(_mm256_subs_epu16(b1.reg0, a1.reg0),
+        zero);
+
+    reg::x1_t result;
+    result.reg0 = _mm256_andnot_si256(
+        _mm256_permute4x64_epi64(_mm256_packs_epi16(ge0, ge1), 0xd8),
+        _mm256_set1_epi8(1));
+    return result;
+  }
+
+  inline static
+  reg::s1_t add_s1(const reg::s1_t &a, const reg::s1_t &b) {
+    reg::s1_t result;
+    result.reg0 = _mm256_add_epi16(a.reg0, b.reg0);
+    return result;
+  }
+
+  // see sse_impl::select_min_s1
+  inline static
+  void select_min_s1(
+      reg::s1_t &best,
+      reg::s1_t &best_index,
+      const reg::s1_t &value,
+      const reg::s1_t &index) {
+
+    __m256i less = _mm256_cmpgt_epi16(best.reg0, value.reg0);
+
+    best.reg0 = _mm256_min_epi16(value.reg0, best.reg0);
+    best_index.reg0 = _mm256_blendv_epi8(best_index.reg0, index.reg0, less);
+  }
+
+ private:
+  inline static
+  __m256i load_lanes(const uint8_t *lo, const uint8_t *hi) {
+    return _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(lo))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi)), 1);
+  }
+
+  // the luma of 16 YUYV pixels at lo and at hi, in the low and high lanes.
+  // As load_x1_even, the pack interleaves quarters, which the permute undoes.
+  inline static
+  __m256i load_even(const uint8_t *lo, const uint8_t *hi) {
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lo));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(hi));
+
+    return _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_and_si256(a, mask),
+          _mm256_and_si256(b, mask)), 0xd8);
+  }
+
+  inline static
+  __m256i popcnt_epi8(__m256i v) {
+    const __m256i lut = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+    __m256i lo = _mm256_and_si256(v, nibble);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+
+    return _mm256_add_epi8(
+        _mm256_shuffle_epi8(lut, lo),
+        _mm256_shuffle_epi8(lut, hi));
+  }
+
+  // shift r up by one descriptor, carrying in the top descriptor of prev
+  inline static
+  __m256i shift_up_carry(__m256i r, __m256i prev) {
+    // <prev.hi | r.lo>
+    __m256i carry = _mm256_permute2x128_si256(r, prev, 0x03);
+    return _mm256_alignr_epi8(r, carry, 12);
+  }
+};
+
+} // namespace simd
+} // namespace detail
+} // namespace sgm_cpu
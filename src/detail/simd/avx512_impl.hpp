@@ -0,0 +1,544 @@
+#pragma once
+
+#if (!defined(__AVX512BW__) || !defined(__AVX512VPOPCNTDQ__)) && \
+    !defined(SGM_CPU_TARGET_PRAGMA)
+#error "avx512_impl.hpp requires AVX512BW and AVX512VPOPCNTDQ (Ice Lake or later)"
+#endif
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+#include <detail/simd/x86_intrinsics.hpp>
+
+namespace sgm_cpu {
+namespace detail {
+namespace simd {
+
+// AVX-512 implementation, four 128-bit lanes in the sse_impl layout:
+//
+//  - census registers hold eight rows, lane j = <row 2j | row 2j+1>, so one
+//    execute_patch_x2 iteration produces eight output rows.
+//  - aggregation registers hold 16 descriptors, which vpopcntd XORs and
+//    counts in one instruction. A patch covers 64 left pixels and 64
+//    disparities, with one 64-byte x1_t per disparity row.
+//
+// Predicates live in mask registers rather than byte vectors.
+struct avx512_impl {
+  struct reg {
+    struct x1_t {
+      __m512i reg0;
+    };
+
+    struct s1_t {
+      __m512i reg0;
+    };
+
+    struct w4_t {
+      __m512i reg[4];
+    };
+
+    struct p1_t {
+      __mmask64 reg0;
+    };
+
+    struct x2_t {
+      // lane j of reg0 = <row(2j).left, row(2j+1).left>
+      // lane j of reg1 = <row(2j).right, row(2j+1).right>
+      __m512i reg0;
+      __m512i reg1;
+    };
+
+    static constexpr int census_rows_per_x2 = 8;
+    static constexpr int descriptors_per_w1 = 16;
+  };
+
+  inline static
+  void clear(reg::x1_t &r) {
+    r.reg0 = _mm512_setzero_si512();
+  }
+
+  inline static
+  void clear(reg::s1_t &r) {
+    r.reg0 = _mm512_setzero_si512();
+  }
+
+  inline static
+  void clear(reg::w4_t &r) {
+    for (int i = 0; i < 4; i += 1) {
+      r.reg[i] = _mm512_setzero_si512();
+    }
+  }
+
+  inline static
+  void load_row2(reg::x2_t &r, const uint8_t *src, ptrdiff_t pitch) {
+    __m512i even = load_lanes(src, 2*pitch);
+    __m512i odd = load_lanes(src + pitch, 2*pitch);
+
+    r.reg0 = _mm512_unpacklo_epi64(even, odd);
+    r.reg1 = _mm512_unpackhi_epi64(even, odd);
+  }
+
+  // see array128_impl::load_row2_even
+  inline static
+  void load_row2_even(reg::x2_t &r, const uint8_t *src, ptrdiff_t pitch) {
+    __m512i even = load_lanes_even(src, 2*pitch);
+    __m512i odd = load_lanes_even(src + pitch, 2*pitch);
+
+    r.reg0 = _mm512_unpacklo_epi64(even, odd);
+    r.reg1 = _mm512_unpackhi_epi64(even, odd);
+  }
+
+  // see array128_impl::load_row2
+  inline static
+  void load_row2(reg::x2_t &r, const uint8_t *const *rows) {
+    __m512i even = load_lanes(rows[0], rows[2], rows[4], rows[6]);
+    __m512i odd = load_lanes(rows[1], rows[3], rows[5], rows[7]);
+
+    r.reg0 = _mm512_unpacklo_epi64(even, odd);
+    r.reg1 = _mm512_unpackhi_epi64(even, odd);
+  }
+
+  inline static
+  void load_row2_even(reg::x2_t &r, const uint8_t *const *rows) {
+    __m512i even = _mm512_inserti64x4(
+        _mm512_castsi256_si512(load_even(rows[0], rows[2])),
+        load_even(rows[4], rows[6]), 1);
+    __m512i odd = _mm512_inserti64x4(
+        _mm512_castsi256_si512(load_even(rows[1], rows[3])),
+        load_even(rows[5], rows[7]), 1);
+
+    r.reg0 = _mm512_unpacklo_epi64(even, odd);
+    r.reg1 = _mm512_unpackhi_epi64(even, odd);
+  }
+
+  // see array128_impl::permute_row2. A row is a 128-bit lane of the
+  // unpacked registers, which the in-lane shuffle suits.
+  inline static
+  void permute_row2(reg::x2_t &r, const uint8_t *index) {
+    const __m512i idx = _mm512_broadcast_i32x4(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(index)));
+
+    __m512i even = _mm512_shuffle_epi8(
+        _mm512_unpacklo_epi64(r.reg0, r.reg1), idx);
+    __m512i odd = _mm512_shuffle_epi8(
+        _mm512_unpackhi_epi64(r.reg0, r.reg1), idx);
+
+    r.reg0 = _mm512_unpacklo_epi64(even, odd);
+    r.reg1 = _mm512_unpackhi_epi64(even, odd);
+  }
+
+  inline static
+  void store_feature(reg::x1_t r, uint32_t *dst, ptrdiff_t pitch) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 0*pitch),
+        _mm512_extracti32x4_epi32(r.reg0, 0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2*pitch),
+        _mm512_extracti32x4_epi32(r.reg0, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4*pitch),
+        _mm512_extracti32x4_epi32(r.reg0, 2));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 6*pitch),
+        _mm512_extracti32x4_epi32(r.reg0, 3));
+  }
+
+  inline static
+  void store_x1(const reg::x1_t &r, uint8_t *dst) {
+    _mm512_storeu_si512(dst, r.reg0);
+  }
+
+  inline static
+  void store_w4(const reg::w4_t &r, uint32_t *dst) {
+    for (int i = 0; i < 4; i += 1) {
+      _mm512_storeu_si512(dst + 16*i, r.reg[i]);
+    }
+  }
+
+  inline static
+  void load_s1(reg::s1_t &r, const uint16_t *src) {
+    r.reg0 = _mm512_loadu_si512(src);
+  }
+
+  inline static
+  void load_w4(reg::w4_t &r, const uint32_t *src) {
+    for (int i = 0; i < 4; i += 1) {
+      r.reg[i] = _mm512_loadu_si512(src + 16*i);
+    }
+  }
+
+  inline static
+  reg::p1_t cmp_row2(reg::x2_t a, reg::x2_t b) {
+    reg::p1_t result;
+    result.reg0 = _mm512_cmplt_epu8_mask(a.reg0, b.reg1);
+    return result;
+  }
+
+  template <int b> static
+  reg::x1_t bsel2(reg::x1_t acc, reg::p1_t pred) {
+    const __m512i bit = _mm512_set1_epi8(static_cast<char>(1 << b));
+
+    // with the bit cleared, adding it under the mask sets it
+    __m512i cleared = _mm512_andnot_si512(bit, acc.reg0);
+
+    reg::x1_t result;
+    result.reg0 = _mm512_mask_add_epi8(cleared, pred.reg0, cleared, bit);
+    return result;
+  }
+
+  inline static
+  void transpose_row2(reg::x2_t &r0, reg::x2_t &r1) {
+    __m512i t0 = _mm512_unpacklo_epi64(r0.reg0, r1.reg0);
+    __m512i t1 = _mm512_unpacklo_epi64(r0.reg1, r1.reg1);
+
+    r1.reg0 = _mm512_unpackhi_epi64(r0.reg0, r1.reg0);
+    r1.reg1 = _mm512_unpackhi_epi64(r0.reg1, r1.reg1);
+
+    r0.reg0 = t0;
+    r0.reg1 = t1;
+  }
+
+  inline static
+  void zip4b2(reg::x1_t &r0, reg::x1_t &r1, reg::x1_t &r2, reg::x1_t &r3) {
+    __m512i lo01 = _mm512_unpacklo_epi8(r0.reg0, r1.reg0);
+    __m512i lo23 = _mm512_unpacklo_epi8(r2.reg0, r3.reg0);
+    __m512i hi01 = _mm512_unpackhi_epi8(r0.reg0, r1.reg0);
+    __m512i hi23 = _mm512_unpackhi_epi8(r2.reg0, r3.reg0);
+
+    r0.reg0 = _mm512_unpacklo_epi16(lo01, lo23);
+    r1.reg0 = _mm512_unpackhi_epi16(lo01, lo23);
+    r2.reg0 = _mm512_unpacklo_epi16(hi01, hi23);
+    r3.reg0 = _mm512_unpackhi_epi16(hi01, hi23);
+  }
+
+  // see sse_impl::roll_outward2, shuffle masks repeat in every lane
+  inline static
+  reg::x2_t roll_outward2(reg::x2_t r, int x) {
+    const __m512i offset = _mm512_set1_epi8(static_cast<char>(2*x));
+
+    const __m512i down0 = _mm512_broadcast_i32x4(_mm_setr_epi8(
+        1, 2, 3, 4, 5, 6, 7, -128, 9, 10, 11, 12, 13, 14, 15, -128));
+    const __m512i down1 = _mm512_add_epi8(offset,
+        _mm512_broadcast_i32x4(_mm_setr_epi8(
+        -128, -128, -128, -128, -128, -128, -128, 0,
+        -128, -128, -128, -128, -128, -128, -128, 8)));
+
+    const __m512i up0 = _mm512_sub_epi8(
+        _mm512_broadcast_i32x4(_mm_setr_epi8(
+        7, -113, -113, -113, -113, -113, -113, -113,
+        15, -113, -113, -113, -113, -113, -113, -113)), offset);
+    const __m512i up1 = _mm512_broadcast_i32x4(_mm_setr_epi8(
+        -128, 0, 1, 2, 3, 4, 5, 6, -128, 8, 9, 10, 11, 12, 13, 14));
+
+    reg::x2_t result;
+    result.reg0 = _mm512_or_si512(
+        _mm512_shuffle_epi8(r.reg0, down0),
+        _mm512_shuffle_epi8(r.reg1, down1));
+    result.reg1 = _mm512_or_si512(
+        _mm512_shuffle_epi8(r.reg0, up0),
+        _mm512_shuffle_epi8(r.reg1, up1));
+
+    return result;
+  }
+
+  inline static
+  reg::x1_t fill_x1(uint8_t x) {
+    reg::x1_t result;
+    result.reg0 = _mm512_set1_epi8(static_cast<char>(x));
+    return result;
+  }
+
+  inline static
+  reg::x1_t and_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm512_and_si512(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t or_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm512_or_si512(a.reg0, b.reg0);
+    return result;
+  }
+
+  // see array128_impl::shl_bits_x1. There are no byte shifts, so shift
+  // words and mask off the bits that crossed between bytes.
+  template <int n> static
+  reg::x1_t shl_bits_x1(const reg::x1_t &r) {
+    reg::x1_t result;
+    result.reg0 = _mm512_and_si512(_mm512_slli_epi16(r.reg0, n),
+        _mm512_set1_epi8(static_cast<char>((0xff << n) & 0xff)));
+    return result;
+  }
+
+  template <int n> static
+  reg::x1_t shr_bits_x1(const reg::x1_t &r) {
+    reg::x1_t result;
+    result.reg0 = _mm512_and_si512(_mm512_srli_epi16(r.reg0, n),
+        _mm512_set1_epi8(static_cast<char>(0xff >> n)));
+    return result;
+  }
+
+  // see avx2_impl::shiftr_x1
+  inline static
+  reg::x1_t shiftr_x1(const reg::x1_t &r, int n) {
+    alignas(64) uint8_t buffer[128] = {};
+    _mm512_store_si512(buffer + 64, r.reg0);
+
+    reg::x1_t result;
+    result.reg0 = _mm512_loadu_si512(buffer + 64 - n);
+    return result;
+  }
+
+  template<int offset> static
+  reg::x1_t popcnt_xor_w4(
+      const reg::w4_t &left,
+      const reg::w4_t &right0,
+      const reg::w4_t &right1) {
+
+    static_assert(0 <= offset && offset < 4,
+        "popcnt_xor_w2 offset must be one of 0,1,2,3");
+
+    __m512i count[4];
+    for (int l = 0; l < 4; l += 1) {
+      const __m512i &right = l >= offset ?
+        right1.reg[l-offset] : right0.reg[l+4-offset];
+
+      count[l] = _mm512_popcnt_epi32(_mm512_xor_si512(left.reg[l], right));
+    }
+
+    // In-lane packing leaves dword 4j+l holding descriptors 4j..4j+3 of
+    // register l, permute them back into register order.
+    __m512i packed = _mm512_packus_epi16(
+        _mm512_packus_epi32(count[0], count[1]),
+        _mm512_packus_epi32(count[2], count[3]));
+
+    reg::x1_t result;
+    result.reg0 = _mm512_permutexvar_epi32(_mm512_setr_epi32(
+          0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15), packed);
+
+    return result;
+  }
+
+  inline static
+  void shift_up_w4(
+      reg::w4_t &right0,
+      reg::w4_t &right1) {
+
+    for (int i = 3; i >= 1; i -= 1) {
+      right1.reg[i] = _mm512_alignr_epi32(right1.reg[i], right1.reg[i-1], 15);
+    }
+    right1.reg[0] = _mm512_alignr_epi32(right1.reg[0], right0.reg[3], 15);
+
+    for (int i = 3; i >= 1; i -= 1) {
+      right0.reg[i] = _mm512_alignr_epi32(right0.reg[i], right0.reg[i-1], 15);
+    }
+    right0.reg[0] = _mm512_alignr_epi32(
+        right0.reg[0], _mm512_setzero_si512(), 15);
+  }
+
+  inline static
+  void load_x1(reg::x1_t &r, const uint8_t *src) {
+    r.reg0 = _mm512_loadu_si512(src);
+  }
+
+  // see array128_impl::load_x1_even
+  inline static
+  void load_x1_even(reg::x1_t &r, const uint8_t *src) {
+    __m256i lo = _mm512_cvtepi16_epi8(_mm512_loadu_si512(src));
+    __m256i hi = _mm512_cvtepi16_epi8(_mm512_loadu_si512(src + 64));
+
+    r.reg0 = _mm512_inserti64x4(_mm512_castsi256_si512(lo), hi, 1);
+  }
+
+  inline static
+  void store_s1(const reg::s1_t &r, uint16_t *dst) {
+    _mm512_storeu_si512(dst, r.reg0);
+  }
+
+  inline static
+  reg::s1_t fill_s1(uint16_t x) {
+    reg::s1_t result;
+    result.reg0 = _mm512_set1_epi16(static_cast<short>(x));
+    return result;
+  }
+
+  inline static
+  reg::x1_t min_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm512_min_epu8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t adds_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm512_adds_epu8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t subs_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm512_subs_epu8(a.reg0, b.reg0);
+    return result;
+  }
+
+  // see avx2_impl::zip_lo_x1, the low 8 bytes of lane j get qword j
+  inline static
+  reg::x1_t zip_lo_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    const __m512i order = _mm512_setr_epi64(0, 4, 1, 5, 2, 6, 3, 7);
+
+    reg::x1_t result;
+    result.reg0 = _mm512_unpacklo_epi8(
+        _mm512_permutexvar_epi64(order, a.reg0),
+        _mm512_permutexvar_epi64(order, b.reg0));
+    return result;
+  }
+
+  inline static
+  reg::x1_t zip_hi_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    const __m512i order = _mm512_setr_epi64(0, 4, 1, 5, 2, 6, 3, 7);
+
+    reg::x1_t result;
+    result.reg0 = _mm512_unpackhi_epi8(
+        _mm512_permutexvar_epi64(order, a.reg0),
+        _mm512_permutexvar_epi64(order, b.reg0));
+    return result;
+  }
+
+  // Lane j of lower is lane j-1 of <prev, r>, which alignr then shifts in.
+  inline static
+  reg::x1_t shift_up_x1(const reg::x1_t &r, const reg::x1_t &prev) {
+    __m512i lower = _mm512_alignr_epi64(r.reg0, prev.reg0, 6);
+
+    reg::x1_t result;
+    result.reg0 = _mm512_alignr_epi8(r.reg0, lower, 15);
+    return result;
+  }
+
+  inline static
+  reg::x1_t shift_down_x1(const reg::x1_t &r, const reg::x1_t &next) {
+    __m512i upper = _mm512_alignr_epi64(next.reg0, r.reg0, 2);
+
+    reg::x1_t result;
+    result.reg0 = _mm512_alignr_epi8(upper, r.reg0, 1);
+    return result;
+  }
+
+  // see array128_impl::align_x1 and avx2_impl::align_x1, with valignq
+  // moving whole lanes
+  template <int n> static
+  reg::x1_t align_x1(const reg::x1_t &lo, const reg::x1_t &hi) {
+    constexpr int lane = n / 16;
+
+    const __m512i first = _mm512_alignr_epi64(hi.reg0, lo.reg0, 2*lane);
+
+    reg::x1_t result;
+    if constexpr (lane < 3) {
+      result.reg0 = _mm512_alignr_epi8(
+          _mm512_alignr_epi64(hi.reg0, lo.reg0, 2*lane + 2), first, n % 16);
+    } else {
+      result.reg0 = _mm512_alignr_epi8(hi.reg0, first, n % 16);
+    }
+    return result;
+  }
+
+  inline static
+  reg::x1_t hmin_x1(const reg::x1_t &r) {
+    __m512i m = _mm512_min_epu8(r.reg0,
+        _mm512_shuffle_i64x2(r.reg0, r.reg0, 0x4e));
+    m = _mm512_min_epu8(m, _mm512_shuffle_i64x2(m, m, 0xb1));
+    m = _mm512_min_epu8(m, _mm512_shuffle_epi32(m, _MM_PERM_BADC));
+    m = _mm512_min_epu8(m, _mm512_shuffle_epi32(m, _MM_PERM_CDAB));
+    m = _mm512_min_epu8(m, _mm512_srli_epi32(m, 16));
+    m = _mm512_min_epu8(m, _mm512_srli_epi16(m, 8));
+
+    reg::x1_t result;
+    result.reg0 = _mm512_shuffle_epi8(m, _mm512_setzero_si512());
+    return result;
+  }
+
+  inline static
+  void widen_x1(const reg::x1_t &r, reg::s1_t &lo, reg::s1_t &hi) {
+    lo.reg0 = _mm512_cvtepu8_epi16(_mm512_castsi512_si256(r.reg0));
+    hi.reg0 = _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(r.reg0, 1));
+  }
+
+  // see array128_impl::lt_s1x2
+  inline static
+  reg::x1_t lt_s1x2(
+      const reg::s1_t &a0,
+      const reg::s1_t &a1,
+      const reg::s1_t &b0,
+      const reg::s1_t &b1) {
+
+    const uint64_t lt0 = _mm512_cmplt_epu16_mask(a0.reg0, b0.reg0);
+    const uint64_t lt1 = _mm512_cmplt_epu16_mask(a1.reg0, b1.reg0);
+
+    reg::x1_t result;
+    result.reg0 = _mm512_maskz_set1_epi8(lt0 | (lt1 << 32), 1);
+    return result;
+  }
+
+  inline static
+  reg::s1_t add_s1(const reg::s1_t &a, const reg::s1_t &b) {
+    reg::s1_t result;
+    result.reg0 = _mm512_add_epi16(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  void select_min_s1(
+      reg::s1_t &best,
+      reg::s1_t &best_index,
+      const reg::s1_t &value,
+      const reg::s1_t &index) {
+
+    __mmask32 less = _mm512_cmplt_epu16_mask(value.reg0, best.reg0);
+
+    best.reg0 = _mm512_mask_mov_epi16(best.reg0, less, value.reg0);
+    best_index.reg0 = _mm512_mask_mov_epi16(best_index.reg0, less, index.reg0);
+  }
+
+ private:
+  // 16 bytes from each of four rows, pitch apart
+  inline static
+  __m512i load_lanes(const uint8_t *src, ptrdiff_t pitch) {
+    return load_lanes(src, src + 1*pitch, src + 2*pitch, src + 3*pitch);
+  }
+
+  inline static
+  __m512i load_lanes(const uint8_t *src0, const uint8_t *src1,
+      const uint8_t *src2, const uint8_t *src3) {
+    auto load = [](const uint8_t *p) {
+      return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    };
+
+    __m512i r = _mm512_castsi128_si512(load(src0));
+    r = _mm512_inserti32x4(r, load(src1), 1);
+    r = _mm512_inserti32x4(r, load(src2), 2);
+    r = _mm512_inserti32x4(r, load(src3), 3);
+    return r;
+  }
+
+  // load_lanes of the luma of YUYV rows
+  inline static
+  __m512i load_lanes_even(const uint8_t *src, ptrdiff_t pitch) {
+    return _mm512_inserti64x4(
+        _mm512_castsi256_si512(load_even(src, src + pitch)),
+        load_even(src + 2*pitch, src + 3*pitch), 1);
+  }
+
+  // the luma of 16 YUYV pixels at each of lo and hi, narrowed together
+  inline static
+  __m256i load_even(const uint8_t *lo, const uint8_t *hi) {
+    __m512i r = _mm512_castsi256_si512(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lo)));
+    r = _mm512_inserti64x4(r,
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(hi)), 1);
+    return _mm512_cvtepi16_epi8(r);
+  }
+};
+
+} // namespace simd
+} // namespace detail
+} // namespace sgm_cpu
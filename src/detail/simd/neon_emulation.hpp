@@ -0,0 +1,337 @@
+#pragma once
+
+// Portable stand-ins for the AArch64 NEON intrinsics used by neon_impl, in
+// the spirit of SIMDe's native aliases. They let the NEON backend build and
+// run its test suites on non-ARM hosts (define SGM_CPU_EMULATE_NEON).
+//
+// Only the subset neon_impl needs is provided, with the documented
+// semantics of each intrinsic. This is for testing, not speed.
+
+#if defined(__aarch64__)
+#error "neon_emulation.hpp must not be used on AArch64, include <arm_neon.h>"
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+struct uint8x8_t { uint8_t v[8]; };
+struct uint8x16_t { uint8_t v[16]; };
+struct uint16x8_t { uint16_t v[8]; };
+struct uint32x4_t { uint32_t v[4]; };
+
+struct uint8x16x2_t { uint8x16_t val[2]; };
+struct uint16x8x2_t { uint16x8_t val[2]; };
+
+// loads / stores
+
+inline uint8x8_t vld1_u8(const uint8_t *src) {
+  uint8x8_t r;
+  std::memcpy(r.v, src, sizeof(r.v));
+  return r;
+}
+
+inline uint8x16_t vld1q_u8(const uint8_t *src) {
+  uint8x16_t r;
+  std::memcpy(r.v, src, sizeof(r.v));
+  return r;
+}
+
+inline uint8x16x2_t vld2q_u8(const uint8_t *src) {
+  uint8x16x2_t r;
+  for (int i = 0; i < 16; i += 1) {
+    r.val[0].v[i] = src[2*i + 0];
+    r.val[1].v[i] = src[2*i + 1];
+  }
+  return r;
+}
+
+inline uint16x8_t vld1q_u16(const uint16_t *src) {
+  uint16x8_t r;
+  std::memcpy(r.v, src, sizeof(r.v));
+  return r;
+}
+
+inline uint32x4_t vld1q_u32(const uint32_t *src) {
+  uint32x4_t r;
+  std::memcpy(r.v, src, sizeof(r.v));
+  return r;
+}
+
+inline void vst1q_u8(uint8_t *dst, uint8x16_t r) {
+  std::memcpy(dst, r.v, sizeof(r.v));
+}
+
+inline void vst1q_u16(uint16_t *dst, uint16x8_t r) {
+  std::memcpy(dst, r.v, sizeof(r.v));
+}
+
+inline void vst1q_u32(uint32_t *dst, uint32x4_t r) {
+  std::memcpy(dst, r.v, sizeof(r.v));
+}
+
+// broadcast
+
+inline uint8x16_t vdupq_n_u8(uint8_t x) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) r.v[i] = x;
+  return r;
+}
+
+inline uint16x8_t vdupq_n_u16(uint16_t x) {
+  uint16x8_t r;
+  for (int i = 0; i < 8; i += 1) r.v[i] = x;
+  return r;
+}
+
+inline uint32x4_t vdupq_n_u32(uint32_t x) {
+  uint32x4_t r;
+  for (int i = 0; i < 4; i += 1) r.v[i] = x;
+  return r;
+}
+
+// halves
+
+inline uint8x16_t vcombine_u8(uint8x8_t lo, uint8x8_t hi) {
+  uint8x16_t r;
+  std::memcpy(r.v + 0, lo.v, 8);
+  std::memcpy(r.v + 8, hi.v, 8);
+  return r;
+}
+
+inline uint8x8_t vget_low_u8(uint8x16_t a) {
+  uint8x8_t r;
+  std::memcpy(r.v, a.v + 0, 8);
+  return r;
+}
+
+inline uint8x8_t vget_high_u8(uint8x16_t a) {
+  uint8x8_t r;
+  std::memcpy(r.v, a.v + 8, 8);
+  return r;
+}
+
+// reinterpret
+
+inline uint16x8_t vreinterpretq_u16_u8(uint8x16_t a) {
+  uint16x8_t r;
+  std::memcpy(r.v, a.v, sizeof(r.v));
+  return r;
+}
+
+inline uint8x16_t vreinterpretq_u8_u16(uint16x8_t a) {
+  uint8x16_t r;
+  std::memcpy(r.v, a.v, sizeof(r.v));
+  return r;
+}
+
+inline uint8x16_t vreinterpretq_u8_u32(uint32x4_t a) {
+  uint8x16_t r;
+  std::memcpy(r.v, a.v, sizeof(r.v));
+  return r;
+}
+
+inline uint32x4_t vreinterpretq_u32_u8(uint8x16_t a) {
+  uint32x4_t r;
+  std::memcpy(r.v, a.v, sizeof(r.v));
+  return r;
+}
+
+// arithmetic / logic
+
+inline uint8x16_t vaddq_u8(uint8x16_t a, uint8x16_t b) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) r.v[i] = static_cast<uint8_t>(a.v[i] + b.v[i]);
+  return r;
+}
+
+inline uint8x16_t vsubq_u8(uint8x16_t a, uint8x16_t b) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) r.v[i] = static_cast<uint8_t>(a.v[i] - b.v[i]);
+  return r;
+}
+
+inline uint8x16_t vandq_u8(uint8x16_t a, uint8x16_t b) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) r.v[i] = a.v[i] & b.v[i];
+  return r;
+}
+
+inline uint8x16_t vorrq_u8(uint8x16_t a, uint8x16_t b) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) r.v[i] = a.v[i] | b.v[i];
+  return r;
+}
+
+inline uint8x16_t vshlq_n_u8(uint8x16_t a, int n) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) r.v[i] = static_cast<uint8_t>(a.v[i] << n);
+  return r;
+}
+
+inline uint8x16_t vshrq_n_u8(uint8x16_t a, int n) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) r.v[i] = static_cast<uint8_t>(a.v[i] >> n);
+  return r;
+}
+
+inline uint32x4_t veorq_u32(uint32x4_t a, uint32x4_t b) {
+  uint32x4_t r;
+  for (int i = 0; i < 4; i += 1) r.v[i] = a.v[i] ^ b.v[i];
+  return r;
+}
+
+inline uint8x16_t vcltq_u8(uint8x16_t a, uint8x16_t b) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) r.v[i] = a.v[i] < b.v[i] ? 0xff : 0;
+  return r;
+}
+
+inline uint8x16_t vbslq_u8(uint8x16_t mask, uint8x16_t a, uint8x16_t b) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) {
+    r.v[i] = (mask.v[i] & a.v[i]) | (~mask.v[i] & b.v[i]);
+  }
+  return r;
+}
+
+inline uint8x16_t vcntq_u8(uint8x16_t a) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) r.v[i] = __builtin_popcount(a.v[i]);
+  return r;
+}
+
+inline uint8x16_t vpaddq_u8(uint8x16_t a, uint8x16_t b) {
+  uint8x16_t r;
+  for (int i = 0; i < 8; i += 1) {
+    r.v[i] = static_cast<uint8_t>(a.v[2*i] + a.v[2*i+1]);
+    r.v[8+i] = static_cast<uint8_t>(b.v[2*i] + b.v[2*i+1]);
+  }
+  return r;
+}
+
+inline uint8x16_t vminq_u8(uint8x16_t a, uint8x16_t b) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+  return r;
+}
+
+inline uint8x16_t vqaddq_u8(uint8x16_t a, uint8x16_t b) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) {
+    int x = a.v[i] + b.v[i];
+    r.v[i] = static_cast<uint8_t>(x > 0xff ? 0xff : x);
+  }
+  return r;
+}
+
+inline uint8x16_t vqsubq_u8(uint8x16_t a, uint8x16_t b) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) {
+    r.v[i] = static_cast<uint8_t>(a.v[i] > b.v[i] ? a.v[i] - b.v[i] : 0);
+  }
+  return r;
+}
+
+inline uint8_t vminvq_u8(uint8x16_t a) {
+  uint8_t m = a.v[0];
+  for (int i = 1; i < 16; i += 1) m = a.v[i] < m ? a.v[i] : m;
+  return m;
+}
+
+inline uint16x8_t vmovl_u8(uint8x8_t a) {
+  uint16x8_t r;
+  for (int i = 0; i < 8; i += 1) r.v[i] = a.v[i];
+  return r;
+}
+
+inline uint8x8_t vmovn_u16(uint16x8_t a) {
+  uint8x8_t r;
+  for (int i = 0; i < 8; i += 1) r.v[i] = static_cast<uint8_t>(a.v[i]);
+  return r;
+}
+
+inline uint16x8_t vaddq_u16(uint16x8_t a, uint16x8_t b) {
+  uint16x8_t r;
+  for (int i = 0; i < 8; i += 1) r.v[i] = static_cast<uint16_t>(a.v[i] + b.v[i]);
+  return r;
+}
+
+inline uint16x8_t vminq_u16(uint16x8_t a, uint16x8_t b) {
+  uint16x8_t r;
+  for (int i = 0; i < 8; i += 1) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+  return r;
+}
+
+inline uint16x8_t vcltq_u16(uint16x8_t a, uint16x8_t b) {
+  uint16x8_t r;
+  for (int i = 0; i < 8; i += 1) r.v[i] = a.v[i] < b.v[i] ? 0xffff : 0;
+  return r;
+}
+
+inline uint16x8_t vbslq_u16(uint16x8_t mask, uint16x8_t a, uint16x8_t b) {
+  uint16x8_t r;
+  for (int i = 0; i < 8; i += 1) {
+    r.v[i] = static_cast<uint16_t>((mask.v[i] & a.v[i]) | (~mask.v[i] & b.v[i]));
+  }
+  return r;
+}
+
+// permutes
+
+inline uint8x16x2_t vzipq_u8(uint8x16_t a, uint8x16_t b) {
+  uint8x16x2_t r;
+  for (int i = 0; i < 16; i += 1) {
+    r.val[i/8].v[2*(i%8) + 0] = a.v[i];
+    r.val[i/8].v[2*(i%8) + 1] = b.v[i];
+  }
+  return r;
+}
+
+inline uint16x8x2_t vzipq_u16(uint16x8_t a, uint16x8_t b) {
+  uint16x8x2_t r;
+  for (int i = 0; i < 8; i += 1) {
+    r.val[i/4].v[2*(i%4) + 0] = a.v[i];
+    r.val[i/4].v[2*(i%4) + 1] = b.v[i];
+  }
+  return r;
+}
+
+inline uint8x16_t vzip1q_u8(uint8x16_t a, uint8x16_t b) {
+  return vzipq_u8(a, b).val[0];
+}
+
+inline uint8x16_t vzip2q_u8(uint8x16_t a, uint8x16_t b) {
+  return vzipq_u8(a, b).val[1];
+}
+
+inline uint8x16_t vextq_u8(uint8x16_t a, uint8x16_t b, int n) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) {
+    r.v[i] = (i + n < 16) ? a.v[i + n] : b.v[i + n - 16];
+  }
+  return r;
+}
+
+inline uint32x4_t vextq_u32(uint32x4_t a, uint32x4_t b, int n) {
+  uint32x4_t r;
+  for (int i = 0; i < 4; i += 1) {
+    r.v[i] = (i + n < 4) ? a.v[i + n] : b.v[i + n - 4];
+  }
+  return r;
+}
+
+inline uint8x16_t vqtbl1q_u8(uint8x16_t t, uint8x16_t idx) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) {
+    r.v[i] = idx.v[i] < 16 ? t.v[idx.v[i]] : 0;
+  }
+  return r;
+}
+
+inline uint8x16_t vqtbl2q_u8(uint8x16x2_t t, uint8x16_t idx) {
+  uint8x16_t r;
+  for (int i = 0; i < 16; i += 1) {
+    r.v[i] = idx.v[i] < 32 ? t.val[idx.v[i] / 16].v[idx.v[i] % 16] : 0;
+  }
+  return r;
+}
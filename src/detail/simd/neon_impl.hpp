@@ -0,0 +1,442 @@
+#pragma once
+
+#if defined(SGM_CPU_EMULATE_NEON) && !defined(__aarch64__)
+#include <detail/simd/neon_emulation.hpp>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#else
+#error "neon_impl.hpp requires AArch64 (or SGM_CPU_EMULATE_NEON for testing)"
+#endif
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace sgm_cpu {
+namespace detail {
+namespace simd {
+
+// AArch64 NEON implementation of the array128_impl interface. Register
+// contents match array128_impl lane for lane. Unlike SSE, NEON has unsigned
+// byte compares and multi-register table lookups, so p1_t holds the true
+// predicate and the census rolls are a single tbl per register.
+struct neon_impl {
+  struct reg {
+    struct x1_t {
+      uint8x16_t reg0;
+    };
+
+    struct s1_t {
+      uint16x8_t reg0;
+    };
+
+    struct w4_t {
+      uint32x4_t reg[4];
+    };
+
+    struct p1_t {
+      uint8x16_t reg0;
+    };
+
+    struct x2_t {
+      // one row (16-byte) per register
+      uint8x16_t reg0;
+      uint8x16_t reg1;
+    };
+
+    static constexpr int census_rows_per_x2 = 2;
+    static constexpr int descriptors_per_w1 = 4;
+  };
+
+  inline static
+  void clear(reg::x1_t &r) {
+    r.reg0 = vdupq_n_u8(0);
+  }
+
+  inline static
+  void clear(reg::s1_t &r) {
+    r.reg0 = vdupq_n_u16(0);
+  }
+
+  inline static
+  void clear(reg::w4_t &r) {
+    for (int i = 0; i < 4; i += 1) {
+      r.reg[i] = vdupq_n_u32(0);
+    }
+  }
+
+  inline static
+  void load_row2(reg::x2_t &r, const uint8_t *src, ptrdiff_t pitch) {
+    const uint8_t *src0 = src + 0*pitch;
+    const uint8_t *src1 = src + 1*pitch;
+
+    r.reg0 = vcombine_u8(vld1_u8(src0), vld1_u8(src1));
+    r.reg1 = vcombine_u8(vld1_u8(src0 + 8), vld1_u8(src1 + 8));
+  }
+
+  // see array128_impl::load_row2_even
+  inline static
+  void load_row2_even(reg::x2_t &r, const uint8_t *src, ptrdiff_t pitch) {
+    uint8x16_t row0 = vld2q_u8(src + 0*pitch).val[0];
+    uint8x16_t row1 = vld2q_u8(src + 1*pitch).val[0];
+
+    r.reg0 = vcombine_u8(vget_low_u8(row0), vget_low_u8(row1));
+    r.reg1 = vcombine_u8(vget_high_u8(row0), vget_high_u8(row1));
+  }
+
+  // see array128_impl::load_row2
+  inline static
+  void load_row2(reg::x2_t &r, const uint8_t *const *rows) {
+    r.reg0 = vcombine_u8(vld1_u8(rows[0]), vld1_u8(rows[1]));
+    r.reg1 = vcombine_u8(vld1_u8(rows[0] + 8), vld1_u8(rows[1] + 8));
+  }
+
+  inline static
+  void load_row2_even(reg::x2_t &r, const uint8_t *const *rows) {
+    uint8x16_t row0 = vld2q_u8(rows[0]).val[0];
+    uint8x16_t row1 = vld2q_u8(rows[1]).val[0];
+
+    r.reg0 = vcombine_u8(vget_low_u8(row0), vget_low_u8(row1));
+    r.reg1 = vcombine_u8(vget_high_u8(row0), vget_high_u8(row1));
+  }
+
+  // see array128_impl::permute_row2. Indices of 16 and up read 0, as the
+  // high bit does.
+  inline static
+  void permute_row2(reg::x2_t &r, const uint8_t *index) {
+    const uint8x16_t idx = vld1q_u8(index);
+
+    uint8x16_t row0 = vqtbl1q_u8(
+        vcombine_u8(vget_low_u8(r.reg0), vget_low_u8(r.reg1)), idx);
+    uint8x16_t row1 = vqtbl1q_u8(
+        vcombine_u8(vget_high_u8(r.reg0), vget_high_u8(r.reg1)), idx);
+
+    r.reg0 = vcombine_u8(vget_low_u8(row0), vget_low_u8(row1));
+    r.reg1 = vcombine_u8(vget_high_u8(row0), vget_high_u8(row1));
+  }
+
+  inline static
+  void store_feature(reg::x1_t r, uint32_t *dst, ptrdiff_t pitch) {
+    vst1q_u8(reinterpret_cast<uint8_t *>(dst), r.reg0);
+  }
+
+  inline static
+  void store_x1(const reg::x1_t &r, uint8_t *dst) {
+    vst1q_u8(dst, r.reg0);
+  }
+
+  inline static
+  void store_w4(const reg::w4_t &r, uint32_t *dst) {
+    for (int i = 0; i < 4; i += 1) {
+      vst1q_u32(dst + 4*i, r.reg[i]);
+    }
+  }
+
+  inline static
+  void load_s1(reg::s1_t &r, const uint16_t *src) {
+    r.reg0 = vld1q_u16(src);
+  }
+
+  inline static
+  void load_w4(reg::w4_t &r, const uint32_t *src) {
+    for (int i = 0; i < 4; i += 1) {
+      r.reg[i] = vld1q_u32(src + 4*i);
+    }
+  }
+
+  inline static
+  reg::p1_t cmp_row2(reg::x2_t a, reg::x2_t b) {
+    reg::p1_t result;
+    result.reg0 = vcltq_u8(a.reg0, b.reg1);
+    return result;
+  }
+
+  template <int b> static
+  reg::x1_t bsel2(reg::x1_t acc, reg::p1_t pred) {
+    reg::x1_t result;
+    result.reg0 = vbslq_u8(vdupq_n_u8(1 << b), pred.reg0, acc.reg0);
+    return result;
+  }
+
+  inline static
+  void transpose_row2(reg::x2_t &r0, reg::x2_t &r1) {
+    uint8x16_t t0 = vcombine_u8(vget_low_u8(r0.reg0), vget_low_u8(r1.reg0));
+    uint8x16_t t1 = vcombine_u8(vget_low_u8(r0.reg1), vget_low_u8(r1.reg1));
+
+    r1.reg0 = vcombine_u8(vget_high_u8(r0.reg0), vget_high_u8(r1.reg0));
+    r1.reg1 = vcombine_u8(vget_high_u8(r0.reg1), vget_high_u8(r1.reg1));
+
+    r0.reg0 = t0;
+    r0.reg1 = t1;
+  }
+
+  // Byte interleave of the four registers, see sse_impl::zip4b2
+  inline static
+  void zip4b2(reg::x1_t &r0, reg::x1_t &r1, reg::x1_t &r2, reg::x1_t &r3) {
+    uint8x16x2_t z01 = vzipq_u8(r0.reg0, r1.reg0);
+    uint8x16x2_t z23 = vzipq_u8(r2.reg0, r3.reg0);
+
+    uint16x8x2_t lo = vzipq_u16(
+        vreinterpretq_u16_u8(z01.val[0]), vreinterpretq_u16_u8(z23.val[0]));
+    uint16x8x2_t hi = vzipq_u16(
+        vreinterpretq_u16_u8(z01.val[1]), vreinterpretq_u16_u8(z23.val[1]));
+
+    r0.reg0 = vreinterpretq_u8_u16(lo.val[0]);
+    r1.reg0 = vreinterpretq_u8_u16(lo.val[1]);
+    r2.reg0 = vreinterpretq_u8_u16(hi.val[0]);
+    r3.reg0 = vreinterpretq_u8_u16(hi.val[1]);
+  }
+
+  // Both outputs are a lookup into the 32-byte table <reg0, reg1>, see
+  // sse_impl::roll_outward2 for the 2*x offset of the crossing bytes.
+  inline static
+  reg::x2_t roll_outward2(reg::x2_t r, int x) {
+    static constexpr uint8_t down[16] = {
+       1,  2,  3,  4,  5,  6,  7, 16,  9, 10, 11, 12, 13, 14, 15, 24 };
+    static constexpr uint8_t up[16] = {
+       7, 16, 17, 18, 19, 20, 21, 22, 15, 24, 25, 26, 27, 28, 29, 30 };
+    static constexpr uint8_t down_cross[16] = {
+       0,  0,  0,  0,  0,  0,  0, 0xff, 0,  0,  0,  0,  0,  0,  0, 0xff };
+    static constexpr uint8_t up_cross[16] = {
+       0xff, 0,  0,  0,  0,  0,  0,  0, 0xff, 0,  0,  0,  0,  0,  0,  0 };
+
+    const uint8x16_t offset = vdupq_n_u8(static_cast<uint8_t>(2*x));
+
+    uint8x16x2_t table;
+    table.val[0] = r.reg0;
+    table.val[1] = r.reg1;
+
+    reg::x2_t result;
+    result.reg0 = vqtbl2q_u8(table, vaddq_u8(vld1q_u8(down),
+          vandq_u8(vld1q_u8(down_cross), offset)));
+    result.reg1 = vqtbl2q_u8(table, vsubq_u8(vld1q_u8(up),
+          vandq_u8(vld1q_u8(up_cross), offset)));
+
+    return result;
+  }
+
+  inline static
+  reg::x1_t fill_x1(uint8_t x) {
+    reg::x1_t result;
+    result.reg0 = vdupq_n_u8(x);
+    return result;
+  }
+
+  inline static
+  reg::x1_t and_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = vandq_u8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t or_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = vorrq_u8(a.reg0, b.reg0);
+    return result;
+  }
+
+  // see array128_impl::shl_bits_x1
+  template <int n> static
+  reg::x1_t shl_bits_x1(const reg::x1_t &r) {
+    reg::x1_t result;
+    result.reg0 = vshlq_n_u8(r.reg0, n);
+    return result;
+  }
+
+  template <int n> static
+  reg::x1_t shr_bits_x1(const reg::x1_t &r) {
+    reg::x1_t result;
+    result.reg0 = vshrq_n_u8(r.reg0, n);
+    return result;
+  }
+
+  // Variable byte shift. Indices below n wrap past 15, and tbl returns zero
+  // for out of range indices.
+  inline static
+  reg::x1_t shiftr_x1(const reg::x1_t &r, int n) {
+    static constexpr uint8_t iota[16] = {
+      0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+    reg::x1_t result;
+    result.reg0 = vqtbl1q_u8(r.reg0,
+        vsubq_u8(vld1q_u8(iota), vdupq_n_u8(static_cast<uint8_t>(n))));
+    return result;
+  }
+
+  template<int offset> static
+  reg::x1_t popcnt_xor_w4(
+      const reg::w4_t &left,
+      const reg::w4_t &right0,
+      const reg::w4_t &right1) {
+
+    static_assert(0 <= offset && offset < 4,
+        "popcnt_xor_w2 offset must be one of 0,1,2,3");
+
+    uint8x16_t count[4];
+    for (int l = 0; l < 4; l += 1) {
+      const uint32x4_t &right = l >= offset ?
+        right1.reg[l-offset] : right0.reg[l+4-offset];
+
+      count[l] = vcntq_u8(vreinterpretq_u8_u32(veorq_u32(left.reg[l], right)));
+    }
+
+    // Two rounds of pairwise adds reduce each descriptor's four byte counts
+    // to one byte, already in register order.
+    reg::x1_t result;
+    result.reg0 = vpaddq_u8(
+        vpaddq_u8(count[0], count[1]),
+        vpaddq_u8(count[2], count[3]));
+
+    return result;
+  }
+
+  inline static
+  void shift_up_w4(
+      reg::w4_t &right0,
+      reg::w4_t &right1) {
+
+    for (int i = 3; i >= 1; i -= 1) {
+      right1.reg[i] = vextq_u32(right1.reg[i-1], right1.reg[i], 3);
+    }
+    right1.reg[0] = vextq_u32(right0.reg[3], right1.reg[0], 3);
+
+    for (int i = 3; i >= 1; i -= 1) {
+      right0.reg[i] = vextq_u32(right0.reg[i-1], right0.reg[i], 3);
+    }
+    right0.reg[0] = vextq_u32(vdupq_n_u32(0), right0.reg[0], 3);
+  }
+
+  inline static
+  void load_x1(reg::x1_t &r, const uint8_t *src) {
+    r.reg0 = vld1q_u8(src);
+  }
+
+  // see array128_impl::load_x1_even
+  inline static
+  void load_x1_even(reg::x1_t &r, const uint8_t *src) {
+    r.reg0 = vld2q_u8(src).val[0];
+  }
+
+  inline static
+  void store_s1(const reg::s1_t &r, uint16_t *dst) {
+    vst1q_u16(dst, r.reg0);
+  }
+
+  inline static
+  reg::s1_t fill_s1(uint16_t x) {
+    reg::s1_t result;
+    result.reg0 = vdupq_n_u16(x);
+    return result;
+  }
+
+  inline static
+  reg::x1_t min_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = vminq_u8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t adds_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = vqaddq_u8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t subs_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = vqsubq_u8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t zip_lo_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = vzip1q_u8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t zip_hi_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = vzip2q_u8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t shift_up_x1(const reg::x1_t &r, const reg::x1_t &prev) {
+    reg::x1_t result;
+    result.reg0 = vextq_u8(prev.reg0, r.reg0, 15);
+    return result;
+  }
+
+  inline static
+  reg::x1_t shift_down_x1(const reg::x1_t &r, const reg::x1_t &next) {
+    reg::x1_t result;
+    result.reg0 = vextq_u8(r.reg0, next.reg0, 1);
+    return result;
+  }
+
+  // see array128_impl::align_x1
+  template <int n> static
+  reg::x1_t align_x1(const reg::x1_t &lo, const reg::x1_t &hi) {
+    reg::x1_t result;
+    result.reg0 = vextq_u8(lo.reg0, hi.reg0, n);
+    return result;
+  }
+
+  inline static
+  reg::x1_t hmin_x1(const reg::x1_t &r) {
+    return fill_x1(vminvq_u8(r.reg0));
+  }
+
+  inline static
+  void widen_x1(const reg::x1_t &r, reg::s1_t &lo, reg::s1_t &hi) {
+    lo.reg0 = vmovl_u8(vget_low_u8(r.reg0));
+    hi.reg0 = vmovl_u8(vget_high_u8(r.reg0));
+  }
+
+  // see array128_impl::lt_s1x2
+  inline static
+  reg::x1_t lt_s1x2(
+      const reg::s1_t &a0,
+      const reg::s1_t &a1,
+      const reg::s1_t &b0,
+      const reg::s1_t &b1) {
+
+    uint8x16_t lt = vcombine_u8(
+        vmovn_u16(vcltq_u16(a0.reg0, b0.reg0)),
+        vmovn_u16(vcltq_u16(a1.reg0, b1.reg0)));
+
+    reg::x1_t result;
+    result.reg0 = vandq_u8(lt, vdupq_n_u8(1));
+    return result;
+  }
+
+  inline static
+  reg::s1_t add_s1(const reg::s1_t &a, const reg::s1_t &b) {
+    reg::s1_t result;
+    result.reg0 = vaddq_u16(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  void select_min_s1(
+      reg::s1_t &best,
+      reg::s1_t &best_index,
+      const reg::s1_t &value,
+      const reg::s1_t &index) {
+
+    uint16x8_t less = vcltq_u16(value.reg0, best.reg0);
+
+    best.reg0 = vminq_u16(value.reg0, best.reg0);
+    best_index.reg0 = vbslq_u16(less, index.reg0, best_index.reg0);
+  }
+
+};
+
+} // namespace simd
+} // namespace detail
+} // namespace sgm_cpu
@@ -0,0 +1,496 @@
+#pragma once
+
+#if !defined(__SSSE3__) && !defined(SGM_CPU_TARGET_PRAGMA)
+#error "sse_impl.hpp requires SSSE3 (compile with -mssse3 or better)"
+#endif
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+#include <tmmintrin.h>
+
+namespace sgm_cpu {
+namespace detail {
+namespace simd {
+
+// Native SSE2/SSSE3 implementation of the array128_impl interface. Register
+// contents match array128_impl lane for lane, the only exception being p1_t
+// which holds the complement of the predicate (see cmp_row2).
+struct sse_impl {
+  struct reg {
+    struct x1_t {
+      __m128i reg0;
+    };
+
+    struct s1_t {
+      __m128i reg0;
+    };
+
+    struct w4_t {
+      __m128i reg[4];
+    };
+
+    struct p1_t {
+      // 0xff where the comparison is false, i.e. (a >= b)
+      __m128i reg0;
+    };
+
+    struct x2_t {
+      // one row (16-byte) per register
+      __m128i reg0;
+      __m128i reg1;
+    };
+
+    static constexpr int census_rows_per_x2 = 2;
+    static constexpr int descriptors_per_w1 = 4;
+  };
+
+  inline static
+  void clear(reg::x1_t &r) {
+    r.reg0 = _mm_setzero_si128();
+  }
+
+  inline static
+  void clear(reg::s1_t &r) {
+    r.reg0 = _mm_setzero_si128();
+  }
+
+  inline static
+  void clear(reg::w4_t &r) {
+    for (int i = 0; i < 4; i += 1) {
+      r.reg[i] = _mm_setzero_si128();
+    }
+  }
+
+  inline static
+  void load_row2(reg::x2_t &r, const uint8_t *src, ptrdiff_t pitch) {
+    __m128i row0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    __m128i row1 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(src + pitch));
+
+    r.reg0 = _mm_unpacklo_epi64(row0, row1);
+    r.reg1 = _mm_unpackhi_epi64(row0, row1);
+  }
+
+  // see array128_impl::load_row2_even
+  inline static
+  void load_row2_even(reg::x2_t &r, const uint8_t *src, ptrdiff_t pitch) {
+    reg::x1_t row0;
+    reg::x1_t row1;
+    load_x1_even(row0, src);
+    load_x1_even(row1, src + pitch);
+
+    r.reg0 = _mm_unpacklo_epi64(row0.reg0, row1.reg0);
+    r.reg1 = _mm_unpackhi_epi64(row0.reg0, row1.reg0);
+  }
+
+  // see array128_impl::load_row2
+  inline static
+  void load_row2(reg::x2_t &r, const uint8_t *const *rows) {
+    __m128i row0 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[0]));
+    __m128i row1 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[1]));
+
+    r.reg0 = _mm_unpacklo_epi64(row0, row1);
+    r.reg1 = _mm_unpackhi_epi64(row0, row1);
+  }
+
+  inline static
+  void load_row2_even(reg::x2_t &r, const uint8_t *const *rows) {
+    reg::x1_t row0;
+    reg::x1_t row1;
+    load_x1_even(row0, rows[0]);
+    load_x1_even(row1, rows[1]);
+
+    r.reg0 = _mm_unpacklo_epi64(row0.reg0, row1.reg0);
+    r.reg1 = _mm_unpackhi_epi64(row0.reg0, row1.reg0);
+  }
+
+  // see array128_impl::permute_row2
+  inline static
+  void permute_row2(reg::x2_t &r, const uint8_t *index) {
+    const __m128i idx =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(index));
+
+    __m128i row0 = _mm_shuffle_epi8(_mm_unpacklo_epi64(r.reg0, r.reg1), idx);
+    __m128i row1 = _mm_shuffle_epi8(_mm_unpackhi_epi64(r.reg0, r.reg1), idx);
+
+    r.reg0 = _mm_unpacklo_epi64(row0, row1);
+    r.reg1 = _mm_unpackhi_epi64(row0, row1);
+  }
+
+  inline static
+  void store_feature(reg::x1_t r, uint32_t *dst, ptrdiff_t pitch) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), r.reg0);
+  }
+
+  inline static
+  void store_x1(const reg::x1_t &r, uint8_t *dst) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), r.reg0);
+  }
+
+  inline static
+  void store_w4(const reg::w4_t &r, uint32_t *dst) {
+    for (int i = 0; i < 4; i += 1) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4*i), r.reg[i]);
+    }
+  }
+
+  inline static
+  void load_s1(reg::s1_t &r, const uint16_t *src) {
+    r.reg0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+  }
+
+  inline static
+  void load_w4(reg::w4_t &r, const uint32_t *src) {
+    for (int i = 0; i < 4; i += 1) {
+      r.reg[i] = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(src + 4*i));
+    }
+  }
+
+  // SSE has no unsigned byte compare, but min(a, b) == b is exactly
+  // (a >= b). Rather than spend a third instruction inverting it, p1_t holds
+  // the complement and bsel2 selects with andnot.
+  inline static
+  reg::p1_t cmp_row2(reg::x2_t a, reg::x2_t b) {
+    reg::p1_t result;
+    result.reg0 = _mm_cmpeq_epi8(_mm_min_epu8(a.reg0, b.reg1), b.reg1);
+    return result;
+  }
+
+  template <int b> static
+  reg::x1_t bsel2(reg::x1_t acc, reg::p1_t pred) {
+    const __m128i bit = _mm_set1_epi8(static_cast<char>(1 << b));
+
+    reg::x1_t result;
+    result.reg0 = _mm_or_si128(
+        _mm_andnot_si128(bit, acc.reg0),
+        _mm_andnot_si128(pred.reg0, bit));
+
+    return result;
+  }
+
+  inline static
+  void transpose_row2(reg::x2_t &r0, reg::x2_t &r1) {
+    __m128i t0 = _mm_unpacklo_epi64(r0.reg0, r1.reg0);
+    __m128i t1 = _mm_unpacklo_epi64(r0.reg1, r1.reg1);
+
+    r1.reg0 = _mm_unpackhi_epi64(r0.reg0, r1.reg0);
+    r1.reg1 = _mm_unpackhi_epi64(r0.reg1, r1.reg1);
+
+    r0.reg0 = t0;
+    r0.reg1 = t1;
+  }
+
+  // Byte interleave of the four registers. Equivalent to array128_impl's
+  // 4x4 byte transpose followed by 4x4 word transpose.
+  inline static
+  void zip4b2(reg::x1_t &r0, reg::x1_t &r1, reg::x1_t &r2, reg::x1_t &r3) {
+    __m128i lo01 = _mm_unpacklo_epi8(r0.reg0, r1.reg0);
+    __m128i lo23 = _mm_unpacklo_epi8(r2.reg0, r3.reg0);
+    __m128i hi01 = _mm_unpackhi_epi8(r0.reg0, r1.reg0);
+    __m128i hi23 = _mm_unpackhi_epi8(r2.reg0, r3.reg0);
+
+    r0.reg0 = _mm_unpacklo_epi16(lo01, lo23);
+    r1.reg0 = _mm_unpackhi_epi16(lo01, lo23);
+    r2.reg0 = _mm_unpacklo_epi16(hi01, hi23);
+    r3.reg0 = _mm_unpackhi_epi16(hi01, hi23);
+  }
+
+  // reg0 slides down one byte per half and reg1 slides up. The byte crossing
+  // over sits 2*x from the inner edge, since the other register has already
+  // been rolled x times. x is a loop counter, so after unrolling the shuffle
+  // masks fold to constants.
+  inline static
+  reg::x2_t roll_outward2(reg::x2_t r, int x) {
+    const __m128i offset = _mm_set1_epi8(static_cast<char>(2*x));
+
+    const __m128i down0 = _mm_setr_epi8(
+        1, 2, 3, 4, 5, 6, 7, -128, 9, 10, 11, 12, 13, 14, 15, -128);
+    const __m128i down1 = _mm_add_epi8(offset, _mm_setr_epi8(
+        -128, -128, -128, -128, -128, -128, -128, 0,
+        -128, -128, -128, -128, -128, -128, -128, 8));
+
+    const __m128i up0 = _mm_sub_epi8(_mm_setr_epi8(
+        7, -113, -113, -113, -113, -113, -113, -113,
+        15, -113, -113, -113, -113, -113, -113, -113), offset);
+    const __m128i up1 = _mm_setr_epi8(
+        -128, 0, 1, 2, 3, 4, 5, 6, -128, 8, 9, 10, 11, 12, 13, 14);
+
+    reg::x2_t result;
+    result.reg0 = _mm_or_si128(
+        _mm_shuffle_epi8(r.reg0, down0),
+        _mm_shuffle_epi8(r.reg1, down1));
+    result.reg1 = _mm_or_si128(
+        _mm_shuffle_epi8(r.reg0, up0),
+        _mm_shuffle_epi8(r.reg1, up1));
+
+    return result;
+  }
+
+  inline static
+  reg::x1_t fill_x1(uint8_t x) {
+    reg::x1_t result;
+    result.reg0 = _mm_set1_epi8(static_cast<char>(x));
+    return result;
+  }
+
+  inline static
+  reg::x1_t and_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm_and_si128(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t or_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm_or_si128(a.reg0, b.reg0);
+    return result;
+  }
+
+  // see array128_impl::shl_bits_x1. There are no byte shifts, so shift
+  // words and mask off the bits that crossed between bytes.
+  template <int n> static
+  reg::x1_t shl_bits_x1(const reg::x1_t &r) {
+    reg::x1_t result;
+    result.reg0 = _mm_and_si128(_mm_slli_epi16(r.reg0, n),
+        _mm_set1_epi8(static_cast<char>((0xff << n) & 0xff)));
+    return result;
+  }
+
+  template <int n> static
+  reg::x1_t shr_bits_x1(const reg::x1_t &r) {
+    reg::x1_t result;
+    result.reg0 = _mm_and_si128(_mm_srli_epi16(r.reg0, n),
+        _mm_set1_epi8(static_cast<char>(0xff >> n)));
+    return result;
+  }
+
+  // Variable byte shift. Indices below n go negative, and pshufb zeroes any
+  // lane whose index has the high bit set.
+  inline static
+  reg::x1_t shiftr_x1(const reg::x1_t &r, int n) {
+    const __m128i iota = _mm_setr_epi8(
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    reg::x1_t result;
+    result.reg0 = _mm_shuffle_epi8(r.reg0,
+        _mm_sub_epi8(iota, _mm_set1_epi8(static_cast<char>(n))));
+    return result;
+  }
+
+  template<int offset> static
+  reg::x1_t popcnt_xor_w4(
+      const reg::w4_t &left,
+      const reg::w4_t &right0,
+      const reg::w4_t &right1) {
+
+    static_assert(0 <= offset && offset < 4,
+        "popcnt_xor_w2 offset must be one of 0,1,2,3");
+
+    const __m128i ones = _mm_set1_epi8(1);
+
+    __m128i sum[4];
+    for (int l = 0; l < 4; l += 1) {
+      const __m128i &right = l >= offset ?
+        right1.reg[l-offset] : right0.reg[l+4-offset];
+
+      // byte counts, then pairwise sums into 16-bit lanes
+      __m128i count = popcnt_epi8(_mm_xor_si128(left.reg[l], right));
+      sum[l] = _mm_maddubs_epi16(count, ones);
+    }
+
+    // finish each 32-bit lane and narrow to one byte per descriptor
+    reg::x1_t result;
+    result.reg0 = _mm_packus_epi16(
+        _mm_hadd_epi16(sum[0], sum[1]),
+        _mm_hadd_epi16(sum[2], sum[3]));
+
+    return result;
+  }
+
+  inline static
+  void shift_up_w4(
+      reg::w4_t &right0,
+      reg::w4_t &right1) {
+
+    for (int i = 3; i >= 1; i -= 1) {
+      right1.reg[i] = _mm_alignr_epi8(right1.reg[i], right1.reg[i-1], 12);
+    }
+    right1.reg[0] = _mm_alignr_epi8(right1.reg[0], right0.reg[3], 12);
+
+    for (int i = 3; i >= 1; i -= 1) {
+      right0.reg[i] = _mm_alignr_epi8(right0.reg[i], right0.reg[i-1], 12);
+    }
+    right0.reg[0] = _mm_slli_si128(right0.reg[0], 4);
+  }
+
+  inline static
+  void load_x1(reg::x1_t &r, const uint8_t *src) {
+    r.reg0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+  }
+
+  // see array128_impl::load_x1_even
+  inline static
+  void load_x1_even(reg::x1_t &r, const uint8_t *src) {
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+
+    r.reg0 = _mm_packus_epi16(_mm_and_si128(lo, mask),
+        _mm_and_si128(hi, mask));
+  }
+
+  inline static
+  void store_s1(const reg::s1_t &r, uint16_t *dst) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), r.reg0);
+  }
+
+  inline static
+  reg::s1_t fill_s1(uint16_t x) {
+    reg::s1_t result;
+    result.reg0 = _mm_set1_epi16(static_cast<short>(x));
+    return result;
+  }
+
+  inline static
+  reg::x1_t min_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm_min_epu8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t adds_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm_adds_epu8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t subs_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm_subs_epu8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t zip_lo_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm_unpacklo_epi8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t zip_hi_x1(const reg::x1_t &a, const reg::x1_t &b) {
+    reg::x1_t result;
+    result.reg0 = _mm_unpackhi_epi8(a.reg0, b.reg0);
+    return result;
+  }
+
+  inline static
+  reg::x1_t shift_up_x1(const reg::x1_t &r, const reg::x1_t &prev) {
+    reg::x1_t result;
+    result.reg0 = _mm_alignr_epi8(r.reg0, prev.reg0, 15);
+    return result;
+  }
+
+  inline static
+  reg::x1_t shift_down_x1(const reg::x1_t &r, const reg::x1_t &next) {
+    reg::x1_t result;
+    result.reg0 = _mm_alignr_epi8(next.reg0, r.reg0, 1);
+    return result;
+  }
+
+  // see array128_impl::align_x1
+  template <int n> static
+  reg::x1_t align_x1(const reg::x1_t &lo, const reg::x1_t &hi) {
+    reg::x1_t result;
+    result.reg0 = _mm_alignr_epi8(hi.reg0, lo.reg0, n);
+    return result;
+  }
+
+  // Fold halves until the minimum is in byte 0, then broadcast it. There is
+  // no phminposuw before SSE4.1.
+  inline static
+  reg::x1_t hmin_x1(const reg::x1_t &r) {
+    __m128i m = _mm_min_epu8(r.reg0, _mm_shuffle_epi32(r.reg0, 0x4e));
+    m = _mm_min_epu8(m, _mm_shuffle_epi32(m, 0xb1));
+    m = _mm_min_epu8(m, _mm_srli_epi32(m, 16));
+    m = _mm_min_epu8(m, _mm_srli_epi16(m, 8));
+
+    reg::x1_t result;
+    result.reg0 = _mm_shuffle_epi8(m, _mm_setzero_si128());
+    return result;
+  }
+
+  inline static
+  void widen_x1(const reg::x1_t &r, reg::s1_t &lo, reg::s1_t &hi) {
+    lo.reg0 = _mm_unpacklo_epi8(r.reg0, _mm_setzero_si128());
+    hi.reg0 = _mm_unpackhi_epi8(r.reg0, _mm_setzero_si128());
+  }
+
+  // see array128_impl::lt_s1x2. As for bytes, b - a saturates to 0 exactly
+  // where a >= b, and the saturating pack keeps 0 and -1 as they are.
+  inline static
+  reg::x1_t lt_s1x2(
+      const reg::s1_t &a0,
+      const reg::s1_t &a1,
+      const reg::s1_t &b0,
+      const reg::s1_t &b1) {
+
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ge0 = _mm_cmpeq_epi16(_mm_subs_epu16(b0.reg0, a0.reg0), zero);
+    __m128i ge1 = _mm_cmpeq_epi16(_mm_subs_epu16(b1.reg0, a1.reg0), zero);
+
+    reg::x1_t result;
+    result.reg0 = _mm_andnot_si128(_mm_packs_epi16(ge0, ge1),
+        _mm_set1_epi8(1));
+    return result;
+  }
+
+  inline static
+  reg::s1_t add_s1(const reg::s1_t &a, const reg::s1_t &b) {
+    reg::s1_t result;
+    result.reg0 = _mm_add_epi16(a.reg0, b.reg0);
+    return result;
+  }
+
+  // SSE2 only has signed 16-bit compares. Summed path costs are at most
+  // 8*255, so they compare the same either way.
+  inline static
+  void select_min_s1(
+      reg::s1_t &best,
+      reg::s1_t &best_index,
+      const reg::s1_t &value,
+      const reg::s1_t &index) {
+
+    __m128i less = _mm_cmplt_epi16(value.reg0, best.reg0);
+
+    best.reg0 = _mm_min_epi16(value.reg0, best.reg0);
+    best_index.reg0 = _mm_or_si128(
+        _mm_and_si128(less, index.reg0),
+        _mm_andnot_si128(less, best_index.reg0));
+  }
+
+ private:
+  inline static
+  __m128i popcnt_epi8(__m128i v) {
+    const __m128i lut = _mm_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+
+    __m128i lo = _mm_and_si128(v, nibble);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+
+    return _mm_add_epi8(_mm_shuffle_epi8(lut, lo), _mm_shuffle_epi8(lut, hi));
+  }
+};
+
+} // namespace simd
+} // namespace detail
+} // namespace sgm_cpu
@@ -0,0 +1,18 @@
+#pragma once
+
+// immintrin.h for the AVX2 and AVX-512 backends. With optimisation GCC 12
+// warns about the self-initialised placeholder in _mm512_undefined_*()
+// wherever an intrinsic built on it is inlined (GCC bug 105593). The warning
+// is reported inside the header, so it is silenced here, wherever
+// immintrin.h is first included.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include <immintrin.h>
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,659 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include <detail/census_ops.hpp>
+#include <detail/path_aggregation_ops.hpp>
+#include <detail/winner_takes_all_ops.hpp>
+
+namespace sgm_cpu {
+
+template <class Arch>
+StereoSGM<Arch>::StereoSGM(
+    int width,
+    int height,
+    int disparity_size,
+    const Parameters &param) :
+  m_width(width),
+  m_height(height),
+  m_disparity_size(disparity_size),
+  m_param(param),
+  m_feature_width(width - 2*border_x()),
+  m_feature_height(height - 2*border_y()),
+  m_padded_width(0),
+  m_census_left(param.census_border),
+  m_census_right(param.census_border) {
+
+  if (!check_parameters()) {
+    return;
+  }
+
+  const int P = detail::PathAggregationOps<Arch>::patch_size();
+
+  m_padded_width = (m_feature_width + P - 1) / P * P;
+
+  const size_t row_size = static_cast<size_t>(m_disparity_size) *
+    m_padded_width;
+  // SCAN_5PATH over a thread pool keeps two rows of each of three sums
+  const size_t volume_size = is_single_sweep() ?
+    6 * row_size : m_feature_height * row_size;
+
+  const detail::PathStateLayout layout(m_padded_width, m_disparity_size);
+
+  if (!m_param.fused) {
+    const size_t cost_row_size = detail::CostVolumeLayout(m_padded_width,
+        m_disparity_size, m_param.cost_packing).row_size();
+
+    m_cost.reset(new cost_type[is_single_sweep() ?
+        cost_row_size : m_feature_height * cost_row_size]);
+  }
+  m_cost_sum.reset(new cost_sum_type[volume_size]);
+  m_path_state.reset(new uint8_t[4 * 3 * layout.path_size()]);
+
+  // the pool overloads, for as many threads as ThreadPool::global() has
+  const int n_threads =
+    static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+  m_disparity_rows.resize(n_threads * row_slot());
+  m_stripe_begin.reserve(n_threads + 1);
+}
+
+template <class Arch>
+bool StereoSGM<Arch>::check_parameters() const {
+  // the census transform's own minimum, a patch of features plus the border
+  using CensusOps = detail::CensusOps<Arch>;
+
+  if ((m_width < CensusOps::min_width()) ||
+      (m_height < CensusOps::min_height())) {
+    std::cerr << "StereoSGM: image size " << m_width << "x" << m_height <<
+      " is smaller than the minimum " << CensusOps::min_width() << "x" <<
+      CensusOps::min_height() << "\n";
+    return false;
+  }
+
+  const int multiple =
+    detail::PathAggregationOps<Arch>::disparity_multiple();
+
+  if ((m_disparity_size <= 0) || ((m_disparity_size % multiple) != 0) ||
+      (m_disparity_size > 256)) {
+    std::cerr << "StereoSGM: disparity size " << m_disparity_size <<
+      " must be a multiple of " << multiple << ", at most 256\n";
+    return false;
+  }
+
+  if ((m_param.pixel_format == PixelFormat::YUYV) &&
+      (sizeof(input_type) != 1)) {
+    std::cerr << "StereoSGM: YUYV is 8-bit, the tune takes 16-bit input\n";
+    return false;
+  }
+
+  if (m_param.min_disparity < 0) {
+    std::cerr << "StereoSGM: min disparity " << m_param.min_disparity <<
+      " must not be negative\n";
+    return false;
+  }
+
+  // the largest disparity must fit 16 bits, short of invalid_disparity
+  if (m_param.min_disparity > invalid_disparity - m_disparity_size) {
+    std::cerr << "StereoSGM: disparities up to " <<
+      m_param.min_disparity + m_disparity_size - 1 << " do not fit 16 bits\n";
+    return false;
+  }
+
+  if ((m_param.cost_packing == CostPacking::FOUR_BIT) &&
+      ((m_param.cost_clamp < 0) || (m_param.cost_clamp > 15))) {
+    std::cerr << "StereoSGM: 4-bit costs must be clamped to 0..15 (" <<
+      m_param.cost_clamp << ")\n";
+    return false;
+  }
+
+  if (detail::is_pixel_major<detail::cost_layout_t<Arch>>() &&
+      (m_param.cost_packing != CostPacking::BYTE)) {
+    std::cerr << "StereoSGM: the tune's cost layout holds byte costs only\n";
+    return false;
+  }
+
+  // the Hamming distance of 64-bit descriptors goes up to 64
+  constexpr int max_cost = detail::PathAggregationOps<Arch>::consts::max_cost;
+
+  if ((max_cost >= 64) && (m_param.cost_packing == CostPacking::SIX_BIT)) {
+    std::cerr << "StereoSGM: 6-bit costs do not hold the matching cost of "
+      "the tune's census window\n";
+    return false;
+  }
+
+  if (m_param.lr_check && (m_param.lr_max_diff < 0)) {
+    std::cerr << "StereoSGM: left-right max difference " <<
+      m_param.lr_max_diff << " must not be negative\n";
+    return false;
+  }
+
+  if ((m_param.subpixel != SubpixelFit::NONE) &&
+      (((m_param.min_disparity + m_disparity_size) << subpixel_shift) >
+       invalid_disparity)) {
+    std::cerr << "StereoSGM: subpixel disparities up to " <<
+      m_param.min_disparity + m_disparity_size << " do not fit 16 bits\n";
+    return false;
+  }
+
+  if ((m_param.P1 < 0) || (m_param.P1 > m_param.P2) ||
+      (m_param.P2 > 255 - max_cost)) {
+    std::cerr << "StereoSGM: penalties must satisfy 0 <= P1 <= P2 <= " <<
+      255 - max_cost << " (P1 = " << m_param.P1 << ", P2 = " << m_param.P2 <<
+      ")\n";
+    return false;
+  }
+
+  return true;
+}
+
+template <class Arch>
+void StereoSGM<Arch>::execute(
+    const input_type *left,
+    const input_type *right,
+    output_type *dst,
+    int src_pitch,
+    int dst_pitch) {
+
+  if (!m_cost_sum) {
+    std::cerr << "StereoSGM::execute: not configured, see the error from "
+      "the constructor\n";
+    return;
+  }
+
+  src_pitch = (src_pitch == -1) ? input_pitch() : src_pitch;
+  dst_pitch = (dst_pitch == -1) ? m_width : dst_pitch;
+
+  const int W = m_padded_width;
+
+  m_census_left.execute(left, m_width, m_height, src_pitch, W,
+      m_param.pixel_format);
+  m_census_right.execute(right, m_width, m_height, src_pitch, W,
+      m_param.pixel_format);
+
+  if (is_single_sweep()) {
+    execute_single_sweep(m_census_left.get_output(),
+        m_census_right.get_output(), dst, dst_pitch);
+  } else {
+    execute_two_sweeps(m_census_left.get_output(),
+        m_census_right.get_output(), dst, dst_pitch);
+  }
+
+  store_border_rows(dst, dst_pitch);
+}
+
+// Two sweeps over the rows. The first sums the paths arriving from above
+// and from the left, and keeps the matching cost unless fused. The second
+// adds the paths from below and from the right, which completes each row in
+// turn for the winner-takes-all.
+template <class Arch>
+void StereoSGM<Arch>::execute_two_sweeps(
+    const feature_type *left,
+    const feature_type *right,
+    output_type *dst,
+    int dst_pitch) {
+
+  using PathOps = detail::PathAggregationOps<Arch>;
+
+  const int W = m_padded_width;
+  const int D = m_disparity_size;
+  const int D0 = m_param.min_disparity;
+  const int P1 = m_param.P1;
+  const int P2 = m_param.P2;
+  const bool fused = m_param.fused;
+  const CostPacking packing = m_param.cost_packing;
+
+  const size_t row_size = static_cast<size_t>(D) * W;
+  const size_t cost_row_size =
+    detail::CostVolumeLayout(W, D, packing).row_size();
+
+  const int n_vertical = (m_param.path_type == PathType::SCAN_8PATH) ? 3 : 1;
+
+  const detail::PathStateLayout layout(W, D);
+  uint8_t *prev = m_path_state.get();
+  uint8_t *cur = prev + 3*layout.path_size();
+
+  layout.reset(prev, n_vertical);
+  layout.reset(cur, n_vertical);
+
+  for (int y = 0; y < m_feature_height; y += 1) {
+    cost_sum_type *sum = m_cost_sum.get() + y*row_size;
+
+    std::fill(sum, sum + row_size, 0);
+
+    if (fused) {
+      PathOps::execute_fused_row(left + y*W, right + y*W, W,
+          m_feature_width, D, P1, P2, n_vertical, prev, cur, true, false,
+          sum, D0);
+      std::swap(prev, cur);
+      continue;
+    }
+
+    const detail::CostVolume cost(m_cost.get() + y*cost_row_size, W,
+        packing, m_param.cost_clamp);
+
+    PathOps::execute_cost_row(left + y*W, right + y*W, W, D, cost, D0);
+
+    PathOps::execute_vertical_row(cost, W, m_feature_width, D, P1, P2,
+        n_vertical, prev, cur, sum);
+    std::swap(prev, cur);
+
+    PathOps::execute_horizontal_row(cost, W, m_feature_width, D, P1, P2,
+        false, sum);
+  }
+
+  layout.reset(prev, n_vertical);
+  layout.reset(cur, n_vertical);
+
+  for (int y = m_feature_height - 1; y >= 0; y -= 1) {
+    cost_sum_type *sum = m_cost_sum.get() + y*row_size;
+
+    if (fused) {
+      PathOps::execute_fused_row(left + y*W, right + y*W, W,
+          m_feature_width, D, P1, P2, n_vertical, prev, cur, false, true,
+          sum, D0);
+      std::swap(prev, cur);
+    } else {
+      const detail::ConstCostVolume cost(m_cost.get() + y*cost_row_size, W,
+          packing, m_param.cost_clamp);
+
+      PathOps::execute_vertical_row(cost, W, m_feature_width, D, P1, P2,
+          n_vertical, prev, cur, sum);
+      std::swap(prev, cur);
+
+      PathOps::execute_horizontal_row(cost, W, m_feature_width, D, P1, P2,
+          true, sum);
+    }
+
+    select_row(sum, m_disparity_rows.data(), y, dst, dst_pitch);
+  }
+}
+
+// Every path arrives from above or along the row, so each row is complete
+// once it has been aggregated, and only that row's cost and sums are kept.
+template <class Arch>
+void StereoSGM<Arch>::execute_single_sweep(
+    const feature_type *left,
+    const feature_type *right,
+    output_type *dst,
+    int dst_pitch) {
+
+  using PathOps = detail::PathAggregationOps<Arch>;
+
+  const int W = m_padded_width;
+  const int D = m_disparity_size;
+  const int D0 = m_param.min_disparity;
+  const int P1 = m_param.P1;
+  const int P2 = m_param.P2;
+  const CostPacking packing = m_param.cost_packing;
+
+  const size_t row_size = static_cast<size_t>(D) * W;
+
+  const detail::PathStateLayout layout(W, D);
+  uint8_t *prev = m_path_state.get();
+  uint8_t *cur = prev + 3*layout.path_size();
+
+  layout.reset(prev, 3);
+  layout.reset(cur, 3);
+
+  cost_sum_type *sum = m_cost_sum.get();
+
+  for (int y = 0; y < m_feature_height; y += 1) {
+    std::fill(sum, sum + row_size, 0);
+
+    if (m_param.fused) {
+      PathOps::execute_fused_row(left + y*W, right + y*W, W,
+          m_feature_width, D, P1, P2, 3, prev, cur, true, true, sum, D0);
+    } else {
+      const detail::CostVolume cost(m_cost.get(), W, packing,
+          m_param.cost_clamp);
+
+      PathOps::execute_cost_row(left + y*W, right + y*W, W, D, cost, D0);
+
+      PathOps::execute_vertical_row(cost, W, m_feature_width, D, P1, P2,
+          3, prev, cur, sum);
+      PathOps::execute_horizontal_row(cost, W, m_feature_width, D, P1, P2,
+          false, sum);
+      PathOps::execute_horizontal_row(cost, W, m_feature_width, D, P1, P2,
+          true, sum);
+    }
+    std::swap(prev, cur);
+
+    select_row(sum, m_disparity_rows.data(), y, dst, dst_pitch);
+  }
+}
+
+template <class Arch>
+void StereoSGM<Arch>::execute(
+    const input_type *left,
+    const input_type *right,
+    output_type *dst,
+    int src_pitch,
+    int dst_pitch,
+    ThreadPool &pool) {
+
+  if (!m_cost_sum) {
+    std::cerr << "StereoSGM::execute: not configured, see the error from "
+      "the constructor\n";
+    return;
+  }
+
+  src_pitch = (src_pitch == -1) ? input_pitch() : src_pitch;
+  dst_pitch = (dst_pitch == -1) ? m_width : dst_pitch;
+
+  const int W = m_padded_width;
+
+  CensusTransform<Arch>::execute_pair(m_census_left, m_census_right,
+      left, right, m_width, m_height, src_pitch, W, pool,
+      m_param.pixel_format);
+
+  if (is_single_sweep()) {
+    execute_single_sweep(m_census_left.get_output(),
+        m_census_right.get_output(), dst, dst_pitch, pool);
+  } else {
+    execute_two_sweeps(m_census_left.get_output(),
+        m_census_right.get_output(), dst, dst_pitch, pool);
+  }
+
+  store_border_rows(dst, dst_pitch);
+}
+
+// The cost and the paths along each row first, a row per task. Then the
+// sweeps down and up the image step together, a row each per step, so they
+// never share a row of sums. Each row is split into column stripes, which
+// only need the previous row of their sweep to be complete.
+template <class Arch>
+void StereoSGM<Arch>::execute_two_sweeps(
+    const feature_type *left,
+    const feature_type *right,
+    output_type *dst,
+    int dst_pitch,
+    ThreadPool &pool) {
+
+  using PathOps = detail::PathAggregationOps<Arch>;
+
+  const int W = m_padded_width;
+  const int H = m_feature_height;
+  const int D = m_disparity_size;
+  const int D0 = m_param.min_disparity;
+  const int P1 = m_param.P1;
+  const int P2 = m_param.P2;
+  const bool fused = m_param.fused;
+  const CostPacking packing = m_param.cost_packing;
+
+  const size_t row_size = static_cast<size_t>(D) * W;
+  const size_t cost_row_size =
+    detail::CostVolumeLayout(W, D, packing).row_size();
+
+  const int n_vertical = (m_param.path_type == PathType::SCAN_8PATH) ? 3 : 1;
+
+  pool.parallel_for(H, [&](int y) {
+    cost_sum_type *sum = m_cost_sum.get() + y*row_size;
+
+    std::fill(sum, sum + row_size, 0);
+
+    if (fused) {
+      PathOps::execute_fused_horizontal_row(left + y*W, right + y*W, W,
+          m_feature_width, D, P1, P2, false, sum, D0);
+      PathOps::execute_fused_horizontal_row(left + y*W, right + y*W, W,
+          m_feature_width, D, P1, P2, true, sum, D0);
+      return;
+    }
+
+    const detail::CostVolume cost(m_cost.get() + y*cost_row_size, W,
+        packing, m_param.cost_clamp);
+
+    PathOps::execute_cost_row(left + y*W, right + y*W, W, D, cost, D0);
+
+    PathOps::execute_horizontal_row(cost, W, m_feature_width, D, P1, P2,
+        false, sum);
+    PathOps::execute_horizontal_row(cost, W, m_feature_width, D, P1, P2,
+        true, sum);
+  });
+
+  const int n_stripes =
+    stripe_spans((pool.size() + 1) / 2, m_stripe_begin);
+  const std::vector<int> &x_begin = m_stripe_begin;
+
+  const detail::PathStateLayout layout(W, D);
+  uint8_t *down_prev = m_path_state.get();
+  uint8_t *down_cur = down_prev + 3*layout.path_size();
+  uint8_t *up_prev = down_cur + 3*layout.path_size();
+  uint8_t *up_cur = up_prev + 3*layout.path_size();
+
+  for (uint8_t *state : { down_prev, down_cur, up_prev, up_cur }) {
+    layout.reset(state, n_vertical);
+  }
+
+  auto vertical_stripe = [&](int y, const uint8_t *prev, uint8_t *cur,
+      int i) {
+    cost_sum_type *sum = m_cost_sum.get() + y*row_size;
+
+    if (fused) {
+      PathOps::execute_fused_vertical_stripe(left + y*W, right + y*W, W,
+          m_feature_width, D, P1, P2, n_vertical, prev, cur, x_begin[i],
+          x_begin[i+1], sum, D0);
+    } else {
+      const detail::ConstCostVolume cost(m_cost.get() + y*cost_row_size, W,
+          packing, m_param.cost_clamp);
+
+      PathOps::execute_vertical_stripe(cost, W, m_feature_width, D, P1, P2,
+          n_vertical, prev, cur, x_begin[i], x_begin[i+1], sum);
+    }
+  };
+
+  for (int t = 0; t < H; t += 1) {
+    const int y_down = t;
+    const int y_up = H - 1 - t;
+
+    if (y_down != y_up) {
+      pool.parallel_for(2*n_stripes, [&](int i) {
+        if (i < n_stripes) {
+          vertical_stripe(y_down, down_prev, down_cur, i);
+        } else {
+          vertical_stripe(y_up, up_prev, up_cur, i - n_stripes);
+        }
+      });
+    } else {
+      // the middle row of an odd height, one sweep after the other
+      pool.parallel_for(n_stripes, [&](int i) {
+        vertical_stripe(y_down, down_prev, down_cur, i);
+      });
+      pool.parallel_for(n_stripes, [&](int i) {
+        vertical_stripe(y_up, up_prev, up_cur, i);
+      });
+    }
+
+    std::swap(down_prev, down_cur);
+    std::swap(up_prev, up_cur);
+  }
+
+  const int n_chunks = std::min(pool.size(), H);
+
+  const size_t slot = row_slot();
+
+  // only for a pool larger than the constructor allowed for
+  if (m_disparity_rows.size() < n_chunks * slot) {
+    m_disparity_rows.resize(n_chunks * slot);
+  }
+
+  pool.parallel_for(n_chunks, [&](int c) {
+    output_type *row = m_disparity_rows.data() + c*slot;
+
+    for (int y = c*H / n_chunks; y < (c + 1)*H / n_chunks; y += 1) {
+      select_row(m_cost_sum.get() + y*row_size, row, y, dst, dst_pitch);
+    }
+  });
+}
+
+// Each step aggregates a row, with the stripes of the paths from above and
+// the two paths along the row as separate tasks. The paths along the row
+// accumulate into sums of their own, so no two tasks share a sum, and they
+// are added up in the next step together with the winner-takes-all. The
+// tasks compute the cost themselves, whether or not fused is set, and
+// saturate it as FOUR_BIT would store it.
+template <class Arch>
+void StereoSGM<Arch>::execute_single_sweep(
+    const feature_type *left,
+    const feature_type *right,
+    output_type *dst,
+    int dst_pitch,
+    ThreadPool &pool) {
+
+  using PathOps = detail::PathAggregationOps<Arch>;
+
+  const int W = m_padded_width;
+  const int H = m_feature_height;
+  const int D = m_disparity_size;
+  const int D0 = m_param.min_disparity;
+  const int P1 = m_param.P1;
+  const int P2 = m_param.P2;
+  // the volume the tasks stand in for, which fused does not store
+  const detail::ConstCostVolume stored(nullptr, W,
+      m_param.fused ? CostPacking::BYTE : m_param.cost_packing,
+      m_param.cost_clamp);
+
+  const size_t row_size = static_cast<size_t>(D) * W;
+
+  const int n_stripes = stripe_spans(pool.size(), m_stripe_begin);
+  const std::vector<int> &x_begin = m_stripe_begin;
+
+  const detail::PathStateLayout layout(W, D);
+  uint8_t *prev = m_path_state.get();
+  uint8_t *cur = prev + 3*layout.path_size();
+
+  layout.reset(prev, 3);
+  layout.reset(cur, 3);
+
+  // for rows alternately: vertical, left to right, right to left
+  auto sums = [&](int y, int k) {
+    return m_cost_sum.get() + (3*(y % 2) + k)*row_size;
+  };
+
+  for (int y = 0; y <= H; y += 1) {
+    const int n_tasks = ((y < H) ? n_stripes + 2 : 0) + ((y > 0) ? 1 : 0);
+
+    pool.parallel_for(n_tasks, [&](int i) {
+      if ((y < H) && (i < n_stripes)) {
+        cost_sum_type *sum = sums(y, 0);
+
+        for (int d = 0; d < D; d += 1) {
+          std::fill(sum + d*W + x_begin[i], sum + d*W + x_begin[i+1], 0);
+        }
+
+        PathOps::execute_fused_vertical_stripe(left + y*W, right + y*W, W,
+            m_feature_width, D, P1, P2, 3, prev, cur, x_begin[i],
+            x_begin[i+1], sum, D0, stored);
+
+      } else if ((y < H) && (i < n_stripes + 2)) {
+        const bool reverse = (i == n_stripes + 1);
+        cost_sum_type *sum = sums(y, reverse ? 2 : 1);
+
+        std::fill(sum, sum + row_size, 0);
+
+        PathOps::execute_fused_horizontal_row(left + y*W, right + y*W, W,
+            m_feature_width, D, P1, P2, reverse, sum, D0, stored);
+
+      } else {
+        cost_sum_type *sum = sums(y - 1, 0);
+
+        PathOps::execute_sum_row(sums(y - 1, 1), row_size, sum);
+        PathOps::execute_sum_row(sums(y - 1, 2), row_size, sum);
+
+        select_row(sum, m_disparity_rows.data(), y - 1, dst, dst_pitch);
+      }
+    });
+
+    std::swap(prev, cur);
+  }
+}
+
+template <class Arch>
+int StereoSGM<Arch>::stripe_spans(
+    int n_stripes,
+    std::vector<int> &x_begin) const {
+
+  const int P = detail::PathAggregationOps<Arch>::patch_size();
+  const int n_patches = m_padded_width / P;
+
+  n_stripes = std::max(1, std::min(n_stripes, n_patches));
+
+  x_begin.resize(n_stripes + 1);
+  for (int i = 0; i <= n_stripes; i += 1) {
+    x_begin[i] = (i * n_patches / n_stripes) * P;
+  }
+
+  return n_stripes;
+}
+
+template <class Arch>
+void StereoSGM<Arch>::select_row(
+    const cost_sum_type *sum,
+    output_type *row,
+    int y,
+    output_type *dst,
+    int dst_pitch) const {
+
+  using WtaOps = detail::WinnerTakesAllOps<Arch>;
+
+  const int W = m_padded_width;
+  const int D = m_disparity_size;
+
+  if (m_param.subpixel == SubpixelFit::NONE) {
+    WtaOps::execute_row(sum, W, D, row);
+  } else {
+    WtaOps::execute_subpixel_row(sum, W, D, m_param.subpixel, subpixel_shift,
+        row);
+  }
+
+  if (m_param.lr_check) {
+    output_type *right = row + W;
+
+    WtaOps::execute_right_row(sum, W, m_feature_width, D,
+        m_param.min_disparity, invalid_disparity, right);
+    WtaOps::execute_lr_check(row, right, m_feature_width,
+        m_param.min_disparity, m_param.lr_max_diff, invalid_disparity,
+        output_shift());
+  }
+
+  store_row(row, y, dst, dst_pitch);
+}
+
+template <class Arch>
+void StereoSGM<Arch>::store_row(
+    const output_type *row,
+    int y,
+    output_type *dst,
+    int dst_pitch) const {
+
+  const int x0 = border_x();
+
+  output_type *dst_row = dst + (y + border_y())*dst_pitch;
+
+  std::fill(dst_row, dst_row + x0, 0);
+  const int d_min = m_param.min_disparity << output_shift();
+  std::transform(row, row + m_feature_width, dst_row + x0,
+      [d_min](output_type d) {
+        return (d == invalid_disparity) ?
+          d : static_cast<output_type>(d + d_min);
+      });
+  std::fill(dst_row + x0 + m_feature_width, dst_row + m_width, 0);
+}
+
+template <class Arch>
+void StereoSGM<Arch>::store_border_rows(
+    output_type *dst,
+    int dst_pitch) const {
+
+  const int y0 = border_y();
+
+  for (int y = 0; y < m_height; y += 1) {
+    if ((y < y0) || (y >= y0 + m_feature_height)) {
+      std::fill(dst + y*dst_pitch, dst + y*dst_pitch + m_width, 0);
+    }
+  }
+}
+
+} // sgm_cpu
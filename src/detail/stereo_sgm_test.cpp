@@ -0,0 +1,666 @@
+#include <random>
+#include <iostream>
+
+#include <stereo_sgm.hpp>
+
+#include <gtest/gtest.h>
+
+#include "test_tunes.hpp"
+#include "test_util.hpp"
+
+namespace sgm_cpu {
+namespace test {
+
+template <class Tune>
+class StereoSGMTest : public ::testing::Test {};
+
+TYPED_TEST_SUITE(StereoSGMTest, TestTunes);
+
+template <class Tune>
+static void check_reference(PathType path_type, bool fused) {
+  std::minstd_rand0 rng;
+
+  // feature width deliberately not a multiple of any patch size
+  int W = 8 + 100;
+  int H = 6 + 24;
+  int D = 64;
+
+  std::vector<uint8_t> left = random_patch(W, H, rng);
+  std::vector<uint8_t> right = random_patch(W, H, rng);
+
+  std::vector<uint16_t> reference =
+    reference_sgm(left.data(), right.data(), W, H, D, 10, 120, path_type);
+
+  std::vector<uint16_t> output(W*H, 0xffff);
+
+  typename StereoSGM<Tune>::Parameters param;
+  param.path_type = path_type;
+  param.fused = fused;
+
+  StereoSGM<Tune> sgm(W, H, D, param);
+  sgm.execute(reinterpret_cast<char *>(left.data()),
+      reinterpret_cast<char *>(right.data()), output.data());
+
+  for (int y = 0; y < H; y += 1) {
+    for (int x = 0; x < W; x += 1) {
+      ASSERT_EQ(output[y*W + x], reference[y*W + x])
+        << "x = " << x << ", y = " << y << "\n";
+    }
+  }
+}
+
+TYPED_TEST(StereoSGMTest, Reference4Path) {
+  check_reference<TypeParam>(PathType::SCAN_4PATH, false);
+}
+
+TYPED_TEST(StereoSGMTest, Reference8Path) {
+  check_reference<TypeParam>(PathType::SCAN_8PATH, false);
+}
+
+TYPED_TEST(StereoSGMTest, Reference5Path) {
+  check_reference<TypeParam>(PathType::SCAN_5PATH, false);
+}
+
+TYPED_TEST(StereoSGMTest, Fused4Path) {
+  check_reference<TypeParam>(PathType::SCAN_4PATH, true);
+}
+
+TYPED_TEST(StereoSGMTest, Fused8Path) {
+  check_reference<TypeParam>(PathType::SCAN_8PATH, true);
+}
+
+TYPED_TEST(StereoSGMTest, Fused5Path) {
+  check_reference<TypeParam>(PathType::SCAN_5PATH, true);
+}
+
+// Every mode over pools of a few sizes. The feature height is odd, so the
+// sweeps down and up meet on a row.
+TYPED_TEST(StereoSGMTest, Threaded) {
+  std::minstd_rand0 rng;
+
+  int W = 8 + 100;
+  int H = 6 + 25;
+  int D = 64;
+
+  std::vector<uint8_t> left = random_patch(W, H, rng);
+  std::vector<uint8_t> right = random_patch(W, H, rng);
+
+  for (PathType path_type : { PathType::SCAN_4PATH, PathType::SCAN_8PATH,
+      PathType::SCAN_5PATH }) {
+
+    std::vector<uint16_t> reference =
+      reference_sgm(left.data(), right.data(), W, H, D, 10, 120, path_type);
+
+    for (bool fused : { false, true }) {
+      typename StereoSGM<TypeParam>::Parameters param;
+      param.path_type = path_type;
+      param.fused = fused;
+
+      StereoSGM<TypeParam> sgm(W, H, D, param);
+
+      for (int n_threads : { 1, 3, 8 }) {
+        ThreadPool pool(n_threads);
+
+        std::vector<uint16_t> output(W*H, 0xffff);
+        sgm.execute(reinterpret_cast<char *>(left.data()),
+            reinterpret_cast<char *>(right.data()), output.data(), -1, -1,
+            pool);
+
+        for (int i = 0; i < W*H; i += 1) {
+          ASSERT_EQ(output[i], reference[i]) << "i = " << i <<
+            ", path_type = " << static_cast<int>(path_type) <<
+            ", fused = " << fused << ", n_threads = " << n_threads << "\n";
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(StereoSGMTest, ConstantShift) {
+  std::minstd_rand0 rng;
+
+  int W = 160;
+  int H = 60;
+  int D = 64;
+  int shift = 11;
+
+  // disparity = shift everywhere
+  auto [left, right] = shifted_pair(W, H, shift, rng);
+
+  std::vector<uint16_t> output(W*H);
+
+  StereoSGM<TypeParam> sgm(W, H, D);
+  sgm.execute(reinterpret_cast<char *>(left.data()),
+      reinterpret_cast<char *>(right.data()), output.data());
+
+  for (int y = 3; y < H-3; y += 1) {
+    for (int x = 4 + shift; x < W-4; x += 1) {
+      ASSERT_EQ(output[y*W + x], shift) << "x = " << x << ", y = " << y << "\n";
+    }
+  }
+}
+
+// Other census windows move the border, the disparities stay the same. So
+// do other input widths.
+template <class Tune>
+static void check_constant_shift(std::minstd_rand0 &rng) {
+  using Window = typename Tune::census::window;
+
+  int W = 160;
+  int H = 60;
+  int D = 64;
+  int shift = 11;
+
+  using input_type = typename StereoSGM<Tune>::input_type;
+
+  // 8-bit, or 12-bit for 16-bit input
+  const unsigned range = (sizeof(input_type) == 1) ? 0xff : 0xfff;
+
+  auto [left, right] = shifted_pair<input_type>(W, H, shift, rng, range);
+
+  std::vector<uint16_t> output(W*H, 0xffff);
+
+  StereoSGM<Tune> sgm(W, H, D);
+  sgm.execute(left.data(), right.data(), output.data());
+
+  const int bx = Window::width / 2;
+  const int by = Window::height / 2;
+
+  for (int y = 0; y < H; y += 1) {
+    for (int x = 0; x < W; x += 1) {
+      bool border = (x < bx) || (x >= W - bx) || (y < by) || (y >= H - by);
+      if (border) {
+        ASSERT_EQ(output[y*W + x], 0) << "x = " << x << ", y = " << y;
+      } else if (x >= bx + shift) {
+        ASSERT_EQ(output[y*W + x], shift) << "x = " << x << ", y = " << y;
+      }
+    }
+  }
+}
+
+TYPED_TEST(StereoSGMTest, ConstantShiftWindows) {
+  std::minstd_rand0 rng;
+
+  check_constant_shift<WindowTune<TypeParam, CensusWindow5x5>>(rng);
+  check_constant_shift<WindowTune<TypeParam, CensusWindow7x7>>(rng);
+  check_constant_shift<WindowTune<TypeParam, CensusWindow11x9>>(rng);
+}
+
+TYPED_TEST(StereoSGMTest, ConstantShiftWideInput) {
+  std::minstd_rand0 rng;
+
+  check_constant_shift<WideInputTune<TypeParam>>(rng);
+  check_constant_shift<WideInputTune<TypeParam, CensusWindow5x5>>(rng);
+}
+
+// With a full size census, disparities reach the top and bottom rows, and
+// the columns at the left and right edges
+TYPED_TEST(StereoSGMTest, CensusBorder) {
+  std::minstd_rand0 rng;
+
+  int W = 160;
+  int H = 60;
+  int D = 64;
+  int shift = 11;
+
+  auto [left, right] = shifted_pair(W, H, shift, rng);
+
+  using Parameters = typename StereoSGM<TypeParam>::Parameters;
+
+  Parameters param;
+  param.census_border = CensusBorder::REPLICATE;
+
+  std::vector<uint16_t> output(W*H, 0xffff);
+  StereoSGM<TypeParam> sgm(W, H, D, param);
+  sgm.execute(reinterpret_cast<char *>(left.data()),
+      reinterpret_cast<char *>(right.data()), output.data());
+
+  // the right edge windows read past the end of the shifted copy
+  for (int y = 0; y < H; y += 1) {
+    for (int x = shift; x < W - 4; x += 1) {
+      ASSERT_EQ(output[y*W + x], shift) << "x = " << x << ", y = " << y;
+    }
+  }
+}
+
+// A shift beyond the disparity range is found with min_disparity, the
+// offset need not be a multiple of the patch size
+TYPED_TEST(StereoSGMTest, MinDisparity) {
+  std::minstd_rand0 rng;
+
+  int W = 160;
+  int H = 60;
+  int D = 64;
+  int shift = 75;
+  int min_disparity = 37;
+
+  auto [left, right] = shifted_pair(W, H, shift, rng);
+
+  using Parameters = typename StereoSGM<TypeParam>::Parameters;
+
+  for (bool fused : { false, true }) {
+    Parameters param;
+    param.fused = fused;
+    param.min_disparity = min_disparity;
+
+    std::vector<uint16_t> output(W*H, 0xffff);
+    StereoSGM<TypeParam> sgm(W, H, D, param);
+    sgm.execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), output.data());
+
+    for (int y = 3; y < H-3; y += 1) {
+      for (int x = 4 + shift; x < W-4; x += 1) {
+        ASSERT_EQ(output[y*W + x], shift) << "x = " << x << ", y = " << y <<
+          ", fused = " << fused;
+      }
+    }
+  }
+}
+
+// The largest disparity, min_disparity + D - 1, must stay below
+// invalid_disparity
+TYPED_TEST(StereoSGMTest, MinDisparityRange) {
+  std::minstd_rand0 rng;
+
+  int W = 72;
+  int H = 40;
+  int D = 64;
+
+  std::vector<uint8_t> left = random_patch(W, H, rng);
+  std::vector<uint8_t> right = random_patch(W, H, rng);
+
+  using Parameters = typename StereoSGM<TypeParam>::Parameters;
+
+  for (int min_disparity : { 0xffff - D, 0xffff - D + 1 }) {
+    Parameters param;
+    param.min_disparity = min_disparity;
+
+    std::vector<uint16_t> output(W*H, 0x1234);
+    StereoSGM<TypeParam> sgm(W, H, D, param);
+    sgm.execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), output.data());
+
+    // accepted, the interior is written
+    const bool valid = (min_disparity + D <= 0xffff);
+    ASSERT_EQ(output[(H/2)*W + W/2] != 0x1234, valid) <<
+      "min_disparity = " << min_disparity;
+  }
+}
+
+// SIX_BIT costs are exact, so the disparities are those of bytes. FOUR_BIT
+// saturates them, which still finds a clean shift.
+TYPED_TEST(StereoSGMTest, CostPacking) {
+  std::minstd_rand0 rng;
+
+  int W = 160;
+  int H = 60;
+  int D = 64;
+  int shift = 11;
+
+  auto [left, right] = shifted_pair(W, H, shift, rng);
+
+  using Parameters = typename StereoSGM<TypeParam>::Parameters;
+
+  for (PathType path_type : { PathType::SCAN_4PATH, PathType::SCAN_8PATH,
+      PathType::SCAN_5PATH }) {
+    Parameters param;
+    param.path_type = path_type;
+
+    std::vector<uint16_t> reference(W*H);
+    StereoSGM<TypeParam> bytes(W, H, D, param);
+    bytes.execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), reference.data());
+
+    for (CostPacking packing : { CostPacking::SIX_BIT,
+        CostPacking::FOUR_BIT }) {
+      param.cost_packing = packing;
+
+      std::vector<uint16_t> output(W*H, 0xffff);
+      StereoSGM<TypeParam> sgm(W, H, D, param);
+      sgm.execute(reinterpret_cast<char *>(left.data()),
+          reinterpret_cast<char *>(right.data()), output.data());
+
+      for (int y = 3; y < H-3; y += 1) {
+        for (int x = 4 + shift; x < W-4; x += 1) {
+          ASSERT_EQ(output[y*W + x], shift) << "x = " << x << ", y = " << y <<
+            ", packing = " << static_cast<int>(packing);
+        }
+      }
+
+      if (packing == CostPacking::SIX_BIT) {
+        ASSERT_EQ(output, reference) <<
+          "path_type = " << static_cast<int>(path_type);
+      }
+    }
+
+    // over a pool, clamped as serially, even where the clamp takes over
+    for (int clamp : { 15, 4 }) {
+      param.cost_packing = CostPacking::FOUR_BIT;
+      param.cost_clamp = clamp;
+
+      StereoSGM<TypeParam> sgm(W, H, D, param);
+
+      std::vector<uint16_t> serial(W*H);
+      sgm.execute(reinterpret_cast<char *>(left.data()),
+          reinterpret_cast<char *>(right.data()), serial.data());
+
+      ThreadPool pool(3);
+
+      std::vector<uint16_t> threaded(W*H);
+      sgm.execute(reinterpret_cast<char *>(left.data()),
+          reinterpret_cast<char *>(right.data()), threaded.data(), -1, -1,
+          pool);
+
+      ASSERT_EQ(threaded, serial) << "path_type = " <<
+        static_cast<int>(path_type) << ", clamp = " << clamp;
+    }
+  }
+}
+
+// Cost layouts move the volume around, the disparities stay the same
+template <class Layout, class Tune>
+static void check_cost_layout(std::minstd_rand0 &rng) {
+  int W = 160;
+  int H = 60;
+  int D = 64;
+
+  std::vector<uint8_t> left = random_patch(W, H, rng);
+  std::vector<uint8_t> right = random_patch(W, H, rng);
+
+  for (PathType path_type : { PathType::SCAN_4PATH, PathType::SCAN_8PATH,
+      PathType::SCAN_5PATH }) {
+    typename StereoSGM<Tune>::Parameters param;
+    param.path_type = path_type;
+
+    std::vector<uint16_t> expected(W*H);
+    StereoSGM<Tune> planes(W, H, D, param);
+    planes.execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), expected.data());
+
+    typename StereoSGM<LayoutTune<Tune, Layout>>::Parameters layout_param;
+    layout_param.path_type = path_type;
+
+    std::vector<uint16_t> output(W*H, 0xffff);
+    StereoSGM<LayoutTune<Tune, Layout>> sgm(W, H, D, layout_param);
+    sgm.execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), output.data());
+
+    ASSERT_EQ(output, expected) << "path_type = " <<
+      static_cast<int>(path_type);
+  }
+}
+
+TYPED_TEST(StereoSGMTest, CostLayouts) {
+  std::minstd_rand0 rng;
+
+  check_cost_layout<CostLayoutTiled, TypeParam>(rng);
+  check_cost_layout<CostLayoutInterleaved, TypeParam>(rng);
+}
+
+// The check keeps a clean shift and drops the left pixels with nothing to
+// match, and only ever replaces a disparity by invalid_disparity, serial
+// or over a pool.
+TYPED_TEST(StereoSGMTest, LeftRightCheck) {
+  std::minstd_rand0 rng;
+
+  int W = 160;
+  int H = 60;
+  int D = 64;
+  int shift = 19;
+  int min_disparity = 7;
+
+  auto [left, right] = shifted_pair(W, H, shift, rng);
+
+  using SGM = StereoSGM<TypeParam>;
+  using Parameters = typename SGM::Parameters;
+
+  for (PathType path_type : { PathType::SCAN_4PATH, PathType::SCAN_8PATH,
+      PathType::SCAN_5PATH }) {
+
+    Parameters param;
+    param.path_type = path_type;
+    param.min_disparity = min_disparity;
+
+    std::vector<uint16_t> unchecked(W*H);
+    SGM(W, H, D, param).execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), unchecked.data());
+
+    param.lr_check = true;
+    SGM sgm(W, H, D, param);
+
+    std::vector<uint16_t> output(W*H);
+    sgm.execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), output.data());
+
+    for (int y = 3; y < H-3; y += 1) {
+      for (int x = 4; x < W-4; x += 1) {
+        const uint16_t d = output[y*W + x];
+
+        if (x < 4 + min_disparity) {
+          ASSERT_EQ(d, SGM::invalid_disparity) << "x = " << x << ", y = " << y;
+        } else if (x >= 4 + shift) {
+          ASSERT_EQ(d, shift) << "x = " << x << ", y = " << y;
+        } else if (d != SGM::invalid_disparity) {
+          ASSERT_EQ(d, unchecked[y*W + x]) << "x = " << x << ", y = " << y;
+        }
+      }
+    }
+
+    ThreadPool pool(3);
+
+    std::vector<uint16_t> threaded(W*H);
+    sgm.execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), threaded.data(), -1, -1,
+        pool);
+
+    ASSERT_EQ(threaded, output) << "path_type = " <<
+      static_cast<int>(path_type);
+  }
+}
+
+// A clean shift has its minimum at the shift, so the fit only moves it
+// within half a disparity. The left-right check and threads work on the
+// fixed point disparities as on whole ones.
+TYPED_TEST(StereoSGMTest, Subpixel) {
+  std::minstd_rand0 rng;
+
+  int W = 160;
+  int H = 60;
+  int D = 64;
+  int shift = 19;
+  int min_disparity = 7;
+
+  auto [left, right] = shifted_pair(W, H, shift, rng);
+
+  using SGM = StereoSGM<TypeParam>;
+  using Parameters = typename SGM::Parameters;
+
+  const int S = SGM::subpixel_scale;
+
+  for (SubpixelFit fit : { SubpixelFit::PARABOLA, SubpixelFit::EQUIANGULAR }) {
+    for (PathType path_type : { PathType::SCAN_8PATH, PathType::SCAN_5PATH }) {
+      for (bool lr_check : { false, true }) {
+        Parameters param;
+        param.path_type = path_type;
+        param.min_disparity = min_disparity;
+        param.lr_check = lr_check;
+        param.subpixel = fit;
+
+        SGM sgm(W, H, D, param);
+
+        std::vector<uint16_t> output(W*H);
+        sgm.execute(reinterpret_cast<char *>(left.data()),
+            reinterpret_cast<char *>(right.data()), output.data());
+
+        for (int y = 3; y < H-3; y += 1) {
+          for (int x = 4 + shift; x < W-4; x += 1) {
+            const int d = output[y*W + x];
+            ASSERT_LE(std::abs(d - shift*S), S/2) << "x = " << x <<
+              ", y = " << y << ", fit = " << static_cast<int>(fit) <<
+              ", lr_check = " << lr_check;
+          }
+          for (int x = 4; lr_check && (x < 4 + min_disparity); x += 1) {
+            ASSERT_EQ(output[y*W + x], SGM::invalid_disparity);
+          }
+        }
+
+        ThreadPool pool(3);
+
+        std::vector<uint16_t> threaded(W*H);
+        sgm.execute(reinterpret_cast<char *>(left.data()),
+            reinterpret_cast<char *>(right.data()), threaded.data(), -1, -1,
+            pool);
+
+        ASSERT_EQ(threaded, output);
+      }
+    }
+  }
+
+  // the disparities must fit 16 bits with their fraction
+  Parameters param;
+  param.min_disparity = 4096 - D + 1;
+  param.subpixel = SubpixelFit::PARABOLA;
+
+  std::vector<uint16_t> output(W*H, 1);
+  SGM(W, H, D, param).execute(reinterpret_cast<char *>(left.data()),
+      reinterpret_cast<char *>(right.data()), output.data());
+  EXPECT_EQ(output, std::vector<uint16_t>(W*H, 1));
+}
+
+// YUYV input, with the default src_pitch, gives the disparities of its
+// luma plane
+TYPED_TEST(StereoSGMTest, Yuyv) {
+  std::minstd_rand0 rng;
+
+  int W = 96;
+  int H = 40;
+  int D = 64;
+
+  std::vector<uint8_t> left = random_patch(2*W, H, rng);
+  std::vector<uint8_t> right = random_patch(2*W, H, rng);
+
+  std::vector<uint8_t> left_luma(W*H);
+  std::vector<uint8_t> right_luma(W*H);
+  for (int i = 0; i < W*H; i += 1) {
+    left_luma[i] = left[2*i];
+    right_luma[i] = right[2*i];
+  }
+
+  using Parameters = typename StereoSGM<TypeParam>::Parameters;
+
+  std::vector<uint16_t> expected(W*H);
+  StereoSGM<TypeParam> gray(W, H, D);
+  gray.execute(reinterpret_cast<char *>(left_luma.data()),
+      reinterpret_cast<char *>(right_luma.data()), expected.data());
+
+  Parameters param;
+  param.pixel_format = PixelFormat::YUYV;
+
+  std::vector<uint16_t> output(W*H);
+  StereoSGM<TypeParam> yuyv(W, H, D, param);
+  yuyv.execute(reinterpret_cast<char *>(left.data()),
+      reinterpret_cast<char *>(right.data()), output.data());
+
+  ASSERT_EQ(output, expected);
+}
+
+TYPED_TEST(StereoSGMTest, RejectsSmallImage) {
+  std::minstd_rand0 rng;
+
+  using CensusOps = detail::CensusOps<TypeParam>;
+
+  // larger than the census window, smaller than the census patch
+  int W = CensusOps::min_width() - 1;
+  int H = CensusOps::min_height();
+  int D = 64;
+
+  std::vector<uint8_t> left = random_patch(W, H, rng);
+  std::vector<uint8_t> right = random_patch(W, H, rng);
+
+  std::vector<uint16_t> output(W*H, 0x1234);
+
+  StereoSGM<TypeParam> sgm(W, H, D);
+  sgm.execute(reinterpret_cast<char *>(left.data()),
+      reinterpret_cast<char *>(right.data()), output.data());
+
+  ASSERT_EQ(output, std::vector<uint16_t>(W*H, 0x1234));
+}
+
+// Costs of 64-bit descriptors go up to 64, beyond 6 bits and leaving 191
+// for P2
+TYPED_TEST(StereoSGMTest, RejectsWideDescriptorParameters) {
+  using Tune = WindowTune<TypeParam, CensusWindow11x9>;
+
+  std::minstd_rand0 rng;
+
+  int W = 72;
+  int H = 40;
+  int D = 64;
+
+  std::vector<uint8_t> left = random_patch(W, H, rng);
+  std::vector<uint8_t> right = random_patch(W, H, rng);
+
+  typename StereoSGM<Tune>::Parameters six_bit;
+  six_bit.cost_packing = CostPacking::SIX_BIT;
+
+  typename StereoSGM<Tune>::Parameters high_p2;
+  high_p2.P2 = 200;
+
+  for (const auto &param : { six_bit, high_p2 }) {
+    std::vector<uint16_t> output(W*H, 0x1234);
+
+    StereoSGM<Tune> sgm(W, H, D, param);
+    sgm.execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), output.data());
+
+    ASSERT_EQ(output, std::vector<uint16_t>(W*H, 0x1234));
+  }
+}
+
+TYPED_TEST(StereoSGMTest, Pitch) {
+  std::minstd_rand0 rng;
+
+  int W = 72;
+  int H = 40;
+  int D = 64;
+  int src_pitch = W + 5;
+  int dst_pitch = W + 3;
+
+  std::vector<uint8_t> left = random_patch(src_pitch, H, rng);
+  std::vector<uint8_t> right = random_patch(src_pitch, H, rng);
+
+  std::vector<uint8_t> left_packed(W*H);
+  std::vector<uint8_t> right_packed(W*H);
+  for (int y = 0; y < H; y += 1) {
+    std::copy_n(left.data() + y*src_pitch, W, left_packed.data() + y*W);
+    std::copy_n(right.data() + y*src_pitch, W, right_packed.data() + y*W);
+  }
+
+  std::vector<uint16_t> reference =
+    reference_sgm(left_packed.data(), right_packed.data(), W, H, D, 10, 120,
+        PathType::SCAN_8PATH);
+
+  std::vector<uint16_t> output(dst_pitch*H, 0xffff);
+
+  StereoSGM<TypeParam> sgm(W, H, D);
+
+  // twice, reusing the buffers
+  for (int i = 0; i < 2; i += 1) {
+    sgm.execute(reinterpret_cast<char *>(left.data()),
+        reinterpret_cast<char *>(right.data()), output.data(),
+        src_pitch, dst_pitch);
+  }
+
+  for (int y = 0; y < H; y += 1) {
+    for (int x = 0; x < W; x += 1) {
+      ASSERT_EQ(output[y*dst_pitch + x], reference[y*W + x])
+        << "x = " << x << ", y = " << y << "\n";
+    }
+    for (int x = W; x < dst_pitch; x += 1) {
+      ASSERT_EQ(output[y*dst_pitch + x], 0xffff);
+    }
+  }
+}
+
+} // namespace test
+} // namespace sgm_cpu
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include <census_window.hpp>
+#include <cost_layout.hpp>
+#include <tune/array128_tune.hpp>
+
+#if defined(__SSSE3__)
+#include <tune/sse128_tune.hpp>
+#endif
+
+#if defined(__AVX2__)
+#include <tune/avx2_tune.hpp>
+#endif
+
+#if defined(__AVX512BW__) && defined(__AVX512VPOPCNTDQ__)
+#include <tune/avx512_tune.hpp>
+#endif
+
+#if defined(__aarch64__) || defined(SGM_CPU_EMULATE_NEON)
+#include <tune/neon128_tune.hpp>
+#endif
+
+namespace sgm_cpu {
+namespace test {
+
+// Every tune the test binary was compiled for. Native backends are only
+// included when the matching instruction set is enabled at compile time,
+// except NEON which can also run through neon_emulation.hpp.
+using TestTunes = ::testing::Types<
+    tune::Array128
+#if defined(__SSSE3__)
+    , tune::Sse128
+#endif
+#if defined(__AVX2__)
+    , tune::Avx2
+#endif
+#if defined(__AVX512BW__) && defined(__AVX512VPOPCNTDQ__)
+    , tune::Avx512
+#endif
+#if defined(__aarch64__) || defined(SGM_CPU_EMULATE_NEON)
+    , tune::Neon128
+#endif
+    >;
+
+// A tune with another census window, see census_window.hpp
+template <class Base, class Window>
+struct WindowTune {
+  using simd = typename Base::simd;
+
+  struct census {
+    static constexpr int h_block = Base::census::h_block;
+    static constexpr int v_block = Base::census::v_block;
+
+    static constexpr int h_step = Base::census::h_step;
+    static constexpr int v_step = Base::census::v_step;
+
+    using window = Window;
+  };
+};
+
+// A tune for 16-bit input, with any census window
+template <class Base, class Window = CensusWindow9x7>
+struct WideInputTune {
+  using simd = typename Base::simd;
+
+  struct census {
+    static constexpr int h_block = Base::census::h_block;
+    static constexpr int v_block = Base::census::v_block;
+
+    static constexpr int h_step = Base::census::h_step;
+    static constexpr int v_step = Base::census::v_step;
+
+    using window = Window;
+    using input_type = uint16_t;
+  };
+};
+
+// A tune with another cost volume layout, see cost_layout.hpp
+template <class Base, class Layout>
+struct LayoutTune {
+  using simd = typename Base::simd;
+  using census = typename Base::census;
+
+  struct aggregation {
+    using cost_layout = Layout;
+  };
+};
+
+} // namespace test
+} // namespace sgm_cpu
@@ -21,6 +21,38 @@ std::vector<uint8_t> random_patch(int w, int h, std::minstd_rand0 &rng) {
   return patch;
 }
 
+template <class Pixel>
+std::pair<std::vector<Pixel>, std::vector<Pixel>> shifted_pair(int w, int h,
+    int shift, std::minstd_rand0 &rng, unsigned range) {
+
+  std::vector<Pixel> left(w * h);
+  std::vector<Pixel> right(w * h);
+  for (Pixel &p : left) {
+    p = static_cast<Pixel>(rng() & range);
+  }
+  for (Pixel &p : right) {
+    p = static_cast<Pixel>(rng() & range);
+  }
+
+  for (int y = 0; y < h; y += 1) {
+    for (int x = 0; x + shift < w; x += 1) {
+      right[y*w + x] = left[y*w + x + shift];
+    }
+  }
+
+  return { std::move(left), std::move(right) };
+}
+
+template std::pair<std::vector<uint8_t>, std::vector<uint8_t>>
+shifted_pair(int w, int h, int shift, std::minstd_rand0 &rng,
+    unsigned range);
+template std::pair<std::vector<char>, std::vector<char>>
+shifted_pair(int w, int h, int shift, std::minstd_rand0 &rng,
+    unsigned range);
+template std::pair<std::vector<uint16_t>, std::vector<uint16_t>>
+shifted_pair(int w, int h, int shift, std::minstd_rand0 &rng,
+    unsigned range);
+
 std::vector<uint32_t> random_descriptors(int w, int h, int border,
     std::minstd_rand0 &rng) {
 
@@ -121,6 +153,110 @@ std::ostream &print_descriptor(std::ostream &os, uint32_t desc) {
   return os;
 }
 
+std::vector<uint16_t> reference_sgm(const uint8_t *left, const uint8_t *right,
+    int width, int height, int disparity_size, int p1, int p2,
+    PathType path_type) {
+
+  const int W = width - 8;
+  const int H = height - 6;
+  const int D = disparity_size;
+
+  std::vector<uint32_t> fl = apply_census(left, width, height, width);
+  std::vector<uint32_t> fr = apply_census(right, width, height, width);
+
+  auto index = [&](int x, int y, int d) {
+    return (static_cast<size_t>(y)*W + x)*D + d;
+  };
+
+  std::vector<int> cost(static_cast<size_t>(W)*H*D);
+  for (int y = 0; y < H; y += 1) {
+    for (int x = 0; x < W; x += 1) {
+      for (int d = 0; d < D; d += 1) {
+        uint32_t r = x >= d ? fr[y*W + x - d] : 0;
+        cost[index(x, y, d)] = __builtin_popcount(fl[y*W + x] ^ r);
+      }
+    }
+  }
+
+  // the step from the previous pixel on each path
+  static constexpr int directions[8][2] = {
+    {0, 1}, {0, -1}, {1, 0}, {-1, 0},
+    {1, 1}, {-1, 1}, {1, -1}, {-1, -1} };
+
+  // indices into directions
+  std::vector<int> selected;
+  switch (path_type) {
+    case PathType::SCAN_4PATH:
+      selected = { 0, 1, 2, 3 };
+      break;
+    case PathType::SCAN_8PATH:
+      selected = { 0, 1, 2, 3, 4, 5, 6, 7 };
+      break;
+    case PathType::SCAN_5PATH:
+      selected = { 0, 2, 3, 4, 5 };
+      break;
+  }
+
+  std::vector<int> sum(cost.size(), 0);
+  std::vector<int> path(cost.size());
+
+  for (int r : selected) {
+    const int dx = directions[r][0];
+    const int dy = directions[r][1];
+
+    // visit predecessors first
+    for (int j = 0; j < H; j += 1) {
+      const int y = dy >= 0 ? j : H - 1 - j;
+
+      for (int i = 0; i < W; i += 1) {
+        const int x = dx >= 0 ? i : W - 1 - i;
+
+        const int px = x - dx;
+        const int py = y - dy;
+
+        if (px < 0 || px >= W || py < 0 || py >= H) {
+          for (int d = 0; d < D; d += 1) {
+            path[index(x, y, d)] = cost[index(x, y, d)];
+          }
+          continue;
+        }
+
+        int min_prev = path[index(px, py, 0)];
+        for (int d = 1; d < D; d += 1) {
+          min_prev = std::min(min_prev, path[index(px, py, d)]);
+        }
+
+        for (int d = 0; d < D; d += 1) {
+          int best = std::min(path[index(px, py, d)], min_prev + p2);
+          if (d > 0) best = std::min(best, path[index(px, py, d-1)] + p1);
+          if (d < D-1) best = std::min(best, path[index(px, py, d+1)] + p1);
+
+          path[index(x, y, d)] = cost[index(x, y, d)] + best - min_prev;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < sum.size(); i += 1) {
+      sum[i] += path[i];
+    }
+  }
+
+  std::vector<uint16_t> disparity(static_cast<size_t>(width)*height, 0);
+  for (int y = 0; y < H; y += 1) {
+    for (int x = 0; x < W; x += 1) {
+      int best = 0;
+      for (int d = 1; d < D; d += 1) {
+        if (sum[index(x, y, d)] < sum[index(x, y, best)]) {
+          best = d;
+        }
+      }
+      disparity[(y + 3)*width + x + 4] = best;
+    }
+  }
+
+  return disparity;
+}
+
 } // namespace test
 } // namespace sgm_cpu
 
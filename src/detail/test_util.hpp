@@ -1,5 +1,9 @@
 #include <random>
 #include <iostream>
+#include <utility>
+#include <vector>
+
+#include <stereo_sgm.hpp>
 
 namespace sgm_cpu {
 namespace test {
@@ -8,6 +12,14 @@ std::vector<uint8_t> random_patch(int w, int h, std::minstd_rand0 &rng);
 std::vector<uint32_t> random_descriptors(int w, int h, int border,
     std::minstd_rand0 &rng);
 
+// A random left image and a right one with right[x] = left[x + shift], so
+// the disparity is shift wherever the census windows fit. The last shift
+// columns of right stay random. Pixels are rng() & range, 12-bit say for
+// 16-bit input. Defined for uint8_t, char and uint16_t pixels.
+template <class Pixel = uint8_t>
+std::pair<std::vector<Pixel>, std::vector<Pixel>> shifted_pair(int w, int h,
+    int shift, std::minstd_rand0 &rng, unsigned range = 0xff);
+
 uint32_t compute_census(const uint8_t *src, int src_pitch);
 
 std::vector<uint32_t> apply_census(const uint8_t *src,
@@ -15,6 +27,12 @@ std::vector<uint32_t> apply_census(const uint8_t *src,
 
 std::ostream &print_descriptor(std::ostream &os, uint32_t desc);
 
+// Straightforward semi-global matching over the directions of path_type,
+// with the output conventions of StereoSGM.
+std::vector<uint16_t> reference_sgm(const uint8_t *left, const uint8_t *right,
+    int width, int height, int disparity_size, int p1, int p2,
+    PathType path_type);
+
 } // namespace test
 } // namespace sgm_cpu
 
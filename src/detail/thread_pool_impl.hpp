@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+
+namespace sgm_cpu {
+namespace detail {
+
+// the pool whose task this thread is running, if any
+inline thread_local const ThreadPool *t_running_pool = nullptr;
+
+} // detail
+
+inline ThreadPool::ThreadPool(int n_threads) :
+  m_task(nullptr),
+  m_n_tasks(0),
+  m_finished(0),
+  m_active(0),
+  m_generation(0),
+  m_stop(false),
+  m_next(0) {
+
+  if (n_threads <= 0) {
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (int i = 1; i < n_threads; i += 1) {
+    m_workers.emplace_back([this] { worker_loop(); });
+  }
+}
+
+inline ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+
+  for (std::thread &worker : m_workers) {
+    worker.join();
+  }
+}
+
+inline ThreadPool &ThreadPool::global() {
+  static ThreadPool pool;
+  return pool;
+}
+
+inline void ThreadPool::parallel_for(
+    int n_tasks,
+    const std::function<void(int)> &task) {
+
+  // Nested loops would wait on workers that are busy with the outer one.
+  if (m_workers.empty() || (detail::t_running_pool != nullptr) ||
+      (n_tasks <= 1)) {
+    for (int i = 0; i < n_tasks; i += 1) {
+      task(i);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> submit(m_submit);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_task = &task;
+    m_n_tasks = n_tasks;
+    m_finished = 0;
+    m_next.store(0, std::memory_order_relaxed);
+    m_generation += 1;
+  }
+  m_wake.notify_all();
+
+  int finished = run_tasks(task, n_tasks);
+
+  // Workers hold the task and its size until they leave run_tasks, so wait
+  // for them as well as the tasks before the next loop may replace either.
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_finished += finished;
+  m_done.wait(lock, [this] {
+    return (m_finished == m_n_tasks) && (m_active == 0);
+  });
+  m_task = nullptr;
+}
+
+inline int ThreadPool::run_tasks(
+    const std::function<void(int)> &task,
+    int n_tasks) {
+
+  detail::t_running_pool = this;
+
+  int finished = 0;
+  for (;;) {
+    int i = m_next.fetch_add(1, std::memory_order_relaxed);
+    if (i >= n_tasks) {
+      break;
+    }
+    task(i);
+    finished += 1;
+  }
+
+  detail::t_running_pool = nullptr;
+  return finished;
+}
+
+inline void ThreadPool::worker_loop() {
+  unsigned seen = 0;
+
+  for (;;) {
+    const std::function<void(int)> *task;
+    int n_tasks;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [this, seen] {
+        return m_stop || ((m_generation != seen) && (m_task != nullptr));
+      });
+
+      if (m_stop) {
+        return;
+      }
+
+      seen = m_generation;
+      task = m_task;
+      n_tasks = m_n_tasks;
+      m_active += 1;
+    }
+
+    int finished = run_tasks(*task, n_tasks);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_finished += finished;
+      m_active -= 1;
+    }
+    m_done.notify_one();
+  }
+}
+
+} // sgm_cpu
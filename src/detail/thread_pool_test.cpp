@@ -0,0 +1,65 @@
+#include <atomic>
+#include <vector>
+
+#include <thread_pool.hpp>
+
+#include <gtest/gtest.h>
+
+namespace sgm_cpu {
+namespace test {
+
+TEST(ThreadPool, Size) {
+  ThreadPool pool(3);
+  ASSERT_EQ(pool.size(), 3);
+
+  ThreadPool automatic;
+  ASSERT_GE(automatic.size(), 1);
+}
+
+TEST(ThreadPool, EachTaskOnce) {
+  for (int n_threads : { 1, 2, 8 }) {
+    ThreadPool pool(n_threads);
+
+    // repeated loops of varying size reuse the workers
+    for (int n_tasks : { 0, 1, 7, 1000, 3 }) {
+      std::vector<std::atomic<int>> count(n_tasks);
+
+      pool.parallel_for(n_tasks, [&](int i) {
+        count[i].fetch_add(1);
+      });
+
+      for (int i = 0; i < n_tasks; i += 1) {
+        ASSERT_EQ(count[i].load(), 1) << "i = " << i << ", n_threads = " <<
+          n_threads << "\n";
+      }
+    }
+  }
+}
+
+TEST(ThreadPool, Nested) {
+  ThreadPool pool(4);
+
+  std::atomic<int> total(0);
+
+  pool.parallel_for(8, [&](int i) {
+    pool.parallel_for(10, [&](int j) {
+      total.fetch_add(1);
+    });
+  });
+
+  ASSERT_EQ(total.load(), 80);
+}
+
+TEST(ThreadPool, Global) {
+  ASSERT_EQ(&ThreadPool::global(), &ThreadPool::global());
+
+  std::atomic<int> total(0);
+  ThreadPool::global().parallel_for(100, [&](int i) {
+    total.fetch_add(i);
+  });
+
+  ASSERT_EQ(total.load(), 4950);
+}
+
+} // namespace test
+} // namespace sgm_cpu
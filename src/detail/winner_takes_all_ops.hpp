@@ -0,0 +1,95 @@
+#pragma once
+
+#include <types.hpp>
+
+namespace sgm_cpu {
+namespace detail {
+
+template <class Tune>
+class WinnerTakesAllOps {
+
+ public:
+  using tune = Tune;
+
+  // For each pixel of a row of summed path costs (disparity_size rows of
+  // width sums, see PathAggregationOps::execute_vertical_row):
+  //
+  //   dst[x] = argmin_d sum[d*width + x]
+  //
+  // taking the smallest d on ties. width must be a multiple of
+  // consts::pixels_per_s1.
+  static void execute_row(
+      const cost_sum_type *sum,
+      int width,
+      int disparity_size,
+      output_type *dst);
+
+  // As execute_row, with a fraction fitted over the sums of the best d and
+  // its neighbours, output in fixed point with shift fractional bits:
+  //
+  //   dst[x] = (d << shift) + round(frac * (1 << shift)),  |frac| <= 1/2
+  //
+  // A best d of 0 or disparity_size - 1 has no neighbour on one side and
+  // keeps frac = 0, as does SubpixelFit::NONE.
+  static void execute_subpixel_row(
+      const cost_sum_type *sum,
+      int width,
+      int disparity_size,
+      SubpixelFit fit,
+      int shift,
+      output_type *dst);
+
+  // Disparities of the right view from the same sums. Right pixel x
+  // matches left pixel x + min_disparity + d at disparity d, so its costs
+  // lie along a diagonal of the sums:
+  //
+  //   dst[x] = argmin_d sum[d*width + x + min_disparity + d]
+  //
+  // over the d whose left pixel is before valid_width, smallest d on ties,
+  // and invalid where there is none. As execute_row, d counts from 0 and
+  // width must be a multiple of consts::pixels_per_s1.
+  static void execute_right_row(
+      const cost_sum_type *sum,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int min_disparity,
+      output_type invalid,
+      output_type *dst);
+
+  // Left-right consistency check of a row of execute_row disparities
+  // against execute_right_row's: left[x] becomes invalid unless the right
+  // pixel it matches, x - min_disparity - left[x], exists and has a
+  // disparity within max_diff of it. Occluded pixels and mismatches seen
+  // from only one side fail. Left disparities from execute_subpixel_row
+  // give their shift, and are rounded to whole ones to match.
+  static void execute_lr_check(
+      output_type *left,
+      const output_type *right,
+      int width,
+      int min_disparity,
+      int max_diff,
+      output_type invalid,
+      int shift = 0);
+
+  // shift fractional bits of the minimum of the fitted curve, relative to
+  // the best d
+  static int subpixel_offset(
+      int left,
+      int best,
+      int right,
+      SubpixelFit fit,
+      int shift);
+
+  struct consts {
+    // an s1_t holds half as many 16-bit sums as an x1_t holds costs
+    static constexpr int pixels_per_s1 =
+      2 * Tune::simd::reg::descriptors_per_w1;
+  };
+
+};
+
+} // detail
+} // sgm_cpu
+
+#include <detail/winner_takes_all_ops_impl.hpp>
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace sgm_cpu {
+namespace detail {
+
+template <class Tune>
+void WinnerTakesAllOps<Tune>::execute_row(
+    const cost_sum_type *sum,
+    int width,
+    int disparity_size,
+    output_type *dst) {
+
+  using simd = typename Tune::simd;
+  using s1_t = typename simd::reg::s1_t;
+
+  constexpr int N = consts::pixels_per_s1;
+
+  if (((width % N) != 0) || (disparity_size <= 0)) {
+    std::cerr << "WinnerTakesAllOps::execute_row: width must be a multiple "
+      "of " << N << " (" << width << ")\n";
+    return;
+  }
+
+  for (int x = 0; x < width; x += N) {
+    s1_t best;
+    s1_t best_index;
+
+    simd::load_s1(best, sum + x);
+    simd::clear(best_index);
+
+    for (int d = 1; d < disparity_size; d += 1) {
+      s1_t value;
+      simd::load_s1(value, sum + d*width + x);
+
+      simd::select_min_s1(best, best_index, value, simd::fill_s1(d));
+    }
+
+    simd::store_s1(best_index, dst + x);
+  }
+}
+
+// Fused into the scan over d, keeping the neighbours of the best d so far:
+// left takes the previous sum wherever the best changes, and right the
+// current sum wherever it changed one d ago, seen as the best falling from
+// one d to the next. All of it is select_min_s1 on copies, with 0x7fff
+// standing for a missing neighbour. The fit divides, which none of the
+// backends do on 16-bit lanes, so it is per pixel, once per row rather than
+// once per d.
+template <class Tune>
+void WinnerTakesAllOps<Tune>::execute_subpixel_row(
+    const cost_sum_type *sum,
+    int width,
+    int disparity_size,
+    SubpixelFit fit,
+    int shift,
+    output_type *dst) {
+
+  using simd = typename Tune::simd;
+  using s1_t = typename simd::reg::s1_t;
+
+  constexpr int N = consts::pixels_per_s1;
+
+  if (((width % N) != 0) || (disparity_size <= 0) || (shift < 0) ||
+      ((disparity_size << shift) > 0x10000)) {
+    std::cerr << "WinnerTakesAllOps::execute_subpixel_row: width must be a "
+      "multiple of " << N << " (" << width << "), and disparities fit 16 "
+      "bits with " << shift << " fractional\n";
+    return;
+  }
+
+  const s1_t none = simd::fill_s1(0x7fff);
+
+  for (int x = 0; x < width; x += N) {
+    s1_t best;
+    s1_t best_index;
+    s1_t left = none;
+    s1_t right = none;
+    s1_t previous_best = none;
+    s1_t prev;
+
+    simd::load_s1(best, sum + x);
+    simd::clear(best_index);
+    prev = best;
+
+    for (int d = 1; d < disparity_size; d += 1) {
+      s1_t value;
+      simd::load_s1(value, sum + d*width + x);
+
+      s1_t t = previous_best;
+      simd::select_min_s1(t, right, best, value);
+      previous_best = best;
+
+      t = best;
+      simd::select_min_s1(t, left, value, prev);
+      simd::select_min_s1(best, best_index, value, simd::fill_s1(d));
+      prev = value;
+    }
+
+    // a best d of disparity_size - 1 has nothing on its right
+    s1_t t = previous_best;
+    simd::select_min_s1(t, right, best, none);
+
+    cost_sum_type b[N];
+    cost_sum_type l[N];
+    cost_sum_type r[N];
+
+    simd::store_s1(best_index, dst + x);
+    simd::store_s1(best, b);
+    simd::store_s1(left, l);
+    simd::store_s1(right, r);
+
+    for (int i = 0; i < N; i += 1) {
+      dst[x + i] = static_cast<output_type>((dst[x + i] << shift) +
+          subpixel_offset(l[i], b[i], r[i], fit, shift));
+    }
+  }
+}
+
+template <class Tune>
+int WinnerTakesAllOps<Tune>::subpixel_offset(
+    int left,
+    int best,
+    int right,
+    SubpixelFit fit,
+    int shift) {
+
+  if ((fit == SubpixelFit::NONE) || (left == 0x7fff) || (right == 0x7fff)) {
+    return 0;
+  }
+
+  // the best is the smallest d of the lowest sum, so left > best and
+  // right >= best, and both denominators are positive
+  const int denom = (fit == SubpixelFit::PARABOLA) ?
+    2*(left - 2*best + right) : 2*(std::max(left, right) - best);
+  const int numer = (left - right) * (1 << shift);
+
+  // rounded half away from zero
+  return (2*numer + ((numer < 0) ? -denom : denom)) / (2*denom);
+}
+
+// The diagonal is an unaligned load per disparity, until the left pixels
+// run out at valid_width. Sums are at most 8*255, so 0x7fff beyond it never
+// wins, and neither do the d past the last left pixel, which end the loop.
+template <class Tune>
+void WinnerTakesAllOps<Tune>::execute_right_row(
+    const cost_sum_type *sum,
+    int width,
+    int valid_width,
+    int disparity_size,
+    int min_disparity,
+    output_type invalid,
+    output_type *dst) {
+
+  using simd = typename Tune::simd;
+  using s1_t = typename simd::reg::s1_t;
+
+  constexpr int N = consts::pixels_per_s1;
+
+  if (((width % N) != 0) || (disparity_size <= 0) || (min_disparity < 0) ||
+      (valid_width > width)) {
+    std::cerr << "WinnerTakesAllOps::execute_right_row: width must be a "
+      "multiple of " << N << ", valid width at most width (" << width <<
+      ", " << valid_width << ")\n";
+    return;
+  }
+
+  const s1_t none = simd::fill_s1(0x7fff);
+
+  for (int x = 0; x < width; x += N) {
+    s1_t best = none;
+    s1_t best_index = simd::fill_s1(invalid);
+
+    for (int d = 0; d < disparity_size; d += 1) {
+      const int c = x + min_disparity + d;
+
+      if (c >= valid_width) {
+        break;
+      }
+
+      s1_t value;
+      if (c + N <= valid_width) {
+        simd::load_s1(value, sum + d*width + c);
+      } else {
+        cost_sum_type padded[N];
+        std::fill(padded, padded + N, 0x7fff);
+        std::copy(sum + d*width + c, sum + d*width + valid_width, padded);
+        simd::load_s1(value, padded);
+      }
+
+      simd::select_min_s1(best, best_index, value, simd::fill_s1(d));
+    }
+
+    simd::store_s1(best_index, dst + x);
+  }
+}
+
+// One lookup per pixel at a data dependent offset, a gather the backends
+// lack for 16-bit lanes. Over disparities instead it would cost as much as
+// the winner-takes-all, so this stays scalar.
+template <class Tune>
+void WinnerTakesAllOps<Tune>::execute_lr_check(
+    output_type *left,
+    const output_type *right,
+    int width,
+    int min_disparity,
+    int max_diff,
+    output_type invalid,
+    int shift) {
+
+  const int half = (1 << shift) >> 1;
+
+  for (int x = 0; x < width; x += 1) {
+    const int d = (left[x] + half) >> shift;
+    const int r = x - min_disparity - d;
+
+    if ((left[x] == invalid) || (r < 0) || (right[r] == invalid) ||
+        (std::abs(right[r] - d) > max_diff)) {
+      left[x] = invalid;
+    }
+  }
+}
+
+} // detail
+} // sgm_cpu
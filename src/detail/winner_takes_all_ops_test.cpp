@@ -0,0 +1,179 @@
+#include <cmath>
+#include <random>
+#include <iostream>
+
+#include <detail/winner_takes_all_ops.hpp>
+
+#include <gtest/gtest.h>
+
+#include "test_tunes.hpp"
+
+namespace sgm_cpu {
+namespace test {
+
+template <class Tune>
+class WinnerTakesAllOps : public ::testing::Test {};
+
+TYPED_TEST_SUITE(WinnerTakesAllOps, TestTunes);
+
+// Small sums with many ties, so that the smallest d must win them
+static std::vector<uint16_t> random_sums(int width, int disparity_size,
+    std::minstd_rand0 &rng) {
+
+  std::vector<uint16_t> sum(static_cast<size_t>(width) * disparity_size);
+  for (uint16_t &s : sum) {
+    s = static_cast<uint16_t>(rng() % 8);
+  }
+  return sum;
+}
+
+TYPED_TEST(WinnerTakesAllOps, ExecuteRow) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::WinnerTakesAllOps<TypeParam>;
+
+  const int W = 4*Ops::consts::pixels_per_s1;
+  const int D = 48;
+
+  std::vector<uint16_t> sum = random_sums(W, D, rng);
+  std::vector<uint16_t> output(W);
+
+  Ops::execute_row(sum.data(), W, D, output.data());
+
+  for (int x = 0; x < W; x += 1) {
+    int best = 0;
+    for (int d = 1; d < D; d += 1) {
+      if (sum[d*W + x] < sum[best*W + x]) {
+        best = d;
+      }
+    }
+    ASSERT_EQ(output[x], best) << "x = " << x;
+  } // namespace test
+} // namespace sgm_cpu
+
+// Against a fit in floating point. Sums from 0 to 63 leave most minima
+// inside the range, but some at either end.
+TYPED_TEST(WinnerTakesAllOps, ExecuteSubpixelRow) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::WinnerTakesAllOps<TypeParam>;
+
+  const int W = 4*Ops::consts::pixels_per_s1;
+
+  for (int D : { 1, 2, 16, 48 }) {
+    std::vector<uint16_t> sum(static_cast<size_t>(W) * D);
+    for (uint16_t &s : sum) {
+      s = static_cast<uint16_t>(rng() % 64);
+    }
+
+    for (SubpixelFit fit : { SubpixelFit::NONE, SubpixelFit::PARABOLA,
+        SubpixelFit::EQUIANGULAR }) {
+      for (int shift : { 0, 4, 8 }) {
+        std::vector<uint16_t> output(W);
+        Ops::execute_subpixel_row(sum.data(), W, D, fit, shift,
+            output.data());
+
+        for (int x = 0; x < W; x += 1) {
+          int best = 0;
+          for (int d = 1; d < D; d += 1) {
+            if (sum[d*W + x] < sum[best*W + x]) {
+              best = d;
+            }
+          }
+
+          double frac = 0;
+          if ((fit != SubpixelFit::NONE) && (best > 0) && (best < D - 1)) {
+            const double l = sum[(best - 1)*W + x];
+            const double b = sum[best*W + x];
+            const double r = sum[(best + 1)*W + x];
+            frac = (l - r) / ((fit == SubpixelFit::PARABOLA) ?
+                2*(l - 2*b + r) : 2*(std::max(l, r) - b));
+          }
+
+          const int expected = best * (1 << shift) +
+            static_cast<int>(std::round(frac * (1 << shift)));
+
+          ASSERT_EQ(output[x], expected) << "x = " << x << ", D = " << D <<
+            ", fit = " << static_cast<int>(fit) << ", shift = " << shift;
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(WinnerTakesAllOps, ExecuteRightRow) {
+  std::minstd_rand0 rng;
+
+  using Ops = detail::WinnerTakesAllOps<TypeParam>;
+
+  const int N = Ops::consts::pixels_per_s1;
+  const int W = 4*N;
+  const int D = 48;
+  const uint16_t invalid = 0xffff;
+
+  std::vector<uint16_t> sum = random_sums(W, D, rng);
+
+  // valid widths within a register, at one and at the padded width
+  for (int valid_width : { W - N/2 - 1, W - N, W }) {
+    for (int m : { 0, 3, N + 5 }) {
+      std::vector<uint16_t> output(W, 0);
+
+      Ops::execute_right_row(sum.data(), W, valid_width, D, m, invalid,
+          output.data());
+
+      for (int x = 0; x < W; x += 1) {
+        int best = invalid;
+        for (int d = 0; (d < D) && (x + m + d < valid_width); d += 1) {
+          if ((best == invalid) ||
+              (sum[d*W + x + m + d] < sum[best*W + x + m + best])) {
+            best = d;
+          }
+        }
+        ASSERT_EQ(output[x], best) << "x = " << x << ", valid width = " <<
+          valid_width << ", min disparity = " << m;
+      }
+    }
+  } // namespace test
+} // namespace sgm_cpu
+
+TYPED_TEST(WinnerTakesAllOps, ExecuteLRCheck) {
+  using Ops = detail::WinnerTakesAllOps<TypeParam>;
+
+  const uint16_t I = 0xffff;
+  const int m = 2;
+
+  // left pixel x matches right pixel x - 2 - left[x]
+  const std::vector<uint16_t> right = { 0, 3, 1, 7, I, 2, 5, 0 };
+  std::vector<uint16_t> left =        { 0, 1, 0, 0, 1, 1, 2, 1 };
+  const std::vector<uint16_t> expected = {
+    I,  // matches x = -2, outside the right image
+    I,  // matches x = -2
+    0,  // matches x = 0 exactly
+    I,  // matches x = 1, off by 3
+    I,  // matches x = 1, off by 2
+    1,  // matches x = 2 exactly
+    2,  // matches x = 2, off by 1
+    I,  // matches x = 4, invalid
+  };
+
+  Ops::execute_lr_check(left.data(), right.data(), 8, m, 1, I);
+  EXPECT_EQ(left, expected);
+
+  // an invalid right pixel fails whatever the difference allowed
+  left = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  Ops::execute_lr_check(left.data(), right.data(), 8, m, 0xffff, I);
+  EXPECT_EQ(left, std::vector<uint16_t>({ I, I, 0, 0, 0, 0, I, 0 }));
+
+  // min disparity moves every match left
+  left = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  Ops::execute_lr_check(left.data(), right.data(), 8, 4, 0xffff, I);
+  EXPECT_EQ(left, std::vector<uint16_t>({ I, I, I, I, 0, 0, 0, 0 }));
+
+  // subpixel disparities match rounded to whole ones
+  left = { 0, 0, 0, 8, 24, 18, 0, 40 };
+  Ops::execute_lr_check(left.data(), right.data(), 8, m, 0, I, 4);
+  EXPECT_EQ(left, std::vector<uint16_t>({ I, I, 0, I, I, 18, I, I }));
+}
+
+} // namespace test
+} // namespace sgm_cpu
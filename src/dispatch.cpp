@@ -0,0 +1,128 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include <dispatch.hpp>
+
+namespace sgm_cpu {
+namespace detail {
+
+// Defined in dispatch/<backend>.cpp, each enabling its own instruction sets
+// for its kernels. They return nullptr when the build target lacks them.
+const KernelTable *kernel_table_array128();
+const KernelTable *kernel_table_neon128();
+const KernelTable *kernel_table_sse128();
+const KernelTable *kernel_table_avx2();
+const KernelTable *kernel_table_avx512();
+
+static bool cpu_supports(Backend backend) {
+  switch (backend) {
+    case Backend::Array128:
+      return true;
+
+#if defined(__x86_64__) || defined(__i386__)
+    case Backend::Sse128:
+      return __builtin_cpu_supports("ssse3");
+
+    case Backend::Avx2:
+      return __builtin_cpu_supports("avx2");
+
+    case Backend::Avx512:
+      return __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+    case Backend::Neon128:
+      return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+#elif defined(__aarch64__)
+    case Backend::Neon128:
+      return true; // mandatory on AArch64
+#endif
+
+    default:
+      return false;
+  }
+}
+
+const KernelTable *kernel_table(Backend backend) {
+  switch (backend) {
+    case Backend::Array128: return kernel_table_array128();
+    case Backend::Neon128: return kernel_table_neon128();
+    case Backend::Sse128: return kernel_table_sse128();
+    case Backend::Avx2: return kernel_table_avx2();
+    case Backend::Avx512: return kernel_table_avx512();
+  }
+  return nullptr;
+}
+
+Backend select_backend(const char *override_name) {
+  static constexpr Backend preference[] = {
+    Backend::Avx512,
+    Backend::Avx2,
+    Backend::Sse128,
+    Backend::Neon128,
+    Backend::Array128,
+  };
+
+  if (override_name && *override_name) {
+    bool known = false;
+
+    for (Backend backend : preference) {
+      if (std::strcmp(override_name, backend_name(backend)) == 0) {
+        if (backend_available(backend)) {
+          return backend;
+        }
+        known = true;
+      }
+    }
+
+    std::cerr << "sgm_cpu: LIBSGM_CPU_BACKEND=" << override_name <<
+      (known ? " is not available" : " is not a backend") <<
+      ", selecting automatically\n";
+  }
+
+  for (Backend backend : preference) {
+    if (backend_available(backend)) {
+      return backend;
+    }
+  }
+
+  return Backend::Array128;
+}
+
+const KernelTable &active_kernels() {
+  static const KernelTable *table = kernel_table(active_backend());
+  return *table;
+}
+
+} // namespace detail
+
+const char *backend_name(Backend backend) {
+  switch (backend) {
+    case Backend::Array128: return "array128";
+    case Backend::Neon128: return "neon128";
+    case Backend::Sse128: return "sse128";
+    case Backend::Avx2: return "avx2";
+    case Backend::Avx512: return "avx512";
+  }
+  return "unknown";
+}
+
+bool backend_available(Backend backend) {
+  return detail::kernel_table(backend) != nullptr &&
+    detail::cpu_supports(backend);
+}
+
+Backend active_backend() {
+  static const Backend backend =
+    detail::select_backend(std::getenv("LIBSGM_CPU_BACKEND"));
+  return backend;
+}
+
+} // namespace sgm_cpu
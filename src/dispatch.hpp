@@ -0,0 +1,597 @@
+#pragma once
+
+#include <types.hpp>
+#include <census_transform.hpp>
+#include <detail/census_ops.hpp>
+#include <detail/path_aggregation_ops.hpp>
+#include <detail/winner_takes_all_ops.hpp>
+#include <stereo_sgm.hpp>
+
+namespace sgm_cpu {
+
+// SIMD backends in increasing order of preference. Each is compiled in its
+// own translation unit with the instruction sets it needs enabled for its
+// kernels, so a single binary carries all of them for the target
+// architecture.
+enum class Backend {
+  Array128,
+  Neon128,
+  Sse128,
+  Avx2,
+  Avx512,
+};
+
+const char *backend_name(Backend backend);
+
+// True if the backend was compiled in and the CPU supports it.
+bool backend_available(Backend backend);
+
+// The backend behind tune::Dispatch. On first call this probes the CPU and
+// picks the fastest available backend, unless the LIBSGM_CPU_BACKEND
+// environment variable names another available one (e.g. "sse128").
+Backend active_backend();
+
+namespace tune {
+
+// Use in place of a concrete tune to route through the active backend.
+struct Dispatch {};
+
+} // namespace tune
+
+namespace detail {
+
+struct KernelTable {
+  Backend backend;
+
+  // PathAggregationOps<Tune>::consts::patch_size
+  int cost_patch_size;
+
+  // CensusOps<Tune>::min_width(), min_height()
+  int census_min_width;
+  int census_min_height;
+
+  // CensusOps<Tune>::band_rows(), band_height(), min_band_width()
+  int census_band_rows;
+  int census_band_height;
+  int census_min_band_width;
+
+  void (*execute_census)(
+      const CensusTransform<tune::Dispatch>::input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      PixelFormat format,
+      CensusBorder border);
+
+  int (*census_blocks)(int width, int height);
+
+  std::vector<int> (*roi_blocks)(
+      int width,
+      int height,
+      const std::vector<Rect> &rois);
+
+  void (*execute_census_block)(
+      const CensusTransform<tune::Dispatch>::input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      int block,
+      PixelFormat format);
+
+  void (*execute_census_edge)(
+      const CensusTransform<tune::Dispatch>::input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      CensusBorder border,
+      int edge,
+      PixelFormat format);
+
+  void (*execute_census_band)(
+      const CensusTransform<tune::Dispatch>::input_type *const *rows,
+      feature_type *dst,
+      int width,
+      int dst_pitch);
+
+  void (*extract_luma)(const uint8_t *src, uint8_t *dst, int width);
+
+  void (*execute_cost_row)(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int disparity_size,
+      const CostVolume &dst,
+      int min_disparity);
+
+  void (*execute_vertical_row)(
+      const ConstCostVolume &cost,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      cost_sum_type *sum);
+
+  void (*execute_vertical_stripe)(
+      const ConstCostVolume &cost,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      int x_begin,
+      int x_end,
+      cost_sum_type *sum);
+
+  void (*execute_horizontal_row)(
+      const ConstCostVolume &cost,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      bool reverse,
+      cost_sum_type *sum);
+
+  void (*execute_fused_row)(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      bool from_left,
+      bool from_right,
+      cost_sum_type *sum,
+      int min_disparity);
+
+  void (*execute_fused_vertical_stripe)(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      int x_begin,
+      int x_end,
+      cost_sum_type *sum,
+      int min_disparity,
+      const ConstCostVolume &stored);
+
+  void (*execute_fused_horizontal_row)(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      bool reverse,
+      cost_sum_type *sum,
+      int min_disparity,
+      const ConstCostVolume &stored);
+
+  void (*execute_sum_row)(
+      const cost_sum_type *src,
+      int size,
+      cost_sum_type *dst);
+
+  void (*execute_wta_row)(
+      const cost_sum_type *sum,
+      int width,
+      int disparity_size,
+      output_type *dst);
+
+  void (*execute_wta_subpixel_row)(
+      const cost_sum_type *sum,
+      int width,
+      int disparity_size,
+      SubpixelFit fit,
+      int shift,
+      output_type *dst);
+
+  void (*execute_wta_right_row)(
+      const cost_sum_type *sum,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int min_disparity,
+      output_type invalid,
+      output_type *dst);
+
+  void (*execute_lr_check)(
+      output_type *left,
+      const output_type *right,
+      int width,
+      int min_disparity,
+      int max_diff,
+      output_type invalid,
+      int shift);
+};
+
+// nullptr if the backend was not compiled in
+const KernelTable *kernel_table(Backend backend);
+
+const KernelTable &active_kernels();
+
+// Backend selection, less the caching. Exposed for testing.
+Backend select_backend(const char *override_name);
+
+template <class Tune>
+KernelTable make_kernel_table(Backend backend) {
+  KernelTable table;
+  table.backend = backend;
+  table.cost_patch_size = PathAggregationOps<Tune>::consts::patch_size;
+  table.census_min_width = CensusOps<Tune>::min_width();
+  table.census_min_height = CensusOps<Tune>::min_height();
+  table.census_band_rows = CensusOps<Tune>::band_rows();
+  table.census_band_height = CensusOps<Tune>::band_height();
+  table.census_min_band_width = CensusOps<Tune>::min_band_width();
+  table.execute_census = &CensusOps<Tune>::execute_census;
+  table.census_blocks = &CensusOps<Tune>::census_blocks;
+  table.roi_blocks = &CensusOps<Tune>::roi_blocks;
+  table.execute_census_block = &CensusOps<Tune>::execute_census_block;
+  table.execute_census_edge = &CensusOps<Tune>::execute_census_edge;
+  table.execute_census_band = &CensusOps<Tune>::execute_band;
+  table.extract_luma = &CensusOps<Tune>::extract_luma;
+  table.execute_cost_row = &PathAggregationOps<Tune>::execute_cost_row;
+  table.execute_vertical_row =
+    &PathAggregationOps<Tune>::execute_vertical_row;
+  table.execute_vertical_stripe =
+    &PathAggregationOps<Tune>::execute_vertical_stripe;
+  table.execute_horizontal_row =
+    &PathAggregationOps<Tune>::execute_horizontal_row;
+  table.execute_fused_row = &PathAggregationOps<Tune>::execute_fused_row;
+  table.execute_fused_vertical_stripe =
+    &PathAggregationOps<Tune>::execute_fused_vertical_stripe;
+  table.execute_fused_horizontal_row =
+    &PathAggregationOps<Tune>::execute_fused_horizontal_row;
+  table.execute_sum_row = &PathAggregationOps<Tune>::execute_sum_row;
+  table.execute_wta_row = &WinnerTakesAllOps<Tune>::execute_row;
+  table.execute_wta_subpixel_row =
+    &WinnerTakesAllOps<Tune>::execute_subpixel_row;
+  table.execute_wta_right_row = &WinnerTakesAllOps<Tune>::execute_right_row;
+  table.execute_lr_check = &WinnerTakesAllOps<Tune>::execute_lr_check;
+  return table;
+}
+
+template <>
+class CensusOps<tune::Dispatch> {
+
+ public:
+  using tune = tune::Dispatch;
+  using input_type = typename CensusTransform<tune>::input_type;
+
+  static void execute_census(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      PixelFormat format = PixelFormat::GRAY,
+      CensusBorder border = CensusBorder::CROP) {
+
+    active_kernels().execute_census(
+        src, dst, width, height, src_pitch, dst_pitch, format, border);
+  }
+
+  static int min_width() {
+    return active_kernels().census_min_width;
+  }
+
+  static int min_height() {
+    return active_kernels().census_min_height;
+  }
+
+  static int band_rows() {
+    return active_kernels().census_band_rows;
+  }
+
+  static int band_height() {
+    return active_kernels().census_band_height;
+  }
+
+  static int min_band_width() {
+    return active_kernels().census_min_band_width;
+  }
+
+  static int census_blocks(int width, int height) {
+    return active_kernels().census_blocks(width, height);
+  }
+
+  static std::vector<int> roi_blocks(
+      int width,
+      int height,
+      const std::vector<Rect> &rois) {
+
+    return active_kernels().roi_blocks(width, height, rois);
+  }
+
+  static void execute_census_block(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      int block,
+      PixelFormat format = PixelFormat::GRAY) {
+
+    active_kernels().execute_census_block(
+        src, dst, width, height, src_pitch, dst_pitch, block, format);
+  }
+
+  static void execute_census_edge(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      CensusBorder border,
+      int edge,
+      PixelFormat format = PixelFormat::GRAY) {
+
+    active_kernels().execute_census_edge(src, dst, width, height, src_pitch,
+        dst_pitch, border, edge, format);
+  }
+
+  static void execute_band(
+      const input_type *const *rows,
+      feature_type *dst,
+      int width,
+      int dst_pitch) {
+
+    active_kernels().execute_census_band(rows, dst, width, dst_pitch);
+  }
+
+  static void extract_luma(const uint8_t *src, uint8_t *dst, int width) {
+    active_kernels().extract_luma(src, dst, width);
+  }
+
+  static void execute_census_rois(
+      const input_type *src,
+      feature_type *dst,
+      int width,
+      int height,
+      int src_pitch,
+      int dst_pitch,
+      const std::vector<Rect> &rois,
+      PixelFormat format = PixelFormat::GRAY) {
+
+    for (int block : roi_blocks(width, height, rois)) {
+      execute_census_block(src, dst, width, height, src_pitch, dst_pitch,
+          block, format);
+    }
+  }
+};
+
+template <>
+class PathAggregationOps<tune::Dispatch> {
+
+ public:
+  using tune = tune::Dispatch;
+
+  // those of the backends' consts that do not depend on the backend
+  struct consts {
+    static constexpr int max_cost = 32;
+  };
+
+  // runtime equivalent of consts::patch_size
+  static int patch_size() {
+    return active_kernels().cost_patch_size;
+  }
+
+  // The largest patch of any backend rather than the active one, so that
+  // a disparity_size accepted on one host is accepted on all of them.
+  static int disparity_multiple() {
+    return 64;
+  }
+
+  static void execute_cost_row(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int disparity_size,
+      const CostVolume &dst,
+      int min_disparity = 0) {
+
+    active_kernels().execute_cost_row(
+        left, right, width, disparity_size, dst, min_disparity);
+  }
+
+  static void execute_vertical_row(
+      const ConstCostVolume &cost,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      cost_sum_type *sum) {
+
+    active_kernels().execute_vertical_row(cost, width, valid_width,
+        disparity_size, p1, p2, n_paths, prev, cur, sum);
+  }
+
+  static void execute_vertical_stripe(
+      const ConstCostVolume &cost,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      int x_begin,
+      int x_end,
+      cost_sum_type *sum) {
+
+    active_kernels().execute_vertical_stripe(cost, width, valid_width,
+        disparity_size, p1, p2, n_paths, prev, cur, x_begin, x_end, sum);
+  }
+
+  static void execute_horizontal_row(
+      const ConstCostVolume &cost,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      bool reverse,
+      cost_sum_type *sum) {
+
+    active_kernels().execute_horizontal_row(cost, width, valid_width,
+        disparity_size, p1, p2, reverse, sum);
+  }
+
+  static void execute_fused_row(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      bool from_left,
+      bool from_right,
+      cost_sum_type *sum,
+      int min_disparity = 0) {
+
+    active_kernels().execute_fused_row(left, right, width, valid_width,
+        disparity_size, p1, p2, n_paths, prev, cur, from_left, from_right,
+        sum, min_disparity);
+  }
+
+  static void execute_fused_vertical_stripe(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      int n_paths,
+      const uint8_t *prev,
+      uint8_t *cur,
+      int x_begin,
+      int x_end,
+      cost_sum_type *sum,
+      int min_disparity = 0,
+      const ConstCostVolume &stored = ConstCostVolume(nullptr)) {
+
+    active_kernels().execute_fused_vertical_stripe(left, right, width,
+        valid_width, disparity_size, p1, p2, n_paths, prev, cur, x_begin,
+        x_end, sum, min_disparity, stored);
+  }
+
+  static void execute_fused_horizontal_row(
+      const feature_type *left,
+      const feature_type *right,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int p1,
+      int p2,
+      bool reverse,
+      cost_sum_type *sum,
+      int min_disparity = 0,
+      const ConstCostVolume &stored = ConstCostVolume(nullptr)) {
+
+    active_kernels().execute_fused_horizontal_row(left, right, width,
+        valid_width, disparity_size, p1, p2, reverse, sum, min_disparity,
+        stored);
+  }
+
+  static void execute_sum_row(
+      const cost_sum_type *src,
+      int size,
+      cost_sum_type *dst) {
+
+    active_kernels().execute_sum_row(src, size, dst);
+  }
+};
+
+template <>
+class WinnerTakesAllOps<tune::Dispatch> {
+
+ public:
+  using tune = tune::Dispatch;
+
+  static void execute_row(
+      const cost_sum_type *sum,
+      int width,
+      int disparity_size,
+      output_type *dst) {
+
+    active_kernels().execute_wta_row(sum, width, disparity_size, dst);
+  }
+
+  static void execute_subpixel_row(
+      const cost_sum_type *sum,
+      int width,
+      int disparity_size,
+      SubpixelFit fit,
+      int shift,
+      output_type *dst) {
+
+    active_kernels().execute_wta_subpixel_row(sum, width, disparity_size, fit,
+        shift, dst);
+  }
+
+  static void execute_right_row(
+      const cost_sum_type *sum,
+      int width,
+      int valid_width,
+      int disparity_size,
+      int min_disparity,
+      output_type invalid,
+      output_type *dst) {
+
+    active_kernels().execute_wta_right_row(sum, width, valid_width,
+        disparity_size, min_disparity, invalid, dst);
+  }
+
+  static void execute_lr_check(
+      output_type *left,
+      const output_type *right,
+      int width,
+      int min_disparity,
+      int max_diff,
+      output_type invalid,
+      int shift = 0) {
+
+    active_kernels().execute_lr_check(left, right, width, min_disparity,
+        max_diff, invalid, shift);
+  }
+};
+
+} // namespace detail
+} // namespace sgm_cpu
@@ -0,0 +1,19 @@
+// The portable baseline, built without extra instruction set flags.
+
+#include <dispatch.hpp>
+#include <tune/array128_tune.hpp>
+
+namespace sgm_cpu {
+
+template class detail::CensusOps<tune::Array128>;
+
+namespace detail {
+
+const KernelTable *kernel_table_array128() {
+  static const KernelTable table =
+    make_kernel_table<tune::Array128>(Backend::Array128);
+  return &table;
+}
+
+} // namespace detail
+} // namespace sgm_cpu
@@ -0,0 +1,38 @@
+// AVX-512 kernels, see dispatch/backend.hpp.
+
+#include <dispatch/backend.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+SGM_CPU_BEGIN_TARGET("avx512f,avx512bw,avx512vpopcntdq")
+#include <tune/avx512_tune.hpp>
+#include <detail/census_ops.hpp>
+#include <detail/path_aggregation_ops.hpp>
+#include <detail/winner_takes_all_ops.hpp>
+SGM_CPU_END_TARGET()
+#endif
+
+#include <dispatch.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+namespace sgm_cpu {
+
+template class detail::CensusOps<tune::Avx512>;
+
+} // namespace sgm_cpu
+#endif
+
+namespace sgm_cpu {
+namespace detail {
+
+const KernelTable *kernel_table_avx512() {
+#if defined(__x86_64__) || defined(__i386__)
+  static const KernelTable table =
+    make_kernel_table<tune::Avx512>(Backend::Avx512);
+  return &table;
+#else
+  return nullptr;
+#endif
+}
+
+} // namespace detail
+} // namespace sgm_cpu
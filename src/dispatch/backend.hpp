@@ -0,0 +1,54 @@
+#pragma once
+
+// Included first by each dispatch/<backend>.cpp. Those are built for the
+// baseline like the rest of the library, and a backend's instruction sets
+// are enabled only between SGM_CPU_BEGIN_TARGET and SGM_CPU_END_TARGET,
+// around its tune and the ops headers. Whatever else a backend translation
+// unit defines, the standard library and the library's own inline
+// functions, is shared with the others and merged by the linker, which may
+// keep any one copy. So all of it is parsed here, before the pragma, and
+// every copy is baseline code. A pragma applies where a function is
+// defined, not where it is instantiated, so the standard templates the
+// kernels use stay baseline too.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <types.hpp>
+#include <census_window.hpp>
+#include <cost_layout.hpp>
+#include <thread_pool.hpp>
+#include <detail/aggregation_layout.hpp>
+
+// The simd headers check for their instruction sets, which the pragma does
+// not announce: GCC has lexed the translation unit before it applies it.
+#define SGM_CPU_TARGET_PRAGMA
+
+#define SGM_CPU_PRAGMA(x) _Pragma(#x)
+
+#if defined(__clang__)
+#define SGM_CPU_BEGIN_TARGET(isa) \
+  SGM_CPU_PRAGMA(clang attribute push( \
+        __attribute__((target(isa))), apply_to = function))
+#define SGM_CPU_END_TARGET() SGM_CPU_PRAGMA(clang attribute pop)
+#else
+#define SGM_CPU_BEGIN_TARGET(isa) \
+  SGM_CPU_PRAGMA(GCC push_options) \
+  SGM_CPU_PRAGMA(GCC target(isa))
+#define SGM_CPU_END_TARGET() SGM_CPU_PRAGMA(GCC pop_options)
+#endif
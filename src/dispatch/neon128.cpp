@@ -0,0 +1,36 @@
+// NEON kernels, part of the AArch64 baseline, see dispatch/backend.hpp.
+
+#include <dispatch/backend.hpp>
+
+#if defined(__aarch64__)
+#include <tune/neon128_tune.hpp>
+#include <detail/census_ops.hpp>
+#include <detail/path_aggregation_ops.hpp>
+#include <detail/winner_takes_all_ops.hpp>
+#endif
+
+#include <dispatch.hpp>
+
+#if defined(__aarch64__)
+namespace sgm_cpu {
+
+template class detail::CensusOps<tune::Neon128>;
+
+} // namespace sgm_cpu
+#endif
+
+namespace sgm_cpu {
+namespace detail {
+
+const KernelTable *kernel_table_neon128() {
+#if defined(__aarch64__)
+  static const KernelTable table =
+    make_kernel_table<tune::Neon128>(Backend::Neon128);
+  return &table;
+#else
+  return nullptr;
+#endif
+}
+
+} // namespace detail
+} // namespace sgm_cpu
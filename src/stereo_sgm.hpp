@@ -0,0 +1,248 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <types.hpp>
+#include <census_transform.hpp>
+#include <census_window.hpp>
+#include <thread_pool.hpp>
+
+namespace sgm_cpu {
+
+// SCAN_5PATH takes the three paths from above and both paths along the row.
+// Lacking the paths from below it matches less well, but it needs a single
+// sweep over the image and keeps only one row of cost and sums.
+enum class PathType {
+  SCAN_4PATH,
+  SCAN_8PATH,
+  SCAN_5PATH,
+};
+
+// Semi-global matching of a rectified 8-bit image pair: census transform,
+// Hamming matching cost, min-plus path aggregation over 4, 5 or 8
+// directions and a winner-takes-all disparity per pixel.
+template <class Arch>
+class StereoSGM {
+
+ public:
+  using input_type = typename CensusTransform<Arch>::input_type;
+  using feature_type = typename CensusTransform<Arch>::feature_type;
+
+  // Set the fields that differ from the defaults:
+  //
+  //   Parameters param;
+  //   param.path_type = PathType::SCAN_4PATH;
+  //   param.fused = true;
+  struct Parameters {
+    // penalties for a disparity change of one, and of more than one.
+    // 0 <= P1 <= P2 <= 223 keeps path costs within 8 bits, 191 for the
+    // 64-bit descriptors of CensusWindow11x9.
+    int P1 = 10;
+    int P2 = 120;
+    PathType path_type = PathType::SCAN_8PATH;
+
+    // Compute the matching cost inside the aggregation kernels rather than
+    // storing the width x height x disparity_size cost volume. The second
+    // sweep of SCAN_4PATH and SCAN_8PATH computes it again.
+    bool fused = false;
+
+    // Layout of both input images, see PixelFormat
+    PixelFormat pixel_format = PixelFormat::GRAY;
+
+    // Any but CROP matches and outputs disparities up to the image edge,
+    // from a full size census, see CensusBorder
+    CensusBorder census_border = CensusBorder::CROP;
+
+    // Disparities searched are min_disparity to min_disparity +
+    // disparity_size - 1, and output as such. Any value >= 0 that keeps
+    // them below invalid_disparity in 16 bits.
+    int min_disparity = 0;
+
+    // How the stored cost volume holds each cost, see CostPacking. Packed,
+    // the volume takes 3/4 or 1/2 of the bytes, at the price of unpacking
+    // on every read. FOUR_BIT saturates costs at cost_clamp (at most 15),
+    // which changes the disparities a little. Nothing is stored when fused,
+    // which neither packs nor clamps. SCAN_5PATH over a thread pool stores
+    // nothing either, but clamps the same.
+    // Where the costs go is the tune's cost layout (see cost_layout.hpp),
+    // and the pixel-major one takes BYTE only.
+    CostPacking cost_packing = CostPacking::BYTE;
+    int cost_clamp = 15;
+
+    // Left-right consistency check: disparities of the right image are
+    // taken from the same aggregated sums, and a left pixel is output as
+    // invalid_disparity unless the right pixel it matches agrees within
+    // lr_max_diff. Drops occlusions and most mismatches, for one more
+    // winner-takes-all per row.
+    bool lr_check = false;
+    int lr_max_diff = 1;
+
+    // Anything but NONE refines each disparity from the summed costs of its
+    // neighbours as the winner-takes-all finds it, and outputs it in fixed
+    // point, times subpixel_scale. min_disparity + disparity_size must then
+    // be below 4096, invalid_disparity stays as it is.
+    SubpixelFit subpixel = SubpixelFit::NONE;
+  };
+
+ private:
+  using window = detail::census_window_t<Arch>;
+
+  int m_width;
+  int m_height;
+  int m_disparity_size;
+  Parameters m_param;
+
+  // census output size, and its width padded for the aggregation kernels
+  int m_feature_width;
+  int m_feature_height;
+  int m_padded_width;
+
+  CensusTransform<Arch> m_census_left;
+  CensusTransform<Arch> m_census_right;
+
+  // per row: disparity_size rows of padded_width values, fewer when packed
+  // (see CostVolumeLayout). A single row with SCAN_5PATH, and no cost at
+  // all when fused.
+  std::unique_ptr<cost_type[]> m_cost;
+  std::unique_ptr<cost_sum_type[]> m_cost_sum;
+
+  // Previous and current row of the vertical and diagonal paths, for the
+  // sweeps down and up the image which run together over a thread pool.
+  std::unique_ptr<uint8_t[]> m_path_state;
+
+  // one padded row of disparities per concurrent winner-takes-all, two
+  // with the left-right check, the right row following the left
+  std::vector<output_type> m_disparity_rows;
+
+  // the stripes of the vertical paths over a thread pool, see stripe_spans
+  std::vector<int> m_stripe_begin;
+
+ public:
+  // output by the left-right check for the pixels it rejects
+  static constexpr output_type invalid_disparity = 0xffff;
+
+  // fractional bits of disparities with a subpixel fit
+  static constexpr int subpixel_shift = 4;
+  static constexpr int subpixel_scale = 1 << subpixel_shift;
+
+  // disparity_size must be a multiple of the backend patch size (16, 32 or
+  // 64; always 64 with tune::Dispatch, whichever backend the host selects),
+  // and at most 256. All buffers are allocated here, for thread pools of up
+  // to one thread per hardware thread. A larger pool grows the per-thread
+  // ones once, on its first frame.
+  StereoSGM(
+      int width,
+      int height,
+      int disparity_size,
+      const Parameters &param = Parameters());
+
+  // Writes a width x height disparity map to dst. Unless census_border is
+  // set, the census window does not fit over the image border, so the 4
+  // columns either side and 3 rows above and below (with the default 9x7
+  // window, half the window in general) are set to 0. Pitches of -1 mean
+  // width, src_pitch 2*width for YUYV.
+  void execute(
+      const input_type *left,
+      const input_type *right,
+      output_type *dst,
+      int src_pitch = -1,
+      int dst_pitch = -1);
+
+  // As above, with the work shared out over pool. Rows are independent for
+  // the cost and the paths along them, and the paths down and up the image
+  // run together, each split into column stripes. The output is the same.
+  void execute(
+      const input_type *left,
+      const input_type *right,
+      output_type *dst,
+      int src_pitch,
+      int dst_pitch,
+      ThreadPool &pool);
+
+ private:
+  bool check_parameters() const;
+
+  bool is_single_sweep() const {
+    return m_param.path_type == PathType::SCAN_5PATH;
+  }
+
+  // offset of the census output in the image, none at full size
+  int border_x() const {
+    return (m_param.census_border == CensusBorder::CROP) ? window::width / 2 : 0;
+  }
+
+  int border_y() const {
+    return (m_param.census_border == CensusBorder::CROP) ?
+      window::height / 2 : 0;
+  }
+
+  // the default src_pitch, a packed row of pixels
+  int input_pitch() const {
+    return (m_param.pixel_format == PixelFormat::YUYV) ? 2*m_width : m_width;
+  }
+
+  void execute_two_sweeps(
+      const feature_type *left,
+      const feature_type *right,
+      output_type *dst,
+      int dst_pitch);
+
+  void execute_single_sweep(
+      const feature_type *left,
+      const feature_type *right,
+      output_type *dst,
+      int dst_pitch);
+
+  void execute_two_sweeps(
+      const feature_type *left,
+      const feature_type *right,
+      output_type *dst,
+      int dst_pitch,
+      ThreadPool &pool);
+
+  void execute_single_sweep(
+      const feature_type *left,
+      const feature_type *right,
+      output_type *dst,
+      int dst_pitch,
+      ThreadPool &pool);
+
+  // The disparities of a row of sums to row y of dst, through row (and
+  // the slot after it with the left-right check)
+  void select_row(
+      const cost_sum_type *sum,
+      output_type *row,
+      int y,
+      output_type *dst,
+      int dst_pitch) const;
+
+  // fractional bits of the output
+  int output_shift() const {
+    return (m_param.subpixel == SubpixelFit::NONE) ? 0 : subpixel_shift;
+  }
+
+  // the disparity rows a winner-takes-all needs
+  size_t row_slot() const {
+    return static_cast<size_t>(m_param.lr_check ? 2 : 1) * m_padded_width;
+  }
+
+  // a row of disparities to row y of dst, with the border columns zeroed
+  void store_row(
+      const output_type *row,
+      int y,
+      output_type *dst,
+      int dst_pitch) const;
+
+  // zeros the rows of dst above and below the census output
+  void store_border_rows(output_type *dst, int dst_pitch) const;
+
+  // Stripes of whole patches across the padded width, at most n_stripes of
+  // them. Returns the number, and stripe i is [x_begin[i], x_begin[i+1]).
+  int stripe_spans(int n_stripes, std::vector<int> &x_begin) const;
+};
+
+}
+
+#include <detail/stereo_sgm_impl.hpp>
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sgm_cpu {
+
+// Fixed set of worker threads for data-parallel loops. The calling thread
+// takes part in each loop, so a pool of size 1 has no workers and runs
+// everything inline.
+class ThreadPool {
+
+ public:
+  // n_threads counts the caller, 0 means one per hardware thread
+  explicit ThreadPool(int n_threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  int size() const {
+    return static_cast<int>(m_workers.size()) + 1;
+  }
+
+  // Calls task(i) for 0 <= i < n_tasks and returns once all have finished.
+  // Threads claim the next unclaimed index as they become free, so uneven
+  // tasks balance out. Called from inside a task, it runs inline.
+  void parallel_for(int n_tasks, const std::function<void(int)> &task);
+
+  // Process-wide pool with one thread per hardware thread, created on
+  // first use.
+  static ThreadPool &global();
+
+ private:
+  void worker_loop();
+  int run_tasks(const std::function<void(int)> &task, int n_tasks);
+
+  std::vector<std::thread> m_workers;
+
+  // one parallel_for at a time
+  std::mutex m_submit;
+
+  // guards everything below except m_next
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+
+  const std::function<void(int)> *m_task;
+  int m_n_tasks;
+  int m_finished;
+  int m_active;
+  unsigned m_generation;
+  bool m_stop;
+
+  std::atomic<int> m_next;
+};
+
+}
+
+#include <detail/thread_pool_impl.hpp>
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <array>
+
+#include <detail/simd/avx2_impl.hpp>
+
+namespace sgm_cpu {
+namespace tune {
+
+struct Avx2 {
+  using simd = detail::simd::avx2_impl;
+
+  struct census {
+    static constexpr int h_block = 64;
+    static constexpr int v_block = 64;
+
+    // one execute_patch_x2 iteration produces four rows
+    static constexpr int h_step = 8;
+    static constexpr int v_step = 4;
+  };
+};
+
+} // namespace tune
+} // namespace sgm_cpu
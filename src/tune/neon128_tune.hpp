@@ -0,0 +1,23 @@
+#pragma once
+
+#include <array>
+
+#include <detail/simd/neon_impl.hpp>
+
+namespace sgm_cpu {
+namespace tune {
+
+struct Neon128 {
+  using simd = detail::simd::neon_impl;
+
+  struct census {
+    static constexpr int h_block = 64;
+    static constexpr int v_block = 64;
+
+    static constexpr int h_step = 8;
+    static constexpr int v_step = 2;
+  };
+};
+
+} // namespace tune
+} // namespace sgm_cpu
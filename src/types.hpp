@@ -23,9 +23,39 @@ limitations under the License.
 
 namespace sgm_cpu {
 
+// descriptors of the default 9x7 census window, see census_window.hpp for
+// the others
 using feature_type = uint32_t;
 using cost_type = uint8_t;
 using cost_sum_type = uint16_t;
 using output_type = uint16_t;
 
+// How a stored cost volume holds each cost, 0 to 32 for 32-bit census
+// descriptors. SIX_BIT packs four disparities into three bytes exactly,
+// so it does not hold the costs of 64-bit descriptors, FOUR_BIT two into
+// one byte, saturated at a clamp of at most 15.
+enum class CostPacking {
+  BYTE,
+  SIX_BIT,
+  FOUR_BIT,
+};
+
+// Curve fitted through the summed costs of the best disparity and its two
+// neighbours to place the minimum between whole disparities. PARABOLA
+// suits smooth cost curves, EQUIANGULAR (two lines of equal and opposite
+// slope) the sharper ones of census costs.
+enum class SubpixelFit {
+  NONE,
+  PARABOLA,
+  EQUIANGULAR,
+};
+
+// A rectangle of pixels, (x, y) being its top left corner
+struct Rect {
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
 } // namespace sgm_cpu
@@ -0,0 +1,404 @@
+// Sweeps the census block and step sizes of every backend compiled in for
+// this host, with the row-major and the sliding 9x7 kernel, times
+// CensusOps::execute_census with each and writes the fastest as
+// tune/<name>_tune.hpp, e.g.
+//
+//   sgm_cpu_autotune --name workstation --output ../src/tune
+//
+// Options:
+//   --size WxH       frame to time, default 1920x1080
+//   --repeat N       runs per candidate, the fastest counts, default 10
+//   --backend NAME   only sweep this backend (array128, sse128, ...)
+//   --name NAME      of the tune, default the host name
+//   --output DIR     for the header, default the current directory
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <tune/array128_tune.hpp>
+
+#if defined(__SSSE3__)
+#include <tune/sse128_tune.hpp>
+#endif
+
+#if defined(__AVX2__)
+#include <tune/avx2_tune.hpp>
+#endif
+
+#if defined(__AVX512BW__) && defined(__AVX512VPOPCNTDQ__)
+#include <tune/avx512_tune.hpp>
+#endif
+
+#if defined(__aarch64__)
+#include <tune/neon128_tune.hpp>
+#endif
+
+#include <detail/census_ops.hpp>
+
+namespace sgm_cpu {
+namespace autotune {
+
+// A backend with other census sizes, and perhaps the sliding kernel
+template <class Base, int h_block_, int v_block_, int v_step_, bool sliding_>
+struct CandidateTune {
+  using simd = typename Base::simd;
+
+  struct census {
+    static constexpr int h_block = h_block_;
+    static constexpr int v_block = v_block_;
+
+    static constexpr int h_step = Base::census::h_step;
+    static constexpr int v_step = v_step_;
+
+    static constexpr bool sliding = sliding_;
+  };
+};
+
+static constexpr int block_sizes[] = { 32, 64, 128, 256 };
+static constexpr int n_block_sizes = sizeof(block_sizes) / sizeof(int);
+
+struct Options {
+  int width = 1920;
+  int height = 1080;
+  int repeat = 10;
+  std::string backend;
+  std::string name;
+  std::string output = ".";
+};
+
+struct Frame {
+  int width;
+  int height;
+  std::vector<uint8_t> image;
+  std::vector<feature_type> reference;
+  std::vector<feature_type> output;
+};
+
+struct Result {
+  std::string backend;
+  std::string base_type;
+  int h_block;
+  int v_block;
+  int h_step;
+  int v_step;
+  bool sliding;
+  double ms;
+  bool is_default;
+};
+
+template <class Tune>
+static double time_census(Frame &frame, int repeat) {
+  using Ops = detail::CensusOps<Tune>;
+
+  const char *src = reinterpret_cast<const char *>(frame.image.data());
+  const int dst_width = frame.width - 8;
+
+  double best = std::numeric_limits<double>::infinity();
+
+  for (int i = 0; i < repeat; i += 1) {
+    auto start = std::chrono::steady_clock::now();
+    Ops::execute_census(src, frame.output.data(), frame.width, frame.height,
+        frame.width, dst_width);
+    auto stop = std::chrono::steady_clock::now();
+
+    best = std::min(best,
+        std::chrono::duration<double, std::milli>(stop - start).count());
+  }
+
+  return best;
+}
+
+template <class Base>
+struct Sweep {
+  static constexpr int rows_per_x2 = Base::simd::reg::census_rows_per_x2;
+
+  static void run(const char *backend, const char *base_type, Frame &frame,
+      const Options &options, std::vector<Result> &results) {
+
+    sweep_v_step<1*rows_per_x2>(backend, base_type, frame, options, results);
+    sweep_v_step<2*rows_per_x2>(backend, base_type, frame, options, results);
+    sweep_v_step<3*rows_per_x2>(backend, base_type, frame, options, results);
+  }
+
+  template <int v_step>
+  static void sweep_v_step(const char *backend, const char *base_type,
+      Frame &frame, const Options &options, std::vector<Result> &results) {
+
+    sweep_blocks<v_step, false>(backend, base_type, frame, options, results,
+        std::make_index_sequence<n_block_sizes * n_block_sizes>());
+    sweep_blocks<v_step, true>(backend, base_type, frame, options, results,
+        std::make_index_sequence<n_block_sizes * n_block_sizes>());
+  }
+
+  template <int v_step, bool sliding, size_t... I>
+  static void sweep_blocks(const char *backend, const char *base_type,
+      Frame &frame, const Options &options, std::vector<Result> &results,
+      std::index_sequence<I...>) {
+
+    (measure<block_sizes[I / n_block_sizes], block_sizes[I % n_block_sizes],
+        v_step, sliding>(backend, base_type, frame, options, results), ...);
+  }
+
+  template <int h_block, int v_block, int v_step, bool sliding>
+  static void measure(const char *backend, const char *base_type,
+      Frame &frame, const Options &options, std::vector<Result> &results) {
+
+    // outside the space CensusOps accepts
+    if constexpr (v_block >= v_step + 6) {
+      using Tune = CandidateTune<Base, h_block, v_block, v_step, sliding>;
+
+      std::fill(frame.output.begin(), frame.output.end(), 0);
+      double ms = time_census<Tune>(frame, options.repeat);
+
+      Result result = { backend, base_type, h_block, v_block,
+        Tune::census::h_step, v_step, sliding, ms, !sliding &&
+        (h_block == Base::census::h_block) &&
+        (v_block == Base::census::v_block) &&
+        (v_step == Base::census::v_step) };
+
+      std::cout << std::setw(10) << backend <<
+        std::setw(9) << h_block << std::setw(9) << v_block <<
+        std::setw(8) << v_step << std::setw(9) << (sliding ? "yes" : "no") <<
+        std::setw(12) << std::fixed <<
+        std::setprecision(3) << ms << (result.is_default ? "  default" : "");
+
+      if (frame.output != frame.reference) {
+        std::cout << "  wrong output, skipped\n";
+        return;
+      }
+
+      std::cout << "\n";
+      results.push_back(result);
+    }
+  }
+};
+
+template <class Base>
+static void sweep(const char *backend, const char *base_type, Frame &frame,
+    const Options &options, std::vector<Result> &results) {
+
+  if (options.backend.empty() || (options.backend == backend)) {
+    Sweep<Base>::run(backend, base_type, frame, options, results);
+  }
+}
+
+// lower case letters, digits and underscores
+static std::string file_name(const std::string &name) {
+  std::string out;
+  for (char c : name) {
+    out += std::isalnum(static_cast<unsigned char>(c)) ?
+      static_cast<char>(std::tolower(static_cast<unsigned char>(c))) : '_';
+  }
+  return out;
+}
+
+// "my-host.lan" -> MyHostLan
+static std::string type_name(const std::string &name) {
+  std::string out;
+  bool upper = true;
+  for (char c : name) {
+    if (!std::isalnum(static_cast<unsigned char>(c))) {
+      upper = true;
+      continue;
+    }
+    out += upper ?
+      static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : c;
+    upper = false;
+  }
+  if (out.empty() || std::isdigit(static_cast<unsigned char>(out[0]))) {
+    out = "Host" + out;
+  }
+  return out;
+}
+
+static bool write_header(const std::string &path, const std::string &name,
+    const Result &best, const Result &baseline, const Options &options) {
+
+  std::ofstream out(path);
+  if (!out) {
+    return false;
+  }
+
+  out << "#pragma once\n"
+    "\n"
+    "// Generated by sgm_cpu_autotune for " << name << ".\n"
+    "// execute_census on a " << options.width << "x" << options.height <<
+    " frame took " << std::fixed << std::setprecision(2) << best.ms <<
+    " ms, against " << baseline.ms << " ms\n"
+    "// with tune::" << baseline.base_type << ". Regenerate rather than "
+    "edit.\n"
+    "\n"
+    "#include <tune/" << best.backend << "_tune.hpp>\n"
+    "\n"
+    "namespace sgm_cpu {\n"
+    "namespace tune {\n"
+    "\n"
+    "struct " << type_name(name) << " {\n"
+    "  using simd = " << best.base_type << "::simd;\n"
+    "\n"
+    "  struct census {\n"
+    "    static constexpr int h_block = " << best.h_block << ";\n"
+    "    static constexpr int v_block = " << best.v_block << ";\n"
+    "\n"
+    "    static constexpr int h_step = " << best.h_step << ";\n"
+    "    static constexpr int v_step = " << best.v_step << ";\n" <<
+    (best.sliding ? "\n    static constexpr bool sliding = true;\n" : "") <<
+    "  };\n"
+    "};\n"
+    "\n"
+    "} // namespace tune\n"
+    "} // namespace sgm_cpu\n";
+
+  return static_cast<bool>(out);
+}
+
+static bool parse_options(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i += 1) {
+    const char *arg = argv[i];
+    const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+    static const char *known[] = {
+      "--size", "--repeat", "--backend", "--name", "--output" };
+
+    if (std::none_of(std::begin(known), std::end(known),
+          [arg](const char *k) { return std::strcmp(arg, k) == 0; })) {
+      std::cerr << "sgm_cpu_autotune: unknown option " << arg << "\n";
+      return false;
+    }
+
+    if (value == nullptr) {
+      std::cerr << "sgm_cpu_autotune: " << arg << " needs a value\n";
+      return false;
+    }
+
+    if (std::strcmp(arg, "--size") == 0) {
+      if ((std::sscanf(value, "%dx%d", &options.width, &options.height) != 2) ||
+          (options.width < 64) || (options.height < 64)) {
+        std::cerr << "sgm_cpu_autotune: --size must be WxH, at least 64x64\n";
+        return false;
+      }
+    } else if (std::strcmp(arg, "--repeat") == 0) {
+      options.repeat = std::max(1, std::atoi(value));
+    } else if (std::strcmp(arg, "--backend") == 0) {
+      options.backend = value;
+    } else if (std::strcmp(arg, "--name") == 0) {
+      options.name = value;
+    } else {
+      options.output = value;
+    }
+
+    i += 1;
+  }
+
+  if (options.name.empty()) {
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+    options.name = host[0] ? host : "host";
+  }
+
+  return true;
+}
+
+static int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    return 1;
+  }
+
+  Frame frame;
+  frame.width = options.width;
+  frame.height = options.height;
+
+  std::minstd_rand0 rng;
+  std::uniform_int_distribution<int> dist(0, 255);
+  frame.image.resize(static_cast<size_t>(frame.width) * frame.height);
+  for (uint8_t &p : frame.image) {
+    p = dist(rng);
+  }
+
+  const size_t n_features =
+    static_cast<size_t>(frame.width - 8) * (frame.height - 6);
+  frame.reference.resize(n_features);
+  frame.output.resize(n_features);
+
+  // every candidate must reproduce the baseline
+  detail::CensusOps<tune::Array128>::execute_census(
+      reinterpret_cast<const char *>(frame.image.data()),
+      frame.reference.data(), frame.width, frame.height, frame.width,
+      frame.width - 8);
+
+  std::cout <<
+    "   backend  h_block  v_block  v_step  sliding     time/ms\n";
+
+  std::vector<Result> results;
+
+  sweep<tune::Array128>("array128", "Array128", frame, options, results);
+#if defined(__SSSE3__)
+  sweep<tune::Sse128>("sse128", "Sse128", frame, options, results);
+#endif
+#if defined(__AVX2__)
+  sweep<tune::Avx2>("avx2", "Avx2", frame, options, results);
+#endif
+#if defined(__AVX512BW__) && defined(__AVX512VPOPCNTDQ__)
+  sweep<tune::Avx512>("avx512", "Avx512", frame, options, results);
+#endif
+#if defined(__aarch64__)
+  sweep<tune::Neon128>("neon128", "Neon128", frame, options, results);
+#endif
+
+  if (results.empty()) {
+    std::cerr << "sgm_cpu_autotune: no candidates for backend " <<
+      options.backend << "\n";
+    return 1;
+  }
+
+  auto faster = [](const Result &a, const Result &b) { return a.ms < b.ms; };
+  const Result &best = *std::min_element(results.begin(), results.end(),
+      faster);
+
+  // the stock tune of the winning backend
+  const Result *baseline = &best;
+  for (const Result &result : results) {
+    if (result.is_default && (result.backend == best.backend)) {
+      baseline = &result;
+    }
+  }
+
+  const std::string path =
+    options.output + "/" + file_name(options.name) + "_tune.hpp";
+
+  if (!write_header(path, options.name, best, *baseline, options)) {
+    std::cerr << "sgm_cpu_autotune: could not write " << path << "\n";
+    return 1;
+  }
+
+  std::cout << "\nfastest: " << best.backend << " h_block " << best.h_block <<
+    " v_block " << best.v_block << " v_step " << best.v_step <<
+    (best.sliding ? " sliding" : "") << ", " <<
+    best.ms << " ms against " << baseline->ms << " ms\n" <<
+    "wrote tune::" << type_name(options.name) << " to " << path << "\n";
+
+  return 0;
+}
+
+} // namespace autotune
+} // namespace sgm_cpu
+
+int main(int argc, char **argv) {
+  return sgm_cpu::autotune::main(argc, argv);
+}